@@ -6,6 +6,7 @@
 #include <include/mem.h>
 #include <tty/include/tty.h>
 #include <int/include/apic.h>
+#include <int/include/irq_domain.h>
 
 acpi_xsdt_t *__acpi_xsdt;
 acpi_fadt_t *__acpi_fadt;
@@ -115,6 +116,12 @@ void acpi_switch_madt_entry(void *entry, acpi_madt_entry_type type) {
             //printf("LAPIC: cpuid %d - lapic id %d\n", lapic->acpi_cpu_id, lapic->apic_id);
             break;
 
+        //defines a local apic with a 32 bit id (x2apic)
+        case local_x2apic:
+            acpi_madt_entry_local_x2apic *x2apic = (acpi_madt_entry_local_x2apic *) entry;
+            save_lapic_info(x2apic->local_x2apic_id, x2apic->acpi_id, x2apic->flags);
+            break;
+
         //defines an i/o apic
         case io_apic:
             acpi_madt_entry_io_apic *ioapic = (acpi_madt_entry_io_apic *) entry;
@@ -125,8 +132,7 @@ void acpi_switch_madt_entry(void *entry, acpi_madt_entry_type type) {
         //defines an i/o interrupt map to the gsi
         case ioapic_int_map:
             acpi_madt_entry_io_source_override *io_source_override = (acpi_madt_entry_io_source_override *) entry;
-            extern uint8_t gsi_map[]; //defined in int.c
-            gsi_map[io_source_override->irq_source] = io_source_override->global_system_interrupt;
+            irq_isa_override(io_source_override->irq_source, io_source_override->global_system_interrupt, io_source_override->flags);
             //printf("ioapic int map %d -> %d\n", io_source_override->irq_source, io_source_override->global_system_interrupt);
             break;
 
@@ -214,4 +214,14 @@ typedef struct {
     acpi_table_header h;
     uint64_t reserved;
     acpi_mcfg_entry_t entries[];
-} __attribute__((packed)) acpi_mcfg_t;
\ No newline at end of file
+} __attribute__((packed)) acpi_mcfg_t;
+
+//high precision event timer description table
+typedef struct {
+    acpi_table_header h;
+    uint32_t event_timer_block_id; //copy of the capabilities register (low half)
+    acpi_gas_t base_address;
+    uint8_t hpet_number;
+    uint16_t minimum_tick; //minimum counts between two periodic interrupts
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
\ No newline at end of file
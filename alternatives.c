@@ -0,0 +1,42 @@
+/*
+Boot-time code patching of the static call trampolines (see include/alternatives.h).
+*/
+
+#include <include/types.h>
+#include <include/alternatives.h>
+#include <include/low_level.h>
+
+#define CR0_WP (1 << 16)
+#define JMP_REL32_OPCODE 0xE9
+
+/*
+Redirects a trampoline to target.
+Returns false if the address is not a trampoline or if target is too far for a rel32 jump.
+Interrupts are disabled while the code is patched, so no interrupt handler can run the half written jump.
+*/
+bool static_call_update(void *trampoline, void *target) {
+    if (!trampoline || !target || *(uint8_t *) trampoline != JMP_REL32_OPCODE) {
+        return false;
+    }
+
+    long rel = (long) target - (long)(trampoline + 5);
+
+    if (rel != (long)(int) rel) {
+        return false;
+    }
+
+    bool int_enabled = save_disable_int();
+
+    //the kernel text could be mapped read only, clear CR0.WP while writing
+    uint64_t cr0 = get_cr0();
+    set_cr0(cr0 & ~CR0_WP);
+    *(volatile uint32_t *)(trampoline + 1) = (uint32_t) rel;
+    set_cr0(cr0);
+
+    //cpuid is serializing, the next fetch of the trampoline sees the new jump
+    cpuid(0, null, null, null, null);
+
+    restore_int(int_enabled);
+
+    return true;
+}
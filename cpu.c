@@ -0,0 +1,241 @@
+/*
+CPU feature registry.
+cpu_features_init() queries CPUID once at boot and caches everything the kernel needs (vendor, family/model, feature flags, cache and TLB geometry),
+after that the rest of the kernel uses cpu_has() instead of issuing CPUID.
+*/
+
+#include <include/types.h>
+#include <include/cpu.h>
+#include <include/low_level.h>
+#include <tty/include/tty.h>
+
+cpu_features_t cpu_features;
+
+//maps a cpuid register bit to a feature
+typedef struct {
+    uint32_t leaf, subleaf;
+    uint8_t reg; //0 eax, 1 ebx, 2 ecx, 3 edx
+    uint8_t bit;
+    cpu_feature_t feature;
+} cpu_feature_bit_t;
+
+static const cpu_feature_bit_t cpu_feature_bits[] = {
+    {0x1, 0, 3, 4, CPU_FEATURE_TSC},
+    {0x1, 0, 3, 9, CPU_FEATURE_APIC},
+    {0x1, 0, 3, 13, CPU_FEATURE_PGE},
+    {0x1, 0, 3, 24, CPU_FEATURE_FXSR},
+    {0x1, 0, 3, 26, CPU_FEATURE_SSE2},
+    {0x1, 0, 2, 1, CPU_FEATURE_PCLMUL},
+    {0x1, 0, 2, 17, CPU_FEATURE_PCID},
+    {0x1, 0, 2, 20, CPU_FEATURE_SSE42},
+    {0x1, 0, 2, 21, CPU_FEATURE_X2APIC},
+    {0x1, 0, 2, 24, CPU_FEATURE_TSC_DEADLINE},
+    {0x1, 0, 2, 25, CPU_FEATURE_AES},
+    {0x1, 0, 2, 26, CPU_FEATURE_XSAVE},
+    {0x1, 0, 2, 28, CPU_FEATURE_AVX},
+    {0x1, 0, 2, 30, CPU_FEATURE_RDRAND},
+    {0x1, 0, 2, 31, CPU_FEATURE_HYPERVISOR},
+    {0x7, 0, 1, 5, CPU_FEATURE_AVX2},
+    {0x7, 0, 1, 9, CPU_FEATURE_ERMS},
+    {0x7, 0, 1, 10, CPU_FEATURE_INVPCID},
+    {0x7, 0, 1, 18, CPU_FEATURE_RDSEED},
+    {0x7, 0, 1, 29, CPU_FEATURE_SHA},
+    {0x7, 0, 2, 16, CPU_FEATURE_LA57},
+    {0x7, 0, 3, 4, CPU_FEATURE_FSRM},
+    {0xD, 1, 0, 0, CPU_FEATURE_XSAVEOPT},
+    {0x80000001, 0, 3, 20, CPU_FEATURE_NX},
+    {0x80000001, 0, 3, 26, CPU_FEATURE_PAGE_1GB},
+    {0x80000007, 0, 3, 8, CPU_FEATURE_INVARIANT_TSC}
+};
+
+//associativity of the AMD L2 TLBs (cpuid 0x80000006), 0 means fully associative or unknown
+static const uint16_t amd_l2_assoc[16] = {0, 1, 2, 3, 4, 0, 6, 0, 16, 0, 32, 48, 64, 96, 128, 0};
+
+static void cpu_read_vendor() {
+    uint32_t regs[3];
+    cpuid(0, &cpu_features.max_leaf, &regs[0], &regs[2], &regs[1]); //the string is in ebx, edx, ecx
+
+    for (uint8_t i = 0; i < 12; i++) {
+        cpu_features.vendor_string[i] = (char)(regs[i / 4] >> (i % 4 * 8));
+    }
+
+    cpu_features.vendor_string[12] = '\0';
+
+    //compare the first register only, it's enough to tell the vendors apart
+    if (regs[0] == 0x756E6547) { //"Genu"
+        cpu_features.vendor = cpu_vendor_intel;
+    } else if (regs[0] == 0x68747541) { //"Auth"
+        cpu_features.vendor = cpu_vendor_amd;
+    } else {
+        cpu_features.vendor = cpu_vendor_unknown;
+    }
+
+    cpuid(0x80000000, &cpu_features.max_ext_leaf, null, null, null);
+
+    if (cpu_features.max_ext_leaf < 0x80000000) {
+        cpu_features.max_ext_leaf = 0;
+    }
+}
+
+static void cpu_read_signature() {
+    uint32_t eax;
+    cpuid(1, &eax, null, null, null);
+    uint32_t family = eax >> 8 & 0xF;
+    uint32_t model = eax >> 4 & 0xF;
+
+    if (family == 0xF) {
+        family += eax >> 20 & 0xFF;
+    }
+
+    if (family == 0x6 || family >= 0xF) {
+        model += (eax >> 16 & 0xF) << 4;
+    }
+
+    cpu_features.family = family;
+    cpu_features.model = model;
+    cpu_features.stepping = eax & 0xF;
+}
+
+static void cpu_read_flags() {
+    cpu_features.flags = 0;
+
+    for (uint32_t i = 0; i < sizeof(cpu_feature_bits) / sizeof(cpu_feature_bit_t); i++) {
+        const cpu_feature_bit_t *entry = &cpu_feature_bits[i];
+        uint32_t max = entry->leaf >= 0x80000000 ? cpu_features.max_ext_leaf : cpu_features.max_leaf;
+
+        if (entry->leaf > max) {
+            continue;
+        }
+
+        uint32_t regs[4];
+        cpuid_count(entry->leaf, entry->subleaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+
+        if (regs[entry->reg] >> entry->bit & 1) {
+            cpu_features.flags |= (uint64_t) 1 << entry->feature;
+        }
+    }
+
+    if (cpu_features.max_ext_leaf >= 0x80000008) {
+        uint32_t eax;
+        cpuid(0x80000008, &eax, null, null, null);
+        cpu_features.physical_address_bits = eax & 0xFF;
+        cpu_features.virtual_address_bits = eax >> 8 & 0xFF;
+    }
+}
+
+//reads the deterministic cache parameters (cpuid 4 on Intel, 0x8000001D on AMD, same format)
+static void cpu_read_caches() {
+    uint32_t leaf;
+    cpu_features.caches_count = 0;
+
+    if (cpu_features.vendor == cpu_vendor_amd && cpu_features.max_ext_leaf >= 0x8000001D) {
+        leaf = 0x8000001D;
+    } else if (cpu_features.max_leaf >= 4) {
+        leaf = 4;
+    } else {
+        return;
+    }
+
+    for (uint32_t i = 0; cpu_features.caches_count < CPU_MAX_CACHES; i++) {
+        uint32_t eax, ebx, ecx;
+        cpuid_count(leaf, i, &eax, &ebx, &ecx, null);
+
+        if ((eax & 0x1F) == 0) {
+            break; //no more caches
+        }
+
+        cpu_cache_t *cache = &cpu_features.caches[cpu_features.caches_count++];
+        cache->type = eax & 0x1F;
+        cache->level = eax >> 5 & 0x7;
+        cache->line_size = (ebx & 0xFFF) + 1;
+        cache->ways = (ebx >> 22) + 1;
+        cache->sets = ecx + 1;
+        cache->size = cache->ways * ((ebx >> 12 & 0x3FF) + 1) * cache->line_size * cache->sets;
+    }
+}
+
+static void cpu_add_tlb(uint8_t type, uint8_t level, uint8_t page_sizes, uint16_t ways, uint32_t entries) {
+    if (cpu_features.tlbs_count == CPU_MAX_TLBS || entries == 0) {
+        return;
+    }
+
+    cpu_tlb_t *tlb = &cpu_features.tlbs[cpu_features.tlbs_count++];
+    tlb->type = type;
+    tlb->level = level;
+    tlb->page_sizes = page_sizes;
+    tlb->ways = ways;
+    tlb->entries = entries;
+}
+
+//reads the TLB geometry (cpuid 0x18 on Intel, 0x80000005/0x80000006 on AMD)
+static void cpu_read_tlbs() {
+    cpu_features.tlbs_count = 0;
+
+    if (cpu_features.vendor == cpu_vendor_amd && cpu_features.max_ext_leaf >= 0x80000006) {
+        uint32_t ebx;
+        cpuid(0x80000005, null, &ebx, null, null); //L1 4K tlbs
+        cpu_add_tlb(cpu_cache_data, 1, CPU_TLB_4K, ebx >> 24 == 0xFF ? 0 : ebx >> 24, ebx >> 16 & 0xFF);
+        cpu_add_tlb(cpu_cache_instruction, 1, CPU_TLB_4K, (ebx >> 8 & 0xFF) == 0xFF ? 0 : ebx >> 8 & 0xFF, ebx & 0xFF);
+        cpuid(0x80000006, null, &ebx, null, null); //L2 4K tlbs
+        cpu_add_tlb(cpu_cache_data, 2, CPU_TLB_4K, amd_l2_assoc[ebx >> 28], ebx >> 16 & 0xFFF);
+        cpu_add_tlb(cpu_cache_instruction, 2, CPU_TLB_4K, amd_l2_assoc[ebx >> 12 & 0xF], ebx & 0xFFF);
+        return;
+    }
+
+    if (cpu_features.max_leaf < 0x18) {
+        return;
+    }
+
+    uint32_t max_subleaf;
+    cpuid_count(0x18, 0, &max_subleaf, null, null, null);
+
+    for (uint32_t i = 0; i <= max_subleaf; i++) {
+        uint32_t ebx, ecx, edx;
+        cpuid_count(0x18, i, null, &ebx, &ecx, &edx);
+        uint8_t type = edx & 0x1F;
+
+        if (type == 0) {
+            continue; //invalid subleaf
+        }
+
+        //load only and store only tlbs are counted as data tlbs
+        bool fully_associative = edx >> 8 & 1;
+        cpu_add_tlb(type > 3 ? cpu_cache_data : type, edx >> 5 & 0x7, ebx & 0xF, fully_associative ? 0 : ebx >> 16, (ebx >> 16) * ecx);
+    }
+}
+
+void cpu_features_init() {
+    cpu_read_vendor();
+    cpu_read_signature();
+    cpu_read_flags();
+    cpu_read_caches();
+    cpu_read_tlbs();
+}
+
+void cpu_print_info() {
+    static const char *cache_types[] = {"?", "data", "instruction", "unified"};
+    static const char *feature_names[] = {
+        "tsc", "apic", "pge", "fxsr", "sse2", "pclmul", "sse4.2", "pcid", "x2apic", "tsc-deadline", "aes", "xsave", "avx", "rdrand",
+        "hypervisor", "avx2", "erms", "invpcid", "rdseed", "sha", "la57", "fsrm", "xsaveopt", "nx", "1g-pages", "invariant-tsc"
+    };
+
+    printf("%s family 0x%X model 0x%X stepping %d\n", cpu_features.vendor_string, cpu_features.family, cpu_features.model, cpu_features.stepping);
+
+    for (uint32_t i = 0; i < sizeof(feature_names) / sizeof(char *); i++) {
+        if (cpu_has(i)) {
+            printf("%s ", feature_names[i]);
+        }
+    }
+
+    printf("\n");
+
+    for (uint8_t i = 0; i < cpu_features.caches_count; i++) {
+        cpu_cache_t *cache = &cpu_features.caches[i];
+        printf("L%d %s: %d KiB, %d ways, %d byte lines\n", cache->level, cache_types[cache->type & 3], cache->size / 1024, cache->ways, cache->line_size);
+    }
+
+    for (uint8_t i = 0; i < cpu_features.tlbs_count; i++) {
+        cpu_tlb_t *tlb = &cpu_features.tlbs[i];
+        printf("L%d %s tlb: %d entries, %d ways\n", tlb->level, cache_types[tlb->type & 3], tlb->entries, tlb->ways);
+    }
+}
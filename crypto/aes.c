@@ -0,0 +1,410 @@
+/*
+AES (FIPS 197) and the XTS mode (IEEE 1619) used to encrypt disk sectors.
+The portable implementation uses round tables built at boot (aes_select()), aes_xts_crypt() is a static call patched to the AES-NI
+version on cpus that have it. The AES-NI version encrypts 4 blocks at a time: aesenc has a latency of about 4 cycles and a throughput
+of 1, so 4 independent blocks keep the unit busy.
+XTS: every sector is a data unit, the tweak is the sector number encrypted with the tweak key and it's multiplied by x in GF(2^128)
+for every block of the sector, so equal plaintext blocks encrypt differently in every position of the disk.
+*/
+
+#include <include/types.h>
+#include <crypto/include/aes.h>
+#include <include/fpu.h>
+#include <include/cpu.h>
+#include <include/alternatives.h>
+
+#define XTS_POLY 0x87 //x^128 = x^7 + x^2 + x + 1
+
+typedef uint64_t v2du __attribute__((vector_size(16)));
+typedef v2du v2du_unaligned __attribute__((aligned(1)));
+
+//the blocks are accessed as bytes, 32 and 64 bits words
+typedef uint32_t aes_u32 __attribute__((may_alias, aligned(1)));
+typedef uint64_t aes_u64 __attribute__((may_alias, aligned(1)));
+
+uint8_t aes_sbox[256];
+uint8_t aes_inv_sbox[256];
+uint32_t aes_te[256]; //MixColumns column of the s-box output (big endian word), rotated for the other rows
+uint32_t aes_td[256]; //InvMixColumns column of the inverse s-box output
+bool aes_tables_ready = false;
+bool aes_ni = false;
+
+bool aes_xts_crypt(const aes_xts_key_t *key, uint64_t sector, uint8_t *dst, const uint8_t *src, uint64_t sectors, uint32_t sector_size, bool encrypt);
+bool aes_xts_crypt_generic(const aes_xts_key_t *key, uint64_t sector, uint8_t *dst, const uint8_t *src, uint64_t sectors, uint32_t sector_size, bool encrypt);
+
+//the implementation is selected by aes_select() patching this trampoline
+STATIC_CALL(aes_xts_crypt, aes_xts_crypt_generic)
+
+static inline uint8_t aes_rol8(uint8_t x, uint8_t n) {
+    return x << n | x >> (8 - n);
+}
+
+static inline uint32_t aes_ror32(uint32_t x, uint8_t n) {
+    return x >> n | x << (32 - n);
+}
+
+static inline uint8_t aes_xtime(uint8_t x) {
+    return x << 1 ^ (x & 0x80 ? 0x1B : 0);
+}
+
+//multiplication in GF(2^8)
+static uint8_t aes_mul(uint8_t a, uint8_t b) {
+    uint8_t ret = 0;
+
+    while (b) {
+        if (b & 1) {
+            ret ^= a;
+        }
+
+        a = aes_xtime(a);
+        b >>= 1;
+    }
+
+    return ret;
+}
+
+static inline uint32_t aes_load32(const uint8_t *ptr) {
+    return __builtin_bswap32(*(const aes_u32 *) ptr);
+}
+
+static inline void aes_store32(uint8_t *ptr, uint32_t value) {
+    *(aes_u32 *) ptr = __builtin_bswap32(value);
+}
+
+static void aes_build_tables() {
+    uint8_t p = 1, q = 1;
+
+    //p runs through all the non zero elements (powers of 3), q is its inverse (powers of 1/3)
+    do {
+        p ^= aes_xtime(p);
+        q ^= q << 1;
+        q ^= q << 2;
+        q ^= q << 4;
+
+        if (q & 0x80) {
+            q ^= 0x09;
+        }
+
+        aes_sbox[p] = q ^ aes_rol8(q, 1) ^ aes_rol8(q, 2) ^ aes_rol8(q, 3) ^ aes_rol8(q, 4) ^ 0x63;
+    } while (p != 1);
+
+    aes_sbox[0] = 0x63;
+
+    for (uint32_t i = 0; i < 256; i++) {
+        aes_inv_sbox[aes_sbox[i]] = i;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint8_t s = aes_sbox[i], si = aes_inv_sbox[i];
+        aes_te[i] = (uint32_t) aes_mul(s, 2) << 24 | (uint32_t) s << 16 | (uint32_t) s << 8 | aes_mul(s, 3);
+        aes_td[i] = (uint32_t) aes_mul(si, 14) << 24 | (uint32_t) aes_mul(si, 9) << 16 | (uint32_t) aes_mul(si, 13) << 8 | aes_mul(si, 11);
+    }
+
+    aes_tables_ready = true;
+}
+
+static inline uint32_t aes_sub_word(uint32_t w) {
+    return (uint32_t) aes_sbox[w >> 24] << 24 | (uint32_t) aes_sbox[w >> 16 & 0xFF] << 16 | (uint32_t) aes_sbox[w >> 8 & 0xFF] << 8 | aes_sbox[w & 0xFF];
+}
+
+static uint32_t aes_inv_mix_column(uint32_t w) {
+    uint8_t a0 = w >> 24, a1 = w >> 16, a2 = w >> 8, a3 = w;
+    uint8_t b0 = aes_mul(a0, 14) ^ aes_mul(a1, 11) ^ aes_mul(a2, 13) ^ aes_mul(a3, 9);
+    uint8_t b1 = aes_mul(a0, 9) ^ aes_mul(a1, 14) ^ aes_mul(a2, 11) ^ aes_mul(a3, 13);
+    uint8_t b2 = aes_mul(a0, 13) ^ aes_mul(a1, 9) ^ aes_mul(a2, 14) ^ aes_mul(a3, 11);
+    uint8_t b3 = aes_mul(a0, 11) ^ aes_mul(a1, 13) ^ aes_mul(a2, 9) ^ aes_mul(a3, 14);
+    return (uint32_t) b0 << 24 | (uint32_t) b1 << 16 | (uint32_t) b2 << 8 | b3;
+}
+
+/* expands a 128, 192 or 256 bits key, returns false if the size is not valid */
+bool aes_set_key(aes_key_t *key, const uint8_t *bytes, uint32_t key_bits) {
+    if (key_bits != 128 && key_bits != 192 && key_bits != 256) {
+        return false;
+    }
+
+    if (!aes_tables_ready) {
+        aes_build_tables();
+    }
+
+    uint32_t nk = key_bits / 32;
+    uint32_t words = 4 * (nk + 7);
+    uint32_t w[(AES_MAX_ROUNDS + 1) * 4];
+    uint8_t rcon = 1;
+    key->rounds = nk + 6;
+
+    for (uint32_t i = 0; i < nk; i++) {
+        w[i] = aes_load32(bytes + i * 4);
+    }
+
+    for (uint32_t i = nk; i < words; i++) {
+        uint32_t t = w[i - 1];
+
+        if (i % nk == 0) {
+            t = aes_sub_word(aes_ror32(t, 24)) ^ (uint32_t) rcon << 24;
+            rcon = aes_xtime(rcon);
+        } else if (nk > 6 && i % nk == 4) {
+            t = aes_sub_word(t);
+        }
+
+        w[i] = w[i - nk] ^ t;
+    }
+
+    for (uint32_t round = 0; round <= key->rounds; round++) {
+        uint32_t src = key->rounds - round;
+
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t dec = w[src * 4 + c];
+
+            if (round != 0 && round != key->rounds) {
+                dec = aes_inv_mix_column(dec);
+            }
+
+            aes_store32(key->enc_keys + round * AES_BLOCK_SIZE + c * 4, w[round * 4 + c]);
+            aes_store32(key->dec_keys + round * AES_BLOCK_SIZE + c * 4, dec);
+        }
+    }
+
+    return true;
+}
+
+void aes_encrypt_block(const aes_key_t *key, uint8_t *dst, const uint8_t *src) {
+    const uint8_t *rk = key->enc_keys;
+    uint32_t s0 = aes_load32(src) ^ aes_load32(rk);
+    uint32_t s1 = aes_load32(src + 4) ^ aes_load32(rk + 4);
+    uint32_t s2 = aes_load32(src + 8) ^ aes_load32(rk + 8);
+    uint32_t s3 = aes_load32(src + 12) ^ aes_load32(rk + 12);
+
+    //SubBytes, ShiftRows and MixColumns in 4 table lookups per column
+    for (uint8_t round = 1; round < key->rounds; round++) {
+        rk += AES_BLOCK_SIZE;
+        uint32_t t0 = aes_te[s0 >> 24] ^ aes_ror32(aes_te[s1 >> 16 & 0xFF], 8) ^ aes_ror32(aes_te[s2 >> 8 & 0xFF], 16) ^ aes_ror32(aes_te[s3 & 0xFF], 24);
+        uint32_t t1 = aes_te[s1 >> 24] ^ aes_ror32(aes_te[s2 >> 16 & 0xFF], 8) ^ aes_ror32(aes_te[s3 >> 8 & 0xFF], 16) ^ aes_ror32(aes_te[s0 & 0xFF], 24);
+        uint32_t t2 = aes_te[s2 >> 24] ^ aes_ror32(aes_te[s3 >> 16 & 0xFF], 8) ^ aes_ror32(aes_te[s0 >> 8 & 0xFF], 16) ^ aes_ror32(aes_te[s1 & 0xFF], 24);
+        uint32_t t3 = aes_te[s3 >> 24] ^ aes_ror32(aes_te[s0 >> 16 & 0xFF], 8) ^ aes_ror32(aes_te[s1 >> 8 & 0xFF], 16) ^ aes_ror32(aes_te[s2 & 0xFF], 24);
+        s0 = t0 ^ aes_load32(rk);
+        s1 = t1 ^ aes_load32(rk + 4);
+        s2 = t2 ^ aes_load32(rk + 8);
+        s3 = t3 ^ aes_load32(rk + 12);
+    }
+
+    //the last round has no MixColumns
+    rk += AES_BLOCK_SIZE;
+    aes_store32(dst, aes_sub_word((s0 & 0xFF000000) | (s1 & 0xFF0000) | (s2 & 0xFF00) | (s3 & 0xFF)) ^ aes_load32(rk));
+    aes_store32(dst + 4, aes_sub_word((s1 & 0xFF000000) | (s2 & 0xFF0000) | (s3 & 0xFF00) | (s0 & 0xFF)) ^ aes_load32(rk + 4));
+    aes_store32(dst + 8, aes_sub_word((s2 & 0xFF000000) | (s3 & 0xFF0000) | (s0 & 0xFF00) | (s1 & 0xFF)) ^ aes_load32(rk + 8));
+    aes_store32(dst + 12, aes_sub_word((s3 & 0xFF000000) | (s0 & 0xFF0000) | (s1 & 0xFF00) | (s2 & 0xFF)) ^ aes_load32(rk + 12));
+}
+
+static inline uint32_t aes_inv_sub_word(uint32_t w) {
+    return (uint32_t) aes_inv_sbox[w >> 24] << 24 | (uint32_t) aes_inv_sbox[w >> 16 & 0xFF] << 16 | (uint32_t) aes_inv_sbox[w >> 8 & 0xFF] << 8 | aes_inv_sbox[w & 0xFF];
+}
+
+//equivalent inverse cipher, same structure as aes_encrypt_block() with the decryption round keys
+void aes_decrypt_block(const aes_key_t *key, uint8_t *dst, const uint8_t *src) {
+    const uint8_t *rk = key->dec_keys;
+    uint32_t s0 = aes_load32(src) ^ aes_load32(rk);
+    uint32_t s1 = aes_load32(src + 4) ^ aes_load32(rk + 4);
+    uint32_t s2 = aes_load32(src + 8) ^ aes_load32(rk + 8);
+    uint32_t s3 = aes_load32(src + 12) ^ aes_load32(rk + 12);
+
+    for (uint8_t round = 1; round < key->rounds; round++) {
+        rk += AES_BLOCK_SIZE;
+        uint32_t t0 = aes_td[s0 >> 24] ^ aes_ror32(aes_td[s3 >> 16 & 0xFF], 8) ^ aes_ror32(aes_td[s2 >> 8 & 0xFF], 16) ^ aes_ror32(aes_td[s1 & 0xFF], 24);
+        uint32_t t1 = aes_td[s1 >> 24] ^ aes_ror32(aes_td[s0 >> 16 & 0xFF], 8) ^ aes_ror32(aes_td[s3 >> 8 & 0xFF], 16) ^ aes_ror32(aes_td[s2 & 0xFF], 24);
+        uint32_t t2 = aes_td[s2 >> 24] ^ aes_ror32(aes_td[s1 >> 16 & 0xFF], 8) ^ aes_ror32(aes_td[s0 >> 8 & 0xFF], 16) ^ aes_ror32(aes_td[s3 & 0xFF], 24);
+        uint32_t t3 = aes_td[s3 >> 24] ^ aes_ror32(aes_td[s2 >> 16 & 0xFF], 8) ^ aes_ror32(aes_td[s1 >> 8 & 0xFF], 16) ^ aes_ror32(aes_td[s0 & 0xFF], 24);
+        s0 = t0 ^ aes_load32(rk);
+        s1 = t1 ^ aes_load32(rk + 4);
+        s2 = t2 ^ aes_load32(rk + 8);
+        s3 = t3 ^ aes_load32(rk + 12);
+    }
+
+    rk += AES_BLOCK_SIZE;
+    aes_store32(dst, aes_inv_sub_word((s0 & 0xFF000000) | (s3 & 0xFF0000) | (s2 & 0xFF00) | (s1 & 0xFF)) ^ aes_load32(rk));
+    aes_store32(dst + 4, aes_inv_sub_word((s1 & 0xFF000000) | (s0 & 0xFF0000) | (s3 & 0xFF00) | (s2 & 0xFF)) ^ aes_load32(rk + 4));
+    aes_store32(dst + 8, aes_inv_sub_word((s2 & 0xFF000000) | (s1 & 0xFF0000) | (s0 & 0xFF00) | (s3 & 0xFF)) ^ aes_load32(rk + 8));
+    aes_store32(dst + 12, aes_inv_sub_word((s3 & 0xFF000000) | (s2 & 0xFF0000) | (s1 & 0xFF00) | (s0 & 0xFF)) ^ aes_load32(rk + 12));
+}
+
+bool aes_xts_set_key(aes_xts_key_t *key, const uint8_t *bytes, uint32_t key_bits) {
+    return aes_set_key(&key->data_key, bytes, key_bits) && aes_set_key(&key->tweak_key, bytes + key_bits / 8, key_bits);
+}
+
+//multiplies the tweak by x in GF(2^128) (little endian)
+static inline void xts_mul_x(uint64_t tweak[2]) {
+    uint64_t carry = tweak[1] >> 63;
+    tweak[1] = tweak[1] << 1 | tweak[0] >> 63;
+    tweak[0] = tweak[0] << 1 ^ carry * XTS_POLY;
+}
+
+bool aes_xts_crypt_generic(const aes_xts_key_t *key, uint64_t sector, uint8_t *dst, const uint8_t *src, uint64_t sectors, uint32_t sector_size, bool encrypt) {
+    for (uint64_t s = 0; s < sectors; s++) {
+        uint64_t tweak[2] = {sector + s, 0};
+        aes_encrypt_block(&key->tweak_key, (uint8_t *) tweak, (uint8_t *) tweak);
+
+        for (uint32_t i = 0; i < sector_size; i += AES_BLOCK_SIZE, src += AES_BLOCK_SIZE, dst += AES_BLOCK_SIZE) {
+            uint64_t block[2] = {*(const aes_u64 *) src ^ tweak[0], *(const aes_u64 *)(src + 8) ^ tweak[1]};
+
+            if (encrypt) {
+                aes_encrypt_block(&key->data_key, (uint8_t *) block, (uint8_t *) block);
+            } else {
+                aes_decrypt_block(&key->data_key, (uint8_t *) block, (uint8_t *) block);
+            }
+
+            *(aes_u64 *) dst = block[0] ^ tweak[0];
+            *(aes_u64 *)(dst + 8) = block[1] ^ tweak[1];
+            xts_mul_x(tweak);
+        }
+    }
+
+    return true;
+}
+
+static inline v2du aes_ni_mul_x(v2du tweak) {
+    uint64_t lo = tweak[0], hi = tweak[1];
+    return (v2du){lo << 1 ^ (hi >> 63) * XTS_POLY, hi << 1 | lo >> 63};
+}
+
+static inline v2du aesenc(v2du x, v2du key) {
+    asm("aesenc %1, %0" : "+x"(x) : "x"(key));
+    return x;
+}
+
+static inline v2du aesenclast(v2du x, v2du key) {
+    asm("aesenclast %1, %0" : "+x"(x) : "x"(key));
+    return x;
+}
+
+static inline v2du aesdec(v2du x, v2du key) {
+    asm("aesdec %1, %0" : "+x"(x) : "x"(key));
+    return x;
+}
+
+static inline v2du aesdeclast(v2du x, v2du key) {
+    asm("aesdeclast %1, %0" : "+x"(x) : "x"(key));
+    return x;
+}
+
+//runs the rounds on 4 blocks interleaved, rk[0] has already been added
+static inline void aes_ni_rounds_x4(v2du x[4], const v2du *rk, uint8_t rounds, bool encrypt) {
+    if (encrypt) {
+        for (uint8_t r = 1; r < rounds; r++) {
+            x[0] = aesenc(x[0], rk[r]);
+            x[1] = aesenc(x[1], rk[r]);
+            x[2] = aesenc(x[2], rk[r]);
+            x[3] = aesenc(x[3], rk[r]);
+        }
+
+        for (uint8_t i = 0; i < 4; i++) {
+            x[i] = aesenclast(x[i], rk[rounds]);
+        }
+    } else {
+        for (uint8_t r = 1; r < rounds; r++) {
+            x[0] = aesdec(x[0], rk[r]);
+            x[1] = aesdec(x[1], rk[r]);
+            x[2] = aesdec(x[2], rk[r]);
+            x[3] = aesdec(x[3], rk[r]);
+        }
+
+        for (uint8_t i = 0; i < 4; i++) {
+            x[i] = aesdeclast(x[i], rk[rounds]);
+        }
+    }
+}
+
+static inline v2du aes_ni_rounds(v2du x, const v2du *rk, uint8_t rounds, bool encrypt) {
+    for (uint8_t r = 1; r < rounds; r++) {
+        x = encrypt ? aesenc(x, rk[r]) : aesdec(x, rk[r]);
+    }
+
+    return encrypt ? aesenclast(x, rk[rounds]) : aesdeclast(x, rk[rounds]);
+}
+
+//must be called inside a kernel_fpu_begin()/kernel_fpu_end() section
+__attribute__((noinline))
+static void aes_xts_crypt_ni_sectors(const aes_xts_key_t *key, uint64_t sector, uint8_t *dst, const uint8_t *src, uint64_t sectors, uint32_t sector_size, bool encrypt) {
+    const aes_key_t *data_key = &key->data_key;
+    uint8_t rounds = data_key->rounds;
+    v2du rk[AES_MAX_ROUNDS + 1], tk[AES_MAX_ROUNDS + 1];
+
+    for (uint8_t r = 0; r <= rounds; r++) {
+        rk[r] = *(const v2du_unaligned *)((encrypt ? data_key->enc_keys : data_key->dec_keys) + r * AES_BLOCK_SIZE);
+        tk[r] = *(const v2du_unaligned *)(key->tweak_key.enc_keys + r * AES_BLOCK_SIZE);
+    }
+
+    for (uint64_t s = 0; s < sectors; s++) {
+        v2du tweak = aes_ni_rounds((v2du){sector + s, 0} ^ tk[0], tk, rounds, true);
+        uint32_t blocks = sector_size / AES_BLOCK_SIZE;
+        uint32_t i = 0;
+
+        for (; i + 4 <= blocks; i += 4, src += 4 * AES_BLOCK_SIZE, dst += 4 * AES_BLOCK_SIZE) {
+            v2du t[4], x[4];
+            t[0] = tweak;
+            t[1] = aes_ni_mul_x(t[0]);
+            t[2] = aes_ni_mul_x(t[1]);
+            t[3] = aes_ni_mul_x(t[2]);
+            tweak = aes_ni_mul_x(t[3]);
+
+            for (uint8_t j = 0; j < 4; j++) {
+                x[j] = *(const v2du_unaligned *)(src + j * AES_BLOCK_SIZE) ^ t[j] ^ rk[0];
+            }
+
+            aes_ni_rounds_x4(x, rk, rounds, encrypt);
+
+            for (uint8_t j = 0; j < 4; j++) {
+                *(v2du_unaligned *)(dst + j * AES_BLOCK_SIZE) = x[j] ^ t[j];
+            }
+        }
+
+        for (; i < blocks; i++, src += AES_BLOCK_SIZE, dst += AES_BLOCK_SIZE) {
+            v2du x = aes_ni_rounds(*(const v2du_unaligned *) src ^ tweak ^ rk[0], rk, rounds, encrypt);
+            *(v2du_unaligned *) dst = x ^ tweak;
+            tweak = aes_ni_mul_x(tweak);
+        }
+    }
+}
+
+bool aes_xts_crypt_ni(const aes_xts_key_t *key, uint64_t sector, uint8_t *dst, const uint8_t *src, uint64_t sectors, uint32_t sector_size, bool encrypt) {
+    if (!kernel_fpu_begin()) {
+        return aes_xts_crypt_generic(key, sector, dst, src, sectors, sector_size, encrypt);
+    }
+
+    aes_xts_crypt_ni_sectors(key, sector, dst, src, sectors, sector_size, encrypt);
+    kernel_fpu_end();
+    return true;
+}
+
+/* builds the round tables and selects the XTS implementation for this cpu, called by crypto_init() */
+void aes_select() {
+    if (!aes_tables_ready) {
+        aes_build_tables();
+    }
+
+    if (cpu_has(CPU_FEATURE_AES)) {
+        aes_ni = static_call_update((void *) aes_xts_crypt, (void *) aes_xts_crypt_ni);
+    }
+}
+
+bool aes_ni_enabled() {
+    return aes_ni;
+}
+
+/*
+encrypts sectors data units of sector_size bytes from src to dst (they can be the same buffer), sector is the number of the first one.
+sector_size must be a multiple of the aes block size.
+*/
+bool aes_xts_encrypt(const aes_xts_key_t *key, uint64_t sector, void *dst, const void *src, uint64_t sectors, uint32_t sector_size) {
+    if (!key || !dst || !src || sector_size == 0 || sector_size % AES_BLOCK_SIZE != 0) {
+        return false;
+    }
+
+    return aes_xts_crypt(key, sector, dst, src, sectors, sector_size, true);
+}
+
+bool aes_xts_decrypt(const aes_xts_key_t *key, uint64_t sector, void *dst, const void *src, uint64_t sectors, uint32_t sector_size) {
+    if (!key || !dst || !src || sector_size == 0 || sector_size % AES_BLOCK_SIZE != 0) {
+        return false;
+    }
+
+    return aes_xts_crypt(key, sector, dst, src, sectors, sector_size, false);
+}
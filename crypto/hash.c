@@ -0,0 +1,71 @@
+/*
+Algorithm independent hashing: hash_init()/hash_update()/hash_final() work on a hash_ctx_t and forward to the selected algorithm.
+crypto_init() selects the implementations for this cpu (SHA-NI, SSE4.2 crc32, AES-NI) and must be called after cpu_features_init().
+*/
+
+#include <include/types.h>
+#include <crypto/include/hash.h>
+#include <crypto/include/aes.h>
+#include <include/mem.h>
+
+void crypto_init() {
+    sha256_select();
+    crc32c_select();
+    aes_select();
+}
+
+uint32_t hash_digest_size(hash_type_t type) {
+    switch (type) {
+        case hash_md5: return sizeof(md5_t);
+        case hash_sha256: return sizeof(sha256_t);
+        case hash_crc32c: return sizeof(uint32_t);
+        default: return 0;
+    }
+}
+
+bool hash_init(hash_ctx_t *ctx, hash_type_t type) {
+    ctx->type = type;
+
+    switch (type) {
+        case hash_md5: md5_init(&ctx->md5); return true;
+        case hash_sha256: sha256_init(&ctx->sha256); return true;
+        case hash_crc32c: crc32c_init(&ctx->crc32c); return true;
+        default: return false;
+    }
+}
+
+void hash_update(hash_ctx_t *ctx, const void *data, uint64_t size) {
+    switch (ctx->type) {
+        case hash_md5: md5_update(&ctx->md5, data, size); break;
+        case hash_sha256: sha256_update(&ctx->sha256, data, size); break;
+        case hash_crc32c: crc32c_update(&ctx->crc32c, data, size); break;
+    }
+}
+
+//writes the digest (hash_digest_size() bytes) and returns its size
+uint32_t hash_final(hash_ctx_t *ctx, void *digest) {
+    switch (ctx->type) {
+        case hash_md5: {
+            md5_t ret = md5_final(&ctx->md5);
+            memcpy(digest, ret.bytes, sizeof(ret));
+            break;
+        }
+
+        case hash_sha256: {
+            sha256_t ret = sha256_final(&ctx->sha256);
+            memcpy(digest, ret.bytes, sizeof(ret));
+            break;
+        }
+
+        case hash_crc32c: {
+            uint32_t ret = crc32c_final(&ctx->crc32c);
+            memcpy(digest, &ret, sizeof(ret));
+            break;
+        }
+
+        default:
+            return 0;
+    }
+
+    return hash_digest_size(ctx->type);
+}
@@ -0,0 +1,256 @@
+/*
+Throughput of the hash functions, single stream and multi-buffer (HASH_MB_LANES streams hashed together).
+The numbers are bytes per cycle (2 decimals). The known answer tests are checked first, then the accelerated paths against the generic
+code (SHA-NI against sha256_blocks_generic(), the SSE4.2 crc32 against the tables) and the multi-buffer updates against single stream
+updates, over lengths below, at and above a block, unaligned, and with fewer, as many and more streams than HASH_MB_LANES.
+*/
+
+#include <include/types.h>
+#include <crypto/include/hash.h>
+#include <include/mem.h>
+#include <include/low_level.h>
+#include <tty/include/tty.h>
+
+#define HASH_BENCH_SIZE 4096 //size of every update, a block of a storage device
+#define HASH_BENCH_ROUNDS 64
+#define HASH_BENCH_MAX_STREAMS (HASH_MB_LANES * 2 + 1)
+#define HASH_BENCH_STREAM_OFFSET 37 //distance between the data of two streams of the multi-buffer checks
+
+extern bool sha256_ni;
+extern bool crc32c_sse42;
+void sha256_blocks_generic(uint32_t state[8], const uint8_t *data, uint64_t blocks);
+uint32_t crc32c_raw_table(uint32_t crc, const uint8_t *data, uint64_t size);
+
+uint8_t hash_bench_data[HASH_MB_LANES][HASH_BENCH_SIZE] __attribute__((aligned(64)));
+
+//lengths of the cross checks: below a block, around the padding limit, one block, several blocks with and without a tail
+static const uint32_t hash_bench_sizes[] = {1, 3, 7, 55, 56, 63, 64, 65, 128, 64 * 3 + 17, 1000};
+static const uint32_t hash_bench_offsets[] = {0, 1, 3}; //the non zero ones make the input unaligned
+static const uint32_t hash_bench_streams[] = {1, HASH_MB_LANES - 1, HASH_MB_LANES, HASH_MB_LANES + 1, HASH_BENCH_MAX_STREAMS};
+
+static const uint8_t hash_bench_md5_abc[16] = {
+    0x90, 0x01, 0x50, 0x98, 0x3C, 0xD2, 0x4F, 0xB0, 0xD6, 0x96, 0x3F, 0x7D, 0x28, 0xE1, 0x7F, 0x72
+};
+
+static const uint8_t hash_bench_sha256_abc[32] = {
+    0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+    0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD
+};
+
+//prints bytes/cycles with 2 decimals
+static void hash_bench_print(const char *name, uint64_t bytes, uint64_t cycles) {
+    uint64_t hundredths = cycles ? bytes * 100 / cycles : 0;
+    printf("%s: %lu.%02lu bytes/cycle\n", name, hundredths / 100, hundredths % 100);
+}
+
+//sha256 of size bytes compressed by sha256_blocks_generic() only, the reference of the SHA-NI path
+static sha256_t hash_bench_sha256_generic(const uint8_t *data, uint32_t size) {
+    sha256_ctx_t ctx;
+    sha256_t digest;
+    uint8_t tail[SHA256_BLOCK_SIZE * 2];
+    uint32_t blocks = size / SHA256_BLOCK_SIZE, rest = size % SHA256_BLOCK_SIZE;
+    uint32_t tail_size = rest < SHA256_BLOCK_SIZE - 8 ? SHA256_BLOCK_SIZE : SHA256_BLOCK_SIZE * 2;
+
+    sha256_init(&ctx);
+    sha256_blocks_generic(ctx.state, data, blocks);
+    memclear(tail, sizeof(tail));
+    memcpy(tail, (void *)(data + blocks * SHA256_BLOCK_SIZE), rest);
+    tail[rest] = 0x80;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        tail[tail_size - 1 - i] = (uint64_t) size * 8 >> i * 8;
+    }
+
+    sha256_blocks_generic(ctx.state, tail, tail_size / SHA256_BLOCK_SIZE);
+
+    for (uint8_t i = 0; i < 32; i++) {
+        digest.bytes[i] = ctx.state[i / 4] >> (24 - i % 4 * 8);
+    }
+
+    return digest;
+}
+
+//sha256() and crc32c() (SHA-NI and SSE4.2 if the cpu has them) against the generic code, false after printing the first mismatch
+static bool hash_bench_check_accelerated() {
+    const uint8_t *base = (const uint8_t *) hash_bench_data;
+
+    for (uint32_t i = 0; i < sizeof(hash_bench_sizes) / sizeof(uint32_t); i++) {
+        for (uint32_t j = 0; j < sizeof(hash_bench_offsets) / sizeof(uint32_t); j++) {
+            uint32_t size = hash_bench_sizes[i], offset = hash_bench_offsets[j];
+            const uint8_t *data = base + offset;
+            sha256_t digest = sha256((void *) data, size);
+            sha256_t reference = hash_bench_sha256_generic(data, size);
+
+            if (!memcmp(digest.bytes, reference.bytes, 32)) {
+                printf("sha256 %s FAILED (size %u, offset %u)\n", sha256_ni ? "sha-ni" : "generic", size, offset);
+                return false;
+            }
+
+            if (crc32c((void *) data, size) != (crc32c_raw_table(CRC32C_INIT, data, size) ^ 0xFFFFFFFF)) {
+                printf("crc32c %s FAILED (size %u, offset %u)\n", crc32c_sse42 ? "sse4.2" : "table", size, offset);
+                return false;
+            }
+        }
+    }
+
+    printf("sha256 %s, crc32c %s: ok\n", sha256_ni ? "sha-ni" : "generic", crc32c_sse42 ? "sse4.2" : "table");
+    return true;
+}
+
+/*
+*_mb_update() against *_update() on every stream, false after printing the first mismatch. every stream is updated twice with size bytes,
+the second update starts in the middle of a block (unless size is a multiple of it) and goes through the buffered head.
+*/
+static bool hash_bench_check_mb(hash_type_t type, const char *name) {
+    const uint8_t *base = (const uint8_t *) hash_bench_data;
+
+    for (uint32_t i = 0; i < sizeof(hash_bench_sizes) / sizeof(uint32_t); i++) {
+        for (uint32_t j = 0; j < sizeof(hash_bench_offsets) / sizeof(uint32_t); j++) {
+            for (uint32_t k = 0; k < sizeof(hash_bench_streams) / sizeof(uint32_t); k++) {
+                uint32_t size = hash_bench_sizes[i], offset = hash_bench_offsets[j], count = hash_bench_streams[k];
+                hash_ctx_t mb[HASH_BENCH_MAX_STREAMS], single[HASH_BENCH_MAX_STREAMS];
+                void *ptrs[HASH_BENCH_MAX_STREAMS];
+                const void *data[HASH_BENCH_MAX_STREAMS];
+
+                for (uint32_t stream = 0; stream < count; stream++) {
+                    hash_init(&mb[stream], type);
+                    hash_init(&single[stream], type);
+                    ptrs[stream] = &mb[stream].md5; //the contexts of the union all start at the same address
+                    data[stream] = base + offset + stream * HASH_BENCH_STREAM_OFFSET;
+                }
+
+                for (uint32_t pass = 0; pass < 2; pass++) {
+                    switch (type) {
+                        case hash_md5:
+                            md5_mb_update((md5_ctx_t **) ptrs, data, size, count);
+                            break;
+                        case hash_sha256:
+                            sha256_mb_update((sha256_ctx_t **) ptrs, data, size, count);
+                            break;
+                        default:
+                            crc32c_mb_update((crc32c_ctx_t **) ptrs, data, size, count);
+                            break;
+                    }
+
+                    for (uint32_t stream = 0; stream < count; stream++) {
+                        hash_update(&single[stream], data[stream], size);
+                    }
+                }
+
+                for (uint32_t stream = 0; stream < count; stream++) {
+                    uint8_t mb_digest[HASH_MAX_DIGEST_SIZE], single_digest[HASH_MAX_DIGEST_SIZE];
+                    uint32_t digest_size = hash_final(&mb[stream], mb_digest);
+                    hash_final(&single[stream], single_digest);
+
+                    if (!memcmp(mb_digest, single_digest, digest_size)) {
+                        printf("%s multi-buffer FAILED (size %u, offset %u, %u streams, stream %u)\n", name, size, offset, count, stream);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static void hash_bench_check() {
+    md5_t md5_abc = md5("abc", 3);
+    sha256_t sha256_abc = sha256("abc", 3);
+    uint32_t crc = crc32c("123456789", 9);
+
+    printf("md5 %s, sha256 %s, crc32c %s\n",
+        memcmp(md5_abc.bytes, (void *) hash_bench_md5_abc, 16) ? "ok" : "FAILED",
+        memcmp(sha256_abc.bytes, (void *) hash_bench_sha256_abc, 32) ? "ok" : "FAILED",
+        crc == 0xE3069283 ? "ok" : "FAILED");
+
+    hash_bench_check_accelerated();
+
+    //sha256_mb_update() leaves everything to SHA-NI when the cpu has it, the SSE2 lanes are checked with it turned off for the check
+    bool ni = sha256_ni;
+    bool ok = hash_bench_check_mb(hash_md5, "md5");
+    sha256_ni = false;
+    ok = hash_bench_check_mb(hash_sha256, "sha256") && ok;
+    sha256_ni = ni;
+
+    if (ni) {
+        ok = hash_bench_check_mb(hash_sha256, "sha256 (sha-ni)") && ok;
+    }
+
+    ok = hash_bench_check_mb(hash_crc32c, "crc32c") && ok;
+
+    if (ok) {
+        printf("multi-buffer md5, sha256, crc32c: ok\n");
+    }
+}
+
+void hash_bench() {
+    for (uint32_t i = 0; i < HASH_MB_LANES * HASH_BENCH_SIZE; i++) {
+        hash_bench_data[i / HASH_BENCH_SIZE][i % HASH_BENCH_SIZE] = i * 31 + 7;
+    }
+
+    hash_bench_check();
+
+    const void *data[HASH_MB_LANES];
+
+    for (uint32_t i = 0; i < HASH_MB_LANES; i++) {
+        data[i] = hash_bench_data[i];
+    }
+
+    //single stream
+    const char *names[] = {"md5", "sha256", "crc32c"};
+
+    for (hash_type_t type = hash_md5; type <= hash_crc32c; type++) {
+        hash_ctx_t ctx;
+        uint8_t digest[HASH_MAX_DIGEST_SIZE];
+        hash_init(&ctx, type);
+        uint64_t start = rdtsc();
+
+        for (uint32_t i = 0; i < HASH_BENCH_ROUNDS; i++) {
+            hash_update(&ctx, hash_bench_data[0], HASH_BENCH_SIZE);
+        }
+
+        hash_final(&ctx, digest);
+        hash_bench_print(names[type], HASH_BENCH_ROUNDS * HASH_BENCH_SIZE, rdtsc() - start);
+    }
+
+    //multi-buffer, the total of the bytes of all the streams
+    md5_ctx_t md5_ctx[HASH_MB_LANES];
+    sha256_ctx_t sha256_ctx[HASH_MB_LANES];
+    crc32c_ctx_t crc32c_ctx[HASH_MB_LANES];
+    md5_ctx_t *md5_ptrs[HASH_MB_LANES];
+    sha256_ctx_t *sha256_ptrs[HASH_MB_LANES];
+    crc32c_ctx_t *crc32c_ptrs[HASH_MB_LANES];
+
+    for (uint32_t i = 0; i < HASH_MB_LANES; i++) {
+        md5_init(&md5_ctx[i]);
+        sha256_init(&sha256_ctx[i]);
+        crc32c_init(&crc32c_ctx[i]);
+        md5_ptrs[i] = &md5_ctx[i];
+        sha256_ptrs[i] = &sha256_ctx[i];
+        crc32c_ptrs[i] = &crc32c_ctx[i];
+    }
+
+    uint64_t bytes = HASH_MB_LANES * HASH_BENCH_ROUNDS * HASH_BENCH_SIZE;
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < HASH_BENCH_ROUNDS; i++) {
+        md5_mb_update(md5_ptrs, data, HASH_BENCH_SIZE, HASH_MB_LANES);
+    }
+
+    hash_bench_print("md5 multi-buffer", bytes, rdtsc() - start);
+    start = rdtsc();
+
+    for (uint32_t i = 0; i < HASH_BENCH_ROUNDS; i++) {
+        sha256_mb_update(sha256_ptrs, data, HASH_BENCH_SIZE, HASH_MB_LANES);
+    }
+
+    hash_bench_print("sha256 multi-buffer", bytes, rdtsc() - start);
+    start = rdtsc();
+
+    for (uint32_t i = 0; i < HASH_BENCH_ROUNDS; i++) {
+        crc32c_mb_update(crc32c_ptrs, data, HASH_BENCH_SIZE, HASH_MB_LANES);
+    }
+
+    hash_bench_print("crc32c multi-buffer", bytes, rdtsc() - start);
+}
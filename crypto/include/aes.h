@@ -0,0 +1,29 @@
+#pragma once
+#include <include/types.h>
+#define AES_BLOCK_SIZE 16
+#define AES_MAX_ROUNDS 14
+
+/*
+expanded aes key: enc_keys are the round keys of the cipher, dec_keys the round keys of the equivalent inverse cipher
+(reverse order, InvMixColumns applied to the middle ones), the layout AES-NI aesenc/aesdec expect.
+*/
+typedef struct {
+    uint8_t enc_keys[(AES_MAX_ROUNDS + 1) * AES_BLOCK_SIZE];
+    uint8_t dec_keys[(AES_MAX_ROUNDS + 1) * AES_BLOCK_SIZE];
+    uint8_t rounds; //10 for 128 bits keys, 14 for 256 bits keys
+} aes_key_t;
+
+//XTS uses two keys of the same size, one for the data and one to encrypt the tweak (the sector number)
+typedef struct {
+    aes_key_t data_key;
+    aes_key_t tweak_key;
+} aes_xts_key_t;
+
+bool aes_set_key(aes_key_t *key, const uint8_t *bytes, uint32_t key_bits);
+void aes_encrypt_block(const aes_key_t *key, uint8_t *dst, const uint8_t *src);
+void aes_decrypt_block(const aes_key_t *key, uint8_t *dst, const uint8_t *src);
+bool aes_xts_set_key(aes_xts_key_t *key, const uint8_t *bytes, uint32_t key_bits);
+bool aes_xts_encrypt(const aes_xts_key_t *key, uint64_t sector, void *dst, const void *src, uint64_t sectors, uint32_t sector_size);
+bool aes_xts_decrypt(const aes_xts_key_t *key, uint64_t sector, void *dst, const void *src, uint64_t sectors, uint32_t sector_size);
+bool aes_ni_enabled();
+void aes_select(); //called by crypto_init()
@@ -1,6 +1,81 @@
 #pragma once
 #include <include/types.h>
+#define MD5_BLOCK_SIZE 64
+#define SHA256_BLOCK_SIZE 64
+#define HASH_MB_LANES 4 //streams hashed together by the multi-buffer functions
+#define HASH_MAX_DIGEST_SIZE 32
+#define CRC32C_INIT 0xFFFFFFFF
 
 typedef struct {
     uint8_t bytes[16];
-} md5_t;
\ No newline at end of file
+} md5_t;
+
+typedef struct {
+    uint8_t bytes[32];
+} sha256_t;
+
+/*
+streaming contexts: *_init(), then *_update() any number of times with any size, then *_final().
+length is the number of bytes hashed so far, the buffer holds the last incomplete block (length % 64 bytes).
+*/
+typedef struct {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t buffer[MD5_BLOCK_SIZE];
+} md5_ctx_t;
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+} sha256_ctx_t;
+
+typedef struct {
+    uint32_t crc;
+    uint64_t length;
+} crc32c_ctx_t;
+
+typedef enum {
+    hash_md5,
+    hash_sha256,
+    hash_crc32c
+} hash_type_t;
+
+//algorithm independent context
+typedef struct {
+    hash_type_t type;
+
+    union {
+        md5_ctx_t md5;
+        sha256_ctx_t sha256;
+        crc32c_ctx_t crc32c;
+    };
+} hash_ctx_t;
+
+void crypto_init();
+void sha256_select(); //called by crypto_init()
+void crc32c_select(); //called by crypto_init()
+
+void md5_init(md5_ctx_t *ctx);
+void md5_update(md5_ctx_t *ctx, const void *data, uint64_t size);
+md5_t md5_final(md5_ctx_t *ctx);
+md5_t md5(void *input, uint32_t size);
+void md5_mb_update(md5_ctx_t *ctxs[], const void *data[], uint64_t size, uint32_t count);
+
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const void *data, uint64_t size);
+sha256_t sha256_final(sha256_ctx_t *ctx);
+sha256_t sha256(void *input, uint32_t size);
+void sha256_mb_update(sha256_ctx_t *ctxs[], const void *data[], uint64_t size, uint32_t count);
+
+void crc32c_init(crc32c_ctx_t *ctx);
+void crc32c_update(crc32c_ctx_t *ctx, const void *data, uint64_t size);
+uint32_t crc32c_final(crc32c_ctx_t *ctx);
+uint32_t crc32c(void *input, uint32_t size);
+void crc32c_mb_update(crc32c_ctx_t *ctxs[], const void *data[], uint64_t size, uint32_t count);
+
+bool hash_init(hash_ctx_t *ctx, hash_type_t type);
+void hash_update(hash_ctx_t *ctx, const void *data, uint64_t size);
+uint32_t hash_final(hash_ctx_t *ctx, void *digest);
+uint32_t hash_digest_size(hash_type_t type);
+void hash_bench();
\ No newline at end of file
@@ -1,22 +1,237 @@
+/*
+MD5 (RFC 1321), for integrity checks only: it's broken as a cryptographic hash.
+md5_blocks() compresses whole 64 bytes blocks, md5_mb_update() compresses HASH_MB_LANES independent streams at once, one stream in every
+32 bits lane of the SSE2 registers.
+*/
+
 #include <include/types.h>
 #include <crypto/include/hash.h>
 #include <include/mem.h>
+#include <include/fpu.h>
 
-md5_t md5(void *input, uint32_t size) {
+typedef uint32_t v4u __attribute__((vector_size(16)));
+
+static const uint32_t md5_k[64] = {
+    0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+    0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+    0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+    0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+    0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+    0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+    0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+    0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391
+};
+
+//rotation of every step, 4 values per round
+static const uint8_t md5_shifts[4][4] = {{7, 12, 17, 22}, {5, 9, 14, 20}, {4, 11, 16, 23}, {6, 10, 15, 21}};
+
+static inline uint32_t md5_rol(uint32_t x, uint8_t n) {
+    return x << n | x >> (32 - n);
+}
+
+static inline v4u md5_rol_x4(v4u x, uint8_t n) {
+    return x << n | x >> (32 - n);
+}
+
+//message word used by step i
+static inline uint8_t md5_index(uint8_t i) {
+    switch (i / 16) {
+        case 0: return i;
+        case 1: return (5 * i + 1) % 16;
+        case 2: return (3 * i + 5) % 16;
+        default: return 7 * i % 16;
+    }
+}
+
+static void md5_blocks(uint32_t state[4], const uint8_t *data, uint64_t blocks) {
+    for (uint64_t n = 0; n < blocks; n++, data += MD5_BLOCK_SIZE) {
+        const uint32_t *w = (const uint32_t *) data; //md5 words are little endian
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+        for (uint8_t i = 0; i < 64; i++) {
+            uint32_t f;
+
+            switch (i / 16) {
+                case 0: f = (b & c) | (~b & d); break;
+                case 1: f = (d & b) | (~d & c); break;
+                case 2: f = b ^ c ^ d; break;
+                default: f = c ^ (b | ~d); break;
+            }
+
+            f += a + md5_k[i] + w[md5_index(i)];
+            a = d;
+            d = c;
+            c = b;
+            b += md5_rol(f, md5_shifts[i / 16][i % 4]);
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+}
+
+//same as md5_blocks() on HASH_MB_LANES streams, must be called inside a kernel_fpu_begin()/kernel_fpu_end() section
+__attribute__((noinline))
+static void md5_blocks_x4(md5_ctx_t *ctxs[], const uint8_t *data[], uint64_t blocks) {
+    v4u state[4];
+
+    for (uint8_t i = 0; i < 4; i++) {
+        state[i] = (v4u){ctxs[0]->state[i], ctxs[1]->state[i], ctxs[2]->state[i], ctxs[3]->state[i]};
+    }
+
+    for (uint64_t n = 0; n < blocks; n++) {
+        uint64_t offset = n * MD5_BLOCK_SIZE;
+        v4u w[16];
+
+        for (uint8_t j = 0; j < 16; j++) {
+            w[j] = (v4u){
+                *(const uint32_t *)(data[0] + offset + j * 4), *(const uint32_t *)(data[1] + offset + j * 4),
+                *(const uint32_t *)(data[2] + offset + j * 4), *(const uint32_t *)(data[3] + offset + j * 4)
+            };
+        }
+
+        v4u a = state[0], b = state[1], c = state[2], d = state[3];
+
+        for (uint8_t i = 0; i < 64; i++) {
+            v4u f;
+
+            switch (i / 16) {
+                case 0: f = (b & c) | (~b & d); break;
+                case 1: f = (d & b) | (~d & c); break;
+                case 2: f = b ^ c ^ d; break;
+                default: f = c ^ (b | ~d); break;
+            }
+
+            f += a + md5_k[i] + w[md5_index(i)];
+            a = d;
+            d = c;
+            c = b;
+            b += md5_rol_x4(f, md5_shifts[i / 16][i % 4]);
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+
+    for (uint8_t i = 0; i < 4; i++) {
+        for (uint8_t lane = 0; lane < HASH_MB_LANES; lane++) {
+            ctxs[lane]->state[i] = state[i][lane];
+        }
+    }
+}
+
+void md5_init(md5_ctx_t *ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xEFCDAB89;
+    ctx->state[2] = 0x98BADCFE;
+    ctx->state[3] = 0x10325476;
+    ctx->length = 0;
+}
+
+void md5_update(md5_ctx_t *ctx, const void *data, uint64_t size) {
+    const uint8_t *ptr = data;
+    uint32_t buffered = ctx->length % MD5_BLOCK_SIZE;
+    ctx->length += size;
+
+    //complete the buffered block first
+    if (buffered) {
+        uint32_t fill = MD5_BLOCK_SIZE - buffered;
+
+        if (size < fill) {
+            memcpy(ctx->buffer + buffered, (void *) ptr, size);
+            return;
+        }
+
+        memcpy(ctx->buffer + buffered, (void *) ptr, fill);
+        md5_blocks(ctx->state, ctx->buffer, 1);
+        ptr += fill;
+        size -= fill;
+    }
+
+    md5_blocks(ctx->state, ptr, size / MD5_BLOCK_SIZE);
+    memcpy(ctx->buffer, (void *)(ptr + size / MD5_BLOCK_SIZE * MD5_BLOCK_SIZE), size % MD5_BLOCK_SIZE);
+}
+
+md5_t md5_final(md5_ctx_t *ctx) {
+    uint64_t bits = ctx->length * 8;
+    uint32_t buffered = ctx->length % MD5_BLOCK_SIZE;
     md5_t ret;
-    memclear(ret.bytes, 16);
 
-    //calculate the number of 512 bits (4 bytes * 16) blocks
-    uint32_t num_blocks = size / 512 + size % 512 != 0 ? 1 : 0;
-    uint32_t blocks[num_blocks][16];
+    //padding: a 1 bit, zeros up to 56 bytes in the last block and the message length in bits (little endian)
+    ctx->buffer[buffered++] = 0x80;
 
-    //copy the data into the blocks
-    for (uint32_t i = 0; i < num_blocks - 1; i++) {
-        memcpy(&blocks[i], input + 64 * i, 64);
+    if (buffered > MD5_BLOCK_SIZE - 8) {
+        memclear(ctx->buffer + buffered, MD5_BLOCK_SIZE - buffered);
+        md5_blocks(ctx->state, ctx->buffer, 1);
+        buffered = 0;
     }
 
-    //the last block must be filled this way
-    memcpy(&blocks[num_blocks - 1], input + 64 * (num_blocks - 1), size % 512);
+    memclear(ctx->buffer + buffered, MD5_BLOCK_SIZE - 8 - buffered);
+    *(uint64_t *)(ctx->buffer + MD5_BLOCK_SIZE - 8) = bits;
+    md5_blocks(ctx->state, ctx->buffer, 1);
+    memcpy(ret.bytes, ctx->state, sizeof(ret.bytes));
+    return ret;
+}
 
-    
-}
\ No newline at end of file
+md5_t md5(void *input, uint32_t size) {
+    md5_ctx_t ctx;
+    md5_init(&ctx);
+    md5_update(&ctx, input, size);
+    return md5_final(&ctx);
+}
+
+/*
+hashes size bytes of data[i] into ctxs[i] for count streams, the same as md5_update() on every stream.
+the full blocks of HASH_MB_LANES streams are compressed together, this requires the streams to be at the same offset of their block
+(as it happens when they're always updated together), the others are updated one by one.
+*/
+void md5_mb_update(md5_ctx_t *ctxs[], const void *data[], uint64_t size, uint32_t count) {
+    for (uint32_t i = 0; i < count; i += HASH_MB_LANES) {
+        uint32_t lanes = count - i < HASH_MB_LANES ? count - i : HASH_MB_LANES;
+        uint32_t buffered = ctxs[i]->length % MD5_BLOCK_SIZE;
+        bool together = lanes == HASH_MB_LANES;
+
+        for (uint32_t lane = 1; lane < lanes; lane++) {
+            together = together && ctxs[i + lane]->length % MD5_BLOCK_SIZE == buffered;
+        }
+
+        //bytes that complete the buffered blocks, then the blocks compressed together
+        uint64_t head = buffered ? MD5_BLOCK_SIZE - buffered : 0;
+        head = head < size ? head : size;
+        uint64_t blocks = together ? (size - head) / MD5_BLOCK_SIZE : 0;
+
+        if (blocks == 0) {
+            for (uint32_t lane = 0; lane < lanes; lane++) {
+                md5_update(ctxs[i + lane], data[i + lane], size);
+            }
+
+            continue;
+        }
+
+        const uint8_t *ptrs[HASH_MB_LANES];
+
+        for (uint32_t lane = 0; lane < HASH_MB_LANES; lane++) {
+            md5_update(ctxs[i + lane], data[i + lane], head);
+            ptrs[lane] = (const uint8_t *) data[i + lane] + head;
+        }
+
+        //if the SIMD state can't be saved the remaining bytes are hashed one stream at a time
+        if (kernel_fpu_begin()) {
+            md5_blocks_x4(ctxs + i, ptrs, blocks);
+            kernel_fpu_end();
+        } else {
+            blocks = 0;
+        }
+
+        uint64_t done = head + blocks * MD5_BLOCK_SIZE;
+
+        for (uint32_t lane = 0; lane < HASH_MB_LANES; lane++) {
+            ctxs[i + lane]->length += blocks * MD5_BLOCK_SIZE;
+            md5_update(ctxs[i + lane], (const uint8_t *) data[i + lane] + done, size - done);
+        }
+    }
+}
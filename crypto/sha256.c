@@ -0,0 +1,353 @@
+/*
+SHA-256 (FIPS 180-4).
+sha256_blocks() is a static call: crypto_init() points it to the SHA-NI version on cpus that have the SHA extensions.
+sha256_mb_update() compresses HASH_MB_LANES independent streams at once, one stream in every 32 bits lane of the SSE2 registers
+(with SHA-NI a single stream is faster, so the streams are hashed one after the other).
+*/
+
+#include <include/types.h>
+#include <crypto/include/hash.h>
+#include <include/mem.h>
+#include <include/fpu.h>
+#include <include/cpu.h>
+#include <include/alternatives.h>
+
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef v4u v4u_unaligned __attribute__((aligned(1)));
+
+static const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+//pshufb mask that converts 4 big endian words to little endian
+static const uint8_t sha256_bswap_mask[16] __attribute__((aligned(16))) = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+
+bool sha256_ni = false;
+
+void sha256_blocks(uint32_t state[8], const uint8_t *data, uint64_t blocks);
+void sha256_blocks_generic(uint32_t state[8], const uint8_t *data, uint64_t blocks);
+
+//the compression function is selected by sha256_select() patching this trampoline
+STATIC_CALL(sha256_blocks, sha256_blocks_generic)
+
+static inline uint32_t sha256_ror(uint32_t x, uint8_t n) {
+    return x >> n | x << (32 - n);
+}
+
+static inline v4u sha256_ror_x4(v4u x, uint8_t n) {
+    return x >> n | x << (32 - n);
+}
+
+void sha256_blocks_generic(uint32_t state[8], const uint8_t *data, uint64_t blocks) {
+    for (uint64_t n = 0; n < blocks; n++, data += SHA256_BLOCK_SIZE) {
+        uint32_t w[64];
+
+        for (uint8_t i = 0; i < 16; i++) {
+            w[i] = __builtin_bswap32(*(const uint32_t *)(data + i * 4));
+        }
+
+        for (uint8_t i = 16; i < 64; i++) {
+            uint32_t s0 = sha256_ror(w[i - 15], 7) ^ sha256_ror(w[i - 15], 18) ^ w[i - 15] >> 3;
+            uint32_t s1 = sha256_ror(w[i - 2], 17) ^ sha256_ror(w[i - 2], 19) ^ w[i - 2] >> 10;
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (uint8_t i = 0; i < 64; i++) {
+            uint32_t t1 = h + (sha256_ror(e, 6) ^ sha256_ror(e, 11) ^ sha256_ror(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+            uint32_t t2 = (sha256_ror(a, 2) ^ sha256_ror(a, 13) ^ sha256_ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+//sha256rnds2 takes the message words plus constants in xmm0
+static inline v4u sha256_rnds2(v4u cdgh, v4u abef, v4u wk) {
+    asm("sha256rnds2 %%xmm0, %2, %0" : "+x"(cdgh) : "Yz"(wk), "x"(abef));
+    return cdgh;
+}
+
+static inline v4u sha256_msg1(v4u a, v4u b) {
+    asm("sha256msg1 %1, %0" : "+x"(a) : "x"(b));
+    return a;
+}
+
+static inline v4u sha256_msg2(v4u a, v4u b) {
+    asm("sha256msg2 %1, %0" : "+x"(a) : "x"(b));
+    return a;
+}
+
+//the high 12 bytes of low and the low 4 bytes of high (palignr $4)
+static inline v4u sha256_align(v4u high, v4u low) {
+    asm("palignr $4, %1, %0" : "+x"(high) : "x"(low));
+    return high;
+}
+
+/*
+SHA-NI compression. the extensions keep the state in two registers, ABEF and CDGH (A in the highest lane), every sha256rnds2 runs
+two rounds and sha256msg1/sha256msg2 compute the message schedule 4 words at a time.
+*/
+__attribute__((noinline))
+static void sha256_blocks_ni_x1(uint32_t state[8], const uint8_t *data, uint64_t blocks) {
+    v4u abef = (v4u){state[5], state[4], state[1], state[0]};
+    v4u cdgh = (v4u){state[7], state[6], state[3], state[2]};
+    v4u mask = *(const v4u *) sha256_bswap_mask;
+
+    for (uint64_t n = 0; n < blocks; n++, data += SHA256_BLOCK_SIZE) {
+        v4u abef_save = abef, cdgh_save = cdgh;
+        v4u w[4];
+
+        for (uint8_t i = 0; i < 4; i++) {
+            w[i] = *(const v4u_unaligned *)(data + i * 16);
+            asm("pshufb %1, %0" : "+x"(w[i]) : "x"(mask));
+        }
+
+        for (uint8_t i = 0; i < 16; i++) {
+            if (i >= 4) {
+                w[i % 4] = sha256_msg2(sha256_msg1(w[i % 4], w[(i + 1) % 4]) + sha256_align(w[(i + 3) % 4], w[(i + 2) % 4]), w[(i + 3) % 4]);
+            }
+
+            v4u wk = w[i % 4] + *(const v4u *)(sha256_k + i * 4);
+            cdgh = sha256_rnds2(cdgh, abef, wk);
+            wk = __builtin_shuffle(wk, (v4u){2, 3, 0, 1});
+            abef = sha256_rnds2(abef, cdgh, wk);
+        }
+
+        abef += abef_save;
+        cdgh += cdgh_save;
+    }
+
+    state[0] = abef[3];
+    state[1] = abef[2];
+    state[4] = abef[1];
+    state[5] = abef[0];
+    state[2] = cdgh[3];
+    state[3] = cdgh[2];
+    state[6] = cdgh[1];
+    state[7] = cdgh[0];
+}
+
+void sha256_blocks_ni(uint32_t state[8], const uint8_t *data, uint64_t blocks) {
+    if (blocks == 0) {
+        return;
+    }
+
+    if (!kernel_fpu_begin()) {
+        sha256_blocks_generic(state, data, blocks);
+        return;
+    }
+
+    sha256_blocks_ni_x1(state, data, blocks);
+    kernel_fpu_end();
+}
+
+//same as sha256_blocks_generic() on HASH_MB_LANES streams, must be called inside a kernel_fpu_begin()/kernel_fpu_end() section
+__attribute__((noinline))
+static void sha256_blocks_x4(sha256_ctx_t *ctxs[], const uint8_t *data[], uint64_t blocks) {
+    v4u state[8];
+
+    for (uint8_t i = 0; i < 8; i++) {
+        state[i] = (v4u){ctxs[0]->state[i], ctxs[1]->state[i], ctxs[2]->state[i], ctxs[3]->state[i]};
+    }
+
+    for (uint64_t n = 0; n < blocks; n++) {
+        uint64_t offset = n * SHA256_BLOCK_SIZE;
+        v4u w[64];
+
+        for (uint8_t i = 0; i < 16; i++) {
+            w[i] = (v4u){
+                __builtin_bswap32(*(const uint32_t *)(data[0] + offset + i * 4)), __builtin_bswap32(*(const uint32_t *)(data[1] + offset + i * 4)),
+                __builtin_bswap32(*(const uint32_t *)(data[2] + offset + i * 4)), __builtin_bswap32(*(const uint32_t *)(data[3] + offset + i * 4))
+            };
+        }
+
+        for (uint8_t i = 16; i < 64; i++) {
+            v4u s0 = sha256_ror_x4(w[i - 15], 7) ^ sha256_ror_x4(w[i - 15], 18) ^ w[i - 15] >> 3;
+            v4u s1 = sha256_ror_x4(w[i - 2], 17) ^ sha256_ror_x4(w[i - 2], 19) ^ w[i - 2] >> 10;
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        v4u a = state[0], b = state[1], c = state[2], d = state[3];
+        v4u e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (uint8_t i = 0; i < 64; i++) {
+            v4u t1 = h + (sha256_ror_x4(e, 6) ^ sha256_ror_x4(e, 11) ^ sha256_ror_x4(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+            v4u t2 = (sha256_ror_x4(a, 2) ^ sha256_ror_x4(a, 13) ^ sha256_ror_x4(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    for (uint8_t i = 0; i < 8; i++) {
+        for (uint8_t lane = 0; lane < HASH_MB_LANES; lane++) {
+            ctxs[lane]->state[i] = state[i][lane];
+        }
+    }
+}
+
+/* selects the SHA-256 compression function for this cpu, called by crypto_init() */
+void sha256_select() {
+    if (cpu_has(CPU_FEATURE_SHA) && cpu_has(CPU_FEATURE_SSE42)) {
+        sha256_ni = static_call_update((void *) sha256_blocks, (void *) sha256_blocks_ni);
+    }
+}
+
+void sha256_init(sha256_ctx_t *ctx) {
+    ctx->state[0] = 0x6A09E667;
+    ctx->state[1] = 0xBB67AE85;
+    ctx->state[2] = 0x3C6EF372;
+    ctx->state[3] = 0xA54FF53A;
+    ctx->state[4] = 0x510E527F;
+    ctx->state[5] = 0x9B05688C;
+    ctx->state[6] = 0x1F83D9AB;
+    ctx->state[7] = 0x5BE0CD19;
+    ctx->length = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const void *data, uint64_t size) {
+    const uint8_t *ptr = data;
+    uint32_t buffered = ctx->length % SHA256_BLOCK_SIZE;
+    ctx->length += size;
+
+    //complete the buffered block first
+    if (buffered) {
+        uint32_t fill = SHA256_BLOCK_SIZE - buffered;
+
+        if (size < fill) {
+            memcpy(ctx->buffer + buffered, (void *) ptr, size);
+            return;
+        }
+
+        memcpy(ctx->buffer + buffered, (void *) ptr, fill);
+        sha256_blocks(ctx->state, ctx->buffer, 1);
+        ptr += fill;
+        size -= fill;
+    }
+
+    sha256_blocks(ctx->state, ptr, size / SHA256_BLOCK_SIZE);
+    memcpy(ctx->buffer, (void *)(ptr + size / SHA256_BLOCK_SIZE * SHA256_BLOCK_SIZE), size % SHA256_BLOCK_SIZE);
+}
+
+sha256_t sha256_final(sha256_ctx_t *ctx) {
+    uint64_t bits = ctx->length * 8;
+    uint32_t buffered = ctx->length % SHA256_BLOCK_SIZE;
+    sha256_t ret;
+
+    //padding: a 1 bit, zeros up to 56 bytes in the last block and the message length in bits (big endian)
+    ctx->buffer[buffered++] = 0x80;
+
+    if (buffered > SHA256_BLOCK_SIZE - 8) {
+        memclear(ctx->buffer + buffered, SHA256_BLOCK_SIZE - buffered);
+        sha256_blocks(ctx->state, ctx->buffer, 1);
+        buffered = 0;
+    }
+
+    memclear(ctx->buffer + buffered, SHA256_BLOCK_SIZE - 8 - buffered);
+    *(uint64_t *)(ctx->buffer + SHA256_BLOCK_SIZE - 8) = __builtin_bswap64(bits);
+    sha256_blocks(ctx->state, ctx->buffer, 1);
+
+    for (uint8_t i = 0; i < 8; i++) {
+        *(uint32_t *)(ret.bytes + i * 4) = __builtin_bswap32(ctx->state[i]);
+    }
+
+    return ret;
+}
+
+sha256_t sha256(void *input, uint32_t size) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, input, size);
+    return sha256_final(&ctx);
+}
+
+/*
+hashes size bytes of data[i] into ctxs[i] for count streams, the same as sha256_update() on every stream.
+the full blocks of HASH_MB_LANES streams are compressed together, this requires the streams to be at the same offset of their block
+(as it happens when they're always updated together), the others are updated one by one.
+*/
+void sha256_mb_update(sha256_ctx_t *ctxs[], const void *data[], uint64_t size, uint32_t count) {
+    for (uint32_t i = 0; i < count; i += HASH_MB_LANES) {
+        uint32_t lanes = count - i < HASH_MB_LANES ? count - i : HASH_MB_LANES;
+        uint32_t buffered = ctxs[i]->length % SHA256_BLOCK_SIZE;
+        bool together = lanes == HASH_MB_LANES && !sha256_ni;
+
+        for (uint32_t lane = 1; lane < lanes; lane++) {
+            together = together && ctxs[i + lane]->length % SHA256_BLOCK_SIZE == buffered;
+        }
+
+        //bytes that complete the buffered blocks, then the blocks compressed together
+        uint64_t head = buffered ? SHA256_BLOCK_SIZE - buffered : 0;
+        head = head < size ? head : size;
+        uint64_t blocks = together ? (size - head) / SHA256_BLOCK_SIZE : 0;
+
+        if (blocks == 0) {
+            for (uint32_t lane = 0; lane < lanes; lane++) {
+                sha256_update(ctxs[i + lane], data[i + lane], size);
+            }
+
+            continue;
+        }
+
+        const uint8_t *ptrs[HASH_MB_LANES];
+
+        for (uint32_t lane = 0; lane < HASH_MB_LANES; lane++) {
+            sha256_update(ctxs[i + lane], data[i + lane], head);
+            ptrs[lane] = (const uint8_t *) data[i + lane] + head;
+        }
+
+        //if the SIMD state can't be saved the remaining bytes are hashed one stream at a time
+        if (kernel_fpu_begin()) {
+            sha256_blocks_x4(ctxs + i, ptrs, blocks);
+            kernel_fpu_end();
+        } else {
+            blocks = 0;
+        }
+
+        uint64_t done = head + blocks * SHA256_BLOCK_SIZE;
+
+        for (uint32_t lane = 0; lane < HASH_MB_LANES; lane++) {
+            ctxs[i + lane]->length += blocks * SHA256_BLOCK_SIZE;
+            sha256_update(ctxs[i + lane], (const uint8_t *) data[i + lane] + done, size - done);
+        }
+    }
+}
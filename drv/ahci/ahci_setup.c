@@ -10,7 +10,6 @@
 #include <mm/include/paging.h>
 
 pool_t ahci_devices_pool_id;
-uint32_t ahci_devices_pool_last_id;
 
 bool ahci_init(pci_general_dev_t *dev) {
     if (!dev || (pci_dev_type_t) dev->header.class_code != mass_storage || (mass_storage_subclass_t) dev->header.subclass != sata) {
@@ -47,9 +46,7 @@ bool ahci_search_and_add_devices(ahci_hba_memory_t *hba_mem) {
                 .port = &hba_mem->ports[i]
             };
 
-            if (obj_pool_put(ahci_devices_pool_id, (void *) &dev, ahci_devices_pool_last_id)) {
-                ahci_devices_pool_last_id++;
-            } else {
+            if (!obj_pool_push(ahci_devices_pool_id, (void *) &dev, null)) {
                 return false;
             }
         }
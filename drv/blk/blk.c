@@ -0,0 +1,178 @@
+/*
+Block completion engine.
+Completions are handled like network packets in NAPI: the interrupt of a device masks the device interrupt and schedules its queue, and
+the block softirq polls it with a budget. When the queue has nothing else to complete the interrupt is unmasked again.
+At low load (a few requests, a waiter that sleeps) every completion costs an interrupt, but a request never spins the cpu. When completions
+arrive back to back (BLK_BACK_TO_BACK_COUNT in a row, closer than BLK_BACK_TO_BACK_US, like the sectors of a long pio transfer) the queue
+switches to polling: the interrupt stays masked and the waiter polls the device itself, which saves an interrupt, a softirq and a wakeup
+for every completion. After BLK_IDLE_POLLS empty polls, or when the completions slow down, the queue goes back to interrupts.
+Callers that care about latency more than about the cpu can ask blk_wait() to busy poll regardless of the mode.
+*/
+
+#include <include/types.h>
+#include <drv/blk/include/blk.h>
+#include <int/include/softirq.h>
+#include <include/low_level.h>
+#include <time/include/tsc.h>
+#include <include/mem.h>
+
+blk_queue_t *blk_scheduled = null; //queues the block softirq has to poll
+bool blk_softirq_ready = false;
+
+static void blk_mask(blk_queue_t *queue, bool masked) {
+    if (queue->mask && queue->masked != masked) {
+        queue->mask(queue, masked);
+        queue->masked = masked;
+    }
+}
+
+//updates the back to back counter with the completions just handled and switches the mode
+static void blk_account(blk_queue_t *queue, uint32_t completed) {
+    if (!completed) {
+        return;
+    }
+
+    uint64_t now = rdtsc();
+    uint64_t threshold = tsc_khz * BLK_BACK_TO_BACK_US / 1000;
+    bool close = threshold && now - queue->last_completion < threshold;
+    queue->last_completion = now;
+    queue->back_to_back = close ? queue->back_to_back + completed : 0;
+
+    if (queue->mode == blk_irq_mode && queue->back_to_back >= BLK_BACK_TO_BACK_COUNT) {
+        queue->mode = blk_poll_mode;
+        queue->mode_switches++;
+    } else if (queue->mode == blk_poll_mode && !close) {
+        queue->mode = blk_irq_mode;
+        queue->mode_switches++;
+    }
+}
+
+static void blk_schedule(blk_queue_t *queue) {
+    if (!queue->scheduled) {
+        queue->scheduled = true;
+        queue->next = blk_scheduled;
+        blk_scheduled = queue;
+    }
+}
+
+/*
+polls the scheduled queues. a queue that used its whole budget stays scheduled (its interrupt masked) and the softirq is raised again,
+the others are unscheduled and get their interrupt back, unless a waiter is polling them.
+*/
+static void blk_softirq(void *ctx) {
+    bool enabled = save_disable_int();
+    blk_queue_t *queue = blk_scheduled;
+    blk_scheduled = null;
+    restore_int(enabled);
+
+    while (queue) {
+        blk_queue_t *next = queue->next;
+        uint32_t completed = queue->poll(queue, BLK_POLL_BUDGET);
+        queue->irq_completions += completed;
+        blk_account(queue, completed);
+        enabled = save_disable_int();
+        queue->scheduled = false;
+
+        if (completed == BLK_POLL_BUDGET) {
+            blk_schedule(queue);
+            softirq_raise(softirq_block);
+        } else if (queue->mode == blk_irq_mode || !queue->waiters) {
+            blk_mask(queue, false);
+        }
+
+        restore_int(enabled);
+        queue = next;
+    }
+}
+
+/*
+sets up the completion queue of a device, with its interrupt unmasked.
+returns false if the queue or poll are null.
+*/
+bool blk_queue_init(blk_queue_t *queue, uint32_t (*poll)(blk_queue_t *, uint32_t), void (*mask)(blk_queue_t *, bool), void *data) {
+    if (!queue || !poll) {
+        return false;
+    }
+
+    if (!blk_softirq_ready) {
+        if (!softirq_open(softirq_block, blk_softirq, null)) {
+            return false;
+        }
+
+        blk_softirq_ready = true;
+    }
+
+    memclear(queue, sizeof(blk_queue_t));
+    queue->poll = poll;
+    queue->mask = mask;
+    queue->data = data;
+    queue->mode = blk_irq_mode;
+    queue->masked = true;
+    blk_mask(queue, false);
+    return true;
+}
+
+/* called by the interrupt handler of the device: masks the interrupt and leaves the completions to the block softirq */
+void blk_queue_irq(blk_queue_t *queue) {
+    blk_mask(queue, true);
+    blk_schedule(queue);
+    softirq_raise(softirq_block);
+}
+
+/*
+waits for *done, set by the poll function of the driver when the request completes.
+in interrupt mode the cpu halts until the interrupts complete the request, in polling mode (or with blk_wait_busy_poll) it polls the
+queue with the device interrupt masked.
+must be called with the interrupts enabled if the device has an interrupt.
+*/
+void blk_wait(blk_queue_t *queue, volatile bool *done, blk_wait_t how) {
+    uint32_t idle = 0;
+    queue->waiters++;
+
+    while (!*done) {
+        bool polling = how == blk_wait_busy_poll || queue->mode == blk_poll_mode || !queue->mask;
+
+        if (polling) {
+            bool enabled = save_disable_int();
+            blk_mask(queue, true);
+            uint32_t completed = queue->poll(queue, BLK_POLL_BUDGET);
+            restore_int(enabled);
+
+            if (how == blk_wait_busy_poll) {
+                queue->busy_poll_completions += completed;
+            } else {
+                queue->poll_completions += completed;
+            }
+
+            blk_account(queue, completed);
+            idle = completed ? 0 : idle + 1;
+
+            //nothing is coming: back to interrupts
+            if (idle >= BLK_IDLE_POLLS && how != blk_wait_busy_poll && queue->mode == blk_poll_mode) {
+                queue->mode = blk_irq_mode;
+                queue->mode_switches++;
+            }
+
+            continue;
+        }
+
+        //the completion can't be missed: it can only come from an interrupt, and the interrupts are enabled by the hlt itself
+        disable_int();
+        blk_mask(queue, false);
+
+        if (*done) {
+            enable_int();
+            break;
+        }
+
+        wait_for_int();
+    }
+
+    queue->waiters--;
+
+    if (queue->mode == blk_irq_mode && !queue->scheduled) {
+        bool enabled = save_disable_int();
+        blk_mask(queue, false);
+        restore_int(enabled);
+    }
+}
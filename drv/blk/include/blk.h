@@ -0,0 +1,42 @@
+#pragma once
+#include <include/types.h>
+#define BLK_POLL_BUDGET 16          //completions handled by a poll round before the others get a turn
+#define BLK_BACK_TO_BACK_US 100     //completions closer than this are back to back
+#define BLK_BACK_TO_BACK_COUNT 4    //back to back completions that switch a queue to polling
+#define BLK_IDLE_POLLS 4096         //empty polls after which a polling queue goes back to interrupts
+
+typedef enum {
+    blk_irq_mode,   //the device interrupts for every completion
+    blk_poll_mode   //device interrupt masked, the waiter polls the completions
+} blk_mode_t;
+
+typedef enum {
+    blk_wait_adaptive,  //interrupts at low load, polling when the completions come back to back
+    blk_wait_busy_poll  //always polls, for latency critical callers (no interrupt latency, the cpu spins)
+} blk_wait_t;
+
+/*
+completion queue of a block device (or of one of its channels).
+the driver provides poll(), which handles up to budget completions (e.g. transfers a ready sector and completes the request) and returns
+how many it handled, and mask(), which masks or unmasks the interrupt of the device (null if the device has no interrupt).
+*/
+typedef struct blk_queue {
+    uint32_t (*poll)(struct blk_queue *queue, uint32_t budget);
+    void (*mask)(struct blk_queue *queue, bool masked);
+    void *data;
+    blk_mode_t mode;
+    bool masked;
+    bool scheduled;                 //in the list of the queues the block softirq polls
+    uint32_t waiters;
+    uint32_t back_to_back;
+    uint64_t last_completion;       //tsc
+    struct blk_queue *next;
+    uint64_t irq_completions;       //statistics: completions handled by the softirq after an interrupt,
+    uint64_t poll_completions;      //by a waiter of a polling queue,
+    uint64_t busy_poll_completions; //by a busy polling waiter
+    uint64_t mode_switches;
+} blk_queue_t;
+
+bool blk_queue_init(blk_queue_t *queue, uint32_t (*poll)(blk_queue_t *, uint32_t), void (*mask)(blk_queue_t *, bool), void *data);
+void blk_queue_irq(blk_queue_t *queue);
+void blk_wait(blk_queue_t *queue, volatile bool *done, blk_wait_t how);
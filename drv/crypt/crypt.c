@@ -0,0 +1,124 @@
+/*
+Encrypting block device.
+A crypt device wraps an IDE drive: crypt_write() encrypts the data with AES-XTS before ide_write_wrapper() and crypt_read() decrypts
+it after ide_read_wrapper(), so the data on the disk is always encrypted. The sector address is the XTS tweak.
+Requests are split in batches of CRYPT_BATCH_SECTORS sectors: every batch is decrypted right after it's read (and written right
+after it's encrypted) while it's still in the cache, and the encryption of a batch uses the 4 blocks AES-NI pipeline.
+Devices are allocated from a slab pool and referenced by handle.
+*/
+
+#include <include/types.h>
+#include <drv/crypt/include/crypt.h>
+#include <drv/ide/include/ide_wrapper.h>
+#include <crypto/include/aes.h>
+#include <mm/include/obj_alloc.h>
+#include <mm/include/kmalloc.h>
+#include <include/mem.h>
+
+pool_t crypt_devices_pool_id;
+bool crypt_devices_pool_ready = false;
+
+/* creates a crypt device on drive, key is 2 * key_bits bits long (data key and tweak key) */
+bool crypt_create(crypt_dev_id *id, ide_drive_id drive, const uint8_t *key, uint32_t key_bits) {
+    if (!id || !key) {
+        return false;
+    }
+
+    if (!crypt_devices_pool_ready) {
+        if (!create_growable_obj_pool(&crypt_devices_pool_id, sizeof(crypt_device_t), CRYPT_MAX_DEVICES, slab)) {
+            return false;
+        }
+
+        crypt_devices_pool_ready = true;
+    }
+
+    crypt_device_t *dev;
+
+    if (!obj_pool_alloc(crypt_devices_pool_id, id, (void **) &dev)) {
+        return false;
+    }
+
+    dev->drive = drive;
+    dev->bounce = kmalloc(CRYPT_BATCH_SECTORS * CRYPT_SECTOR_SIZE);
+
+    if (!dev->bounce || !aes_xts_set_key(&dev->key, key, key_bits)) {
+        crypt_destroy(*id);
+        return false;
+    }
+
+    return true;
+}
+
+bool crypt_destroy(crypt_dev_id id) {
+    crypt_device_t *dev;
+
+    if (!crypt_devices_pool_ready || !obj_pool_lookup(crypt_devices_pool_id, id, (void **) &dev)) {
+        return false;
+    }
+
+    //don't leave the key and the last plaintext around
+    memclear(&dev->key, sizeof(aes_xts_key_t));
+
+    if (dev->bounce) {
+        memclear(dev->bounce, CRYPT_BATCH_SECTORS * CRYPT_SECTOR_SIZE);
+        kfree(dev->bounce);
+    }
+
+    return obj_pool_free(crypt_devices_pool_id, id);
+}
+
+static crypt_device_t *crypt_get_device(crypt_dev_id id) {
+    crypt_device_t *dev;
+
+    if (!crypt_devices_pool_ready || !obj_pool_lookup(crypt_devices_pool_id, id, (void **) &dev)) {
+        return null;
+    }
+
+    return dev;
+}
+
+bool crypt_read(crypt_dev_id id, uint64_t address, uint64_t sectors, void *buffer) {
+    crypt_device_t *dev = crypt_get_device(id);
+
+    if (!dev || !buffer) {
+        return false;
+    }
+
+    //the ciphertext is read into the caller's buffer and decrypted in place
+    for (uint64_t done = 0; done < sectors; done += CRYPT_BATCH_SECTORS) {
+        uint64_t batch = sectors - done < CRYPT_BATCH_SECTORS ? sectors - done : CRYPT_BATCH_SECTORS;
+        void *ptr = buffer + done * CRYPT_SECTOR_SIZE;
+
+        if (!ide_read_wrapper(dev->drive, address + done, batch, ptr)) {
+            return false;
+        }
+
+        if (!aes_xts_decrypt(&dev->key, address + done, ptr, ptr, batch, CRYPT_SECTOR_SIZE)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool crypt_write(crypt_dev_id id, uint64_t address, uint64_t sectors, void *data) {
+    crypt_device_t *dev = crypt_get_device(id);
+
+    if (!dev || !data) {
+        return false;
+    }
+
+    for (uint64_t done = 0; done < sectors; done += CRYPT_BATCH_SECTORS) {
+        uint64_t batch = sectors - done < CRYPT_BATCH_SECTORS ? sectors - done : CRYPT_BATCH_SECTORS;
+
+        if (!aes_xts_encrypt(&dev->key, address + done, dev->bounce, data + done * CRYPT_SECTOR_SIZE, batch, CRYPT_SECTOR_SIZE)) {
+            return false;
+        }
+
+        if (!ide_write_wrapper(dev->drive, address + done, batch, dev->bounce)) {
+            return false;
+        }
+    }
+
+    return true;
+}
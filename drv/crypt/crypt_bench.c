@@ -0,0 +1,134 @@
+/*
+Throughput overhead of the encrypting block device.
+It measures the cipher alone (portable and AES-NI), then raw and encrypted reads and writes of the same sectors of the drive.
+The sectors starting at address are overwritten.
+*/
+
+#include <include/types.h>
+#include <drv/crypt/include/crypt.h>
+#include <drv/ide/include/ide_wrapper.h>
+#include <crypto/include/aes.h>
+#include <mm/include/kmalloc.h>
+#include <include/mem.h>
+#include <include/low_level.h>
+#include <tty/include/tty.h>
+#include <include/string.h>
+
+#define CRYPT_BENCH_SECTORS 64
+#define CRYPT_BENCH_ROUNDS 16
+
+bool aes_xts_crypt_generic(const aes_xts_key_t *key, uint64_t sector, uint8_t *dst, const uint8_t *src, uint64_t sectors, uint32_t sector_size, bool encrypt);
+
+//prints the cycles per byte with 2 decimals
+static void crypt_bench_print(const char *name, uint64_t cycles, uint64_t bytes) {
+    uint64_t hundredths = cycles * 100 / bytes;
+    printf("%s: %lu.%02lu cycles/byte\n", name, hundredths / 100, hundredths % 100);
+}
+
+//the overhead is negative when the encrypted path is faster (batched transfers, noise)
+static void crypt_bench_overhead(const char *name, uint64_t raw, uint64_t encrypted) {
+    long overhead = raw ? ((long) encrypted - (long) raw) * 100 / (long) raw : 0;
+    printf("%s: raw %lu cycles, encrypted %lu cycles, overhead %ld%%\n", name, raw, encrypted, overhead);
+}
+
+bool crypt_bench(ide_drive_id drive, uint64_t address) {
+    uint64_t size = CRYPT_BENCH_SECTORS * CRYPT_SECTOR_SIZE;
+    uint8_t *buffer = kmalloc(size);
+    uint8_t key[64];
+    aes_xts_key_t xts_key;
+    crypt_dev_id id;
+    bool ret = false;
+
+    if (!buffer) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sizeof(key); i++) {
+        key[i] = i * 13 + 1;
+    }
+
+    for (uint64_t i = 0; i < size; i++) {
+        buffer[i] = i;
+    }
+
+    aes_xts_set_key(&xts_key, key, 256);
+
+    //cipher only
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < CRYPT_BENCH_ROUNDS; i++) {
+        aes_xts_crypt_generic(&xts_key, address, buffer, buffer, CRYPT_BENCH_SECTORS, CRYPT_SECTOR_SIZE, true);
+    }
+
+    crypt_bench_print("aes-256-xts portable", rdtsc() - start, CRYPT_BENCH_ROUNDS * size);
+
+    if (aes_ni_enabled()) {
+        start = rdtsc();
+
+        for (uint32_t i = 0; i < CRYPT_BENCH_ROUNDS; i++) {
+            aes_xts_encrypt(&xts_key, address, buffer, buffer, CRYPT_BENCH_SECTORS, CRYPT_SECTOR_SIZE);
+        }
+
+        crypt_bench_print("aes-256-xts aes-ni", rdtsc() - start, CRYPT_BENCH_ROUNDS * size);
+    }
+
+    if (!crypt_create(&id, drive, key, 256)) {
+        goto end;
+    }
+
+    //raw and encrypted device I/O on the same sectors
+    start = rdtsc();
+
+    if (!ide_write_wrapper(drive, address, CRYPT_BENCH_SECTORS, buffer)) {
+        goto destroy;
+    }
+
+    uint64_t raw_write = rdtsc() - start;
+    start = rdtsc();
+
+    if (!crypt_write(id, address, CRYPT_BENCH_SECTORS, buffer)) {
+        goto destroy;
+    }
+
+    uint64_t crypt_write_cycles = rdtsc() - start;
+    start = rdtsc();
+
+    if (!ide_read_wrapper(drive, address, CRYPT_BENCH_SECTORS, buffer)) {
+        goto destroy;
+    }
+
+    uint64_t raw_read = rdtsc() - start;
+    start = rdtsc();
+
+    if (!crypt_read(id, address, CRYPT_BENCH_SECTORS, buffer)) {
+        goto destroy;
+    }
+
+    uint64_t crypt_read_cycles = rdtsc() - start;
+    crypt_bench_overhead("write", raw_write, crypt_write_cycles);
+    crypt_bench_overhead("read", raw_read, crypt_read_cycles);
+    ret = true;
+
+destroy:
+    crypt_destroy(id);
+end:
+    memclear(&xts_key, sizeof(xts_key));
+    kfree(buffer);
+    return ret;
+}
+
+/* terminal command cryptbench <drive> <sector>: the sectors from sector on are overwritten, so the drive and the sector are required */
+void crypt_bench_command(char *args) {
+    char *saveptr;
+    char *drive = strtok_r(args, " ", &saveptr);
+    char *sector = strtok_r(null, " ", &saveptr);
+
+    if (!drive || !sector) {
+        printf("usage: cryptbench <drive> <sector>, overwrites %d sectors from sector on\n", CRYPT_BENCH_SECTORS);
+        return;
+    }
+
+    if (!crypt_bench(stoi(drive), stoi(sector))) {
+        printf("cryptbench: the drive can't be read or written\n");
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <include/types.h>
+#include <drv/ide/include/ide_wrapper.h>
+#include <crypto/include/aes.h>
+#include <mm/include/obj_alloc.h>
+#define CRYPT_SECTOR_SIZE 512
+#define CRYPT_BATCH_SECTORS 16 //sectors encrypted (or decrypted) and transferred together
+#define CRYPT_MAX_DEVICES 16
+
+typedef obj_handle_t crypt_dev_id;
+
+//encrypting block device: every sector of the drive is encrypted with AES-XTS, the tweak is the sector address
+typedef struct {
+    ide_drive_id drive;
+    aes_xts_key_t key;
+    uint8_t *bounce; //ciphertext of a batch of sectors being written, the caller's data is never modified
+} crypt_device_t;
+
+bool crypt_create(crypt_dev_id *id, ide_drive_id drive, const uint8_t *key, uint32_t key_bits);
+bool crypt_destroy(crypt_dev_id id);
+bool crypt_read(crypt_dev_id id, uint64_t address, uint64_t sectors, void *buffer);
+bool crypt_write(crypt_dev_id id, uint64_t address, uint64_t sectors, void *data);
+bool crypt_bench(ide_drive_id drive, uint64_t address);
+void crypt_bench_command(char *args);
\ No newline at end of file
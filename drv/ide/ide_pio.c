@@ -1,89 +1,195 @@
 /*
 IDE driver.
 This file contains the functions to actually use the IDE devices.
+A transfer is a request of the bus queue (see blk.c): after the command the drive raises its interrupt (or sets DRQ, for the polling
+waiters) every time a sector is ready, and ide_pio_poll() moves the whole sector with a single rep insw/outsw.
 */
 
 #include <include/types.h>
 #include <drv/ide/include/ide.h>
 #include <drv/ide/include/ide_pio.h>
+#include <drv/blk/include/blk.h>
+#include <int/include/irq_domain.h>
+#include <io/include/port_io.h>
+#include <include/low_level.h>
 #include <include/mem.h>
 
-/* reads some sectors using pio mode */
-bool ide_read(ide_device_t *dev, uint64_t address, uint32_t sectors, void *buffer) {
-    if (!dev || !buffer || sectors == 0 || !dev->bus) {
-        return false;
+//the status register is valid 400ns after a command or a sector transfer, 4 reads of the alternate status
+static void ide_delay(ide_bus_t *bus) {
+    for (uint8_t i = 0; i < 4; i++) {
+        inb(bus->ctrl_bar + IDE_BAR_OFFSET_ALT_STATUS);
     }
+}
 
-    if (!ide_check_type(dev)) {
-        return false;
-    }
+/*
+poll function of the bus queue: transfers the sectors that are ready between the data register and the buffer of the request in progress.
+every sector (and the end of a write) is a completion. reading the status register also acknowledges the interrupt of the drive.
+*/
+static uint32_t ide_pio_poll(blk_queue_t *queue, uint32_t budget) {
+    ide_bus_t *bus = (ide_bus_t *) queue->data;
+    ide_request_t *request = bus->request;
+    uint32_t completed = 0;
 
-    ide_select_drive(dev->bus, dev->drive);
+    while (completed < budget) {
+        uint8_t status = ide_status(bus);
 
-    if (!ide_init_transaction(dev, address, sectors)) {
-        return false;
-    }
+        if (!request || request->done || (status & IDE_STATUS_BSY)) {
+            break;
+        }
 
-    if (dev->addr_mode == chs || dev->addr_mode == lba28) {
-        ide_command(dev->bus, IDE_COMM_READ_PIO);
-    } else if (dev->addr_mode == lba48) {
-        ide_command(dev->bus, IDE_COMM_READ_PIO_EXT);
-    } else {
-        return false;
-    }
+        if ((status & (IDE_STATUS_ERR | IDE_STATUS_DF)) || ((status & IDE_STATUS_DRQ) && request->sectors == 0)) {
+            request->error = true;
+            request->done = true;
+            completed++;
+            break;
+        }
 
-    for (uint32_t i = 0; i < sectors * 256; i++) {
-        ide_poll(dev->bus);
+        if (!(status & IDE_STATUS_DRQ)) {
+            //a write is over when the drive has taken the last sector and is no longer busy
+            if (request->write && request->sectors == 0) {
+                request->done = true;
+                completed++;
+            }
 
-        if (ide_check_error(dev->bus)) {
-            memclear(buffer, sectors * 512);
-            return false;
+            break;
+        }
+
+        if (request->write) {
+            outsw(bus->io_bar + IDE_BAR_OFFSET_DATA_REG, request->buffer, IDE_SECTOR_WORDS);
+        } else {
+            insw(bus->io_bar + IDE_BAR_OFFSET_DATA_REG, request->buffer, IDE_SECTOR_WORDS);
         }
 
-        *((uint16_t *) buffer + i) = ide_read_reg(dev->bus->io_bar, IDE_BAR_OFFSET_DATA_REG);
+        request->buffer += IDE_SECTOR_WORDS;
+        request->sectors--;
+        completed++;
+
+        if (!request->write && request->sectors == 0) {
+            request->done = true;
+            break;
+        }
+
+        ide_delay(bus);
+    }
+
+    return completed;
+}
+
+static void ide_irq_mask(blk_queue_t *queue, bool masked) {
+    ide_bus_t *bus = (ide_bus_t *) queue->data;
+    outb(bus->ctrl_bar + IDE_BAR_OFFSET_DEV_CTRL, masked ? IDE_DEV_CTRL_NIEN : 0);
+}
+
+//interrupt of a bus (ctx), the sectors are transferred by the block softirq
+static bool ide_irq(int_regs_t *regs, void *ctx) {
+    ide_bus_t *bus = (ide_bus_t *) ctx;
+
+    if (!bus->request) {
+        ide_status(bus); //nobody is waiting, acknowledge it
+        return true;
     }
 
+    blk_queue_irq(&bus->queue);
     return true;
 }
 
-bool ide_write(ide_device_t *dev, uint64_t address, uint32_t sectors, void *data) {
-    if (!dev || !data || sectors == 0 || !dev->bus) {
-        return false;
+/*
+sets up the completion queue of a bus and its interrupt (isa irq 14 or 15 in compatibility mode).
+if the interrupt can't be hooked the bus queue only polls.
+*/
+bool ide_bus_init_queue(ide_bus_t *bus, uint8_t isa_irq) {
+    bus->request = null;
+    outb(bus->ctrl_bar + IDE_BAR_OFFSET_DEV_CTRL, IDE_DEV_CTRL_NIEN); //no interrupt until a request waits for one
+
+    if (irq_request_isa(isa_irq, ide_irq, bus, &bus->vector, &bus->hook)) {
+        return blk_queue_init(&bus->queue, ide_pio_poll, ide_irq_mask, bus);
     }
 
-    if (!ide_check_type(dev)) {
+    return blk_queue_init(&bus->queue, ide_pio_poll, null, bus);
+}
+
+/*
+reads or writes some sectors using pio mode, how tells blk_wait() whether to adapt to the load or to busy poll.
+writes are followed by a single cache flush.
+*/
+bool ide_transfer(ide_device_t *dev, uint64_t address, uint32_t sectors, void *buffer, bool write, blk_wait_t how) {
+    if (!dev || !buffer || sectors == 0 || !dev->bus) {
         return false;
     }
 
-    ide_select_drive(dev->bus, dev->drive);
-
-    if (!ide_init_transaction(dev, address, sectors)) {
+    if (!ide_check_type(dev)) {
         return false;
     }
 
-    uint8_t flush_command;
+    ide_bus_t *bus = dev->bus;
+    uint8_t command, flush_command;
 
     if (dev->addr_mode == chs || dev->addr_mode == lba28) {
-        ide_command(dev->bus, IDE_COMM_WRITE_PIO);
+        command = write ? IDE_COMM_WRITE_PIO : IDE_COMM_READ_PIO;
         flush_command = IDE_COMM_CACHE_FLUSH;
     } else if (dev->addr_mode == lba48) {
-        ide_command(dev->bus, IDE_COMM_WRITE_PIO_EXT);
+        command = write ? IDE_COMM_WRITE_PIO_EXT : IDE_COMM_READ_PIO_EXT;
         flush_command = IDE_COMM_CACHE_FLUSH_EXT;
     } else {
         return false;
     }
 
-    for (uint32_t i = 0; i < sectors * 256; i++) {
-        ide_poll(dev->bus);
-        ide_write_reg(dev->bus->io_bar, IDE_BAR_OFFSET_DATA_REG, *((uint16_t *) data + i));
-        ide_command(dev->bus, flush_command);
+    ide_request_t request;
+    request.buffer = (uint16_t *) buffer;
+    request.sectors = sectors;
+    request.write = write;
+    request.done = false;
+    request.error = false;
+
+    ide_select_drive(bus, dev->drive);
+
+    if (!ide_init_transaction(dev, address, sectors)) {
+        return false;
+    }
+
+    bus->request = &request;
+    ide_command(bus, command);
+    ide_delay(bus);
+
+    //the first sector of a write is sent without waiting for an interrupt, the drive raises one when it wants the next
+    if (write) {
+        while ((ide_status(bus) & (IDE_STATUS_BSY | IDE_STATUS_DRQ)) == IDE_STATUS_BSY);
+        bool enabled = save_disable_int();
+        ide_pio_poll(&bus->queue, 1);
+        restore_int(enabled);
+    }
+
+    blk_wait(&bus->queue, &request.done, how);
+    bus->request = null;
+
+    if (request.error) {
+        if (!write) {
+            memclear(buffer, sectors * 512);
+        }
+
+        return false;
+    }
+
+    if (write) {
+        ide_command(bus, flush_command);
+        ide_delay(bus);
+        while (ide_status(bus) & IDE_STATUS_BSY);
     }
 
     return true;
 }
 
+/* reads some sectors using pio mode */
+bool ide_read(ide_device_t *dev, uint64_t address, uint32_t sectors, void *buffer) {
+    return ide_transfer(dev, address, sectors, buffer, false, blk_wait_adaptive);
+}
+
+bool ide_write(ide_device_t *dev, uint64_t address, uint32_t sectors, void *data) {
+    return ide_transfer(dev, address, sectors, data, true, blk_wait_adaptive);
+}
+
 /* this driver doesn't support packet interface */
 bool ide_check_type(ide_device_t *dev) {
     ide_type_t type = dev->ide_type;
     return type == ide_pata || type == ide_sata;
-}
\ No newline at end of file
+}
@@ -7,6 +7,7 @@ in this system and save their data in a structured manner.
 #include <include/types.h>
 #include <drv/ide/include/ide.h>
 #include <drv/ide/include/ide_setup.h>
+#include <drv/ide/include/ide_pio.h>
 #include <io/include/pci.h>
 #include <mm/include/obj_alloc.h>
 #include <mm/include/kmalloc.h>
@@ -14,7 +15,6 @@ in this system and save their data in a structured manner.
 #include <io/include/devs.h>
 
 pool_t ide_devices_pool_id;
-uint16_t ide_devices_pool_last_ind = 0;
 
 /*
 Given the PCI device, this function search and initialize every drive, and then it saves
@@ -71,11 +71,15 @@ bool ide_init(pci_general_dev_t *pci_dev) {
     if (primary_drives == 0) {
         kfree(primary_prdt);
         kfree(primary_bus);
+    } else {
+        ide_bus_init_queue(primary_bus, IDE_PRIMARY_IRQ);
     }
 
     if (secondary_drives == 0) {
         kfree(secondary_prdt);
         kfree(secondary_bus);
+    } else {
+        ide_bus_init_queue(secondary_bus, IDE_SECONDARY_IRQ);
     }
 
     return true;
@@ -105,8 +109,7 @@ uint8_t ide_bus_test_and_add_drives(ide_bus_t *bus) {
         ide_save_device_info(&master_drv, device_info);
         ide_save_device_ide_type(&master_drv);
         
-        if (obj_pool_put(ide_devices_pool_id, (void *) &master_drv, ide_devices_pool_last_ind)) {
-            ide_devices_pool_last_ind++;
+        if (obj_pool_push(ide_devices_pool_id, (void *) &master_drv, null)) {
             found++;
         }
     }
@@ -118,8 +121,7 @@ uint8_t ide_bus_test_and_add_drives(ide_bus_t *bus) {
         ide_save_device_info(&dev, device_info);
         ide_save_device_ide_type(&slave_drv);
         
-        if (obj_pool_put(ide_devices_pool_id, (void *) &slave_drv, ide_devices_pool_last_ind)) {
-            ide_devices_pool_last_ind++;
+        if (obj_pool_push(ide_devices_pool_id, (void *) &slave_drv, null)) {
             found++;
         }
     }
@@ -256,4 +258,5 @@ void ide_bus_init(ide_bus_t *bus, uint32_t io, uint32_t ctrl, bool dma, ide_prd_
     bus->ctrl_bar = ctrl;
     bus->dma_enabled = dma;
     bus->prdt = prdt;
+    bus->request = null;
 }
\ No newline at end of file
@@ -8,7 +8,6 @@
 #define TEST_BUFFER_SIZE 512
 
 extern pool_t ide_devices_pool_id;
-extern uint16_t ide_devices_pool_last_ind;
 
 bool ide_test() {
     char *test_str = "Hello World";
@@ -1,5 +1,7 @@
 #pragma once
 #include <include/types.h>
+#include <drv/blk/include/blk.h>
+#include <int/include/int.h>
 
 /* I/O bar offsets */
 
@@ -38,6 +40,17 @@
 
 #define IDE_DEVICE_MAGIC 0xC0
 
+/* status and device control bits */
+
+#define IDE_STATUS_ERR 0x01
+#define IDE_STATUS_DRQ 0x08
+#define IDE_STATUS_DF 0x20
+#define IDE_STATUS_BSY 0x80
+#define IDE_DEV_CTRL_NIEN 0x02 //the drive doesn't raise its interrupt
+#define IDE_PRIMARY_IRQ 14     //isa irqs of the buses in compatibility mode
+#define IDE_SECONDARY_IRQ 15
+#define IDE_SECTOR_WORDS 256
+
 typedef enum {
     ide_pata,
     ide_sata,
@@ -72,12 +85,25 @@ typedef struct {
     uint8_t foo;
 } ide_prd_t;
 
+/* pio transfer in progress on a bus, completed by the poll function of the bus queue */
+typedef struct {
+    uint16_t *buffer;            //next sector to transfer
+    uint32_t sectors;            //sectors left to transfer
+    bool write;
+    volatile bool done;
+    bool error;
+} ide_request_t;
+
 /* defines an IDE bus */
 typedef struct {
     uint32_t io_bar;             //PCI bar for I/O
     uint32_t ctrl_bar;           //PCI bar for control
     bool dma_enabled;            //true if this bus supports DMA
     ide_prd_t *prdt;             //pointer to this bus prdt
+    blk_queue_t queue;           //completions of the bus (one command at a time)
+    ide_request_t *request;      //transfer in progress, null if none
+    uint8_t vector;              //interrupt of the bus, if hooked
+    int_hook_t hook;
 } ide_bus_t;
 
 /* defines an IDE device */
@@ -1,7 +1,10 @@
 #pragma once
 #include <include/types.h>
 #include <drv/ide/include/ide.h>
+#include <drv/blk/include/blk.h>
 
+bool ide_bus_init_queue(ide_bus_t *bus, uint8_t isa_irq);
+bool ide_transfer(ide_device_t *dev, uint64_t address, uint32_t sectors, void *buffer, bool write, blk_wait_t how);
 bool ide_read(ide_device_t *dev, uint64_t address, uint32_t sectors, void *buffer);
 bool ide_write(ide_device_t *dev, uint64_t address, uint32_t sectors, void *data);
-bool ide_check_type(ide_device_t *dev);
\ No newline at end of file
+bool ide_check_type(ide_device_t *dev);
@@ -0,0 +1,128 @@
+/*
+Kernel FPU/SIMD context management.
+fpu_init() enables x87, SSE (CR0, CR4.OSFXSR/OSXMMEXCPT) and, if the cpu supports XSAVE, CR4.OSXSAVE and the AVX state in XCR0.
+The interrupt code is compiled with -mgeneral-regs-only, so an interrupt handler that wants to use SIMD registers (directly or through
+functions like memcpy_simd()) must wrap that code in kernel_fpu_begin()/kernel_fpu_end().
+The nesting depth and the save areas are per cpu (percpu_t), the sections of two cpus never share an area.
+*/
+
+#include <include/types.h>
+#include <include/fpu.h>
+#include <include/low_level.h>
+#include <include/cpu.h>
+#include <include/percpu.h>
+
+#define CR0_MP (1 << 1)
+#define CR0_EM (1 << 2)
+#define CR0_TS (1 << 3)
+#define CR0_NE (1 << 5)
+#define CR4_OSFXSR (1 << 9)
+#define CR4_OSXMMEXCPT (1 << 10)
+#define CR4_OSXSAVE (1 << 18)
+
+typedef enum {
+    fpu_save_none, //fpu_init() not called or no FXSR
+    fpu_save_fxsave,
+    fpu_save_xsave,
+    fpu_save_xsaveopt
+} fpu_save_method_t;
+
+fpu_save_method_t fpu_save_method = fpu_save_none;
+uint64_t fpu_xcr0 = 0;
+
+//must be called after cpu_features_init() and percpu_init()
+bool fpu_init() {
+    if (!cpu_has(CPU_FEATURE_FXSR) || !cpu_has(CPU_FEATURE_SSE2)) {
+        return false;
+    }
+
+    //x87 present and native error reporting, no lazy switching trap (TS)
+    set_cr0((get_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+    set_cr4(get_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    fpu_save_method = fpu_save_fxsave;
+
+    if (cpu_has(CPU_FEATURE_XSAVE) && cpu_features.max_leaf >= 0xD) {
+        uint32_t supported, size;
+        set_cr4(get_cr4() | CR4_OSXSAVE);
+        cpuid_count(0xD, 0, &supported, null, null, null);
+        fpu_xcr0 = XCR0_X87 | XCR0_SSE;
+
+        if (cpu_has(CPU_FEATURE_AVX) && (supported & XCR0_AVX)) {
+            fpu_xcr0 |= XCR0_AVX;
+        }
+
+        xsetbv(0, fpu_xcr0);
+        cpuid_count(0xD, 0, null, &size, null, null); //size of the save area for the components enabled in XCR0
+
+        if (size <= FPU_SAVE_AREA_SIZE) {
+            fpu_save_method = cpu_has(CPU_FEATURE_XSAVEOPT) ? fpu_save_xsaveopt : fpu_save_xsave;
+        } else {
+            //the save areas are too small, don't use XSAVE (and AVX)
+            fpu_xcr0 = XCR0_X87 | XCR0_SSE;
+            xsetbv(0, fpu_xcr0);
+        }
+    }
+
+    asm volatile("fninit");
+    return true;
+}
+
+bool fpu_avx_enabled() {
+    return (fpu_xcr0 & XCR0_AVX) != 0;
+}
+
+bool kernel_fpu_begin() {
+    if (fpu_save_method == fpu_save_none) {
+        return false;
+    }
+
+    percpu_t *cpu = this_cpu();
+    uint32_t depth = cpu->fpu_depth;
+
+    if (depth == FPU_MAX_DEPTH) {
+        return false;
+    }
+
+    /*
+    the area is claimed before saving, so an interrupt that arrives in between uses the next area and restores the same registers
+    that we're about to save.
+    */
+    cpu->fpu_depth = depth + 1;
+    asm volatile("" : : : "memory");
+    void *area = cpu->fpu_save_areas[depth];
+
+    switch (fpu_save_method) {
+        case fpu_save_xsaveopt:
+            asm volatile("xsaveopt64 (%0)" : : "r"(area), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+            break;
+        case fpu_save_xsave:
+            asm volatile("xsave64 (%0)" : : "r"(area), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+            break;
+        default:
+            asm volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+            break;
+    }
+
+    return true;
+}
+
+void kernel_fpu_end() {
+    percpu_t *cpu = this_cpu();
+    uint32_t depth = cpu->fpu_depth;
+
+    if (depth == 0) {
+        return;
+    }
+
+    void *area = cpu->fpu_save_areas[depth - 1];
+
+    if (fpu_save_method == fpu_save_fxsave) {
+        asm volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+    } else {
+        asm volatile("xrstor64 (%0)" : : "r"(area), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+    }
+
+    //release the area only after the registers have been restored
+    asm volatile("" : : : "memory");
+    cpu->fpu_depth = depth - 1;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <include/types.h>
+
+/*
+static calls: a hot function whose best implementation depends on the cpu is called through a trampoline, a 5 bytes "jmp rel32" placed in
+.text under the function's name. at boot the subsystem that owns the function picks the implementation once and static_call_update() rewrites
+the jump, so every call site pays a direct call and a direct jump instead of loading a function pointer or testing a flag.
+STATIC_CALL(name, target) defines the trampoline "name" (declared as a normal function in the headers) that initially jumps to target,
+target must be a global symbol.
+*/
+#define STATIC_CALL(name, target)                         \
+    asm(".pushsection .text\n"                            \
+        ".globl " #name "\n"                              \
+        ".type " #name ", @function\n"                    \
+        ".balign 8\n"                                     \
+        #name ":\n"                                       \
+        ".byte 0xE9\n"                                    \
+        ".long " #target " - . - 4\n"                     \
+        ".byte 0xCC, 0xCC, 0xCC\n"                        \
+        ".size " #name ", 8\n"                            \
+        ".popsection");
+
+bool static_call_update(void *trampoline, void *target);
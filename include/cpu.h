@@ -0,0 +1,92 @@
+#pragma once
+#include <include/types.h>
+#define CPU_MAX_CACHES 8
+#define CPU_MAX_TLBS 8
+
+//cpu features, each one is a bit of cpu_features.flags
+typedef enum {
+    CPU_FEATURE_TSC,
+    CPU_FEATURE_APIC,
+    CPU_FEATURE_PGE,
+    CPU_FEATURE_FXSR,
+    CPU_FEATURE_SSE2,
+    CPU_FEATURE_PCLMUL,
+    CPU_FEATURE_SSE42,
+    CPU_FEATURE_PCID,
+    CPU_FEATURE_X2APIC,
+    CPU_FEATURE_TSC_DEADLINE,
+    CPU_FEATURE_AES,
+    CPU_FEATURE_XSAVE,
+    CPU_FEATURE_AVX,
+    CPU_FEATURE_RDRAND,
+    CPU_FEATURE_HYPERVISOR,
+    CPU_FEATURE_AVX2,
+    CPU_FEATURE_ERMS,
+    CPU_FEATURE_INVPCID,
+    CPU_FEATURE_RDSEED,
+    CPU_FEATURE_SHA,
+    CPU_FEATURE_LA57,
+    CPU_FEATURE_FSRM,
+    CPU_FEATURE_XSAVEOPT,
+    CPU_FEATURE_NX,
+    CPU_FEATURE_PAGE_1GB,
+    CPU_FEATURE_INVARIANT_TSC
+} cpu_feature_t;
+
+typedef enum {
+    cpu_vendor_unknown,
+    cpu_vendor_intel,
+    cpu_vendor_amd
+} cpu_vendor_t;
+
+typedef enum {
+    cpu_cache_data = 1,
+    cpu_cache_instruction = 2,
+    cpu_cache_unified = 3
+} cpu_cache_type_t;
+
+typedef struct {
+    cpu_cache_type_t type;
+    uint8_t level;
+    uint16_t line_size;
+    uint16_t ways;
+    uint32_t sets;
+    uint32_t size; //in bytes
+} cpu_cache_t;
+
+//page sizes a tlb can hold (bitmask)
+#define CPU_TLB_4K (1 << 0)
+#define CPU_TLB_2M (1 << 1)
+#define CPU_TLB_4M (1 << 2)
+#define CPU_TLB_1G (1 << 3)
+
+typedef struct {
+    uint8_t type; //same values as cpu_cache_type_t
+    uint8_t level;
+    uint8_t page_sizes;
+    uint16_t ways; //0 if fully associative or unknown
+    uint32_t entries;
+} cpu_tlb_t;
+
+typedef struct {
+    char vendor_string[13];
+    cpu_vendor_t vendor;
+    uint32_t max_leaf;
+    uint32_t max_ext_leaf;
+    uint32_t family, model, stepping;
+    uint64_t flags;
+    uint8_t physical_address_bits, virtual_address_bits;
+    uint8_t caches_count;
+    cpu_cache_t caches[CPU_MAX_CACHES];
+    uint8_t tlbs_count;
+    cpu_tlb_t tlbs[CPU_MAX_TLBS];
+} cpu_features_t;
+
+extern cpu_features_t cpu_features;
+
+static inline bool cpu_has(cpu_feature_t feature) {
+    return cpu_features.flags >> feature & 1;
+}
+
+void cpu_features_init();
+void cpu_print_info();
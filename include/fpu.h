@@ -0,0 +1,20 @@
+#pragma once
+#include <include/types.h>
+#define FPU_MAX_DEPTH 8 //max nesting of kernel_fpu_begin() (normal code + nested interrupts)
+#define FPU_SAVE_AREA_SIZE 1024 //enough for x87, SSE and AVX state (XSAVE standard format)
+#define XCR0_X87 (1 << 0)
+#define XCR0_SSE (1 << 1)
+#define XCR0_AVX (1 << 2)
+
+/*
+kernel_fpu_begin() saves the x87/SSE/AVX state of the code that is using the registers (the interrupted code if called in an interrupt handler)
+and kernel_fpu_end() restores it. the code between the two can use any SIMD instruction.
+every nesting depth has its own save area, XSAVEOPT skips the components that are in their initial state or that haven't been modified since
+the last restore from the same area, so a section that doesn't find live state pays almost nothing.
+kernel_fpu_begin() returns false if SIMD can't be used (fpu_init() not called yet or too many nested sections), in that case the caller
+must use a scalar path and must not call kernel_fpu_end().
+*/
+bool fpu_init();
+bool kernel_fpu_begin();
+void kernel_fpu_end();
+bool fpu_avx_enabled();
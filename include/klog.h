@@ -0,0 +1,44 @@
+#pragma once
+#include <include/types.h>
+#include <include/ring.h>
+#include <tty/include/vsnprintf.h>
+#define KLOG_MAX_ARGS 6
+#define KLOG_RECORDS 128 //per cpu, must be a power of 2
+
+/*
+binary log record: the format string is formatted only when the record is flushed, so it must be a literal (or live forever),
+and so must the strings passed to %s.
+*/
+typedef struct {
+    uint64_t tsc;
+    const char *fmt;
+    uint64_t args[KLOG_MAX_ARGS];
+} klog_record_t;
+
+typedef struct {
+    spsc_ring_t ring; //produced by its cpu (with its interrupts disabled), consumed by klog_flush()
+    uint64_t dropped; //records lost because the ring was full
+    uint64_t reported; //drops already reported by klog_flush()
+} klog_cpu_t;
+
+//every argument is stored as a raw 64 bit value, up to KLOG_MAX_ARGS of them
+#define KLOG_ARG(x) (uint64_t)(x)
+#define KLOG_ARGS_0()
+#define KLOG_ARGS_1(a) KLOG_ARG(a)
+#define KLOG_ARGS_2(a, b) KLOG_ARG(a), KLOG_ARG(b)
+#define KLOG_ARGS_3(a, b, c) KLOG_ARG(a), KLOG_ARG(b), KLOG_ARG(c)
+#define KLOG_ARGS_4(a, b, c, d) KLOG_ARG(a), KLOG_ARG(b), KLOG_ARG(c), KLOG_ARG(d)
+#define KLOG_ARGS_5(a, b, c, d, e) KLOG_ARG(a), KLOG_ARG(b), KLOG_ARG(c), KLOG_ARG(d), KLOG_ARG(e)
+#define KLOG_ARGS_6(a, b, c, d, e, f) KLOG_ARG(a), KLOG_ARG(b), KLOG_ARG(c), KLOG_ARG(d), KLOG_ARG(e), KLOG_ARG(f)
+#define KLOG_SELECT(_1, _2, _3, _4, _5, _6, name, ...) name
+#define KLOG_COUNT(...) KLOG_SELECT(__VA_ARGS__ __VA_OPT__(,) 6, 5, 4, 3, 2, 1, 0)
+#define KLOG_ARGS(...) \
+    KLOG_SELECT(__VA_ARGS__ __VA_OPT__(,) KLOG_ARGS_6, KLOG_ARGS_5, KLOG_ARGS_4, KLOG_ARGS_3, KLOG_ARGS_2, KLOG_ARGS_1, KLOG_ARGS_0)(__VA_ARGS__)
+
+//logs a message without formatting it, same conversions as printf()
+#define klog(fmt, ...) klog_record(fmt, KLOG_COUNT(__VA_ARGS__), (const uint64_t[KLOG_MAX_ARGS]){KLOG_ARGS(__VA_ARGS__)})
+
+bool klog_init();
+void klog_record(const char *fmt, uint32_t count, const uint64_t *args);
+uint32_t klog_flush(fmt_sink_t *sink);
+uint64_t klog_dropped();
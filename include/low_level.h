@@ -2,10 +2,22 @@
 #include <include/types.h>
 
 void sys_hlt();
+void wait_for_int();
 void disable_int();
 void enable_int();
+uint64_t get_rflags();
+bool save_disable_int();
+void restore_int(bool enabled);
+uint64_t get_cr0();
+void set_cr0(uint64_t cr0);
+uint64_t get_cr4();
+void set_cr4(uint64_t cr4);
 uint64_t get_cr3();
 uint64_t get_cr2();
 void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+uint64_t xgetbv(uint32_t xcr);
+void xsetbv(uint32_t xcr, uint64_t value);
 void get_msr(uint32_t msr, uint32_t *lo, uint32_t *hi);
-void set_msr(uint32_t msr, uint32_t lo, uint32_t hi);
\ No newline at end of file
+void set_msr(uint32_t msr, uint32_t lo, uint32_t hi);
+uint64_t rdtsc();
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 #include <include/types.h>
 
+void mem_init();
 uint64_t memcpy(void *dst, void *src, uint64_t size);
+uint64_t memcpy_simd(void *dst, void *src, uint64_t size);
 uint64_t memmove(void *dst, void *src, uint64_t size);
 void memset(void *dst, uint64_t size, uint8_t value);
 void memclear(void *, uint64_t);
 void reverse_endianess(void *, uint64_t);
-bool memcmp(void *, void *, uint64_t);
\ No newline at end of file
+bool memcmp(void *, void *, uint64_t);
+void mem_bench();
\ No newline at end of file
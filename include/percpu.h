@@ -0,0 +1,34 @@
+#pragma once
+#include <include/types.h>
+#include <include/random.h>
+#include <include/fpu.h>
+#define MAX_CPUS 16
+#define IA32_GS_BASE 0xC0000101
+
+/*
+per-cpu data: every cpu has its own percpu_t (cache line aligned, so two cpus never share a line) and its GS base points to it.
+this_cpu() reads the self pointer at %gs:0, so the access costs a single load and doesn't need the cpu index.
+*/
+typedef struct percpu {
+    struct percpu *self; //must be the first field
+    uint32_t cpu_index;
+    uint32_t lapic_id;
+    uint32_t softirq_pending; //bit n set if softirq n has been raised on this cpu (see softirq.c)
+    bool softirq_active;
+    struct irqstat_cpu *irqstat; //interrupt statistics, null until irqstat_init_cpu()
+    struct timer_base *timers; //timer wheel and hrtimers, null until timer_init_cpu()
+    random_state_t random;
+    volatile uint32_t fpu_depth; //open kernel_fpu_begin() sections, the next one saves in fpu_save_areas[fpu_depth]
+    uint8_t fpu_save_areas[FPU_MAX_DEPTH][FPU_SAVE_AREA_SIZE] __attribute__((aligned(64)));
+} __attribute__((aligned(64))) percpu_t;
+
+extern percpu_t percpu_areas[MAX_CPUS];
+extern uint64_t percpu_online; //bit n set once cpu n has called percpu_init()
+
+static inline percpu_t *this_cpu() {
+    percpu_t *ptr;
+    asm volatile("mov %%gs:0, %0" : "=r"(ptr));
+    return ptr;
+}
+
+bool percpu_init(uint32_t cpu_index);
\ No newline at end of file
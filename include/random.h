@@ -0,0 +1,25 @@
+#pragma once
+#include <include/types.h>
+#define RANDOM_BLOCK_SIZE 64 //size of a chacha20 block
+#define RANDOM_REFILL_BLOCKS 4 //blocks generated by a refill, the first 32 bytes become the new key
+#define RANDOM_BUFFER_SIZE (RANDOM_BLOCK_SIZE * RANDOM_REFILL_BLOCKS)
+#define RANDOM_KEY_SIZE 32
+#define RANDOM_RESEED_BYTES (1 << 20) //bytes generated before the key is mixed with new hardware entropy
+
+//per-cpu generator state, lives in the cpu's percpu_t
+typedef struct {
+    uint32_t key[RANDOM_KEY_SIZE / 4];
+    uint64_t counter;
+    uint8_t buffer[RANDOM_BUFFER_SIZE]; //output of the last refill, the bytes before position are used (and erased)
+    uint32_t position;
+    uint64_t generated; //bytes generated since the last reseed
+    bool seeded;
+} random_state_t;
+
+bool random_init();
+bool random_init_cpu();
+uint64_t get_random_u64();
+uint32_t get_random_u32();
+uint64_t get_random_below(uint64_t bound);
+void get_random_bytes(void *buffer, uint64_t size);
+void random_add_entropy(const void *data, uint64_t size);
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include <include/types.h>
+#define RING_CACHE_LINE 64
+#define __ring_aligned __attribute__((aligned(RING_CACHE_LINE)))
+
+//size of the slots buffer to give to spsc_ring_init()/mpmc_ring_init() for a ring of capacity elements of elem_size bytes
+#define SPSC_RING_BUFFER_SIZE(elem_size, capacity) ((uint64_t)(elem_size) * (capacity))
+#define MPMC_RING_SLOT_SIZE(elem_size) ((sizeof(uint64_t) + (elem_size) + 7) & ~7ULL)
+#define MPMC_RING_BUFFER_SIZE(elem_size, capacity) (MPMC_RING_SLOT_SIZE(elem_size) * (capacity))
+
+/*
+single producer single consumer ring.
+head and tail are free running counters (they're never wrapped, the slot is counter & mask), each one is written by one side only and lives
+on its own cache line together with the copy of the other counter last seen by that side, so that the two sides don't share any written line
+unless the ring looks full (producer) or empty (consumer).
+the producer can be an interrupt handler and the consumer normal code (or the other way around) without disabling interrupts.
+*/
+typedef struct {
+    uint32_t head __ring_aligned; //next slot to fill, written by the producer
+    uint32_t cached_tail;         //producer's copy of tail
+    uint32_t tail __ring_aligned; //next slot to drain, written by the consumer
+    uint32_t cached_head;         //consumer's copy of head
+    void *slots __ring_aligned;   //read only after init
+    uint32_t mask;                //capacity - 1
+    uint32_t elem_size;
+} spsc_ring_t;
+
+/*
+multi producer multi consumer ring (bounded queue with a sequence number per slot).
+a slot whose sequence is equal to the enqueue position is free, a slot whose sequence is the position + 1 is full. producers and consumers
+claim positions with a compare and swap on their own counter and publish the slot by updating its sequence.
+*/
+typedef struct {
+    uint64_t enqueue_pos __ring_aligned;
+    uint64_t dequeue_pos __ring_aligned;
+    void *slots __ring_aligned;
+    uint64_t mask;
+    uint32_t elem_size;
+    uint32_t slot_size;
+} mpmc_ring_t;
+
+bool spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t elem_size, uint32_t capacity);
+bool spsc_ring_enqueue(spsc_ring_t *ring, void *elem);
+bool spsc_ring_dequeue(spsc_ring_t *ring, void *elem);
+uint32_t spsc_ring_enqueue_batch(spsc_ring_t *ring, void *elems, uint32_t n);
+uint32_t spsc_ring_dequeue_batch(spsc_ring_t *ring, void *elems, uint32_t n);
+uint32_t spsc_ring_count(spsc_ring_t *ring);
+void *spsc_ring_reserve(spsc_ring_t *ring);
+void spsc_ring_commit(spsc_ring_t *ring);
+
+bool mpmc_ring_init(mpmc_ring_t *ring, void *buffer, uint32_t elem_size, uint32_t capacity);
+bool mpmc_ring_enqueue(mpmc_ring_t *ring, void *elem);
+bool mpmc_ring_dequeue(mpmc_ring_t *ring, void *elem);
+uint32_t mpmc_ring_enqueue_batch(mpmc_ring_t *ring, void *elems, uint32_t n);
+uint32_t mpmc_ring_dequeue_batch(mpmc_ring_t *ring, void *elems, uint32_t n);
+
+void ring_bench();
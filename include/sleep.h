@@ -1,5 +1,6 @@
 #pragma once
 #include <include/types.h>
+#include <int/include/int.h>
 
 bool sleep(uint16_t ms);
-void sleep_notify();
\ No newline at end of file
+bool sleep_notify(int_regs_t *regs, void *ctx);
\ No newline at end of file
@@ -4,11 +4,16 @@
 #define STR_EQUAL 0
 #define STR_DIFF  1
 
+void string_init();
 void strcat(char *, const char *);
 void strcpy(char *, const char *);
 void *strncpy(char *dest, char *src, uint32_t n);
 uint32_t strlen(const char *);
-uint32_t strcmp(const char *, const char *);
-int strncmp(char *str1, char *str2, uint32_t n);
+uint32_t strnlen(const char *str, uint32_t n);
+char *strchr(const char *str, char c);
+int strcmp(const char *, const char *);
+int strncmp(const char *str1, const char *str2, uint32_t n);
 char *strtok(const char *, const char *);
-int stoi(char *);
\ No newline at end of file
+char *strtok_r(char *str, const char *delim, char **saveptr);
+int stoi(char *);
+void string_bench();
\ No newline at end of file
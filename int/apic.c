@@ -21,21 +21,27 @@ To increase system flexibility when assigning memory space usage, the I/O APIC's
 #include <include/panic.h>
 #include <tty/include/tty.h>
 #include <mm/include/paging.h>
-#include <include/sleep.h>
 #include <int/include/int.h>
 #include <include/mem.h>
+#include <include/cpu.h>
+#include <include/alternatives.h>
+#include <include/percpu.h>
+#include <time/include/tsc.h>
+#include <time/include/clockevent.h>
+#include <io/include/pit.h>
 
 void *lapic_address = null; //lapic registers physical frame
+bool x2apic_enabled = false; //the lapic registers are msrs, lapic_address is not used
 lapic_t system_lapics[APIC_ARRAYS_LENGTH]; //contains lapic descriptors
 ioapic_t system_ioapics[256]; //contains ioapic descriptors
+ioapic_route_t ioapic_routes[IOAPIC_MAX_GSI]; //ioapic and pin of every gsi
 uint32_t lapics_array_index;
-extern void *isr_hooks[256][ISR_MAX_HOOKS]; //defined in int.c
-extern uint8_t gsi_map[256]; //defined in int.c
 
 /* apic timer variables */
-bool apic_sleep_ready = false;
+bool apic_timer_tsc_deadline = false; //the timer is armed with TSC deadlines
 uint32_t apic_timer_frequency = 0;
-bool apic_sleep_in_progress = false;
+uint64_t apic_timer_error_ppm = 0; //bound of the calibration error of apic_timer_frequency
+clockevent_t apic_clockevent;
 
 /*
 Initialize PIC/APIC system.
@@ -52,8 +58,8 @@ bool init_apic() {
     //if the lapic address wasn't set when acpi tables were read, set it to the address stored in the apic base msr
     if (!lapic_address) {
         uint32_t lo, hi;
-        get_msr(0x1B, &lo, &hi); //IA32_APIC_BASE_MSR
-        lapic_address = (void *)(((uint64_t) lo) | (((uint64_t) hi & 0x0F) << 32));
+        get_msr(IA32_APIC_BASE_MSR, &lo, &hi);
+        lapic_address = (void *)(((uint64_t) lo & 0xFFFFF000) | (((uint64_t) hi & 0x0F) << 32));
     }
 
     //if the lapic address stored in the apic base msr wasn't valid, set it to it's default value (0xFEE00000)
@@ -61,26 +67,31 @@ bool init_apic() {
         lapic_address = DEFAULT_LAPIC_ADDRESS;
     }
 
+    //x2apic mode if the cpu supports it, the lapic is then accessed through msrs
+    if (cpu_has(CPU_FEATURE_X2APIC)) {
+        x2apic_enable();
+    }
+
+    this_cpu()->lapic_id = lapic_get_id();
+
     //checks if lapic and ioapics addresses are correctly mapped into virtual memory
     if (!check_apic_addresses()) {
         printf("LAPIC or I/O APIC(s) addresses are not mapped in virtual memory\n");
         return false;
     }
 
+    ioapic_build_routes();
     clear_int_redirection_table();
 
     //set LVT entries (timer, lint0 and lint1)
-    lapic_set_lvt_entry(LAPIC_LVT_TIMER, 0x19, 1, 0, true); //timer
+    lapic_set_lvt_entry(LAPIC_LVT_TIMER, APIC_TIMER_VECTOR, 1, 0, true); //timer
     lapic_set_lvt_entry(LAPIC_LVT_LINT0, 0x2, 1, 0, false); //lint0 nmi
     lapic_set_lvt_entry(LAPIC_LVT_LINT1, 0x2, 1, 0, false); //lint1 nmi
 
     //sets the spurious interrupt vector register
     lapic_write(LAPIC_SIV_REGISTER, lapic_read(LAPIC_SIV_REGISTER) | 0x100);
 
-    apic_sleep_ready = false;
     apic_timer_frequency = 0;
-    apic_sleep_in_progress = false;
-    memclear(isr_hooks, 256 * ISR_MAX_HOOKS);
 
     return true;
 }
@@ -93,8 +104,8 @@ at this moment the only possibility is to have the same virtual and physical add
 to the right physical address
 */
 bool check_apic_addresses() {
-    //check lapic address
-    if (get_physical_address(lapic_address) != lapic_address) {
+    //check lapic address (not used in x2apic mode)
+    if (!x2apic_enabled && get_physical_address(lapic_address) != lapic_address) {
         return false;
     }
 
@@ -115,32 +126,58 @@ bool check_apic_addresses() {
     return true;
 }
 
-/* resets the interrupt redirection table */
+/* masks and clears every redirection entry of every ioapic */
 void clear_int_redirection_table() {
-    for (uint16_t i = 0; i < 256; i++) {
-        apic_clear_irq(i);
+    for (uint32_t i = 0; i < 256; i++) {
+        ioapic_t *ioapic = &system_ioapics[i];
+
+        if (!ioapic->ioapic_addr) {
+            continue;
+        }
+
+        for (uint32_t pin = 0; pin < ioapic->redirections; pin++) {
+            ioapic_write(ioapic->ioapic_id, IOAPIC_REDIRECTION(pin), IOAPIC_ENTRY_MASKED);
+            ioapic_write(ioapic->ioapic_id, IOAPIC_REDIRECTION(pin) + 1, 0);
+        }
     }
 }
 
-//returns the descriptor of the ioapic that can handle the specified irq number if found
-ioapic_t *get_ioapic_by_irq(uint8_t irq) {
+/*
+fills ioapic_routes from the ioapics found in the madt, so that the ioapic and pin of a gsi are found without scanning system_ioapics.
+called by init_apic(), after the acpi tables have been parsed.
+*/
+void ioapic_build_routes() {
+    memclear(ioapic_routes, sizeof(ioapic_routes));
+
     for (uint32_t i = 0; i < 256; i++) {
-        ioapic_t *entry = &system_ioapics[i];
+        ioapic_t *ioapic = &system_ioapics[i];
 
-        //if this ioapic doesn't exist, continue
-        if (entry->ioapic_addr == null) {
+        if (!ioapic->ioapic_addr) {
             continue;
         }
 
-        uint32_t gsi_base = entry->global_system_interrupt_base;
+        for (uint32_t pin = 0; pin < ioapic->redirections; pin++) {
+            uint32_t gsi = ioapic->global_system_interrupt_base + pin;
 
-        //r u sure about these constraints?
-        if (gsi_base <= irq && irq - gsi_base < entry->max_redirections) {
-            return entry;
+            if (gsi >= IOAPIC_MAX_GSI) {
+                break;
+            }
+
+            ioapic_routes[gsi].ioapic_id = ioapic->ioapic_id;
+            ioapic_routes[gsi].pin = pin;
+            ioapic_routes[gsi].present = true;
         }
     }
+}
+
+//returns the descriptor of the ioapic the specified gsi is connected to, and its pin on that ioapic, null if no ioapic handles the gsi
+ioapic_t *get_ioapic_by_gsi(uint32_t gsi, uint8_t *pin) {
+    if (gsi >= IOAPIC_MAX_GSI || !ioapic_routes[gsi].present) {
+        return null;
+    }
 
-    return null;
+    *pin = ioapic_routes[gsi].pin;
+    return &system_ioapics[ioapic_routes[gsi].ioapic_id];
 }
 
 uint32_t ioapic_read(uint8_t id, uint32_t reg) {
@@ -178,17 +215,18 @@ void ioapic_write(uint8_t id, uint32_t reg, uint32_t data) {
     *data_register = data;
 }
 
-/* reads an irq redirection entry */
-bool ioapic_read_irq_entry(uint8_t irq, uint64_t *entry) {
+/* reads the redirection entry of a gsi */
+bool ioapic_read_irq_entry(uint32_t gsi, uint64_t *entry) {
     *entry = 0;
     ioapic_t *ioapic_struct;
+    uint8_t pin;
 
-    if (!(ioapic_struct = get_ioapic_by_irq(irq))) {
+    if (!(ioapic_struct = get_ioapic_by_gsi(gsi, &pin))) {
         return false;
     }
 
-    uint32_t entry_lo = ioapic_read(ioapic_struct->ioapic_id, 0x10 + 2 * irq);
-    uint32_t entry_hi = ioapic_read(ioapic_struct->ioapic_id, 0x10 + 2 * irq + 1);
+    uint32_t entry_lo = ioapic_read(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin));
+    uint32_t entry_hi = ioapic_read(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin) + 1);
     *entry = entry_lo | (uint64_t) entry_hi << 32;
     return true;
 }
@@ -196,26 +234,27 @@ bool ioapic_read_irq_entry(uint8_t irq, uint64_t *entry) {
 /*
 sets an irq routing rule.
 parameters:
-- irq: source IRQ number
+- gsi: global system interrupt (isa irqs have to be translated first, see irq_isa_to_gsi())
 - int_vector: destination interrupt vector
 - del_mode: delivery mode (fixed/low_priority/smi/nmi/init/extint)
 - dest_mode: destination mode (physical/logical (unsupported))
 - polarity: irq pin polarity (active_high/active_low)
 - trigger_mode: (edge/level)
 - masked: true if this interrupt will be masked
-- destination: if destination mode is set to physical, the lowest 4 bits contain the APIC id of the processor to send the interrupt to, if destination mode
+- destination: if destination mode is set to physical, the APIC id (8 bits) of the processor to send the interrupt to, if destination mode
                 is set to logical this field contains a group of processors (unsupported)
 */
-bool apic_irq(uint8_t irq, uint8_t int_vector, ioapic_int_delivery_mode_t del_mode, uint8_t dest_mode, uint8_t polarity, uint8_t trigger_mode, bool masked, uint8_t destination) {
+bool apic_irq(uint32_t gsi, uint8_t int_vector, ioapic_int_delivery_mode_t del_mode, uint8_t dest_mode, uint8_t polarity, uint8_t trigger_mode, bool masked, uint32_t destination) {
     ioapic_t *ioapic_struct;
+    uint8_t pin;
 
     //if a suitable ioapic is not found, return false
-    if (!(ioapic_struct = get_ioapic_by_irq(irq))) {
+    if (!(ioapic_struct = get_ioapic_by_gsi(gsi, &pin))) {
         return false;
     }
 
-    uint32_t entry_lo = ioapic_read(ioapic_struct->ioapic_id, 0x10 + 2 * irq) & 0xFFFE5000;
-    uint32_t entry_hi = ioapic_read(ioapic_struct->ioapic_id, 0x10 + 2 * irq + 1) & 0xF0FFFFFF;
+    uint32_t entry_lo = ioapic_read(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin)) & 0xFFFE5000;
+    uint32_t entry_hi = ioapic_read(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin) + 1) & 0x00FFFFFF;
 
     entry_lo |= (uint32_t) int_vector & 0xFF;           //interrupt vector bits 0:7
     entry_lo |= ((uint32_t) del_mode & 7) << 8;         //delivery mode bits 8:10
@@ -223,40 +262,57 @@ bool apic_irq(uint8_t irq, uint8_t int_vector, ioapic_int_delivery_mode_t del_mo
     entry_lo |= ((uint32_t) polarity & 1) << 13;        //polarity bit 13
     entry_lo |= ((uint32_t) trigger_mode & 1) << 15;    //trigger mode bit 15
     entry_lo |= ((uint32_t) masked & 1) << 16;          //masked bit 16
-    entry_hi |= ((uint32_t) destination & 0x0F) << 24;  //destination field bits 56:59
+    entry_hi |= (destination & 0xFF) << 24;             //destination field bits 56:63
 
-    ioapic_write(ioapic_struct->ioapic_id, 0x10 + 2 * irq, entry_lo);
-    ioapic_write(ioapic_struct->ioapic_id, 0x10 + 2 * irq + 1, entry_hi);
+    //the high half first, the entry can be unmasked only when the low half is written
+    ioapic_write(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin) + 1, entry_hi);
+    ioapic_write(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin), entry_lo);
 
     return true;
 }
 
 /* clears an entry in the ioapic redirection table */
-bool apic_clear_irq(uint8_t irq) {
+bool apic_clear_irq(uint32_t gsi) {
     ioapic_t *ioapic_struct;
+    uint8_t pin;
 
     //if a suitable ioapic is not found, return false
-    if (!(ioapic_struct = get_ioapic_by_irq(irq))) {
+    if (!(ioapic_struct = get_ioapic_by_gsi(gsi, &pin))) {
         return false;
     }
 
-    ioapic_write(ioapic_struct->ioapic_id, 0x10 + 2 * irq, 1 << 16); //set masked bit
-    ioapic_write(ioapic_struct->ioapic_id, 0x10 + 2 * irq + 1, 0);
+    ioapic_write(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin), IOAPIC_ENTRY_MASKED);
+    ioapic_write(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin) + 1, 0);
     return true;
 }
 
 /* masks or unmasks an irq */
-bool apic_set_mask(uint8_t irq, bool masked) {
+bool apic_set_mask(uint32_t gsi, bool masked) {
     ioapic_t *ioapic_struct;
+    uint8_t pin;
 
     //if a suitable ioapic is not found, return false
-    if (!(ioapic_struct = get_ioapic_by_irq(irq))) {
+    if (!(ioapic_struct = get_ioapic_by_gsi(gsi, &pin))) {
         return false;
     }
 
-    uint32_t entry_lo = ioapic_read(ioapic_struct->ioapic_id, 0x10 + 2 * irq) & 0xFFFEFFFF;
+    uint32_t entry_lo = ioapic_read(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin)) & ~IOAPIC_ENTRY_MASKED;
     entry_lo |= ((uint32_t) masked & 1) << 16;
-    ioapic_write(ioapic_struct->ioapic_id, 0x10 + 2 * irq, entry_lo);
+    ioapic_write(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin), entry_lo);
+    return true;
+}
+
+/* changes the cpu (physical apic id) a gsi is delivered to, the rest of the entry is not touched */
+bool apic_set_destination(uint32_t gsi, uint32_t destination) {
+    ioapic_t *ioapic_struct;
+    uint8_t pin;
+
+    if (destination > 0xFF || !(ioapic_struct = get_ioapic_by_gsi(gsi, &pin))) {
+        return false;
+    }
+
+    uint32_t entry_hi = ioapic_read(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin) + 1) & 0x00FFFFFF;
+    ioapic_write(ioapic_struct->ioapic_id, IOAPIC_REDIRECTION(pin) + 1, entry_hi | destination << 24);
     return true;
 }
 
@@ -267,13 +323,102 @@ void apic_lvt_set_mask(uint32_t reg, bool masked) {
     lapic_write(reg, old);
 }
 
+uint32_t lapic_read_xapic(uint32_t reg);
+void lapic_write_xapic(uint32_t reg, uint32_t data);
+void lapic_eoi_xapic();
+void lapic_self_ipi_xapic(uint8_t vector);
+
+/*
+the lapic access routines are static calls: they start in xapic mode (mmio at lapic_address) and x2apic_enable() switches them
+to the msr versions, so the callers don't check the mode on every access.
+send_eoi() runs at the end of every interrupt.
+*/
+STATIC_CALL(lapic_read, lapic_read_xapic)
+STATIC_CALL(lapic_write, lapic_write_xapic)
+STATIC_CALL(send_eoi, lapic_eoi_xapic)
+STATIC_CALL(lapic_self_ipi, lapic_self_ipi_xapic)
+
 //reads a register mapped at lapic_address, the registers are 4 bytes long but 16 byte aligned
-uint32_t lapic_read(uint32_t reg) {
-    return *(uint32_t *)(lapic_address + reg);
+uint32_t lapic_read_xapic(uint32_t reg) {
+    return *(volatile uint32_t *)(lapic_address + reg);
+}
+
+void lapic_write_xapic(uint32_t reg, uint32_t data) {
+    *(volatile uint32_t *)(lapic_address + reg) = data;
+}
+
+//in x2apic mode the register at offset reg of the xapic page is the msr X2APIC_MSR_BASE + reg / 16
+uint32_t lapic_read_x2apic(uint32_t reg) {
+    uint32_t lo, hi;
+    get_msr(X2APIC_MSR_BASE + (reg >> 4), &lo, &hi);
+    return lo;
+}
+
+void lapic_write_x2apic(uint32_t reg, uint32_t data) {
+    set_msr(X2APIC_MSR_BASE + (reg >> 4), data, 0);
+}
+
+/* called at the end of an interrupt (through send_eoi()) to acknowledge it */
+void lapic_eoi_xapic() {
+    lapic_write_xapic(LAPIC_EOI_REGISTER, 0);
+}
+
+//a single msr write, which (unlike the mmio write) doesn't need to wait for the lapic to acknowledge it
+void lapic_eoi_x2apic() {
+    asm volatile("wrmsr" : : "c"(X2APIC_MSR_BASE + (LAPIC_EOI_REGISTER >> 4)), "a"(0), "d"(0));
+}
+
+//sends an interrupt to this cpu using the "self" destination shorthand of the icr
+void lapic_self_ipi_xapic(uint8_t vector) {
+    lapic_write_xapic(LAPIC_ICR_LOW, LAPIC_ICR_SHORTHAND_SELF | vector);
+
+    while (lapic_read_xapic(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING);
 }
 
-void lapic_write(uint32_t reg, uint32_t data) {
-    *(uint32_t *)(lapic_address + reg) = data;
+//x2apic has a register only for self ipis
+void lapic_self_ipi_x2apic(uint8_t vector) {
+    asm volatile("wrmsr" : : "c"(X2APIC_SELF_IPI_MSR), "a"((uint32_t) vector), "d"(0));
+}
+
+/*
+switches the lapic of this cpu to x2apic mode (IA32_APIC_BASE bits 10 and 11) and the lapic routines to their msr versions.
+*/
+bool x2apic_enable() {
+    if (!cpu_has(CPU_FEATURE_X2APIC)) {
+        return false;
+    }
+
+    uint32_t lo, hi;
+    get_msr(IA32_APIC_BASE_MSR, &lo, &hi);
+    set_msr(IA32_APIC_BASE_MSR, lo | IA32_APIC_BASE_ENABLE | IA32_APIC_BASE_EXTD, hi);
+    static_call_update((void *) lapic_read, (void *) lapic_read_x2apic);
+    static_call_update((void *) lapic_write, (void *) lapic_write_x2apic);
+    static_call_update((void *) send_eoi, (void *) lapic_eoi_x2apic);
+    static_call_update((void *) lapic_self_ipi, (void *) lapic_self_ipi_x2apic);
+    x2apic_enabled = true;
+    return true;
+}
+
+//apic id of this cpu: 32 bits in x2apic mode, 8 bits (bits 24-31 of the id register) in xapic mode
+uint32_t lapic_get_id() {
+    uint32_t id = lapic_read(LAPIC_ID_REGISTER);
+    return x2apic_enabled ? id : id >> 24;
+}
+
+/*
+sends an interrupt to the cpu with the specified apic id.
+in x2apic mode the icr is a single 64 bit msr (destination in the high half), in xapic mode two registers, the low one sends the ipi.
+*/
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    if (x2apic_enabled) {
+        set_msr(X2APIC_MSR_BASE + (LAPIC_ICR_LOW >> 4), vector, apic_id);
+        return;
+    }
+
+    lapic_write_xapic(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write_xapic(LAPIC_ICR_LOW, vector);
+
+    while (lapic_read_xapic(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING);
 }
 
 /*
@@ -313,20 +458,10 @@ void disable_pic() {
 }
 
 bool check_apic() {
-    uint32_t eax, edx;
-    cpuid(1, &eax, null, null, &edx);
-    return edx >> 9 & 1;
-}
-
-/* called by an isr to acknowledge an irq */
-__attribute__((always_inline))
-inline void send_eoi() {
-    for (uint8_t i = 0; i < 10; i++) {
-        lapic_write(LAPIC_EOI_REGISTER, 0);
-    }
+    return cpu_has(CPU_FEATURE_APIC);
 }
 
-void save_lapic_info(uint8_t lapic_id, uint8_t cpu_id, uint32_t flags) {
+void save_lapic_info(uint32_t lapic_id, uint32_t cpu_id, uint32_t flags) {
     if (lapics_array_index >= APIC_ARRAYS_LENGTH) {
         return;
     }
@@ -342,31 +477,111 @@ void save_ioapic_info(uint8_t ioapic_id, uint32_t addr, uint32_t gsib) {
     entry->ioapic_id = ioapic_id;
     entry->ioapic_addr = addr;
     entry->global_system_interrupt_base = gsib;
-    entry->max_redirections = ioapic_read(ioapic_id, 1) >> 16 & 0xFF; //at this point ioapic_read() can be used with this same id
+    entry->redirections = (ioapic_read(ioapic_id, 1) >> 16 & 0xFF) + 1; //the version register holds the index of the last entry, at this point ioapic_read() can be used with this same id
 }
 
 /*
-initialize apic-supported sleep by approximating the frequency of the apic timer.
-the apic-supported sleep won't work until this function is called.
+arms the timer for a clock_ns() deadline, converted to TSC relative to now: clock_ns() may run on another counter, and even on the TSC
+the conversion factors aren't exact inverses, an absolute conversion would drift with the uptime.
+*/
+static void apic_clockevent_arm(uint64_t deadline_ns) {
+    uint64_t now_ns = clock_ns();
+    uint64_t now = rdtsc();
+    apic_timer_arm(deadline_ns > now_ns ? now + ns_to_tsc(deadline_ns - now_ns + 1) + 1 : now);
+}
+
+/*
+initializes the lapic timer: one-shot deadlines in TSC-deadline mode if the cpu supports it, otherwise in one-shot mode with the
+frequency of the timer. The timer runs on the core crystal clock, so it's known if cpuid enumerates the crystal (not trusted under a
+hypervisor, which emulates the timer at its own rate); otherwise it's measured in a single window, APIC_TIMER_CALIBRATION_MS of TSC,
+or a one-shot count of pit channel 2 if the TSC isn't calibrated.
+apic_timer_arm() won't work until this function is called. with a calibrated TSC the timer is registered as a clockevent, the one the
+timers (timer.c) use for their deadlines.
 */
 void apic_timer_init() {
-    //approximate the apic timer ticks/ms
     apic_timer_div(LAPIC_TIMER_DIV1);
-    apic_timer_mode(LAPIC_TIMER_PERIODIC_MODE);
-    apic_lvt_set_mask(LAPIC_LVT_TIMER, false);
-
-    uint64_t avg = 0;
-    for (uint32_t i = 0; i < 100; i++) {
+    apic_timer_mode(LAPIC_TIMER_ONE_SHOT_MODE);
+    apic_lvt_set_mask(LAPIC_LVT_TIMER, true);
+    uint64_t error_ppm = 0;
+    const char *source = "cpuid crystal";
+
+    if (tsc_crystal_khz && !cpu_has(CPU_FEATURE_HYPERVISOR)) {
+        apic_timer_frequency = tsc_crystal_khz;
+    } else if (tsc_khz) {
+        //the count is read between two TSC reads: the error is the width of both reads plus the error of tsc_khz the window is timed with
+        uint64_t window = APIC_TIMER_CALIBRATION_MS * tsc_khz;
+        uint64_t before = rdtsc();
+        apic_timer_set_count(0xFFFFFFFF);
+        uint64_t start = rdtsc();
+        uint64_t now;
+
+        while ((now = rdtsc()) - start < window);
+
+        uint32_t count = apic_timer_get_count();
+        uint64_t end = rdtsc();
+        apic_timer_frequency = (uint64_t)(0xFFFFFFFF - count) * tsc_khz / (now - start);
+        error_ppm = (start - before + end - now) * 1000000 / (now - start) + 1 + tsc_error_ppm;
+        source = "tsc";
+    } else {
+        uint32_t ticks = PIT_FREQUENCY / 1000 * APIC_TIMER_CALIBRATION_MS;
         apic_timer_set_count(0xFFFFFFFF);
-        sleep(1);
-        uint32_t count = 0xFFFFFFFF - apic_timer_get_count();
-        avg += count;
+        pit_oneshot_start(ticks);
+
+        while (!pit_oneshot_done());
+
+        //the pit counts between ticks and ticks + 1 periods
+        uint64_t count = 0xFFFFFFFF - apic_timer_get_count();
+        apic_timer_frequency = count * PIT_FREQUENCY * 2 / (ticks * 2 + 1) / 1000;
+        error_ppm = 1000000 / ticks / 2 + 1;
+        source = "pit";
+    }
+
+    apic_timer_set_count(0);
+    apic_timer_error_ppm = error_ppm;
+    apic_timer_tsc_deadline = tsc_khz && cpu_has(CPU_FEATURE_TSC_DEADLINE);
+    printf("apic timer: %u khz (%s, error < %lu ppm), %s\n", apic_timer_frequency, source, error_ppm,
+        apic_timer_tsc_deadline ? "tsc deadline" : "one-shot");
+
+    //the deadlines are TSC values, the clockevent needs the TSC calibrated
+    if (tsc_khz) {
+        apic_clockevent.name = "lapic";
+        apic_clockevent.arm = apic_clockevent_arm;
+        apic_clockevent.disarm = apic_timer_disarm;
+        apic_clockevent.vector = APIC_TIMER_VECTOR;
+        apic_clockevent.rating = apic_timer_tsc_deadline ? CLOCKEVENT_RATING_LAPIC_DEADLINE : CLOCKEVENT_RATING_LAPIC_ONESHOT;
+        apic_clockevent.per_cpu = true;
+        clockevent_register(&apic_clockevent);
+    }
+}
+
+/*
+arms the lapic timer to interrupt (vector APIC_TIMER_VECTOR) once, when the TSC reaches deadline.
+in TSC-deadline mode the lapic compares the TSC itself and the interrupt is exact, in one-shot mode the deadline is converted to timer
+ticks (clamped to the 32 bit counter: a far deadline fires early and has to be armed again).
+a deadline already passed fires immediately.
+*/
+void apic_timer_arm(uint64_t deadline) {
+    if (apic_timer_tsc_deadline) {
+        lapic_write(LAPIC_LVT_TIMER, APIC_TIMER_VECTOR | LAPIC_TIMER_TSC_MODE << 17);
+        asm volatile("mfence" : : : "memory"); //orders the lvt write (mmio in xapic mode) before the msr write
+        set_msr(IA32_TSC_DEADLINE_MSR, (uint32_t)(deadline | !deadline), (uint32_t)(deadline >> 32)); //0 would disarm
+        return;
+    }
+
+    uint64_t now = rdtsc();
+    uint64_t ticks = deadline > now ? (deadline - now) * apic_timer_frequency / tsc_khz : 0;
+    lapic_write(LAPIC_LVT_TIMER, APIC_TIMER_VECTOR | LAPIC_TIMER_ONE_SHOT_MODE << 17);
+    apic_timer_set_count(ticks > 0xFFFFFFFF ? 0xFFFFFFFF : (ticks ? ticks : 1));
+}
+
+void apic_timer_disarm() {
+    if (apic_timer_tsc_deadline) {
+        set_msr(IA32_TSC_DEADLINE_MSR, 0, 0);
+    } else {
+        apic_timer_set_count(0);
     }
 
     apic_lvt_set_mask(LAPIC_LVT_TIMER, true);
-    avg /= 100;
-    apic_timer_frequency = avg;
-    apic_sleep_ready = true; //from now on the system can use the apic timer to sleep a certain amount of milliseconds
 }
 
 /*
@@ -400,28 +615,66 @@ uint32_t apic_timer_get_count() {
     return lapic_read(APIC_TIMER_CCR);
 }
 
-void apic_sleep(uint32_t ms) {
-    if (!apic_sleep_ready) {
-        return;
+static volatile bool apic_bench_received;
+
+static bool apic_bench_handler(int_regs_t *regs, void *ctx) {
+    apic_bench_received = true;
+    return true;
+}
+
+//the eoi the kernel sent before x2apic support: 10 writes to the mmio register
+static void apic_bench_legacy_eoi() {
+    for (uint8_t i = 0; i < 10; i++) {
+        lapic_write_xapic(LAPIC_EOI_REGISTER, 0);
     }
+}
 
-    apic_timer_div(LAPIC_TIMER_DIV1);
-    apic_timer_mode(LAPIC_TIMER_PERIODIC_MODE);
-    apic_lvt_set_mask(LAPIC_LVT_TIMER, false);
-    uint8_t hook_n = int_hook(0x19, (void *) apic_timer_hook);
-
-    while(ms > 0) {
-        apic_sleep_in_progress = true;
-        apic_timer_set_count(apic_timer_frequency);
-        while(apic_sleep_in_progress);
-        ms--;
+/*
+average cycles of the interrupt acknowledge and of a self ipi delivered and handled (the whole path through int_dispatch, eoi included),
+in the current lapic mode. an eoi with no interrupt in service is ignored by the lapic, so it can be timed on its own.
+the legacy eoi is only measured in xapic mode, it needs the mmio registers. interrupts must be enabled.
+*/
+void apic_bench() {
+    uint64_t start, legacy = 0, eoi, ipi = 0;
+    int_hook_t hook;
+
+    if (!x2apic_enabled) {
+        start = rdtsc();
+
+        for (uint32_t i = 0; i < APIC_BENCH_ITERATIONS; i++) {
+            apic_bench_legacy_eoi();
+        }
+
+        legacy = (rdtsc() - start) / APIC_BENCH_ITERATIONS;
     }
 
-    int_unhook(0x19, hook_n);
-    apic_lvt_set_mask(LAPIC_LVT_TIMER, true);
-}
+    start = rdtsc();
+
+    for (uint32_t i = 0; i < APIC_BENCH_ITERATIONS; i++) {
+        send_eoi();
+    }
+
+    eoi = (rdtsc() - start) / APIC_BENCH_ITERATIONS;
+
+    if (int_hook(APIC_BENCH_VECTOR, apic_bench_handler, null, &hook)) {
+        start = rdtsc();
+
+        for (uint32_t i = 0; i < APIC_BENCH_ITERATIONS; i++) {
+            apic_bench_received = false;
+            lapic_self_ipi(APIC_BENCH_VECTOR);
+            while (!apic_bench_received);
+        }
+
+        ipi = (rdtsc() - start) / APIC_BENCH_ITERATIONS;
+        int_unhook(APIC_BENCH_VECTOR, hook);
+    }
+
+    printf("lapic mode: %s, id %u\n", x2apic_enabled ? "x2apic" : "xapic", lapic_get_id());
 
-/* used to implement apic sleep */
-void apic_timer_hook() {
-    apic_sleep_in_progress = false;
-}
\ No newline at end of file
+    if (!x2apic_enabled) {
+        printf("legacy eoi (10 writes): %lu cycles\n", legacy);
+    }
+
+    printf("eoi: %lu cycles\n", eoi);
+    printf("self ipi round trip: %lu cycles\n", ipi);
+}
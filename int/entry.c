@@ -0,0 +1,68 @@
+/*
+Interrupt entry stubs.
+Every one of the 256 vectors has a stub of INT_STUB_SIZE bytes: the stub pushes a 0 in place of the error code (for the vectors the cpu
+doesn't push one for), pushes the vector number and jumps to int_common_entry, which saves the general purpose registers and calls
+int_dispatch() with a pointer to the saved frame (int_regs_t).
+The cpu aligns the stack to 16 bytes before pushing its frame (5 registers), so after the 2 + 15 pushes of the stubs the stack is
+aligned again for the call.
+*/
+
+#include <include/types.h>
+#include <int/include/int.h>
+
+asm(
+    ".pushsection .text\n"
+    ".balign 16\n"
+    ".global int_entry_stubs\n"
+    "int_entry_stubs:\n"
+    ".set int_vector, 0\n"
+    ".rept 256\n"
+    "    .balign 16\n"
+    //vectors with an error code: #DF, #TS, #NP, #SS, #GP, #PF, #AC, #CP, #VC, #SX
+    "    .if int_vector == 8 || (int_vector >= 10 && int_vector <= 14) || int_vector == 17 || int_vector == 21 || int_vector == 29 || int_vector == 30\n"
+    "    .else\n"
+    "    push $0\n"
+    "    .endif\n"
+    "    push $int_vector\n"
+    "    jmp int_common_entry\n"
+    "    .set int_vector, int_vector + 1\n"
+    ".endr\n"
+    "\n"
+    "int_common_entry:\n"
+    "    push %rax\n"
+    "    push %rbx\n"
+    "    push %rcx\n"
+    "    push %rdx\n"
+    "    push %rsi\n"
+    "    push %rdi\n"
+    "    push %rbp\n"
+    "    push %r8\n"
+    "    push %r9\n"
+    "    push %r10\n"
+    "    push %r11\n"
+    "    push %r12\n"
+    "    push %r13\n"
+    "    push %r14\n"
+    "    push %r15\n"
+    "    mov %rsp, %rdi\n"
+    "    cld\n"
+    "    call int_dispatch\n"
+    "    pop %r15\n"
+    "    pop %r14\n"
+    "    pop %r13\n"
+    "    pop %r12\n"
+    "    pop %r11\n"
+    "    pop %r10\n"
+    "    pop %r9\n"
+    "    pop %r8\n"
+    "    pop %rbp\n"
+    "    pop %rdi\n"
+    "    pop %rsi\n"
+    "    pop %rdx\n"
+    "    pop %rcx\n"
+    "    pop %rbx\n"
+    "    pop %rax\n"
+    "    add $16, %rsp\n" //vector and error code
+    "    iretq\n"
+    ".popsection\n"
+);
@@ -1,11 +1,16 @@
 #pragma once
 #include <include/types.h>
+#include <int/include/int.h>
 
 #define DEFAULT_LAPIC_ADDRESS (void *) 0xFEE00000
 #define APIC_ARRAYS_LENGTH 16
+#define IOAPIC_MAX_GSI 256
+#define IOAPIC_REDIRECTION(pin) (0x10 + 2 * (pin)) //register of the low half of the redirection entry of a pin
+#define IOAPIC_ENTRY_MASKED (1 << 16)
 
 /* lapic registers */
 
+#define LAPIC_ID_REGISTER 0x20
 #define LAPIC_EOI_REGISTER 0xB0 //end of interrupt register
 #define LAPIC_SIV_REGISTER 0xF0 //spurious interrupt vector register
 #define APIC_TIMER_ICR 0x380
@@ -18,6 +23,22 @@
 #define LAPIC_LVT_LINT0 0x350
 #define LAPIC_LVT_LINT1 0x360
 #define LAPIC_LVT_ERROR 0x370
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_ICR_PENDING (1 << 12) //delivery status
+#define LAPIC_ICR_SHORTHAND_SELF (1 << 18)
+
+/* apic base msr and x2apic */
+
+#define IA32_APIC_BASE_MSR 0x1B
+#define IA32_APIC_BASE_EXTD (1 << 10) //x2apic mode
+#define IA32_APIC_BASE_ENABLE (1 << 11)
+#define X2APIC_MSR_BASE 0x800
+#define X2APIC_SELF_IPI_MSR 0x83F
+#define APIC_TIMER_VECTOR 0x19 //an irq vector (INT_IRQ_BASE or above): acknowledged by int_dispatch(), which then runs the timer softirq
+#define APIC_TIMER_CALIBRATION_MS 2
+#define APIC_BENCH_VECTOR 0xF0
+#define APIC_BENCH_ITERATIONS 10000
 
 /* lapic timer divider values */
 
@@ -37,8 +58,8 @@
 #define LAPIC_TIMER_TSC_MODE 2
 
 typedef struct {
-    uint8_t cpu_id;
-    uint8_t lapic_id;
+    uint32_t cpu_id;
+    uint32_t lapic_id; //x2apic ids are 32 bits
     uint32_t flags; //bit 0: processor enabled, bit 1: online capable
 } lapic_t;
 
@@ -46,9 +67,16 @@ typedef struct {
     uint8_t ioapic_id;
     uint32_t ioapic_addr;
     uint32_t global_system_interrupt_base;
-    uint8_t max_redirections;
+    uint16_t redirections; //number of redirection entries (pins)
 } ioapic_t;
 
+//where a gsi is connected
+typedef struct {
+    uint8_t ioapic_id;
+    uint8_t pin;
+    bool present;
+} ioapic_route_t;
+
 typedef enum {
     fixed = 0,
     low_priority = 1,
@@ -91,14 +119,19 @@ bool check_apic();
 uint32_t lapic_read(uint32_t reg);
 void lapic_write(uint32_t reg, uint32_t data);
 void lapic_set_lvt_entry(uint32_t reg, uint8_t int_num, uint8_t polarity, uint8_t trigger, bool masked);
-void save_lapic_info(uint8_t lapic_id, uint8_t cpu_id, uint32_t flags);
+void save_lapic_info(uint32_t lapic_id, uint32_t cpu_id, uint32_t flags);
+bool x2apic_enable();
+uint32_t lapic_get_id();
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+void lapic_self_ipi(uint8_t vector);
 
 /* io apic functions */
 
-ioapic_t *get_ioapic_by_irq(uint8_t irq);
+void ioapic_build_routes();
+ioapic_t *get_ioapic_by_gsi(uint32_t gsi, uint8_t *pin);
 uint32_t ioapic_read(uint8_t id, uint32_t reg);
 void ioapic_write(uint8_t id, uint32_t reg, uint32_t data);
-bool ioapic_read_irq_entry(uint8_t irq, uint64_t *entry);
+bool ioapic_read_irq_entry(uint32_t gsi, uint64_t *entry);
 void save_ioapic_info(uint8_t ioapic_id, uint32_t addr, uint32_t gsib);
 
 /* apic timer functions */
@@ -108,13 +141,15 @@ void apic_timer_mode(uint8_t mode);
 void apic_timer_div(uint8_t div);
 void apic_timer_set_count(uint32_t count);
 uint32_t apic_timer_get_count();
-void apic_sleep(uint32_t ms);
-void apic_timer_hook();
+void apic_timer_arm(uint64_t deadline);
+void apic_timer_disarm();
 
 /* other */
 
 void send_eoi();
-bool apic_irq(uint8_t irq, uint8_t int_vector, ioapic_int_delivery_mode_t del_mode, uint8_t dest_mode, uint8_t polarity, uint8_t trigger_mode, bool masked, uint8_t destination);
-bool apic_clear_irq(uint8_t irq);
-bool apic_set_mask(uint8_t irq, bool masked);
+void apic_bench();
+bool apic_irq(uint32_t gsi, uint8_t int_vector, ioapic_int_delivery_mode_t del_mode, uint8_t dest_mode, uint8_t polarity, uint8_t trigger_mode, bool masked, uint32_t destination);
+bool apic_clear_irq(uint32_t gsi);
+bool apic_set_mask(uint32_t gsi, bool masked);
+bool apic_set_destination(uint32_t gsi, uint32_t destination);
 void apic_lvt_set_mask(uint32_t reg, bool masked);
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <include/types.h>
+#include <mm/include/obj_alloc.h>
 #define ISR_TYPE_INT 0x0E
 #define ISR_TYPE_TRAP 0x0F
 #define ISR_FLAG_PRESENT 0x80
@@ -9,7 +10,14 @@
 #define ISR_FLAG_RING3 0x60
 #define MAX_INTERRUPT 256
 #define NMI_CONTROL_REGISTER 0x70
-#define ISR_MAX_HOOKS 4
+#define INT_EXCEPTIONS 32 //vectors reserved by the cpu to the exceptions, the names printed by int_exception()
+#define INT_LOAD_SEGMENTS 0x16 //used by gdt_load_segments()
+#define INT_IRQ_BASE 0x17 //irqs from here on (the isa irqs and the lapic timer use reserved exception vectors), acknowledged to the lapic
+#define INT_SPURIOUS_VECTOR 0xFF
+#define INT_MAX_HOOKS 4096 //size limit of the pool of hooks, shared by all the vectors
+#define INT_STUB_SIZE 16 //every entry stub starts at int_entry_stubs + vector * INT_STUB_SIZE
+#define INT_DYNAMIC_FIRST 0x30 //vectors given to devices (msi) by int_alloc_vector()
+#define INT_DYNAMIC_LAST 0xEF
 
 typedef struct {
 	uint16_t isr_0;
@@ -26,13 +34,37 @@ typedef struct {
     uint64_t base;
 } __attribute__((packed)) idtr_t;
 
+/*
+registers saved by the entry stubs (see entry.c), lowest address first.
+error is 0 for the vectors without an error code, rip to ss are pushed by the cpu.
+*/
 typedef struct {
-	void *hooks[ISR_MAX_HOOKS];
-} isr_hook_t;
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    uint64_t vector, error;
+    uint64_t rip, cs, rflags, rsp, ss;
+} int_regs_t;
+
+//returns true if the interrupt came from the device of ctx (for exceptions: if it has been handled and the code can resume)
+typedef bool (*int_handler_t)(int_regs_t *regs, void *ctx);
+
+//handler hooked to a vector, the handlers of a vector are a linked list of objects of a slab pool
+typedef struct int_action {
+    int_handler_t handler;
+    void *ctx;
+    obj_handle_t handle;
+    struct int_action *next;
+} int_action_t;
+
+typedef obj_handle_t int_hook_t;
 
 bool setup_interrupts();
 void set_idt_entry(uint8_t n, uint64_t isr, uint8_t flags);
 void nmi_enable();
 void nmi_disable();
-uint8_t int_hook(uint8_t int_n, void *handler);
-bool int_unhook(uint8_t int_n, uint8_t hook_n);
\ No newline at end of file
+bool int_hook(uint8_t vector, int_handler_t handler, void *ctx, int_hook_t *hook);
+bool int_unhook(uint8_t vector, int_hook_t hook);
+bool int_alloc_vector(uint8_t *vector);
+void int_free_vector(uint8_t vector);
+bool int_request_vector(int_handler_t handler, void *ctx, uint8_t *vector, int_hook_t *hook);
+void int_dispatch(int_regs_t *regs);
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+#include <include/types.h>
+#define IRQ_BALANCE_INTERVAL_MS 1000
+#define IRQ_BALANCE_MIN_IMBALANCE 100   //interrupts/s between the busiest and the idlest cpu below which nothing moves
+#define IRQ_BALANCE_IMBALANCE_PCT 25    //imbalance, in percent of the busiest cpu load, below which nothing moves
+#define IRQ_BALANCE_MAX_MOVES 4         //gsis moved per pass
+
+bool irq_balance_init();
+void irq_balance_tick(uint64_t tsc);
+void irq_balance();
+bool irq_pin(uint32_t gsi, uint32_t cpu_index);
+bool irq_unpin(uint32_t gsi);
+void irq_balance_print(char *args);
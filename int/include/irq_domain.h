@@ -0,0 +1,45 @@
+#pragma once
+#include <include/types.h>
+#include <int/include/int.h>
+#include <int/include/apic.h>
+#define IRQ_ISA_COUNT 16
+#define IRQ_AFFINITY_ALL 0xFFFFFFFFFFFFFFFF //every cpu (bit n: cpu index n)
+
+/* mps inti flags of the madt interrupt source overrides, 0 means "conforms to the bus" (isa: active high, edge) */
+
+#define IRQ_FLAGS_POLARITY_MASK 0x03
+#define IRQ_FLAGS_ACTIVE_LOW 0x03
+#define IRQ_FLAGS_TRIGGER_MASK 0x0C
+#define IRQ_FLAGS_LEVEL 0x0C
+
+//isa irq redirected to another gsi (or with another polarity/trigger mode) by the madt
+typedef struct {
+    uint32_t gsi;
+    uint16_t flags;
+    bool present;
+} irq_isa_override_t;
+
+//state of a gsi routed through an ioapic
+typedef struct {
+    uint64_t affinity;      //cpus the irq may be sent to
+    uint64_t saved_affinity; //affinity before irq_pin(), given back by irq_unpin()
+    uint32_t destination;   //apic id of the cpu it's sent to
+    uint8_t vector;
+    uint8_t polarity;
+    uint8_t trigger;
+    bool masked;
+    bool configured;
+    bool pinned;            //kept on its cpu by the balancer
+} irq_desc_t;
+
+void irq_isa_override(uint8_t isa, uint32_t gsi, uint16_t flags);
+uint32_t irq_isa_to_gsi(uint8_t isa);
+bool irq_setup(uint32_t gsi, uint8_t vector, uint8_t polarity, uint8_t trigger, bool masked);
+bool irq_setup_isa(uint8_t isa, uint8_t vector, bool masked, uint32_t *gsi);
+bool irq_request_isa(uint8_t isa, int_handler_t handler, void *ctx, uint8_t *vector, int_hook_t *hook);
+bool irq_request(uint32_t gsi, uint8_t polarity, uint8_t trigger, int_handler_t handler, void *ctx, uint8_t *vector, int_hook_t *hook);
+bool irq_set_mask(uint32_t gsi, bool masked);
+bool irq_set_affinity(uint32_t gsi, uint64_t affinity);
+bool irq_set_destination(uint32_t gsi, uint32_t cpu_index);
+bool irq_cpu_online(uint32_t cpu_index);
+irq_desc_t *irq_get_desc(uint32_t gsi);
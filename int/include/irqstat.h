@@ -0,0 +1,22 @@
+#pragma once
+#include <include/types.h>
+#define IRQSTAT_BUCKETS 24 //latency histogram: 2 buckets per power of 2 from 64 cycles, the last one collects everything above
+#define IRQSTAT_MIN_SHIFT 6
+
+//statistics of a vector on a cpu, written only by that cpu with the interrupts disabled
+typedef struct {
+    uint64_t count;
+    uint64_t unhandled; //no handler recognized the interrupt (spurious or a device without driver)
+    uint64_t cycles; //total time in the handlers
+    uint64_t max;
+    uint32_t histogram[IRQSTAT_BUCKETS];
+} irqstat_vector_t;
+
+typedef struct irqstat_cpu {
+    irqstat_vector_t vectors[256];
+} irqstat_cpu_t;
+
+bool irqstat_init();
+bool irqstat_init_cpu();
+void irqstat_record(uint8_t vector, uint64_t cycles, bool handled);
+void irqstat_print(char *args);
@@ -0,0 +1,18 @@
+#pragma once
+#include <include/types.h>
+#define SOFTIRQ_MAX_RESTARTS 8 //rounds of softirq_run() before leaving the rest to the next interrupt
+
+//bottom halves, a lower number runs first
+typedef enum {
+    softirq_timer,
+    softirq_block,
+    softirq_keyboard,
+    softirq_balance,
+    softirq_count
+} softirq_t;
+
+typedef void (*softirq_handler_t)(void *ctx);
+
+bool softirq_open(softirq_t nr, softirq_handler_t handler, void *ctx);
+void softirq_raise(softirq_t nr);
+void softirq_run();
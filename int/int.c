@@ -5,6 +5,10 @@
 #include <io/include/port_io.h>
 #include <mm/include/obj_alloc.h>
 #include <include/mem.h>
+#include <int/include/isr.h>
+#include <int/include/softirq.h>
+#include <int/include/irqstat.h>
+#include <int/include/irq_balance.h>
 
 /*
 0x00 	Division by zero
@@ -34,37 +38,78 @@
 __attribute__((aligned(sizeof(idt_t)))) //16 byte aligned
 idt_t idt[MAX_INTERRUPT]; //vector for ISRs addresses
 idtr_t idtr; //idt register structure
-extern uint64_t isrs[];
-uint8_t gsi_map[256];
-void *isr_hooks[256][ISR_MAX_HOOKS];
+extern uint8_t int_entry_stubs[]; //defined in entry.c
 bool nmi_enabled = true;
 
-//loads idt with 256 entries and loads idtr
-bool setup_interrupts() {
-    uint16_t limit = 0; //used to count how many isr are available
+//handlers hooked to every vector, null if none (the common case for the unused vectors)
+int_action_t *int_actions[MAX_INTERRUPT];
+pool_t int_actions_pool_id;
+bool int_actions_pool_ready = false;
 
-    for (uint8_t i = 0; i < MAX_INTERRUPT - 1; i++) {
-        if (!isrs[i]) {
-            break;
-        }
-        
-        set_idt_entry(i, isrs[i], ISR_FLAG_PRESENT | ISR_FLAG_RING0 | ISR_TYPE_INT);
-        limit++;
+//vectors given to devices by int_alloc_vector(), a set bit is a vector in use (the bits outside the dynamic range are never cleared)
+uint64_t int_vectors_used[MAX_INTERRUPT / 64] = {
+    0xFFFFFFFFFFFFFFFF >> (64 - INT_DYNAMIC_FIRST),
+    0,
+    0,
+    0xFFFFFFFFFFFFFFFF << (INT_DYNAMIC_LAST - 192 + 1)
+};
+
+//loads idt with 256 entries (all pointing to the entry stubs) and loads idtr
+bool setup_interrupts() {
+    for (uint32_t i = 0; i < MAX_INTERRUPT; i++) {
+        set_idt_entry(i, (uint64_t) int_entry_stubs + i * INT_STUB_SIZE, ISR_FLAG_PRESENT | ISR_FLAG_RING0 | ISR_TYPE_INT);
+        int_actions[i] = null;
     }
 
     idtr.base = (uint64_t) idt;
-    idtr.limit = limit * sizeof(idt_t) - 1;
+    idtr.limit = MAX_INTERRUPT * sizeof(idt_t) - 1;
     disable_int();
     asm volatile("lidt %0" : : "m"(idtr));
     enable_int(); //enables maskable interrupts
     nmi_enable(); //enables non-maskable interrupts
-    
-    for (uint32_t i = 0; i < 256; i++) {
-        gsi_map[i] = i;
+    return true;
+}
+
+/*
+called by the entry stubs for every interrupt.
+the vectors without handlers cost a single load, the exceptions no handler takes care of are reported by int_exception().
+the irqs (INT_IRQ_BASE and above) are acknowledged to the lapic and followed by the softirqs, handled or not.
+*/
+void int_dispatch(int_regs_t *regs) {
+    uint64_t start = rdtsc();
+    uint8_t vector = regs->vector;
+    bool handled = false;
+
+    if (vector == INT_LOAD_SEGMENTS) {
+        regs->ss = GDT_KERNEL_DS * sizeof(gdt_t);
+        regs->cs = GDT_KERNEL_CS * sizeof(gdt_t);
+        return;
     }
 
-    memclear(isr_hooks, 256 * ISR_MAX_HOOKS * sizeof(void *));
-    return true;
+    for (int_action_t *action = int_actions[vector]; action; action = action->next) {
+        handled |= action->handler(regs, action->ctx);
+    }
+
+    //the cpu doesn't raise the exceptions it reserved from INT_IRQ_BASE to INT_EXCEPTIONS, those vectors are irqs like the ones above
+    if (vector < INT_IRQ_BASE) {
+        irqstat_record(vector, rdtsc() - start, handled);
+
+        if (!handled) {
+            int_exception(regs);
+        }
+
+        return;
+    }
+
+    if (vector != INT_SPURIOUS_VECTOR) {
+        send_eoi();
+    }
+
+    irqstat_record(vector, rdtsc() - start, handled);
+    irq_balance_tick(start);
+
+    //the handlers left their slow work to the softirqs
+    softirq_run();
 }
 
 //sets a specific entry into the idt
@@ -94,50 +139,127 @@ void nmi_disable() {
 /* interrupt hook functions */
 
 /*
-hooks an interrupt to a handler function.
-arguments:
-- int_n: interrupt number (0-255)
-- handler: pointer to the handler function
-
-returns:
-- 0xFF if a bad argument is passed or if a interrupt has all its hooks used
-- n < ISR_MAX_HOOKS if the handler is succesfully hooked to the interrupt, n is the index of the hook, use that number to unhook it
+hooks a handler to an interrupt vector, ctx is passed to the handler on every call.
+the handlers of a vector run in the order they were hooked. hook receives the id to give to int_unhook().
+returns false if the handler is null or the memory for the hook can't be allocated.
 */
-uint8_t int_hook(uint8_t int_n, void *handler) {
+bool int_hook(uint8_t vector, int_handler_t handler, void *ctx, int_hook_t *hook) {
     if (!handler) {
-        return 0xFF;
+        return false;
+    }
+
+    //the pool is created by the first hook, after the memory manager is ready
+    if (!int_actions_pool_ready) {
+        if (!create_growable_obj_pool(&int_actions_pool_id, sizeof(int_action_t), INT_MAX_HOOKS, slab)) {
+            return false;
+        }
+
+        int_actions_pool_ready = true;
+    }
+
+    int_action_t *action;
+    obj_handle_t handle;
+
+    if (!obj_pool_alloc(int_actions_pool_id, &handle, (void **) &action)) {
+        return false;
     }
 
-    uint8_t i = 0;
+    action->handler = handler;
+    action->ctx = ctx;
+    action->handle = handle;
+    action->next = null;
 
-    while(i < ISR_MAX_HOOKS && isr_hooks[int_n][i]) {
-        i++;
+    //the list is walked by the interrupt handlers of this cpu, so it's changed with the interrupts disabled
+    bool enabled = save_disable_int();
+    int_action_t **last = &int_actions[vector];
+
+    while (*last) {
+        last = &(*last)->next;
     }
 
-    if (i == ISR_MAX_HOOKS) {
-        return 0xFF;
+    *last = action;
+    restore_int(enabled);
+
+    if (hook) {
+        *hook = handle;
     }
 
-    isr_hooks[int_n][i] = handler;
-    return i;
+    return true;
 }
 
 /*
-unhooks a function handler from an interrupt.
-this function sets to null the hook attached to an interrupt with int_hook().
-arguments:
-- int_n: interrupt number (0-255)
-- hook_n: hook identifier previously returned by int_hook()
-
-returns:
-- false if a bad argument is passed
-- true if the handler function is succesfully unhooked
+unhooks a handler previously hooked with int_hook().
+returns false if the hook is not hooked to this vector.
 */
-bool int_unhook(uint8_t int_n, uint8_t hook_n) {
-    if (hook_n >= ISR_MAX_HOOKS) {
+bool int_unhook(uint8_t vector, int_hook_t hook) {
+    if (!int_actions_pool_ready) {
+        return false;
+    }
+
+    bool enabled = save_disable_int();
+    int_action_t **link = &int_actions[vector];
+
+    while (*link && (*link)->handle != hook) {
+        link = &(*link)->next;
+    }
+
+    int_action_t *action = *link;
+
+    if (action) {
+        *link = action->next;
+    }
+
+    restore_int(enabled);
+    return action && obj_pool_free(int_actions_pool_id, hook);
+}
+
+/*
+reserves a free vector of the dynamic range (INT_DYNAMIC_FIRST to INT_DYNAMIC_LAST) for a device, the lowest one.
+returns false if all of them are in use.
+*/
+bool int_alloc_vector(uint8_t *vector) {
+    bool enabled = save_disable_int();
+
+    for (uint32_t i = 0; i < MAX_INTERRUPT / 64; i++) {
+        uint64_t free = ~int_vectors_used[i];
+
+        if (free) {
+            uint32_t bit = __builtin_ctzll(free);
+            int_vectors_used[i] |= 1ULL << bit;
+            restore_int(enabled);
+            *vector = i * 64 + bit;
+            return true;
+        }
+    }
+
+    restore_int(enabled);
+    return false;
+}
+
+//gives back a vector reserved with int_alloc_vector(), its handlers have to be unhooked first
+void int_free_vector(uint8_t vector) {
+    if (vector < INT_DYNAMIC_FIRST || vector > INT_DYNAMIC_LAST) {
+        return;
+    }
+
+    bool enabled = save_disable_int();
+    int_vectors_used[vector / 64] &= ~(1ULL << (vector % 64));
+    restore_int(enabled);
+}
+
+/*
+reserves a vector and hooks handler to it: the vector is used only by this handler, no other device shares it.
+returns false if there are no free vectors or the hook fails.
+*/
+bool int_request_vector(int_handler_t handler, void *ctx, uint8_t *vector, int_hook_t *hook) {
+    if (!int_alloc_vector(vector)) {
+        return false;
+    }
+
+    if (!int_hook(*vector, handler, ctx, hook)) {
+        int_free_vector(*vector);
         return false;
     }
 
-    isr_hooks[int_n][hook_n] = null;
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,259 @@
+/*
+Interrupt balancer.
+Every IRQ_BALANCE_INTERVAL_MS it takes the rate of every gsi routed through the ioapics (the count of its vector in the irqstat counters
+since the previous pass) and the load of every online cpu (the sum of the rates of the gsis sent to it), then moves gsis from the most
+loaded cpus to the idlest one, within their affinity sets.
+Hysteresis: nothing moves while the difference between the busiest and the idlest cpu is below IRQ_BALANCE_MIN_IMBALANCE interrupts/s and
+IRQ_BALANCE_IMBALANCE_PCT percent of the busiest load, and a gsi moves only if its rate is below half of the difference (so the move
+reduces the imbalance between its cpu and the idlest one instead of swapping their roles, which would move it back at the next pass).
+Pinned gsis (irq_pin()) stay where they are but their load counts.
+The pass runs in the softirq_balance softirq, raised by int_dispatch() through irq_balance_tick() when the interval is over.
+*/
+
+#include <include/types.h>
+#include <int/include/irq_balance.h>
+#include <int/include/irq_domain.h>
+#include <int/include/irqstat.h>
+#include <int/include/softirq.h>
+#include <int/include/apic.h>
+#include <include/percpu.h>
+#include <include/low_level.h>
+#include <time/include/tsc.h>
+#include <include/mem.h>
+#include <tty/include/tty.h>
+
+uint64_t irq_balance_interval = 0; //in tsc cycles, 0 until irq_balance_init() (or if the tsc frequency is unknown)
+uint64_t irq_balance_next;
+uint64_t irq_balance_last_tsc;
+uint64_t irq_balance_last_count[IOAPIC_MAX_GSI]; //vector counts at the previous pass
+uint32_t irq_balance_rate[IOAPIC_MAX_GSI];       //interrupts/s measured by the last pass
+uint64_t irq_balance_cpu_load[MAX_CPUS];         //interrupts/s of the gsis sent to every cpu after the last pass
+uint64_t irq_balance_moves = 0;
+bool irq_balance_running = false;
+
+//count of a vector on all the cpus
+static uint64_t irq_balance_vector_count(uint8_t vector) {
+    uint64_t count = 0;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        irqstat_cpu_t *stats = percpu_areas[cpu].irqstat;
+
+        if (stats) {
+            count += stats->vectors[vector].count;
+        }
+    }
+
+    return count;
+}
+
+//cpu index of an apic id, MAX_CPUS if no online cpu has it
+static uint32_t irq_balance_cpu_of(uint32_t apic_id) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (irq_cpu_online(cpu) && percpu_areas[cpu].lapic_id == apic_id) {
+            return cpu;
+        }
+    }
+
+    return MAX_CPUS;
+}
+
+static void irq_balance_softirq(void *ctx) {
+    irq_balance();
+}
+
+//must be called after tsc_init() (it needs the tsc frequency)
+bool irq_balance_init() {
+    if (!softirq_open(softirq_balance, irq_balance_softirq, null)) {
+        return false;
+    }
+
+    for (uint32_t gsi = 0; gsi < IOAPIC_MAX_GSI; gsi++) {
+        irq_desc_t *desc = irq_get_desc(gsi);
+        irq_balance_last_count[gsi] = desc->configured ? irq_balance_vector_count(desc->vector) : 0;
+    }
+
+    irq_balance_last_tsc = rdtsc();
+    irq_balance_interval = tsc_khz * IRQ_BALANCE_INTERVAL_MS;
+    irq_balance_next = irq_balance_last_tsc + irq_balance_interval;
+    return true;
+}
+
+//called by int_dispatch() with the tsc read at the entry of the interrupt, raises the balancer softirq once per interval
+void irq_balance_tick(uint64_t tsc) {
+    if (irq_balance_interval && tsc >= irq_balance_next) {
+        irq_balance_next = tsc + irq_balance_interval;
+        softirq_raise(softirq_balance);
+    }
+}
+
+/* one pass of the balancer, can also be called directly */
+void irq_balance() {
+    if (__atomic_test_and_set(&irq_balance_running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    uint64_t now = rdtsc();
+    uint64_t elapsed_ms = tsc_khz ? (now - irq_balance_last_tsc) / tsc_khz : 0;
+    uint32_t owner[IOAPIC_MAX_GSI];
+    irq_balance_last_tsc = now;
+    memclear(irq_balance_cpu_load, sizeof(irq_balance_cpu_load));
+
+    //rates of the gsis and loads of the cpus
+    for (uint32_t gsi = 0; gsi < IOAPIC_MAX_GSI; gsi++) {
+        irq_desc_t *desc = irq_get_desc(gsi);
+        owner[gsi] = MAX_CPUS;
+
+        if (!desc->configured) {
+            continue;
+        }
+
+        uint64_t count = irq_balance_vector_count(desc->vector);
+        irq_balance_rate[gsi] = elapsed_ms ? (count - irq_balance_last_count[gsi]) * 1000 / elapsed_ms : 0;
+        irq_balance_last_count[gsi] = count;
+        owner[gsi] = irq_balance_cpu_of(desc->destination);
+
+        if (owner[gsi] < MAX_CPUS && !desc->masked) {
+            irq_balance_cpu_load[owner[gsi]] += irq_balance_rate[gsi];
+        }
+    }
+
+    for (uint32_t move = 0; move < IRQ_BALANCE_MAX_MOVES; move++) {
+        uint32_t busiest = MAX_CPUS, idlest = MAX_CPUS;
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (!irq_cpu_online(cpu)) {
+                continue;
+            }
+
+            if (busiest == MAX_CPUS || irq_balance_cpu_load[cpu] > irq_balance_cpu_load[busiest]) {
+                busiest = cpu;
+            }
+
+            if (idlest == MAX_CPUS || irq_balance_cpu_load[cpu] < irq_balance_cpu_load[idlest]) {
+                idlest = cpu;
+            }
+        }
+
+        if (busiest == idlest) {
+            break;
+        }
+
+        uint64_t imbalance = irq_balance_cpu_load[busiest] - irq_balance_cpu_load[idlest];
+
+        if (imbalance < IRQ_BALANCE_MIN_IMBALANCE || imbalance * 100 < irq_balance_cpu_load[busiest] * IRQ_BALANCE_IMBALANCE_PCT) {
+            break;
+        }
+
+        //a gsi of the most loaded cpu that has one that can move without overshooting, the busiest of them
+        uint32_t candidate = IOAPIC_MAX_GSI;
+
+        for (uint32_t gsi = 0; gsi < IOAPIC_MAX_GSI; gsi++) {
+            irq_desc_t *desc = irq_get_desc(gsi);
+            uint32_t from = owner[gsi];
+
+            if (from == MAX_CPUS || from == idlest || desc->pinned || desc->masked || !(desc->affinity >> idlest & 1)) {
+                continue;
+            }
+
+            if (irq_balance_rate[gsi] == 0 || irq_balance_rate[gsi] * 2 >= irq_balance_cpu_load[from] - irq_balance_cpu_load[idlest]) {
+                continue;
+            }
+
+            if (candidate == IOAPIC_MAX_GSI || irq_balance_cpu_load[from] > irq_balance_cpu_load[owner[candidate]] ||
+                (from == owner[candidate] && irq_balance_rate[gsi] > irq_balance_rate[candidate])) {
+                candidate = gsi;
+            }
+        }
+
+        if (candidate == IOAPIC_MAX_GSI || !irq_set_destination(candidate, idlest)) {
+            break;
+        }
+
+        irq_balance_cpu_load[owner[candidate]] -= irq_balance_rate[candidate];
+        owner[candidate] = idlest;
+        irq_balance_cpu_load[idlest] += irq_balance_rate[candidate];
+        irq_balance_moves++;
+    }
+
+    __atomic_clear(&irq_balance_running, __ATOMIC_RELEASE);
+}
+
+/* keeps a gsi on a cpu, the balancer doesn't move it until irq_unpin(). returns false if the cpu isn't online */
+bool irq_pin(uint32_t gsi, uint32_t cpu_index) {
+    irq_desc_t *desc = irq_get_desc(gsi);
+
+    if (!desc || !desc->configured || cpu_index >= MAX_CPUS || !irq_cpu_online(cpu_index)) {
+        return false;
+    }
+
+    //pinning again moves the gsi but keeps the affinity of the first pin
+    uint64_t affinity = desc->pinned ? desc->saved_affinity : desc->affinity;
+
+    if (!irq_set_affinity(gsi, 1ULL << cpu_index)) {
+        return false;
+    }
+
+    desc->saved_affinity = affinity;
+    desc->pinned = true;
+    return true;
+}
+
+/*
+gives a pinned gsi back to the balancer with the affinity it had before irq_pin(). it stays on its cpu if that one is in the set, else
+it goes to the first online cpu of the set (it stays pinned if there is none).
+*/
+bool irq_unpin(uint32_t gsi) {
+    irq_desc_t *desc = irq_get_desc(gsi);
+
+    if (!desc || !desc->configured || !desc->pinned) {
+        return false;
+    }
+
+    uint32_t cpu = irq_balance_cpu_of(desc->destination);
+
+    if (cpu < MAX_CPUS && (desc->saved_affinity >> cpu & 1)) {
+        desc->affinity = desc->saved_affinity;
+    } else if (!irq_set_affinity(gsi, desc->saved_affinity)) {
+        return false;
+    }
+
+    desc->pinned = false;
+    return true;
+}
+
+/* terminal command irqbalance: load of every cpu and destination of every gsi, as measured by the last pass */
+void irq_balance_print(char *args) {
+    if (!irq_balance_interval) {
+        printf("the balancer is not running (tsc frequency unknown)\n");
+        return;
+    }
+
+    printf("cpu  apic id  gsis  load/s\n");
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!irq_cpu_online(cpu)) {
+            continue;
+        }
+
+        uint32_t gsis = 0;
+
+        for (uint32_t gsi = 0; gsi < IOAPIC_MAX_GSI; gsi++) {
+            irq_desc_t *desc = irq_get_desc(gsi);
+            gsis += desc->configured && desc->destination == percpu_areas[cpu].lapic_id;
+        }
+
+        printf("%3u  %7u  %4u  %6lu\n", cpu, percpu_areas[cpu].lapic_id, gsis, irq_balance_cpu_load[cpu]);
+    }
+
+    printf("\ngsi  vector  apic id  rate/s\n");
+
+    for (uint32_t gsi = 0; gsi < IOAPIC_MAX_GSI; gsi++) {
+        irq_desc_t *desc = irq_get_desc(gsi);
+
+        if (desc->configured) {
+            printf("%3u  0x%02X  %7u  %6u%s%s\n", gsi, desc->vector, desc->destination, irq_balance_rate[gsi], desc->pinned ? " pinned" : "", desc->masked ? " masked" : "");
+        }
+    }
+
+    printf("\n%lu moves\n", irq_balance_moves);
+}
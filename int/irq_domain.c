@@ -0,0 +1,198 @@
+/*
+IRQ domain.
+Drivers name their interrupts by gsi (global system interrupt), the isa irqs are translated first with the interrupt source overrides of
+the madt (e.g. the pit, isa irq 0, is usually connected to gsi 2 and some isa irqs are level triggered/active low).
+Every gsi has a descriptor with its vector, its pin configuration and its affinity, the set of cpus it may be delivered to. The ioapic
+sends it to one of them (physical destination mode); irq_set_affinity() changes the set and rewrites the destination of the redirection
+entry. The ioapic and pin of a gsi come from the table built by ioapic_build_routes(), no lookup scans the ioapics.
+*/
+
+#include <include/types.h>
+#include <int/include/irq_domain.h>
+#include <int/include/apic.h>
+#include <int/include/int.h>
+#include <include/percpu.h>
+#include <include/low_level.h>
+
+irq_isa_override_t irq_isa_overrides[IRQ_ISA_COUNT]; //filled while the madt is parsed, before the ioapics are set up
+irq_desc_t irq_descs[IOAPIC_MAX_GSI];
+
+/* called by the madt parser for every interrupt source override */
+void irq_isa_override(uint8_t isa, uint32_t gsi, uint16_t flags) {
+    if (isa >= IRQ_ISA_COUNT) {
+        return;
+    }
+
+    irq_isa_overrides[isa].gsi = gsi;
+    irq_isa_overrides[isa].flags = flags;
+    irq_isa_overrides[isa].present = true;
+}
+
+//gsi an isa irq is connected to, the same number if the madt doesn't override it
+uint32_t irq_isa_to_gsi(uint8_t isa) {
+    if (isa < IRQ_ISA_COUNT && irq_isa_overrides[isa].present) {
+        return irq_isa_overrides[isa].gsi;
+    }
+
+    return isa;
+}
+
+irq_desc_t *irq_get_desc(uint32_t gsi) {
+    return gsi < IOAPIC_MAX_GSI ? &irq_descs[gsi] : null;
+}
+
+/*
+true if the cpu can receive ioapic interrupts: it called percpu_init() (system_lapics lists every lapic of the madt, also the ones of the
+cpus not started) and has an apic id that fits the 8 bit destination field.
+*/
+bool irq_cpu_online(uint32_t cpu_index) {
+    return cpu_index < MAX_CPUS && (__atomic_load_n(&percpu_online, __ATOMIC_ACQUIRE) >> cpu_index & 1) &&
+        percpu_areas[cpu_index].lapic_id <= 0xFF;
+}
+
+//apic id of the first online cpu of the set, false if there is none
+static bool irq_pick_destination(uint64_t affinity, uint32_t *apic_id) {
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if ((affinity >> i & 1) && irq_cpu_online(i)) {
+            *apic_id = percpu_areas[i].lapic_id;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+routes a gsi to vector, delivered to the cpu that calls this function. the affinity allows every cpu, so the balancer can move it.
+returns false if no ioapic handles the gsi.
+*/
+bool irq_setup(uint32_t gsi, uint8_t vector, uint8_t polarity, uint8_t trigger, bool masked) {
+    irq_desc_t *desc = irq_get_desc(gsi);
+    percpu_t *cpu = this_cpu();
+
+    if (!desc || !apic_irq(gsi, vector, fixed, physical, polarity, trigger, masked, cpu->lapic_id)) {
+        return false;
+    }
+
+    bool enabled = save_disable_int();
+    desc->affinity = IRQ_AFFINITY_ALL;
+    desc->destination = cpu->lapic_id;
+    desc->vector = vector;
+    desc->polarity = polarity;
+    desc->trigger = trigger;
+    desc->masked = masked;
+    desc->pinned = false;
+    desc->saved_affinity = IRQ_AFFINITY_ALL;
+    desc->configured = true;
+    restore_int(enabled);
+    return true;
+}
+
+/*
+routes an isa irq to vector, with the gsi, polarity and trigger mode of its override (active high and edge triggered if it has none).
+gsi (if not null) receives the gsi to use with the other functions.
+*/
+bool irq_setup_isa(uint8_t isa, uint8_t vector, bool masked, uint32_t *gsi) {
+    uint16_t flags = isa < IRQ_ISA_COUNT && irq_isa_overrides[isa].present ? irq_isa_overrides[isa].flags : 0;
+    uint8_t polarity = (flags & IRQ_FLAGS_POLARITY_MASK) == IRQ_FLAGS_ACTIVE_LOW ? active_low : active_high;
+    uint8_t trigger = (flags & IRQ_FLAGS_TRIGGER_MASK) == IRQ_FLAGS_LEVEL ? level : edge;
+    uint32_t target = irq_isa_to_gsi(isa);
+
+    if (gsi) {
+        *gsi = target;
+    }
+
+    return irq_setup(target, vector, polarity, trigger, masked);
+}
+
+/*
+gives a gsi a vector of its own (from the dynamic range), hooks handler to it and unmasks the gsi.
+returns false if there are no free vectors or no ioapic handles the gsi.
+*/
+bool irq_request(uint32_t gsi, uint8_t polarity, uint8_t trigger, int_handler_t handler, void *ctx, uint8_t *vector, int_hook_t *hook) {
+    if (!int_request_vector(handler, ctx, vector, hook)) {
+        return false;
+    }
+
+    if (!irq_setup(gsi, *vector, polarity, trigger, false)) {
+        int_unhook(*vector, *hook);
+        int_free_vector(*vector);
+        return false;
+    }
+
+    return true;
+}
+
+//same as irq_request() for an isa irq, with the gsi and pin configuration of its override
+bool irq_request_isa(uint8_t isa, int_handler_t handler, void *ctx, uint8_t *vector, int_hook_t *hook) {
+    if (!int_request_vector(handler, ctx, vector, hook)) {
+        return false;
+    }
+
+    if (!irq_setup_isa(isa, *vector, false, null)) {
+        int_unhook(*vector, *hook);
+        int_free_vector(*vector);
+        return false;
+    }
+
+    return true;
+}
+
+bool irq_set_mask(uint32_t gsi, bool masked) {
+    irq_desc_t *desc = irq_get_desc(gsi);
+
+    if (!desc || !desc->configured || !apic_set_mask(gsi, masked)) {
+        return false;
+    }
+
+    desc->masked = masked;
+    return true;
+}
+
+/*
+restricts the cpus a gsi may be delivered to (bit n: cpu index n) and sends it to the first online one of them.
+returns false if the gsi isn't configured or none of the cpus is online (the irq keeps its destination).
+*/
+bool irq_set_affinity(uint32_t gsi, uint64_t affinity) {
+    irq_desc_t *desc = irq_get_desc(gsi);
+    uint32_t destination;
+
+    if (!desc || !desc->configured || !irq_pick_destination(affinity, &destination)) {
+        return false;
+    }
+
+    bool enabled = save_disable_int();
+
+    if (destination != desc->destination && !apic_set_destination(gsi, destination)) {
+        restore_int(enabled);
+        return false;
+    }
+
+    desc->affinity = affinity;
+    desc->destination = destination;
+    restore_int(enabled);
+    return true;
+}
+
+/*
+sends a gsi to one cpu of its affinity set, without changing the set (used by the balancer).
+returns false if the cpu is offline or not in the set.
+*/
+bool irq_set_destination(uint32_t gsi, uint32_t cpu_index) {
+    irq_desc_t *desc = irq_get_desc(gsi);
+
+    if (!desc || !desc->configured || !irq_cpu_online(cpu_index) || !(desc->affinity >> cpu_index & 1)) {
+        return false;
+    }
+
+    uint32_t destination = percpu_areas[cpu_index].lapic_id;
+    bool enabled = save_disable_int();
+    bool done = destination == desc->destination || apic_set_destination(gsi, destination);
+
+    if (done) {
+        desc->destination = destination;
+    }
+
+    restore_int(enabled);
+    return done;
+}
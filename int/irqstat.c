@@ -0,0 +1,149 @@
+/*
+Interrupt statistics.
+int_dispatch() measures every interrupt with the TSC, from the entry to the end of the handlers and the EOI (the softirqs are not
+included), and irqstat_record() adds it to the counters and the latency histogram of the vector on the current cpu.
+The histogram has 2 buckets per power of 2, enough to tell a 1 us handler from a 10 us one; p50 and p99 are the upper bounds of
+the buckets that contain them, the max is exact.
+irqstat_print() (terminal command irqstat) sums the cpus and prints the vectors that fired, with their rate since the previous call.
+*/
+
+#include <include/types.h>
+#include <int/include/irqstat.h>
+#include <int/include/int.h>
+#include <include/percpu.h>
+#include <include/low_level.h>
+#include <include/mem.h>
+#include <time/include/tsc.h>
+#include <mm/include/kmalloc.h>
+#include <tty/include/tty.h>
+
+uint64_t irqstat_last_tsc;
+uint64_t irqstat_last_count[256]; //counts at the previous irqstat_print(), for the rates
+
+static inline uint32_t irqstat_bucket(uint64_t cycles) {
+    if (cycles < 1 << IRQSTAT_MIN_SHIFT) {
+        return 0;
+    }
+
+    uint32_t log = 63 - __builtin_clzll(cycles);
+    uint32_t bucket = (log - IRQSTAT_MIN_SHIFT) * 2 + (cycles >> (log - 1) & 1) + 1;
+    return bucket < IRQSTAT_BUCKETS ? bucket : IRQSTAT_BUCKETS - 1;
+}
+
+//first value of the next bucket
+static uint64_t irqstat_bucket_limit(uint32_t bucket) {
+    return (uint64_t)(2 + bucket % 2) << (bucket / 2 + IRQSTAT_MIN_SHIFT - 1);
+}
+
+//allocates the statistics of the current cpu, interrupts before this are not counted
+bool irqstat_init_cpu() {
+    irqstat_cpu_t *stats = kmalloc(sizeof(irqstat_cpu_t));
+
+    if (!stats) {
+        return false;
+    }
+
+    memclear(stats, sizeof(irqstat_cpu_t));
+    this_cpu()->irqstat = stats;
+    return true;
+}
+
+//times are printed in ns if tsc_init() has calibrated the TSC, in cycles otherwise
+bool irqstat_init() {
+    if (!irqstat_init_cpu()) {
+        return false;
+    }
+
+    irqstat_last_tsc = rdtsc();
+    return true;
+}
+
+//called by int_dispatch() with the interrupts disabled
+void irqstat_record(uint8_t vector, uint64_t cycles, bool handled) {
+    irqstat_cpu_t *stats = this_cpu()->irqstat;
+
+    if (!stats) {
+        return;
+    }
+
+    irqstat_vector_t *entry = &stats->vectors[vector];
+    entry->count++;
+    entry->cycles += cycles;
+    entry->histogram[irqstat_bucket(cycles)]++;
+
+    if (cycles > entry->max) {
+        entry->max = cycles;
+    }
+
+    if (!handled) {
+        entry->unhandled++;
+    }
+}
+
+//smallest bucket limit below which at least permille / 1000 of the samples are
+static uint64_t irqstat_percentile(uint32_t *histogram, uint64_t count, uint32_t permille) {
+    uint64_t target = (count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (uint32_t i = 0; i < IRQSTAT_BUCKETS; i++) {
+        seen += histogram[i];
+
+        if (seen >= target) {
+            return irqstat_bucket_limit(i);
+        }
+    }
+
+    return irqstat_bucket_limit(IRQSTAT_BUCKETS - 1);
+}
+
+static uint64_t irqstat_time(uint64_t cycles) {
+    return tsc_khz ? tsc_to_ns(cycles) : cycles;
+}
+
+void irqstat_print(char *args) {
+    uint64_t now = rdtsc();
+    uint64_t elapsed_ms = tsc_khz ? (now - irqstat_last_tsc) / tsc_khz : 0;
+    uint64_t unhandled = 0;
+    printf("vector     count    rate/s  unhandled    p50    p99    max (%s)\n", tsc_khz ? "ns" : "cycles");
+
+    for (uint32_t vector = 0; vector < 256; vector++) {
+        irqstat_vector_t total;
+        memclear(&total, sizeof(irqstat_vector_t));
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            irqstat_cpu_t *stats = percpu_areas[cpu].irqstat;
+
+            if (!stats) {
+                continue;
+            }
+
+            irqstat_vector_t *entry = &stats->vectors[vector];
+            total.count += entry->count;
+            total.unhandled += entry->unhandled;
+            total.max = entry->max > total.max ? entry->max : total.max;
+
+            for (uint32_t i = 0; i < IRQSTAT_BUCKETS; i++) {
+                total.histogram[i] += entry->histogram[i];
+            }
+        }
+
+        if (total.count == 0) {
+            continue;
+        }
+
+        uint64_t p50 = irqstat_percentile(total.histogram, total.count, 500);
+        uint64_t p99 = irqstat_percentile(total.histogram, total.count, 990);
+        uint64_t rate = elapsed_ms ? (total.count - irqstat_last_count[vector]) * 1000 / elapsed_ms : 0;
+        unhandled += total.unhandled;
+        irqstat_last_count[vector] = total.count;
+
+        //the bucket limit can be above the real max
+        p50 = p50 < total.max ? p50 : total.max;
+        p99 = p99 < total.max ? p99 : total.max;
+        printf("  0x%02X %9lu %9lu %10lu %6lu %6lu %6lu\n", vector, total.count, rate, total.unhandled, irqstat_time(p50),
+            irqstat_time(p99), irqstat_time(total.max));
+    }
+
+    printf("unhandled/spurious: %lu\n", unhandled);
+    irqstat_last_tsc = now;
+}
@@ -0,0 +1,78 @@
+/*
+Softirqs (bottom halves).
+An interrupt handler (top half) runs with the interrupts disabled, so it only acknowledges its device, queues what it read and raises its
+softirq. When the outermost interrupt is done int_dispatch() calls softirq_run(), which runs the raised softirqs of the cpu with the
+interrupts enabled: one run handles all the events queued since the last one, and the console or the disks can be slow without
+keeping the interrupts disabled.
+The pending bits live in the percpu_t of every cpu, a softirq always runs on the cpu that raised it.
+The softirq handlers are normal kernel code (drivers, terminal), which can use the SIMD registers, so softirq_run() saves the SIMD state
+of the interrupted code around them.
+*/
+
+#include <include/types.h>
+#include <int/include/softirq.h>
+#include <include/percpu.h>
+#include <include/low_level.h>
+#include <include/fpu.h>
+
+typedef struct {
+    softirq_handler_t handler;
+    void *ctx;
+} softirq_action_t;
+
+softirq_action_t softirq_actions[softirq_count];
+
+//sets the handler of a softirq, usually once at boot by the driver that raises it
+bool softirq_open(softirq_t nr, softirq_handler_t handler, void *ctx) {
+    if (nr >= softirq_count || !handler) {
+        return false;
+    }
+
+    softirq_actions[nr].ctx = ctx;
+    softirq_actions[nr].handler = handler;
+    return true;
+}
+
+//marks a softirq as pending on this cpu, it runs when the current interrupt (or the current softirq round) is over
+void softirq_raise(softirq_t nr) {
+    bool enabled = save_disable_int();
+    this_cpu()->softirq_pending |= 1 << nr;
+    restore_int(enabled);
+}
+
+/*
+Runs the pending softirqs of this cpu with the interrupts enabled, called by int_dispatch() on the way out of an interrupt.
+Softirqs don't nest: an interrupt that arrives while they run only raises its own, which the running loop picks up.
+A softirq raised over and over is left to the next interrupt after SOFTIRQ_MAX_RESTARTS rounds, so the interrupted code still makes progress.
+Returns with the interrupts disabled, like they were when it was called.
+*/
+void softirq_run() {
+    percpu_t *cpu = this_cpu();
+
+    if (cpu->softirq_active || !cpu->softirq_pending) {
+        return;
+    }
+
+    cpu->softirq_active = true;
+    bool fpu_saved = kernel_fpu_begin();
+
+    for (uint32_t round = 0; round < SOFTIRQ_MAX_RESTARTS && cpu->softirq_pending; round++) {
+        uint32_t pending = cpu->softirq_pending;
+        cpu->softirq_pending = 0;
+        enable_int();
+
+        for (uint32_t nr = 0; pending; nr++, pending >>= 1) {
+            if ((pending & 1) && softirq_actions[nr].handler) {
+                softirq_actions[nr].handler(softirq_actions[nr].ctx);
+            }
+        }
+
+        disable_int();
+    }
+
+    if (fpu_saved) {
+        kernel_fpu_end();
+    }
+
+    cpu->softirq_active = false;
+}
@@ -13,7 +13,6 @@ For each type of peripheral there's a function.
 #include <drv/ahci/include/ahci_setup.h>
 
 pool_t mass_storage_pool_id;
-uint32_t mass_storage_last_ind = 0;
 
 /* configure a mass storage device based on its type */
 bool devs_config_mass_storage(pci_general_dev_t *dev) {
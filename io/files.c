@@ -10,20 +10,19 @@ this files includes posix file functions
 
 bool files_ready = false;
 pool_t files_descr_pool;
-uint32_t files_pool_last_ind;
 file_t stdin, stdout, stderr;
 
 bool init_files() {
-    if (!create_obj_pool(&files_descr_pool, sizeof(file_t), MAX_FILES, manual)) {
+    //the file table starts with a page of descriptors and grows up to MAX_FILES
+    if (!create_growable_obj_pool(&files_descr_pool, sizeof(file_t), MAX_FILES, manual)) {
         return false;
     }
 
     //create default files (stdin, stdout, stderr)
-    obj_pool_put(files_descr_pool, (void *) &stdin, 0);
-    obj_pool_put(files_descr_pool, (void *) &stdout, 1);
-    obj_pool_put(files_descr_pool, (void *) &stderr, 2);
+    obj_pool_push(files_descr_pool, (void *) &stdin, null);
+    obj_pool_push(files_descr_pool, (void *) &stdout, null);
+    obj_pool_push(files_descr_pool, (void *) &stderr, null);
 
-    files_pool_last_ind = 3;
     files_ready = true;
     return true;
 }
@@ -1,6 +1,9 @@
 #pragma once
 #include <include/types.h>
+#include <int/include/int.h>
 #define IN_BUFFER_SIZE 256
+#define KEYBOARD_VECTOR 0x18 //irq1, an irq vector (INT_IRQ_BASE or above): int_dispatch() acknowledges it and runs the keyboard softirq
+#define KEYBOARD_RING_SIZE 64 //keys queued by the interrupt handler for the keyboard softirq, must be a power of 2
 #define KEYCODE_NULL 0
 
 /* keyboard control codes */
@@ -72,4 +75,4 @@ bool init_keyboard(void);
 void keypressed(uint8_t code);
 void keyboard_control(uint8_t control);
 void keyboard_wait(char *msg);
-void keyboard_wait_handler();
\ No newline at end of file
+bool keyboard_wait_handler(int_regs_t *regs, void *ctx);
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include <include/types.h>
+#include <io/include/pci.h>
+#include <int/include/int.h>
+
+/* message signaled interrupts: the device writes data to address, the write goes straight to the lapic of the destination cpu */
+
+#define MSI_ADDRESS_BASE 0xFEE00000
+#define MSI_ADDRESS(apic_id) (MSI_ADDRESS_BASE | ((apic_id) & 0xFF) << 12) //physical destination mode, no redirection hint
+#define MSI_DATA(vector) ((uint32_t)(vector))                               //fixed delivery, edge triggered
+#define MSI_MAX_APIC_ID 0xFF //wider x2apic ids need interrupt remapping
+
+/* msi capability */
+
+#define MSI_CONTROL 0x02
+#define MSI_CONTROL_ENABLE (1 << 0)
+#define MSI_CONTROL_MME_MASK (7 << 4)   //multiple message enable, 0 = one vector
+#define MSI_CONTROL_64BIT (1 << 7)
+#define MSI_CONTROL_MASKABLE (1 << 8)   //per vector masking
+#define MSI_ADDRESS_LOW 0x04
+#define MSI_ADDRESS_HIGH 0x08           //64 bit capable functions only
+#define MSI_DATA_32 0x08
+#define MSI_DATA_64 0x0C
+#define MSI_MASK_32 0x0C
+#define MSI_MASK_64 0x10
+
+/* msi-x capability, the vectors are in a table in the memory of one of the bars */
+
+#define MSIX_CONTROL 0x02
+#define MSIX_CONTROL_TABLE_SIZE 0x7FF   //number of entries - 1
+#define MSIX_CONTROL_FUNCTION_MASK (1 << 14)
+#define MSIX_CONTROL_ENABLE (1 << 15)
+#define MSIX_TABLE 0x04                 //offset into the bar (bits 3-31) and bar index (bits 0-2)
+#define MSIX_BIR_MASK 0x07
+#define MSIX_ENTRY_MASKED (1 << 0)
+
+typedef struct {
+    uint32_t address_low;
+    uint32_t address_high;
+    uint32_t data;
+    uint32_t control;
+} __attribute__((packed)) msix_entry_t;
+
+//interrupt of a device requested with pci_irq_request()
+typedef struct {
+    pci_general_dev_t *dev;
+    uint16_t entry;     //msi-x table entry (0 for msi)
+    uint8_t vector;
+    bool msix;
+    int_hook_t hook;
+} pci_irq_t;
+
+uint16_t pci_msix_count(pci_general_dev_t *dev);
+bool pci_msi_enable(pci_general_dev_t *dev, uint8_t vector, uint32_t apic_id);
+void pci_msi_disable(pci_general_dev_t *dev);
+bool pci_msix_enable(pci_general_dev_t *dev, uint16_t entry, uint8_t vector, uint32_t apic_id);
+bool pci_msix_mask(pci_general_dev_t *dev, uint16_t entry, bool masked);
+void pci_msix_disable(pci_general_dev_t *dev);
+bool pci_irq_request(pci_general_dev_t *dev, uint16_t entry, int_handler_t handler, void *ctx, uint32_t apic_id, pci_irq_t *irq);
+bool pci_irq_set_affinity(pci_irq_t *irq, uint32_t apic_id);
+void pci_irq_free(pci_irq_t *irq);
@@ -4,6 +4,13 @@
 #define PCI_CONFIG_DATA (uint16_t) 0x0CFC
 #define PCI_ADDRESS(bus, dev, fnc, off) (((uint32_t) bus & 0xFF) << 16 | ((uint32_t) dev & 0x1F) << 11 | ((uint32_t) fnc & 0x07) << 8 | off & 0xFF | 1 << 31)
 #define PCI_FNC_EXIST(bus, dev, fnc) ((pci_config_read(bus, dev, fnc, 0) & 0xFFFF) != 0xFFFF)
+#define PCI_COMMAND_BUS_MASTER (1 << 2)    //the device can write to memory (dma, msi)
+#define PCI_COMMAND_INTX_DISABLE (1 << 10) //the device doesn't assert its legacy interrupt pin
+#define PCI_STATUS_CAP_LIST (1 << 4)       //capabilities_ptr is valid
+#define PCI_BAR0 0x10                      //offset of the first bar in the configuration space
+#define PCI_CAP_MSI 0x05
+#define PCI_CAP_MSIX 0x11
+#define PCI_MAX_CAPABILITIES 48            //bound for the walk of a malformed (looping) list
 
 typedef struct {
     uint16_t vendor_id;      //identifies the manufacturer of the device
@@ -117,4 +124,6 @@ bool pci_config_read_entry(uint8_t bus, uint8_t dev, uint8_t fnc, pci_device_t *
 void enum_pci();
 void pci_scan_dev(uint8_t bus, uint8_t dev);
 uint32_t pci_read_capability_register(pci_general_dev_t *dev, uint8_t reg);
+uint8_t pci_find_capability(pci_general_dev_t *dev, uint8_t id);
+uint64_t pci_bar_address(pci_general_dev_t *dev, uint8_t bar);
 bool pci_init_device(pci_general_dev_t *dev);
\ No newline at end of file
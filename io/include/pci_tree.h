@@ -2,6 +2,7 @@
 #include <include/types.h>
 #include <io/include/pci.h>
 #define PCI_INITIAL_BUS 0
+#define PCI_TREE_ARENA_PAGES 1 //pages requested by the tree nodes arena every time it grows
 
 typedef struct pci_tree_dev_node {
     pci_general_dev_t *dev;                           //pointer to the actual data structure
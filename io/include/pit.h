@@ -4,7 +4,9 @@
 #define PIT_CHANNEL1_DATA_PORT 0x41 //channel 1 is unused and may not even exist
 #define PIT_CHANNEL2_DATA_PORT 0x42 //channel 2 is connected to the pc speaker
 #define PIT_MODE_COMMAND_REGISTER_PORT 0x43
-#define PIT_IRQ 2
+#define PIT_IRQ 0 //isa irq, usually redirected to gsi 2 by the madt
+#define PIT_FREQUENCY 1193182 //hz
+#define PIT_GATE_PORT 0x61 //bit 0: gate of channel 2, bit 1: pc speaker enable, bit 5: output of channel 2
 
 /* use these to compose a command for the pit */
 
@@ -28,4 +30,6 @@ void init_pit();
 void pit_command(uint8_t command);
 void pit_write(uint8_t channel, uint8_t data);
 void pit_run();
-void pit_stop();
\ No newline at end of file
+void pit_stop();
+void pit_oneshot_start(uint16_t count);
+bool pit_oneshot_done();
\ No newline at end of file
@@ -6,4 +6,6 @@ void outb(uint16_t port, uint8_t data);
 uint16_t inw(uint16_t port);
 void outw(uint16_t port, uint16_t data);
 uint32_t inl(uint16_t port);
-void outl(uint16_t port, uint32_t data);
\ No newline at end of file
+void outl(uint16_t port, uint32_t data);
+void insw(uint16_t port, void *buffer, uint64_t count);
+void outsw(uint16_t port, const void *buffer, uint64_t count);
\ No newline at end of file
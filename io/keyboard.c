@@ -2,9 +2,13 @@
 #include <include/types.h>
 #include <io/include/files.h>
 #include <int/include/apic.h>
+#include <int/include/irq_domain.h>
 #include <tty/include/term.h>
 #include <int/include/int.h>
 #include <tty/include/tty.h>
+#include <io/include/ps2_keyboard.h>
+#include <int/include/softirq.h>
+#include <include/ring.h>
 
 keyboard_status_t ks;
 bool keyboard_ready = false;
@@ -27,6 +31,40 @@ const char keyboard_shift_codes[] = {
     0, 0, 0, 0, 0, 0
 };
 
+/*
+the keys go from the interrupt handler to keypressed() (which draws on the terminal) through a ring:
+irq1 only reads the code from the ps/2 controller and the keyboard softirq, run by int_dispatch() on the way out of the irq, handles all
+the codes queued since its last run.
+*/
+uint8_t keyboard_ring_buffer[KEYBOARD_RING_SIZE];
+spsc_ring_t keyboard_ring;
+uint64_t keyboard_dropped = 0; //keys lost because the ring was full
+
+//irq1 (top half)
+static bool ps2_keyboard_irq(int_regs_t *regs, void *ctx) {
+    uint8_t code = ps2_in();
+
+    if (code != 0) {
+        if (spsc_ring_enqueue(&keyboard_ring, &code)) {
+            softirq_raise(softirq_keyboard);
+        } else {
+            keyboard_dropped++;
+        }
+    }
+
+    return true;
+}
+
+//bottom half, runs with the interrupts enabled
+static void keyboard_softirq(void *ctx) {
+    uint8_t codes[KEYBOARD_RING_SIZE];
+    uint32_t count = spsc_ring_dequeue_batch(&keyboard_ring, codes, KEYBOARD_RING_SIZE);
+
+    for (uint32_t i = 0; i < count; i++) {
+        keypressed(codes[i]);
+    }
+}
+
 /* initialize keyboard input subsystem */
 bool init_keyboard(void) {
     ks.capslock = false;
@@ -38,8 +76,18 @@ bool init_keyboard(void) {
     ks.alt = false;
     ks.fn = false;
     ks.source = ps2; //by default the keyboard input is set to be ps/2, when and if a usb keyboard is found it will be changed
-    apic_irq(1, 0x18, fixed, physical, active_high, edge, false, 0); //ps2 irq
+
+    if (!spsc_ring_init(&keyboard_ring, keyboard_ring_buffer, 1, KEYBOARD_RING_SIZE) || !softirq_open(softirq_keyboard, keyboard_softirq, null)) {
+        return false;
+    }
+
+    if (!int_hook(KEYBOARD_VECTOR, ps2_keyboard_irq, null, null)) {
+        return false;
+    }
+
+    irq_setup_isa(1, KEYBOARD_VECTOR, false, null); //ps2 irq
     keyboard_ready = true;
+    return true;
 }
 
 /*
@@ -118,19 +166,24 @@ void keyboard_control(uint8_t control) {
 }
 
 /* waits for the user to press a key */
-bool keyboard_wait_in_progress = false;
+volatile bool keyboard_wait_in_progress = false; //cleared by the keyboard interrupt handler
 void keyboard_wait(char *msg) {
     if (msg) {
         printf("%s\n", msg);
     }
 
     keyboard_wait_in_progress = true;
-    uint8_t hook_n = int_hook(0x18, (void *) &keyboard_wait_handler);
-    printf("hook n %d\n", hook_n);
+    int_hook_t hook;
+
+    if (!int_hook(KEYBOARD_VECTOR, keyboard_wait_handler, null, &hook)) {
+        return;
+    }
+
     while(keyboard_wait_in_progress);
-    int_unhook(0x18, hook_n);
+    int_unhook(KEYBOARD_VECTOR, hook);
 }
 
-void keyboard_wait_handler() {
+bool keyboard_wait_handler(int_regs_t *regs, void *ctx) {
     keyboard_wait_in_progress = false;
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+/*
+MSI and MSI-X.
+With message signaled interrupts a device doesn't assert an interrupt pin routed through the ioapic: it writes a message (MSI_DATA, which
+holds the vector) to an address in the lapic range (MSI_ADDRESS, which holds the destination apic id). Every message is edge triggered and
+has its own vector, so there is no sharing and no ioapic redirection entry to program or acknowledge.
+MSI gives a function one vector (here, multiple message mode is not used) programmed in the capability itself, MSI-X up to 2048 vectors
+programmed in a table in the memory of one of the bars, with a mask bit per entry. A device that needs a vector per queue uses MSI-X.
+*/
+
+#include <include/types.h>
+#include <io/include/msi.h>
+#include <io/include/pci.h>
+#include <int/include/int.h>
+#include <mm/include/paging.h>
+
+#define PCI_CONFIG16(dev, offset) (*(volatile uint16_t *)((void *)(dev) + (offset)))
+#define PCI_CONFIG32(dev, offset) (*(volatile uint32_t *)((void *)(dev) + (offset)))
+
+//no legacy interrupt and bus mastering, which the device needs to write the messages
+static void pci_msi_command(pci_general_dev_t *dev) {
+    PCI_CONFIG16(dev, 0x04) |= PCI_COMMAND_INTX_DISABLE | PCI_COMMAND_BUS_MASTER;
+}
+
+//number of msi-x vectors of the device, 0 if it doesn't support msi-x
+uint16_t pci_msix_count(pci_general_dev_t *dev) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_MSIX);
+
+    if (!cap) {
+        return 0;
+    }
+
+    return (PCI_CONFIG16(dev, cap + MSIX_CONTROL) & MSIX_CONTROL_TABLE_SIZE) + 1;
+}
+
+/*
+programs the msi capability of the device to send vector to the cpu with the specified apic id, and enables it (msi-x gets disabled,
+a function can use only one of them). returns false if the device doesn't support msi.
+*/
+bool pci_msi_enable(pci_general_dev_t *dev, uint8_t vector, uint32_t apic_id) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_MSI);
+
+    if (!cap || apic_id > MSI_MAX_APIC_ID) {
+        return false;
+    }
+
+    pci_msix_disable(dev);
+    uint16_t control = PCI_CONFIG16(dev, cap + MSI_CONTROL);
+    bool wide = control & MSI_CONTROL_64BIT;
+    PCI_CONFIG16(dev, cap + MSI_CONTROL) = control & ~MSI_CONTROL_ENABLE;
+    PCI_CONFIG32(dev, cap + MSI_ADDRESS_LOW) = MSI_ADDRESS(apic_id);
+
+    if (wide) {
+        PCI_CONFIG32(dev, cap + MSI_ADDRESS_HIGH) = 0;
+    }
+
+    PCI_CONFIG16(dev, cap + (wide ? MSI_DATA_64 : MSI_DATA_32)) = MSI_DATA(vector);
+
+    //unmask the only vector used
+    if (control & MSI_CONTROL_MASKABLE) {
+        PCI_CONFIG32(dev, cap + (wide ? MSI_MASK_64 : MSI_MASK_32)) &= ~1;
+    }
+
+    pci_msi_command(dev);
+    PCI_CONFIG16(dev, cap + MSI_CONTROL) = (control & ~MSI_CONTROL_MME_MASK) | MSI_CONTROL_ENABLE;
+    return true;
+}
+
+void pci_msi_disable(pci_general_dev_t *dev) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_MSI);
+
+    if (cap) {
+        PCI_CONFIG16(dev, cap + MSI_CONTROL) &= ~MSI_CONTROL_ENABLE;
+    }
+}
+
+/*
+returns the msi-x table of the device, the table is in the bar selected by the bir field at the offset in the rest of the register.
+the bars are used with the same virtual and physical address (as for ahci), the pages of the table are mapped if they aren't.
+*/
+static volatile msix_entry_t *pci_msix_table(pci_general_dev_t *dev, uint8_t cap) {
+    uint32_t table = PCI_CONFIG32(dev, cap + MSIX_TABLE);
+    uint64_t bar = pci_bar_address(dev, table & MSIX_BIR_MASK);
+
+    if (!bar) {
+        return null;
+    }
+
+    uint64_t address = bar + (table & ~MSIX_BIR_MASK);
+    uint64_t size = ((PCI_CONFIG16(dev, cap + MSIX_CONTROL) & MSIX_CONTROL_TABLE_SIZE) + 1) * sizeof(msix_entry_t);
+
+    for (uint64_t page = address & ~0xFFFULL; page < address + size; page += 0x1000) {
+        if (get_physical_address((void *) page) != (void *) page && !map_page((void *) page, (void *) page)) {
+            return null;
+        }
+    }
+
+    return (volatile msix_entry_t *) address;
+}
+
+/*
+programs entry of the msi-x table of the device to send vector to the cpu with the specified apic id and unmasks it, enabling msi-x
+if it's not already (msi gets disabled). the entries not programmed stay masked, as they are after reset.
+returns false if the device doesn't support msi-x or the entry doesn't exist.
+*/
+bool pci_msix_enable(pci_general_dev_t *dev, uint16_t entry, uint8_t vector, uint32_t apic_id) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_MSIX);
+
+    if (!cap || apic_id > MSI_MAX_APIC_ID || entry >= pci_msix_count(dev)) {
+        return false;
+    }
+
+    volatile msix_entry_t *table = pci_msix_table(dev, cap);
+
+    if (!table) {
+        return false;
+    }
+
+    //the function stays masked while the entry changes
+    uint16_t control = PCI_CONFIG16(dev, cap + MSIX_CONTROL);
+
+    if (!(control & MSIX_CONTROL_ENABLE)) {
+        pci_msi_disable(dev);
+        pci_msi_command(dev);
+    }
+
+    PCI_CONFIG16(dev, cap + MSIX_CONTROL) = control | MSIX_CONTROL_ENABLE | MSIX_CONTROL_FUNCTION_MASK;
+    volatile msix_entry_t *e = &table[entry];
+    e->control |= MSIX_ENTRY_MASKED;
+    e->address_low = MSI_ADDRESS(apic_id);
+    e->address_high = 0;
+    e->data = MSI_DATA(vector);
+    e->control &= ~MSIX_ENTRY_MASKED;
+    PCI_CONFIG16(dev, cap + MSIX_CONTROL) = (control | MSIX_CONTROL_ENABLE) & ~MSIX_CONTROL_FUNCTION_MASK;
+    return true;
+}
+
+//masks or unmasks one msi-x vector, a masked vector is kept pending by the device and sent when unmasked
+bool pci_msix_mask(pci_general_dev_t *dev, uint16_t entry, bool masked) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_MSIX);
+    volatile msix_entry_t *table;
+
+    if (!cap || entry >= pci_msix_count(dev) || !(table = pci_msix_table(dev, cap))) {
+        return false;
+    }
+
+    if (masked) {
+        table[entry].control |= MSIX_ENTRY_MASKED;
+    } else {
+        table[entry].control &= ~MSIX_ENTRY_MASKED;
+    }
+
+    return true;
+}
+
+void pci_msix_disable(pci_general_dev_t *dev) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_MSIX);
+
+    if (cap) {
+        PCI_CONFIG16(dev, cap + MSIX_CONTROL) &= ~MSIX_CONTROL_ENABLE;
+    }
+}
+
+/*
+gives an interrupt of the device its own vector: reserves a vector, hooks handler to it and programs msi-x entry (or msi, for entry 0
+of the devices without msi-x) to send it to the cpu with the specified apic id.
+irq receives what pci_irq_set_affinity() and pci_irq_free() need. returns false if the device supports neither or there are no free vectors.
+*/
+bool pci_irq_request(pci_general_dev_t *dev, uint16_t entry, int_handler_t handler, void *ctx, uint32_t apic_id, pci_irq_t *irq) {
+    bool msix = entry < pci_msix_count(dev);
+
+    if (!msix && (entry || !pci_find_capability(dev, PCI_CAP_MSI))) {
+        return false;
+    }
+
+    if (!int_request_vector(handler, ctx, &irq->vector, &irq->hook)) {
+        return false;
+    }
+
+    irq->dev = dev;
+    irq->entry = entry;
+    irq->msix = msix;
+
+    if (!pci_irq_set_affinity(irq, apic_id)) {
+        int_unhook(irq->vector, irq->hook);
+        int_free_vector(irq->vector);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+sends the interrupt to another cpu.
+msi-x entries are masked while they change, msi has no mask for a single vector on most devices and is reprogrammed with msi disabled.
+*/
+bool pci_irq_set_affinity(pci_irq_t *irq, uint32_t apic_id) {
+    if (irq->msix) {
+        return pci_msix_enable(irq->dev, irq->entry, irq->vector, apic_id);
+    }
+
+    return pci_msi_enable(irq->dev, irq->vector, apic_id);
+}
+
+//stops the interrupt (masks the msi-x entry or disables msi), unhooks the handler and gives back the vector
+void pci_irq_free(pci_irq_t *irq) {
+    if (irq->msix) {
+        pci_msix_mask(irq->dev, irq->entry, true);
+    } else {
+        pci_msi_disable(irq->dev);
+    }
+
+    int_unhook(irq->vector, irq->hook);
+    int_free_vector(irq->vector);
+}
@@ -16,14 +16,66 @@ bool init_pci() {
         return false;
     }
 
-    //create some pools
-    if (!create_obj_pool(&mass_storage_pool_id, sizeof(ms_dev_t), 8, manual)) {return false;}          //mass storage devices
-    if (!create_obj_pool(&ide_devices_pool_id, sizeof(ide_device_t), 16, manual)) {return false;}      //IDE devices
-    if (!create_obj_pool(&ahci_devices_pool_id, sizeof(ahci_device_t), 128, manual)) {return false;}   //AHCI devices
+    //create the device registries, they start with a page and grow with the number of devices found
+    if (!create_growable_obj_pool(&mass_storage_pool_id, sizeof(ms_dev_t), 64, manual)) {return false;}      //mass storage devices
+    if (!create_growable_obj_pool(&ide_devices_pool_id, sizeof(ide_device_t), 64, manual)) {return false;}   //IDE devices
+    if (!create_growable_obj_pool(&ahci_devices_pool_id, sizeof(ahci_device_t), 1024, manual)) {return false;} //AHCI devices
 
     return enum_pcie();
 }
 
+/* reads the dword at offset reg of the configuration space of the device (mapped by pcie) */
+uint32_t pci_read_capability_register(pci_general_dev_t *dev, uint8_t reg) {
+    return *(volatile uint32_t *)((void *) dev + (reg & 0xFC));
+}
+
+/*
+walks the capability list of the device and returns the offset of the first capability with the specified id,
+0 if the device doesn't have it (0 is never a valid capability offset, it's the vendor id).
+every capability starts with its id (byte 0) and the offset of the next one (byte 1).
+*/
+uint8_t pci_find_capability(pci_general_dev_t *dev, uint8_t id) {
+    if (!(dev->header.status & PCI_STATUS_CAP_LIST)) {
+        return 0;
+    }
+
+    uint8_t offset = dev->capabilities_ptr & 0xFC;
+
+    for (uint32_t i = 0; i < PCI_MAX_CAPABILITIES && offset; i++) {
+        uint32_t header = pci_read_capability_register(dev, offset);
+
+        if ((header & 0xFF) == id) {
+            return offset;
+        }
+
+        offset = (header >> 8) & 0xFC;
+    }
+
+    return 0;
+}
+
+/* physical address of a memory bar, 0 if the bar doesn't exist or is an i/o bar. 64 bit bars take the following bar too */
+uint64_t pci_bar_address(pci_general_dev_t *dev, uint8_t bar) {
+    if (bar > 5) {
+        return 0;
+    }
+
+    uint32_t low = pci_read_capability_register(dev, PCI_BAR0 + bar * 4);
+
+    if (low & 1) {
+        return 0;
+    }
+
+    uint64_t address = low & 0xFFFFFFF0;
+
+    //type 2: 64 bit bar
+    if (((low >> 1) & 3) == 2 && bar < 5) {
+        address |= (uint64_t) pci_read_capability_register(dev, PCI_BAR0 + (bar + 1) * 4) << 32;
+    }
+
+    return address;
+}
+
 /* configures the device, called by pci/pcie bus scan functions */
 bool pci_init_device(pci_general_dev_t *dev) {
     if (!dev) {
@@ -1,15 +1,20 @@
 #include <include/types.h>
 #include <io/include/pci_tree.h>
 #include <include/string.h>
-#include <mm/include/kmalloc.h>
+#include <mm/include/arena.h>
 #include <include/mem.h>
 #include <include/assert.h>
 #include <tty/include/tty.h>
 
 pci_tree_bus_t *pci_tree_root;
+arena_t pci_tree_arena; //the tree nodes live for the whole uptime, so they're allocated from an arena instead of the heap
 
 /* initializes the pci device tree by creating the first bus */
 bool init_pci_tree(void) {
+    if (!arena_init(&pci_tree_arena, PCI_TREE_ARENA_PAGES)) {
+        return false;
+    }
+
     if (!(pci_tree_root = pci_tree_create_bus(PCI_INITIAL_BUS))) {
         return false;
     }
@@ -21,7 +26,7 @@ bool init_pci_tree(void) {
 pci_tree_bus_t *pci_tree_create_bus(uint8_t id) {
     pci_tree_bus_t *node;
 
-    if (!(node = kmalloc(sizeof(pci_tree_bus_t)))) {
+    if (!(node = arena_alloc(&pci_tree_arena, sizeof(pci_tree_bus_t)))) {
         return null;
     }
 
@@ -64,7 +69,7 @@ pci_tree_bus_t *pci_tree_get_bus_by_id(uint8_t id) {
 pci_tree_device_t *pci_tree_create_device(pci_general_dev_t *dev, pci_tree_bus_t *bus) {
     pci_tree_device_t *node;
 
-    if (!(node = kmalloc(sizeof(pci_tree_device_t)))) {
+    if (!(node = arena_alloc(&pci_tree_arena, sizeof(pci_tree_device_t)))) {
         return null;
     }
 
@@ -107,7 +112,7 @@ bool pci_tree_install_bus(pci_tree_bus_t *primary, pci_tree_bus_t *secondary, pc
 
     pci_tree_bridge_t *_bridge;
 
-    if (!(_bridge = kmalloc(sizeof(pci_tree_bridge_t)))) {
+    if (!(_bridge = arena_alloc(&pci_tree_arena, sizeof(pci_tree_bridge_t)))) {
         return false;
     }
 
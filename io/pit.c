@@ -3,12 +3,14 @@
 #include <include/bcd.h>
 #include <io/include/port_io.h>
 #include <int/include/apic.h>
+#include <int/include/irq_domain.h>
 
 bool pit_ready = false;
+uint32_t pit_gsi;
 
 void init_pit() {
     //set pit redirection entry, initially masked
-    if (!apic_irq(PIT_IRQ, 0x17, fixed, physical, active_high, edge, true, 0)) {
+    if (!irq_setup_isa(PIT_IRQ, 0x17, true, &pit_gsi)) {
         return; //che fare?
     }
 
@@ -69,7 +71,7 @@ void pit_run() {
         return;
     }
 
-    apic_set_mask(PIT_IRQ, false);
+    irq_set_mask(pit_gsi, false);
 }
 
 //masks pit irq
@@ -78,5 +80,22 @@ void pit_stop() {
         return;
     }
 
-    apic_set_mask(PIT_IRQ, true);
-}
\ No newline at end of file
+    irq_set_mask(pit_gsi, true);
+}
+
+/*
+starts channel 2 counting down count ticks of PIT_FREQUENCY, with the speaker off. it doesn't use the irq: the output of the channel
+goes high at 0 and is read from the gate port by pit_oneshot_done().
+counting starts on the pit clock edge after the count is written, the window is exact within one tick (838 ns).
+*/
+void pit_oneshot_start(uint16_t count) {
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01); //gate high, speaker off
+    outb(PIT_MODE_COMMAND_REGISTER_PORT, PIT_COMM_BIN | PIT_COMM_INT | PIT_COMM_LOBYTE_HIBYTE | PIT_COMM_CHANNEL2);
+    outb(PIT_CHANNEL2_DATA_PORT, count & 0xFF);
+    outb(PIT_CHANNEL2_DATA_PORT, count >> 8);
+}
+
+//true once the count of pit_oneshot_start() has run out
+bool pit_oneshot_done() {
+    return (inb(PIT_GATE_PORT) & 0x20) != 0;
+}
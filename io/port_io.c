@@ -29,4 +29,13 @@ uint32_t inl(uint16_t port) {
 
 void outl(uint16_t port, uint32_t data) {
   asm volatile("out %%eax, %%dx" : : "a" (data), "d" (port));
-}
\ No newline at end of file
+}
+
+//reads count words from the port into buffer with a single rep insw
+void insw(uint16_t port, void *buffer, uint64_t count) {
+  asm volatile("rep insw" : "+D" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
+void outsw(uint16_t port, const void *buffer, uint64_t count) {
+  asm volatile("rep outsw" : "+S" (buffer), "+c" (count) : "d" (port) : "memory");
+}
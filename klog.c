@@ -0,0 +1,139 @@
+/*
+Binary kernel log.
+klog() stores the format string pointer, the raw arguments and the TSC in a record of the per-cpu ring of the calling cpu: the record is
+built in place, there is no formatting and no shared state, so it can be called from interrupt handlers.
+klog_flush() runs outside interrupt context, merges the rings of all the cpus in TSC order and formats the records into a sink
+(the console for dmesg, any other fmt_sink_t like a serial port). When a ring is full the new records are dropped and counted.
+*/
+
+//klog() is called by interrupt handlers, the record copies must not go through the SIMD registers
+#pragma GCC target("general-regs-only")
+
+#include <include/types.h>
+#include <include/klog.h>
+#include <include/percpu.h>
+#include <include/ring.h>
+#include <include/low_level.h>
+#include <tty/include/vsnprintf.h>
+#include <time/include/tsc.h>
+
+klog_cpu_t klog_cpus[MAX_CPUS];
+klog_record_t klog_buffers[MAX_CPUS][KLOG_RECORDS] __attribute__((aligned(64)));
+bool klog_ready = false;
+uint64_t klog_boot_tsc;
+
+//consumer state, protected by klog_flushing
+volatile bool klog_flushing = false;
+klog_record_t klog_next[MAX_CPUS]; //first record of every ring, already dequeued
+bool klog_next_valid[MAX_CPUS];
+
+//must be called after percpu_init(), klog() calls before it are dropped
+bool klog_init() {
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (!spsc_ring_init(&klog_cpus[i].ring, klog_buffers[i], sizeof(klog_record_t), KLOG_RECORDS)) {
+            return false;
+        }
+
+        klog_cpus[i].dropped = 0;
+        klog_cpus[i].reported = 0;
+        klog_next_valid[i] = false;
+    }
+
+    klog_boot_tsc = rdtsc();
+    klog_ready = true;
+    return true;
+}
+
+void klog_record(const char *fmt, uint32_t count, const uint64_t *args) {
+    if (!klog_ready) {
+        return;
+    }
+
+    //the ring of this cpu has a single producer as long as an interrupt can't log in the middle of a record
+    bool enabled = save_disable_int();
+    klog_cpu_t *log = &klog_cpus[this_cpu()->cpu_index];
+    klog_record_t *record = spsc_ring_reserve(&log->ring);
+
+    if (record) {
+        record->tsc = rdtsc();
+        record->fmt = fmt;
+
+        for (uint32_t i = 0; i < KLOG_MAX_ARGS; i++) {
+            record->args[i] = i < count ? args[i] : 0;
+        }
+
+        spsc_ring_commit(&log->ring);
+    } else {
+        log->dropped++;
+    }
+
+    restore_int(enabled);
+}
+
+/*
+Formats the records logged so far into sink, oldest first, and returns how many were flushed.
+Returns 0 without doing anything if another flush is running.
+*/
+uint32_t klog_flush(fmt_sink_t *sink) {
+    if (!klog_ready || __atomic_test_and_set(&klog_flushing, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    uint32_t flushed = 0;
+
+    while (true) {
+        uint32_t oldest = MAX_CPUS; //none
+
+        for (uint32_t i = 0; i < MAX_CPUS; i++) {
+            if (!klog_next_valid[i]) {
+                klog_next_valid[i] = spsc_ring_dequeue(&klog_cpus[i].ring, &klog_next[i]);
+            }
+
+            if (klog_next_valid[i] && (oldest == MAX_CPUS || klog_next[i].tsc < klog_next[oldest].tsc)) {
+                oldest = i;
+            }
+        }
+
+        if (oldest == MAX_CPUS) {
+            break;
+        }
+
+        klog_record_t *record = &klog_next[oldest];
+        uint64_t elapsed = record->tsc - klog_boot_tsc;
+
+        //seconds since klog_init() once the TSC is calibrated, cycles before
+        if (tsc_khz) {
+            uint64_t ns = tsc_to_ns(elapsed);
+            format(sink, "[%2u %7lu.%06lu] ", oldest, ns / 1000000000, ns / 1000 % 1000000);
+        } else {
+            format(sink, "[%2u %14lu] ", oldest, elapsed);
+        }
+
+        vformat_array(sink, record->fmt, record->args, KLOG_MAX_ARGS);
+        klog_next_valid[oldest] = false;
+        flushed++;
+    }
+
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        uint64_t dropped = __atomic_load_n(&klog_cpus[i].dropped, __ATOMIC_RELAXED);
+
+        if (dropped != klog_cpus[i].reported) {
+            format(sink, "[%2u] %lu records dropped\n", i, dropped - klog_cpus[i].reported);
+            klog_cpus[i].reported = dropped;
+        }
+    }
+
+    __atomic_clear(&klog_flushing, __ATOMIC_RELEASE);
+    return flushed;
+}
+
+//total number of records dropped since boot
+uint64_t klog_dropped() {
+    uint64_t dropped = 0;
+
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        dropped += __atomic_load_n(&klog_cpus[i].dropped, __ATOMIC_RELAXED);
+    }
+
+    return dropped;
+}
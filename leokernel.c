@@ -4,6 +4,9 @@
 #include <mm/include/segmentation.h>
 #include <mm/include/memory_manager.h>
 #include <int/include/int.h>
+#include <int/include/isr.h>
+#include <int/include/irqstat.h>
+#include <int/include/irq_balance.h>
 #include <tty/include/tty.h>
 #include <tty/include/def_colors.h>
 #include <mm/include/paging.h>
@@ -21,6 +24,19 @@
 #include <tty/include/term.h>
 //#include <drv/ide/include/ide_interface.h>
 #include <mm/include/kmalloc.h>
+#include <include/mem.h>
+#include <include/fpu.h>
+#include <include/cpu.h>
+#include <include/string.h>
+#include <crypto/include/hash.h>
+#include <include/percpu.h>
+#include <include/random.h>
+#include <include/klog.h>
+#include <time/include/tsc.h>
+#include <time/include/timer.h>
+#include <time/include/acpi_pm.h>
+#include <time/include/hpet.h>
+#include <time/include/clocksource.h>
 
 void kmain(struct leokernel_boot_params bootp) {
     //if the boot parameters are null, halt the cpu
@@ -28,6 +44,19 @@ void kmain(struct leokernel_boot_params bootp) {
         sys_hlt();
     }
 
+    /*
+    read the cpu features once, set up the per-cpu area of the boot cpu and the kernel log, enable SSE/AVX and the XSAVE state
+    management, select the memory, string and hash routines for this cpu and seed the random generator
+    */
+    cpu_features_init();
+    percpu_init(0);
+    klog_init();
+    fpu_init();
+    mem_init();
+    string_init();
+    crypto_init();
+    random_init();
+
     //we have to set tty_ready to false because for some reason it's not actually set to false
     extern bool tty_ready;
     tty_ready = false;
@@ -73,10 +102,27 @@ void kmain(struct leokernel_boot_params bootp) {
         fail("error setting up APIC");
     }
 
-    /* initialize system timers */
+    /*
+    initialize system timers: the counters register as clocksources and the timer devices as clockevents, the best of each is used.
+    the TSC is measured against the HPET, the pm timer or the PIT if cpuid doesn't tell its frequency.
+    */
     init_pit();
+    acpi_pm_init();
+    hpet_init();
+    tsc_init();
     apic_timer_init();
 
+    //timer wheel and hrtimers, on the best clockevent
+    if (!timer_init()) {
+        printf("timers not available\n");
+    }
+
+    clocksource_init();
+
+    //interrupt statistics
+    irqstat_init();
+    irq_balance_init();
+
     if (!init_pci()) {
         fail("error configuring PCI and PCIe");
     }
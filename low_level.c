@@ -7,6 +7,11 @@ inline void sys_hlt() {
   asm volatile("hlt");
 }
 
+//enables the interrupts and halts until the next one: sti takes effect after hlt, so an interrupt can't arrive in between and be missed
+void wait_for_int() {
+  asm volatile("sti; hlt" : : : "memory");
+}
+
 __attribute__((always_inline))
 inline void disable_int() {
   asm volatile("cli");
@@ -17,6 +22,45 @@ inline void enable_int() {
   asm volatile("sti");
 }
 
+uint64_t get_rflags() {
+  uint64_t rflags;
+  asm volatile("pushfq; pop %0" : "=r"(rflags));
+  return rflags;
+}
+
+//disables the interrupts and returns true if they were enabled, pass the result to restore_int()
+bool save_disable_int() {
+  bool enabled = get_rflags() >> 9 & 1;
+  disable_int();
+  return enabled;
+}
+
+void restore_int(bool enabled) {
+  if (enabled) {
+    enable_int();
+  }
+}
+
+uint64_t get_cr0() {
+  uint64_t cr0;
+  asm volatile("mov %%cr0, %0" : "=r"(cr0));
+  return cr0;
+}
+
+void set_cr0(uint64_t cr0) {
+  asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+uint64_t get_cr4() {
+  uint64_t cr4;
+  asm volatile("mov %%cr4, %0" : "=r"(cr4));
+  return cr4;
+}
+
+void set_cr4(uint64_t cr4) {
+  asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
 uint64_t get_cr3() {
   uint64_t cr3;
   asm volatile("mov %%cr3, %0" : "=r"(cr3));
@@ -30,13 +74,30 @@ uint64_t get_cr2() {
 }
 
 void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
-  asm volatile("mov %0, %%eax" : : "r"(leaf));
-  asm volatile("cpuid");
+  cpuid_count(leaf, 0, eax, ebx, ecx, edx);
+}
+
+//cpuid with a subleaf (ecx), the registers are read in the same asm statement so that the compiler can't clobber them in between
+void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+  uint32_t a, b, c, d;
+  asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(subleaf));
 
-  if (eax != null) {asm volatile("mov %%eax, %0" : "=r"(*eax));}
-  if (ebx != null) {asm volatile("mov %%ebx, %0" : "=r"(*ebx));}
-  if (ecx != null) {asm volatile("mov %%ecx, %0" : "=r"(*ecx));}
-  if (edx != null) {asm volatile("mov %%edx, %0" : "=r"(*edx));}
+  if (eax != null) {*eax = a;}
+  if (ebx != null) {*ebx = b;}
+  if (ecx != null) {*ecx = c;}
+  if (edx != null) {*edx = d;}
+}
+
+//reads an extended control register (CR4.OSXSAVE must be set)
+uint64_t xgetbv(uint32_t xcr) {
+  uint32_t lo, hi;
+  asm volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(xcr));
+  return (uint64_t) hi << 32 | lo;
+}
+
+//writes an extended control register
+void xsetbv(uint32_t xcr, uint64_t value) {
+  asm volatile("xsetbv" : : "c"(xcr), "a"((uint32_t) value), "d"((uint32_t)(value >> 32)));
 }
 
 void get_msr(uint32_t msr, uint32_t *lo, uint32_t *hi) {
@@ -45,4 +106,10 @@ void get_msr(uint32_t msr, uint32_t *lo, uint32_t *hi) {
  
 void set_msr(uint32_t msr, uint32_t lo, uint32_t hi) {
   asm volatile("wrmsr" : : "a"(lo), "d"(hi), "c"(msr));
-}
\ No newline at end of file
+}
+//reads the time stamp counter
+uint64_t rdtsc() {
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (uint64_t) hi << 32 | lo;
+}
@@ -1,5 +1,6 @@
 #include <include/math.h>
 #include <include/types.h>
+#include <include/random.h>
 
 double ceil(double n) {
     if (n == (int) n) {
@@ -75,12 +76,12 @@ double fmod(double a, double b) {
     return r;
 }
 
-static uint32_t next_rand = 1;
+//15 bits random number, kept for compatibility: it uses the per-cpu generator
 uint32_t rand(void) {
-    next_rand = next_rand * 1103515245 + 12345;
-    return (uint32_t) (next_rand / 65536) % 32768;
+    return get_random_u32() & 0x7FFF;
 }
 
+//the generator can't be reset to a known sequence, the seed is mixed into it
 void srand(uint32_t seed) {
-    next_rand = seed;
+    random_add_entropy(&seed, sizeof(seed));
 }
\ No newline at end of file
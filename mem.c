@@ -1,35 +1,170 @@
+/*
+Memory routines.
+memcpy, memset and memcpy_simd have more implementations, the best one for this cpu is selected once by mem_init() (using the cpu features)
+which patches their static call trampolines:
+- word loops: copy/set 8 bytes at a time, used until mem_init() is called and on cpus without ERMS (big copies go through memcpy_simd())
+- rep movsb/stosb: used for big sizes on cpus with ERMS (enhanced rep movsb/stosb), for every size on cpus with FSRM (fast short rep movsb)
+memcpy_simd() copies with SSE2 or AVX2 registers inside a kernel_fpu_begin()/kernel_fpu_end() section, so it can be called from any context.
+The compiler must not turn the loops in this file into calls to these same functions.
+*/
+
 #include <include/mem.h>
 #include <include/types.h>
+#include <include/low_level.h>
+#include <include/fpu.h>
+#include <include/cpu.h>
+#include <include/alternatives.h>
+
+#define MEM_NO_BUILTIN __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#define MEM_REP_THRESHOLD 256 //below this size the startup cost of rep movsb/stosb is higher than a word loop (without FSRM)
+#define MEM_SIMD_THRESHOLD 128
+#define MEM_SIMD_LARGE_THRESHOLD 2048 //without ERMS, copies this big are worth saving and restoring the SIMD state
+
+uint64_t memcpy_words(void *dst, void *src, uint64_t size);
+void memset_words(void *dst, uint64_t size, uint8_t value);
+uint64_t memcpy_simd_sse2(void *dst, void *src, uint64_t size);
+uint64_t memcpy_simd_avx2(void *dst, void *src, uint64_t size);
+
+//the implementations are selected by mem_init() patching these trampolines
+STATIC_CALL(memcpy, memcpy_words)
+STATIC_CALL(memset, memset_words)
+STATIC_CALL(memcpy_simd, memcpy_simd_sse2)
+
+MEM_NO_BUILTIN
+uint64_t memcpy_words(void *dst, void *src, uint64_t size) {
+    uint64_t i = 0;
 
-uint64_t memcpy(void *dst, void *src, uint64_t size) {
-    for (uint64_t i = 0; i < size; i++) {
-        *(char *)(dst + i) = *(char *)(src + i);
+    for (; i + 8 <= size; i += 8) {
+        *(uint64_t *)(dst + i) = *(uint64_t *)(src + i);
+    }
+
+    for (; i < size; i++) {
+        *(uint8_t *)(dst + i) = *(uint8_t *)(src + i);
     }
 
     return size;
 }
 
-uint64_t memmove(void *dst, void *src, uint64_t size) {
-    for (uint64_t i = 0; i < size; i++) {
-        *(char *)(dst + i) = *(char *)(src + i);
-        *(char *)(src + i) = 0x00;
+static inline void rep_movsb(void *dst, void *src, uint64_t size) {
+    asm volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(size) : : "memory");
+}
+
+static inline void rep_stosb(void *dst, uint8_t value, uint64_t size) {
+    asm volatile("rep stosb" : "+D"(dst), "+c"(size) : "a"(value) : "memory");
+}
+
+//rep movsb for big copies, word loop for the small ones
+uint64_t memcpy_erms(void *dst, void *src, uint64_t size) {
+    if (size < MEM_REP_THRESHOLD) {
+        return memcpy_words(dst, src, size);
     }
 
+    rep_movsb(dst, src, size);
     return size;
 }
 
-void memset(void *dst, uint64_t size, uint8_t value) {
-    for (uint64_t i = 0; i < size; i++) {
-        *((uint8_t *)(dst + i)) = value;
+//without ERMS the big copies use the SIMD registers
+uint64_t memcpy_large_simd(void *dst, void *src, uint64_t size) {
+    if (size < MEM_SIMD_LARGE_THRESHOLD) {
+        return memcpy_words(dst, src, size);
     }
+
+    return memcpy_simd(dst, src, size);
+}
+
+//with FSRM rep movsb is fast for short copies too
+uint64_t memcpy_fsrm(void *dst, void *src, uint64_t size) {
+    rep_movsb(dst, src, size);
+    return size;
+}
+
+MEM_NO_BUILTIN
+void memset_words(void *dst, uint64_t size, uint8_t value) {
+    uint64_t pattern = value * 0x0101010101010101;
+    uint64_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        *(uint64_t *)(dst + i) = pattern;
+    }
+
+    for (; i < size; i++) {
+        *(uint8_t *)(dst + i) = value;
+    }
+}
+
+void memset_erms(void *dst, uint64_t size, uint8_t value) {
+    if (size < MEM_REP_THRESHOLD) {
+        memset_words(dst, size, value);
+        return;
+    }
+
+    rep_stosb(dst, value, size);
+}
+
+void memset_fsrm(void *dst, uint64_t size, uint8_t value) {
+    rep_stosb(dst, value, size);
+}
+
+/* selects the memory routines for this cpu, must be called after cpu_features_init() and fpu_init() */
+void mem_init() {
+    if (cpu_has(CPU_FEATURE_FSRM)) {
+        static_call_update((void *) memcpy, (void *) memcpy_fsrm);
+        static_call_update((void *) memset, (void *) memset_fsrm);
+    } else if (cpu_has(CPU_FEATURE_ERMS)) {
+        static_call_update((void *) memcpy, (void *) memcpy_erms);
+        static_call_update((void *) memset, (void *) memset_erms);
+    } else {
+        static_call_update((void *) memcpy, (void *) memcpy_large_simd);
+    }
+
+    if (cpu_has(CPU_FEATURE_AVX2) && fpu_avx_enabled()) {
+        static_call_update((void *) memcpy_simd, (void *) memcpy_simd_avx2);
+    }
+}
+
+/*
+Copies size bytes from src to dst, the two buffers can overlap.
+If dst is after src (and they overlap) the copy goes backwards so that src is not overwritten before it's read.
+*/
+MEM_NO_BUILTIN
+uint64_t memmove(void *dst, void *src, uint64_t size) {
+    if (dst == src || size == 0) {
+        return size;
+    }
+
+    if (dst < src || dst >= src + size) {
+        return memcpy(dst, src, size);
+    }
+
+    uint64_t i = size;
+
+    for (; i >= 8; i -= 8) {
+        *(uint64_t *)(dst + i - 8) = *(uint64_t *)(src + i - 8);
+    }
+
+    for (; i > 0; i--) {
+        *(uint8_t *)(dst + i - 1) = *(uint8_t *)(src + i - 1);
+    }
+
+    return size;
 }
 
 void memclear(void *dst, uint64_t size) {
     memset(dst, size, 0);
 }
 
+//returns true if the two buffers are equal, compares 8 bytes at a time
+MEM_NO_BUILTIN
 bool memcmp(void *buffer1, void *buffer2, uint64_t length) {
-    for (uint64_t i = 0; i < length; i++) {
+    uint64_t i = 0;
+
+    for (; i + 8 <= length; i += 8) {
+        if (*(uint64_t *)(buffer1 + i) != *(uint64_t *)(buffer2 + i)) {
+            return false;
+        }
+    }
+
+    for (; i < length; i++) {
         if (*(uint8_t *)(buffer1 + i) != *(uint8_t *)(buffer2 + i)) {
             return false;
         }
@@ -38,6 +173,56 @@ bool memcmp(void *buffer1, void *buffer2, uint64_t length) {
     return true;
 }
 
+/*
+Copies size bytes with SSE2 registers (32 bytes per iteration), the buffers must not overlap.
+The SIMD state of the caller is saved and restored with kernel_fpu_begin()/kernel_fpu_end(), if it can't be saved the copy uses the word loop.
+*/
+uint64_t memcpy_simd_sse2(void *dst, void *src, uint64_t size) {
+    if (size < MEM_SIMD_THRESHOLD || !kernel_fpu_begin()) {
+        return memcpy_words(dst, src, size);
+    }
+
+    uint64_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        asm volatile(
+            "movdqu (%0), %%xmm0\n"
+            "movdqu 16(%0), %%xmm1\n"
+            "movdqu %%xmm0, (%1)\n"
+            "movdqu %%xmm1, 16(%1)\n"
+            : : "r"(src + i), "r"(dst + i) : "xmm0", "xmm1", "memory"
+        );
+    }
+
+    kernel_fpu_end();
+    memcpy_words(dst + i, src + i, size - i);
+    return size;
+}
+
+//same as memcpy_simd_sse2() with AVX2 registers (64 bytes per iteration)
+uint64_t memcpy_simd_avx2(void *dst, void *src, uint64_t size) {
+    if (size < MEM_SIMD_THRESHOLD || !kernel_fpu_begin()) {
+        return memcpy_words(dst, src, size);
+    }
+
+    uint64_t i = 0;
+
+    for (; i + 64 <= size; i += 64) {
+        asm volatile(
+            "vmovdqu (%0), %%ymm0\n"
+            "vmovdqu 32(%0), %%ymm1\n"
+            "vmovdqu %%ymm0, (%1)\n"
+            "vmovdqu %%ymm1, 32(%1)\n"
+            : : "r"(src + i), "r"(dst + i) : "xmm0", "xmm1", "memory"
+        );
+    }
+
+    asm volatile("vzeroupper" : : : "memory");
+    kernel_fpu_end();
+    memcpy_words(dst + i, src + i, size - i);
+    return size;
+}
+
 void reverse_endianess(void *ptr, uint64_t length) {
     if (length < 2) {
         return;
@@ -50,4 +235,4 @@ void reverse_endianess(void *ptr, uint64_t length) {
         *(uint8_t *)(ptr + i) = *(uint8_t *)(ptr + (length - 1) - i);
         *(uint8_t *)(ptr + (length - 1) - i) = tmp;
     }
-}
\ No newline at end of file
+}
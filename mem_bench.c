@@ -0,0 +1,101 @@
+/*
+Size sweep benchmark of the memory routines against the byte loops they replaced.
+For every size it prints the average number of cycles of a call, old version first.
+*/
+
+#include <include/types.h>
+#include <include/mem.h>
+#include <include/low_level.h>
+#include <tty/include/tty.h>
+
+#define MEM_BENCH_MAX_SIZE 65536
+#define MEM_BENCH_BYTES (1 << 22) //bytes processed for every size, so that small sizes run more iterations
+#define MEM_BENCH_LEGACY __attribute__((noinline, optimize("no-tree-vectorize", "no-tree-loop-distribute-patterns")))
+
+uint8_t mem_bench_src[MEM_BENCH_MAX_SIZE + 64] __attribute__((aligned(64)));
+uint8_t mem_bench_dst[MEM_BENCH_MAX_SIZE + 64] __attribute__((aligned(64)));
+volatile uint64_t mem_bench_sink; //keeps the compiler from dropping the calls whose result is not used
+
+MEM_BENCH_LEGACY
+static uint64_t legacy_memcpy(void *dst, void *src, uint64_t size) {
+    for (uint64_t i = 0; i < size; i++) {
+        *(char *)(dst + i) = *(char *)(src + i);
+    }
+
+    return size;
+}
+
+MEM_BENCH_LEGACY
+static void legacy_memset(void *dst, uint64_t size, uint8_t value) {
+    for (uint64_t i = 0; i < size; i++) {
+        *((uint8_t *)(dst + i)) = value;
+    }
+}
+
+MEM_BENCH_LEGACY
+static bool legacy_memcmp(void *buffer1, void *buffer2, uint64_t length) {
+    for (uint64_t i = 0; i < length; i++) {
+        if (*(uint8_t *)(buffer1 + i) != *(uint8_t *)(buffer2 + i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+typedef enum {
+    bench_memcpy,
+    bench_legacy_memcpy,
+    bench_memcpy_simd,
+    bench_memmove,
+    bench_memset,
+    bench_legacy_memset,
+    bench_memcmp,
+    bench_legacy_memcmp
+} mem_bench_op_t;
+
+//returns the average cycles of a call of op on size bytes
+static uint64_t mem_bench_run(mem_bench_op_t op, uint64_t size, uint32_t misalign) {
+    uint64_t iterations = MEM_BENCH_BYTES / size;
+    void *dst = mem_bench_dst + misalign;
+    void *src = mem_bench_src;
+    uint64_t start = rdtsc();
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        switch (op) {
+            case bench_memcpy: memcpy(dst, src, size); break;
+            case bench_legacy_memcpy: legacy_memcpy(dst, src, size); break;
+            case bench_memcpy_simd: memcpy_simd(dst, src, size); break;
+            case bench_memmove: memmove(src + 1, src, size - 1); break; //overlapping, backward copy
+            case bench_memset: memset(dst, size, (uint8_t) i); break;
+            case bench_legacy_memset: legacy_memset(dst, size, (uint8_t) i); break;
+            case bench_memcmp: mem_bench_sink += memcmp(dst, src, size); break;
+            case bench_legacy_memcmp: mem_bench_sink += legacy_memcmp(dst, src, size); break;
+        }
+    }
+
+    return (rdtsc() - start) / iterations;
+}
+
+void mem_bench() {
+    printf("size      memcpy old/new/simd    memmove  memset old/new     memcmp old/new\n");
+
+    for (uint64_t size = 8; size <= MEM_BENCH_MAX_SIZE; size *= 4) {
+        memcpy(mem_bench_dst, mem_bench_src, size); //equal buffers, so memcmp compares everything
+        uint64_t cpy_old = mem_bench_run(bench_legacy_memcpy, size, 0);
+        uint64_t cpy_new = mem_bench_run(bench_memcpy, size, 0);
+        uint64_t cpy_simd = mem_bench_run(bench_memcpy_simd, size, 0);
+        uint64_t move = mem_bench_run(bench_memmove, size, 0);
+        uint64_t set_old = mem_bench_run(bench_legacy_memset, size, 0);
+        uint64_t set_new = mem_bench_run(bench_memset, size, 0);
+        memcpy(mem_bench_dst, mem_bench_src, size);
+        uint64_t cmp_old = mem_bench_run(bench_legacy_memcmp, size, 0);
+        uint64_t cmp_new = mem_bench_run(bench_memcmp, size, 0);
+        printf("%6lu    %8lu %6lu %6lu %8lu  %8lu %6lu   %8lu %6lu\n", size, cpy_old, cpy_new, cpy_simd, move, set_old, set_new, cmp_old, cmp_new);
+    }
+
+    //misaligned destination
+    uint64_t cpy_old = mem_bench_run(bench_legacy_memcpy, 4096, 3);
+    uint64_t cpy_new = mem_bench_run(bench_memcpy, 4096, 3);
+    printf("4096 misaligned by 3: memcpy %lu -> %lu cycles\n", cpy_old, cpy_new);
+}
@@ -0,0 +1,128 @@
+/*
+Region (arena) allocator.
+An arena hands out memory by bumping a pointer inside a block of pages obtained with kalloc_page(), there's no per-object metadata and
+the objects can't be freed one by one: everything allocated from an arena is released at once with arena_reset() or arena_destroy().
+This is meant for subsystems that create a lot of small objects sharing the same lifetime (e.g. the pci tree nodes that live for the whole
+uptime), so that they don't waste kernel heap descriptors.
+When the current block is full a new one is allocated and put at the head of the block list, the old blocks are kept until the arena is
+reset or destroyed.
+*/
+
+#include <include/types.h>
+#include <mm/include/arena.h>
+#include <mm/include/memory_manager.h>
+#include <include/mem.h>
+
+/* initializes an arena and allocates its first block (block_pages pages) */
+bool arena_init(arena_t *arena, uint32_t block_pages) {
+    if (!arena) {
+        return false;
+    }
+
+    arena->blocks = null;
+    arena->offset = 0;
+    arena->block_pages = block_pages < ARENA_MIN_BLOCK_PAGES ? ARENA_MIN_BLOCK_PAGES : block_pages;
+    arena->allocated = 0;
+
+    return arena_grow(arena, 0);
+}
+
+/*
+Allocates a new block able to contain at least min_size bytes (plus the block header) and makes it the current block.
+The remaining space in the previous block is wasted.
+*/
+bool arena_grow(arena_t *arena, uint64_t min_size) {
+    uint64_t needed = min_size + sizeof(arena_block_t);
+    uint32_t pages = arena->block_pages;
+
+    if (needed > (uint64_t) pages * PAGE_SIZE) {
+        pages = needed / PAGE_SIZE + (needed % PAGE_SIZE != 0 ? 1 : 0);
+    }
+
+    arena_block_t *block = (arena_block_t *) kalloc_page(pages);
+
+    if (!block) {
+        return false;
+    }
+
+    block->next = arena->blocks;
+    block->pages = pages;
+    arena->blocks = block;
+    arena->offset = sizeof(arena_block_t);
+    return true;
+}
+
+/* allocates size bytes aligned to ARENA_DEFAULT_ALIGN */
+void *arena_alloc(arena_t *arena, uint64_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_DEFAULT_ALIGN);
+}
+
+/*
+Allocates size bytes aligned to align (must be a power of 2) from the arena.
+Returns null if size is 0, if the arena is not initialized or if a new block can't be allocated.
+*/
+void *arena_alloc_aligned(arena_t *arena, uint64_t size, uint64_t align) {
+    if (!arena || !arena->blocks || size == 0 || align == 0 || (align & (align - 1)) != 0) {
+        return null;
+    }
+
+    uint64_t base = (uint64_t) arena->blocks;
+    uint64_t start = (base + arena->offset + align - 1) & ~(align - 1);
+
+    //if the object doesn't fit in the current block, grow the arena (with room for the alignment padding)
+    if (start + size > base + (uint64_t) arena->blocks->pages * PAGE_SIZE) {
+        if (!arena_grow(arena, size + align)) {
+            return null;
+        }
+
+        base = (uint64_t) arena->blocks;
+        start = (base + arena->offset + align - 1) & ~(align - 1);
+    }
+
+    arena->offset = start + size - base;
+    arena->allocated += size;
+    return (void *) start;
+}
+
+/*
+Releases every object allocated from the arena.
+The first block allocated by arena_init() is kept (and cleared) so that the arena can be reused without calling the page allocator again,
+the other blocks are given back to the system.
+*/
+void arena_reset(arena_t *arena) {
+    if (!arena || !arena->blocks) {
+        return;
+    }
+
+    arena_block_t *block = arena->blocks;
+
+    while(block->next) {
+        arena_block_t *next = block->next;
+        kfree_page((void *) block);
+        block = next;
+    }
+
+    memclear((void *) block + sizeof(arena_block_t), (uint64_t) block->pages * PAGE_SIZE - sizeof(arena_block_t));
+    arena->blocks = block;
+    arena->offset = sizeof(arena_block_t);
+    arena->allocated = 0;
+}
+
+/* releases every object and every block of the arena, the arena must be initialized again before being used */
+void arena_destroy(arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+
+    arena_block_t *block = arena->blocks;
+
+    while(block) {
+        arena_block_t *next = block->next;
+        kfree_page((void *) block);
+        block = next;
+    }
+
+    arena->blocks = null;
+    arena->offset = 0;
+    arena->allocated = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <include/types.h>
+#define ARENA_DEFAULT_ALIGN 8
+#define ARENA_MIN_BLOCK_PAGES 1
+
+/*
+header of a block of pages owned by an arena, it's stored at the beginning of the block itself.
+the blocks are chained together so that the arena can grow without moving the objects already allocated.
+*/
+typedef struct arena_block {
+    struct arena_block *next; //next (older) block
+    uint32_t pages;           //size of this block in pages
+    uint32_t pad;
+} arena_block_t;
+
+typedef struct {
+    arena_block_t *blocks;    //list of blocks, the first one is the block we're currently allocating from
+    uint64_t offset;          //offset of the first free byte in the current block
+    uint32_t block_pages;     //number of pages to request every time the arena grows
+    uint64_t allocated;       //bytes handed out since the last reset
+} arena_t;
+
+bool arena_init(arena_t *arena, uint32_t block_pages);
+void *arena_alloc(arena_t *arena, uint64_t size);
+void *arena_alloc_aligned(arena_t *arena, uint64_t size, uint64_t align);
+void arena_reset(arena_t *arena);
+void arena_destroy(arena_t *arena);
+bool arena_grow(arena_t *arena, uint64_t min_size);
@@ -1,14 +1,29 @@
 #pragma once
 #include <include/types.h>
-#define OBJECT_POOL_MAX_POOLS 32
+#define OBJECT_POOL_STATIC_POOLS 32 //descriptors available before the registry has to allocate memory
+#define OBJECT_POOL_REGISTRY_CHUNKS 64 //max number of pages of descriptors the registry can allocate
+#define OBJ_POOL_MAX_CHUNKS (PAGE_SIZE / sizeof(void *)) //a growable pool chunk directory is one page
 #define MMAP_POOL_MEMORY_SIZE PAGE_SIZE
-typedef uint8_t pool_t;
+#define OBJ_POOL_NO_SLOT 0xFFFFFFFF //end of a slab free list
+#define OBJ_HANDLE_NULL 0
+#define OBJ_HANDLE(index, gen) ((obj_handle_t)(gen) << 32 | (uint32_t)(index))
+#define OBJ_HANDLE_INDEX(handle) ((uint32_t)((handle) & 0xFFFFFFFF))
+#define OBJ_HANDLE_GEN(handle) ((uint32_t)((handle) >> 32))
+typedef uint32_t pool_t;
+
+/*
+handle to an object allocated from a slab pool: the low 32 bits are the slot index, the high 32 bits are the generation of the slot
+at the moment of the allocation. the generation of a slot is odd while the slot is allocated and even while it's free, so a handle
+that refers to an object that has been freed (and maybe reallocated) is detected as stale.
+*/
+typedef uint64_t obj_handle_t;
 
 //type of pool (aka how the pool is managed)
 typedef enum {
-    manual, //the client use it's own index to access the pool
+    manual, //the client use it's own index to access the pool, or appends and removes objects with obj_pool_push() and obj_pool_remove()
     stack,  //the client uses obj_pool_get() and obj_pool_put() to get and insert an object into the pool
-    queue   //same as stack
+    queue,  //same as stack, the objects are kept in a ring buffer
+    slab    //the client allocates and frees objects with obj_pool_alloc() and obj_pool_free() and references them by handle
 } object_pool_type;
 
 typedef struct {
@@ -16,13 +31,32 @@ typedef struct {
     uint32_t obj_size; //size of the object
     uint32_t pool_size; //size of the pool in objects
     pool_t id;
-    uint32_t top_index, bottom_index;
     object_pool_type type;
+    uint32_t count; //manual: index of the last used object + 1, stack and queue: number of objects, slab: number of allocated objects
+    uint32_t head; //queue: index of the first object of the ring buffer
+    uint32_t free_head; //slab: index of the first free slot, every free slot stores the index of the next one in its first 4 bytes
+    uint32_t *generations; //slab: generation of every slot (fixed pools only, growable pools keep them at the end of every chunk)
+    void **chunks; //growable pools: directory of the chunks, null for fixed pools
+    uint32_t chunks_count; //growable pools: number of allocated chunks
+    uint32_t chunk_shift; //growable pools: every chunk contains (1 << chunk_shift) objects
+    uint32_t chunk_pages; //growable pools: size of a chunk in pages
+    uint32_t max_size; //growable pools: max size of the pool in objects
 } object_pool_descriptor_t;
 
 bool obj_alloc_init(pool_t *id_ptr);
 void init_first_pool(void *base);
 bool create_obj_pool(pool_t *id_ptr, uint32_t obj_size, uint32_t pool_size, object_pool_type type);
+bool create_growable_obj_pool(pool_t *id_ptr, uint32_t obj_size, uint32_t max_size, object_pool_type type);
+bool obj_pool_destroy(pool_t id);
 bool obj_pool_put(pool_t id, void *obj, uint32_t index);
 bool obj_pool_get(pool_t id, void **buffer, uint32_t index);
-bool obj_pool_pack(pool_t id);
\ No newline at end of file
+bool obj_pool_push(pool_t id, void *obj, uint32_t *index);
+bool obj_pool_remove(pool_t id, uint32_t index);
+bool obj_pool_truncate(pool_t id, uint32_t count);
+uint32_t obj_pool_count(pool_t id);
+bool obj_pool_alloc(pool_t id, obj_handle_t *handle, void **obj);
+bool obj_pool_free(pool_t id, obj_handle_t handle);
+bool obj_pool_lookup(pool_t id, obj_handle_t handle, void **obj);
+bool obj_pool_flush(pool_t id);
+bool obj_pool_change_type(pool_t id, object_pool_type new_type);
+bool obj_pool_pack(pool_t id);
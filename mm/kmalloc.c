@@ -8,7 +8,6 @@ void *__kheap = null; //base address of kernel's heap
 uint64_t __kheap_final_size; //number of pages that the system could allocate for the heap
 bool __kheap_ready = false;
 pool_t __kheap_map_pool_id; //pool id of the descriptors
-uint32_t __kheap_map_pool_ind; //index of the last descriptor in the pool + 1
 uint8_t __kheap_ops; //number of operations on the heap's descriptors
 
 /*
@@ -39,12 +38,11 @@ bool init_kmalloc(void) {
     __kheap_init_descriptor(&d, null, __kheap_final_size * PAGE_SIZE, __KHEAP_DESCR_FLAGS_FREE);
 
     //tries to add the first descriptor, if the operation fails, free the heap and return false
-    if (!obj_pool_put(__kheap_map_pool_id, (void *) &d, 0)) {
+    if (!obj_pool_push(__kheap_map_pool_id, (void *) &d, null)) {
         kfree_page(__kheap);
         return false;
     }
 
-    __kheap_map_pool_ind = 1;
     __kheap_ops = 0;
     __kheap_ready = true;
 }
@@ -65,11 +63,11 @@ The allocation fails if:
 */
 void *kmalloc(uint64_t size) {
     if (size == 0 || size >= __kheap_final_size * PAGE_SIZE || !__kheap_ready) {return null;}
-    if (__kheap_map_pool_ind == __KHEAP_MAX_DESCRIPTORS) {return null;} //if the pool is full, return null
+    if (obj_pool_count(__kheap_map_pool_id) == __KHEAP_MAX_DESCRIPTORS) {return null;} //if the pool is full, return null
     bool retried = false;
 
     retry:
-    for (uint32_t i = 0; i < __kheap_map_pool_ind; i++) {
+    for (uint32_t i = 0; i < obj_pool_count(__kheap_map_pool_id); i++) {
         __kheap_descriptor_t *entry = null;
         if (!obj_pool_get(__kheap_map_pool_id, (void **) &entry, i)) {return null;}
         if (!__KHEAP_DESCR_IS_FREE(entry->flags) || entry->size < size) {continue;} //if this descriptor is too small, skip it
@@ -77,19 +75,14 @@ void *kmalloc(uint64_t size) {
         //create a new descriptor for the buffer and add it to the pool
         __kheap_descriptor_t new_entry;
         __kheap_init_descriptor(&new_entry, entry->base, size, __KHEAP_DESCR_FLAG_NULL);
-        if (!obj_pool_put(__kheap_map_pool_id, (void *) &new_entry, __kheap_map_pool_ind)) {return null;}
-        __kheap_map_pool_ind++;
+        if (!obj_pool_push(__kheap_map_pool_id, (void *) &new_entry, null)) {return null;}
 
         //edit the selected descriptor
         entry->size -= size;
         entry->base += size;
 
         //if this descriptor was the exact same size as required, delete it from the pool
-        if (entry->size == 0) {
-            memclear(entry, sizeof(__kheap_descriptor_t));
-            if (!obj_pool_pack(__kheap_map_pool_id)) {return null;}
-            __kheap_map_pool_ind--;
-        }
+        if (entry->size == 0 && !obj_pool_remove(__kheap_map_pool_id, i)) {return null;}
 
         if (++__kheap_ops >= __KHEAP_NUM_OPS_BEFORE_COMPRESSION) {__kheap_compress_map();}
         return (void *)((uint64_t) __kheap + (uint64_t) new_entry.base);
@@ -112,7 +105,7 @@ void *krealloc(void *base, uint64_t new_size) {
         return null;
     }
 
-    for (uint32_t i = 0; i < __kheap_map_pool_ind; i++) {
+    for (uint32_t i = 0; i < obj_pool_count(__kheap_map_pool_id); i++) {
         __kheap_descriptor_t *entry = null;
         if (!obj_pool_get(__kheap_map_pool_id, (void **) &entry, i)) {return null;}
         if (base < __kheap + (uint64_t) entry->base || base >= __kheap + (uint64_t) entry->base + entry->size) {continue;}
@@ -135,7 +128,7 @@ Free a buffer previously allocated with kmalloc().
 void kfree(void *base) {
     if (base < __kheap || base >= __kheap + __kheap_final_size * PAGE_SIZE || !__kheap_ready) {return;}
 
-    for (uint32_t i = 0; i < __kheap_map_pool_ind; i++) {
+    for (uint32_t i = 0; i < obj_pool_count(__kheap_map_pool_id); i++) {
         __kheap_descriptor_t *entry = null;
         if (!obj_pool_get(__kheap_map_pool_id, (void **) &entry, i)) {return;}
         if (base < __kheap + (uint64_t) entry->base || base >= __kheap + (uint64_t) entry->base + entry->size) {continue;}
@@ -157,14 +150,15 @@ This function is called automatically when the number of operations on the map i
 and more descriptors could describe different parts of the same free memory area. Those descriptors can be merged into one.
 */
 void __kheap_compress_map(void) {
-    if (__kheap_map_pool_ind < 2 || !__kheap_ready) {return;}
+    uint32_t count = obj_pool_count(__kheap_map_pool_id);
+    if (count < 2 || !__kheap_ready) {return;}
 
-    for (uint32_t i = 0; i < __kheap_map_pool_ind - 1; i++) {
+    for (uint32_t i = 0; i < count; i++) {
         __kheap_descriptor_t *entry, *selected;
         if (!obj_pool_get(__kheap_map_pool_id, (void **) &entry, i)) {return;}
         selected = entry;
 
-        for (uint32_t j = i + 1; j < __kheap_map_pool_ind; j++) {
+        for (uint32_t j = i + 1; j < count; j++) {
             __kheap_descriptor_t *candidate;
             if (!obj_pool_get(__kheap_map_pool_id, (void **) &candidate, j)) {return;}
 
@@ -177,17 +171,19 @@ void __kheap_compress_map(void) {
         if (selected != entry) {
             __kheap_descriptor_t tmp;
             memcpy((void *) &tmp, (void *) entry, sizeof(__kheap_descriptor_t));
-            memmove((void *) entry, (void *) selected, sizeof(__kheap_descriptor_t));
-            memmove((void *) selected, (void *) &tmp, sizeof(__kheap_descriptor_t));
+            memcpy((void *) entry, (void *) selected, sizeof(__kheap_descriptor_t));
+            memcpy((void *) selected, (void *) &tmp, sizeof(__kheap_descriptor_t));
         }
 
-        //is the selected descriptor can be merged with the previous one merge them and resize the memory map
-        if (i > 0 && (entry - 1)->base + (entry - 1)->size == selected->base && __KHEAP_DESCR_IS_FREE(selected->flags) && __KHEAP_DESCR_IS_FREE((entry - 1)->flags)) {
-            (entry - 1)->size += selected->size;
-            memclear(entry, sizeof(__kheap_descriptor_t));
-            memmove((void *) entry, (void *)(entry + 1), (__kheap_map_pool_ind - i - 1) * sizeof(__kheap_descriptor_t));
+        /*
+        if this descriptor can be merged with the previous one merge them and remove it from the pool.
+        the removal moves the last descriptor in this position, since the descriptors after i aren't ordered yet the selection goes on the same way.
+        */
+        if (i > 0 && (entry - 1)->base + (entry - 1)->size == entry->base && __KHEAP_DESCR_IS_FREE(entry->flags) && __KHEAP_DESCR_IS_FREE((entry - 1)->flags)) {
+            (entry - 1)->size += entry->size;
+            if (!obj_pool_remove(__kheap_map_pool_id, i)) {return;}
+            count--;
             i--;
-            __kheap_map_pool_ind--;
         }
     }
     
@@ -9,8 +9,7 @@
 
 uint64_t memory_length = 0; //total quantity of physical memory
 uint64_t mmap_size = 0;
-uint64_t mmap_last_ind = 0;
-uint8_t mmap_pool_id; //pool id of the memory map (set later)
+pool_t mmap_pool_id; //pool id of the memory map (set later)
 bool mman_ready = false;
 
 bool init_mm(struct leokernel_boot_params bootp) {
@@ -19,7 +18,8 @@ bool init_mm(struct leokernel_boot_params bootp) {
     mmap_pool_id = 0;
     memory_length = 0;
     mmap_pool_id = 0;
-    mmap_last_ind = 0;
+
+    uint64_t map_entries = 0;
 
     //use the memory map to count how much memory is available
     for (uint64_t i = 0; i < bootp.map_size; i++) {
@@ -30,7 +30,7 @@ bool init_mm(struct leokernel_boot_params bootp) {
         }
 
         memory_length += entry->pages * PAGE_SIZE;
-        mmap_last_ind++;
+        map_entries++;
     }
 
     //init physical frame allocator
@@ -44,9 +44,9 @@ bool init_mm(struct leokernel_boot_params bootp) {
     }
 
     //transfer the memory map into the pool
-    for (uint64_t i = 0; i < mmap_last_ind; i++) {
+    for (uint64_t i = 0; i < map_entries; i++) {
         leokernel_memory_descriptor_t *entry = bootp.map + i;
-        obj_pool_put(mmap_pool_id, (void *) entry, i);
+        obj_pool_push(mmap_pool_id, (void *) entry, null);
     }
 
     //clear the memory that was previously used to store the memory map
@@ -105,8 +105,7 @@ void *kalloc_page(uint32_t n) {
     while(m < n) {
         if (m > 0 && frames[m - 1] + PAGE_SIZE != frames[m]) {
             new_entry.flags |= LEOKERNEL_MEMORY_MAP_HAS_NEXT;
-            if (!obj_pool_put(mmap_pool_id, (void *) &new_entry, mmap_last_ind)) {kfree_frames_array(n, frames);}
-            mmap_last_ind++;
+            if (!obj_pool_push(mmap_pool_id, (void *) &new_entry, null)) {kfree_frames_array(n, frames);}
             init_descriptor(&new_entry, (void *) new_entry.virtual_address + m * PAGE_SIZE, frames[m], 0, LEOKERNEL_MEMORY_MAP_VALID, kernel_reserved);
         }
 
@@ -117,26 +116,19 @@ void *kalloc_page(uint32_t n) {
         m++;
 
         if (m == n) {
-            if (!obj_pool_put(mmap_pool_id, (void *) &new_entry, mmap_last_ind)) {kfree_frames_array(n, frames);}
-            mmap_last_ind++;
+            if (!obj_pool_push(mmap_pool_id, (void *) &new_entry, null)) {kfree_frames_array(n, frames);}
         }
     }
 
-    //if this descriptor is now empty, delete it from the map
+    //if this descriptor is now empty, delete it from the map (the last descriptor takes its place, the map is ordered right after)
     if (entry->pages == 0) {
-        if (descr_ind == mmap_size - 1) { //if it was the last, jut remove it
-            memclear(entry, sizeof(leokernel_memory_descriptor_t));
-        } else { //otherwise move every descriptor after this a position back
-            memmove((void *) entry, (void *)(entry + 1), (mmap_last_ind - descr_ind - 1) * sizeof(leokernel_memory_descriptor_t));
-        }
-
-        mmap_last_ind--;
+        obj_pool_remove(mmap_pool_id, (uint32_t) descr_ind);
     }
 
     //get the pointer of the first entry of the map to operate on them directly
     leokernel_memory_descriptor_t *first_entry;
     obj_pool_get(mmap_pool_id, (void *) &first_entry, 0);
-    order_map(first_entry, mmap_last_ind);
+    order_map(first_entry, obj_pool_count(mmap_pool_id));
     return base_address;
 }
 
@@ -196,7 +188,7 @@ bool kfree_page(void *base) {
 
     leokernel_memory_descriptor_t *first_entry;
     obj_pool_get(mmap_pool_id, (void **) &first_entry, 0);
-    compress_map(first_entry, mmap_last_ind);
+    compress_map(first_entry, obj_pool_count(mmap_pool_id));
 
     return true;
 }
@@ -268,22 +260,19 @@ bool kmap_page(void *virtual, void *physical) {
             init_descriptor(&after, (void *)(page_address + PAGE_SIZE), (void *) null, pages_after, referenced_entry->flags, referenced_entry->type);
 
             if (page_address > referenced_entry->virtual_address) {
-                if (!obj_pool_put(mmap_pool_id, (void *) &before, mmap_last_ind)) {return false;}
-                mmap_last_ind++;
+                if (!obj_pool_push(mmap_pool_id, (void *) &before, null)) {return false;}
             }
 
             if (page_address < referenced_entry->virtual_address + referenced_entry->pages * PAGE_SIZE) {
-                if (!obj_pool_put(mmap_pool_id, (void *) &after, mmap_last_ind)) {return false;}
-                mmap_last_ind++;
+                if (!obj_pool_push(mmap_pool_id, (void *) &after, null)) {return false;}
             }
         }
     }
     
-    if (!obj_pool_put(mmap_pool_id, (void *) &new_entry, mmap_last_ind)) {return false;}
-    mmap_last_ind++;
+    if (!obj_pool_push(mmap_pool_id, (void *) &new_entry, null)) {return false;}
     leokernel_memory_descriptor_t *first_entry;
     obj_pool_get(mmap_pool_id, (void **) &first_entry, 0);
-    order_map(first_entry, mmap_last_ind);
+    order_map(first_entry, obj_pool_count(mmap_pool_id));
     return map_page((void *) page_address, (void *) frame_address);
 }
 
@@ -357,7 +346,8 @@ void compress_map(leokernel_memory_descriptor_t *map, uint64_t size) {
 			entry->pages = pages;
             memclear((void *)(leokernel_memory_descriptor_t *)(entry + 1), n * sizeof(leokernel_memory_descriptor_t));
 			memmove((void *)(leokernel_memory_descriptor_t *)(entry + 1), (void *)(leokernel_memory_descriptor_t *)(entry + n + 1), (size - n - i - 1) * sizeof(leokernel_memory_descriptor_t));
-            mmap_last_ind -= n;
+            size -= n;
+            obj_pool_truncate(mmap_pool_id, size);
         }
 	}
 }
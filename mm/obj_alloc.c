@@ -1,5 +1,19 @@
 /*
 Object pool allocator.
+A pool is a block of memory divided in fixed size objects, every pool operation runs in constant time (except for flushing and packing).
+There are four types of pool:
+- manual: the pool is an array, the client can access any object by index. The pool keeps track of the number of used objects so that
+          the client can append objects with obj_pool_push() and remove them with obj_pool_remove() (the last object takes the place of the
+          removed one) without keeping its own index.
+- stack:  objects are pushed and popped with obj_pool_put() and obj_pool_get().
+- queue:  same as stack but first in first out, the objects are stored in a ring buffer.
+- slab:   objects are allocated and freed with obj_pool_alloc() and obj_pool_free() and referenced by handle. The free slots are chained in a
+          free list embedded in the slots themselves, and each slot has a generation counter so that stale handles are rejected.
+
+A pool is either fixed (one contiguous allocation made at creation, the clients can do pointer arithmetic on the objects) or growable
+(created with create_growable_obj_pool(), starts with one chunk and allocates a new chunk every time it's full, up to its max size).
+Every chunk of a growable pool contains a power of 2 number of objects, so the chunk of an object is found with a shift.
+The first OBJECT_POOL_STATIC_POOLS descriptors are static, after that the registry allocates pages of descriptors on demand.
 */
 
 #include <include/types.h>
@@ -8,13 +22,176 @@ Object pool allocator.
 #include <include/mem.h>
 #include <mm/include/memory_manager.h>
 
-object_pool_descriptor_t obj_pools[OBJECT_POOL_MAX_POOLS];
+#define OBJECT_POOL_DESCRIPTORS_PER_CHUNK (PAGE_SIZE / sizeof(object_pool_descriptor_t))
+
+object_pool_descriptor_t obj_pools[OBJECT_POOL_STATIC_POOLS];
+object_pool_descriptor_t *obj_pools_registry[OBJECT_POOL_REGISTRY_CHUNKS]; //pages of descriptors for the pools after the static ones
 //leokernel_memory_descriptor_t mmap_pool_memory[MMAP_POOL_MEMORY_SIZE];
 uint8_t mmap_pool_memory[MMAP_POOL_MEMORY_SIZE];
-uint32_t obj_pools_index = 0;
+uint32_t obj_pools_index = 0; //number of pool ids handed out
+pool_t obj_pools_free_id = OBJ_POOL_NO_SLOT; //list of the ids of the destroyed pools (chained through their free_head field)
+
+static inline void *obj_pool_slot(object_pool_descriptor_t *pool, uint32_t index) {
+    if (!pool->chunks) {
+        return pool->base + (uint64_t) pool->obj_size * index;
+    }
+
+    return pool->chunks[index >> pool->chunk_shift] + (uint64_t) pool->obj_size * (index & ((1 << pool->chunk_shift) - 1));
+}
+
+//returns a pointer to the generation of a slab slot, growable pools keep the generations of a chunk after its objects
+static inline uint32_t *obj_pool_generation(object_pool_descriptor_t *pool, uint32_t index) {
+    if (!pool->chunks) {
+        return &pool->generations[index];
+    }
+
+    void *chunk = pool->chunks[index >> pool->chunk_shift];
+    return (uint32_t *)(chunk + ((uint64_t) pool->obj_size << pool->chunk_shift)) + (index & ((1 << pool->chunk_shift) - 1));
+}
+
+static inline object_pool_descriptor_t *obj_pool_registry_entry(pool_t id) {
+    if (id < OBJECT_POOL_STATIC_POOLS) {
+        return &obj_pools[id];
+    }
+
+    id -= OBJECT_POOL_STATIC_POOLS;
+    return &obj_pools_registry[id / OBJECT_POOL_DESCRIPTORS_PER_CHUNK][id % OBJECT_POOL_DESCRIPTORS_PER_CHUNK];
+}
+
+static inline object_pool_descriptor_t *obj_pool_descriptor(pool_t id) {
+    //checks if the pool id is valid (it has been handed out and the pool hasn't been destroyed)
+    if (id >= obj_pools_index) {
+        return null; //illegal pool id
+    }
+
+    object_pool_descriptor_t *pool = obj_pool_registry_entry(id);
+    return pool->base ? pool : null;
+}
+
+//takes a free descriptor from the registry, reusing the ids of destroyed pools first
+static object_pool_descriptor_t *obj_pool_new_descriptor(void) {
+    pool_t id;
+
+    if (obj_pools_free_id != OBJ_POOL_NO_SLOT) {
+        id = obj_pools_free_id;
+        obj_pools_free_id = obj_pool_registry_entry(id)->free_head;
+    } else {
+        id = obj_pools_index;
+
+        //every OBJECT_POOL_DESCRIPTORS_PER_CHUNK ids after the static ones a new page of descriptors is needed
+        if (id >= OBJECT_POOL_STATIC_POOLS && (id - OBJECT_POOL_STATIC_POOLS) % OBJECT_POOL_DESCRIPTORS_PER_CHUNK == 0) {
+            uint32_t chunk = (id - OBJECT_POOL_STATIC_POOLS) / OBJECT_POOL_DESCRIPTORS_PER_CHUNK;
+
+            if (chunk == OBJECT_POOL_REGISTRY_CHUNKS || !(obj_pools_registry[chunk] = kalloc_page(1))) {
+                return null; //the registry is full
+            }
+
+            memclear(obj_pools_registry[chunk], PAGE_SIZE);
+        }
+
+        obj_pools_index++;
+    }
+
+    object_pool_descriptor_t *entry = obj_pool_registry_entry(id);
+    memclear(entry, sizeof(object_pool_descriptor_t));
+    entry->id = id;
+    entry->free_head = OBJ_POOL_NO_SLOT;
+    return entry;
+}
+
+//gives a descriptor back to the registry
+static void obj_pool_release_descriptor(object_pool_descriptor_t *entry) {
+    pool_t id = entry->id;
+    memclear(entry, sizeof(object_pool_descriptor_t));
+    entry->id = id;
+    entry->free_head = obj_pools_free_id;
+    obj_pools_free_id = id;
+}
+
+//chains the slots [from, to) of a slab pool at the head of the free list and resets their generations
+static void obj_pool_link_free(object_pool_descriptor_t *pool, uint32_t from, uint32_t to) {
+    for (uint32_t i = from; i < to; i++) {
+        *(uint32_t *) obj_pool_slot(pool, i) = i + 1 < to ? i + 1 : pool->free_head;
+        *obj_pool_generation(pool, i) = 0;
+    }
+
+    if (from < to) {
+        pool->free_head = from;
+    }
+}
+
+//chains every slot of a slab pool in the free list and resets the generations
+static void obj_pool_init_free_list(object_pool_descriptor_t *pool) {
+    pool->free_head = OBJ_POOL_NO_SLOT;
+    obj_pool_link_free(pool, 0, pool->pool_size);
+}
+
+//clears the objects [from, to) of a pool
+static void obj_pool_clear(object_pool_descriptor_t *pool, uint32_t from, uint32_t to) {
+    if (!pool->chunks) {
+        memclear(obj_pool_slot(pool, from), (uint64_t) pool->obj_size * (to - from));
+        return;
+    }
+
+    for (uint32_t i = from; i < to; i++) {
+        memclear(obj_pool_slot(pool, i), pool->obj_size);
+    }
+}
+
+//reverses the order of the objects in [from, to)
+static void obj_pool_reverse(object_pool_descriptor_t *pool, uint32_t from, uint32_t to) {
+    uint8_t tmp[pool->obj_size];
+
+    while (from + 1 < to) {
+        to--;
+        memcpy(tmp, obj_pool_slot(pool, from), pool->obj_size);
+        memcpy(obj_pool_slot(pool, from), obj_pool_slot(pool, to), pool->obj_size);
+        memcpy(obj_pool_slot(pool, to), tmp, pool->obj_size);
+        from++;
+    }
+}
+
+/*
+Adds a chunk to a growable pool.
+A queue is unwrapped before growing (its objects are moved at the beginning of the pool) so that the new slots end up after the last object.
+Returns false if the pool is fixed, if it reached its max size or if the chunk can't be allocated.
+*/
+static bool obj_pool_grow(object_pool_descriptor_t *pool) {
+    if (!pool->chunks || pool->pool_size >= pool->max_size || pool->chunks_count == OBJ_POOL_MAX_CHUNKS) {
+        return false;
+    }
+
+    void *chunk = kalloc_page(pool->chunk_pages);
+
+    if (!chunk) {
+        return false;
+    }
+
+    if (pool->type == queue && pool->head != 0 && !obj_pool_pack(pool->id)) {
+        kfree_page(chunk);
+        return false;
+    }
+
+    memclear(chunk, pool->chunk_pages * PAGE_SIZE);
+    pool->chunks[pool->chunks_count++] = chunk;
+
+    uint32_t old_size = pool->pool_size;
+    pool->pool_size += 1 << pool->chunk_shift;
+
+    if (pool->pool_size > pool->max_size) {
+        pool->pool_size = pool->max_size;
+    }
+
+    if (pool->type == slab) {
+        obj_pool_link_free(pool, old_size, pool->pool_size);
+    }
+
+    return true;
+}
 
 bool obj_alloc_init(pool_t *id) {
-    memclear(obj_pools, OBJECT_POOL_MAX_POOLS * sizeof(object_pool_descriptor_t));
+    memclear(obj_pools, OBJECT_POOL_STATIC_POOLS * sizeof(object_pool_descriptor_t));
+    memclear(obj_pools_registry, OBJECT_POOL_REGISTRY_CHUNKS * sizeof(object_pool_descriptor_t *));
     memclear(mmap_pool_memory, MMAP_POOL_MEMORY_SIZE);
 
     //create the pool that will contain the memory map, this can't be created with create_obj_pool()
@@ -22,6 +199,7 @@ bool obj_alloc_init(pool_t *id) {
     *id = 0;
 
     obj_pools_index = 1;
+    obj_pools_free_id = OBJ_POOL_NO_SLOT;
     return true;
 }
 
@@ -32,81 +210,185 @@ void init_first_pool(void *base) {
     obj_pools[0].pool_size = MMAP_POOL_MEMORY_SIZE / sizeof(leokernel_memory_descriptor_t);
     obj_pools[0].id = 0;
     obj_pools[0].type = manual;
-    obj_pools[0].top_index = 0;
-    obj_pools[0].bottom_index = 0;
+    obj_pools[0].count = 0;
+    obj_pools[0].head = 0;
+    obj_pools[0].free_head = OBJ_POOL_NO_SLOT;
+    obj_pools[0].generations = null;
+    obj_pools[0].chunks = null;
 }
 
+//creates a fixed pool, the objects are allocated in a single contiguous block
 bool create_obj_pool(pool_t *id, uint32_t obj_size, uint32_t pool_size, object_pool_type type) {
-    //if the pool descriptors array is full return false
-    if (obj_pools_index == OBJECT_POOL_MAX_POOLS) {
+    //the free list of a slab pool is embedded in the free slots, so a slot must be able to contain an index
+    if (obj_size == 0 || pool_size == 0 || (type == slab && obj_size < sizeof(uint32_t))) {
+        return false;
+    }
+
+    uint64_t objects_size = (uint64_t) obj_size * pool_size;
+    uint64_t total_size = objects_size + (type == slab ? pool_size * sizeof(uint32_t) : 0); //slab pools keep the generations after the objects
+    uint64_t pages = total_size / PAGE_SIZE + (total_size % PAGE_SIZE != 0 ? 1 : 0); //calculate the number of pages to allocate for this pool
+    object_pool_descriptor_t *entry = obj_pool_new_descriptor();
+
+    if (!entry) {
         return false; //the pool can't be created
     }
 
-    uint64_t total_size = obj_size * pool_size;
-    uint64_t pages = total_size / PAGE_SIZE + total_size % PAGE_SIZE != 0 ? 1 : 0; //calculate the number of pages to allocate for this pool
     void *base = kalloc_page(pages);
 
     if (!base) {
+        obj_pool_release_descriptor(entry);
         return false;
     }
 
     memclear(base, pages * PAGE_SIZE);
-    object_pool_descriptor_t *entry = &obj_pools[obj_pools_index];
     entry->base = base;
     entry->obj_size = obj_size;
     entry->pool_size = pool_size;
-    entry->id = obj_pools_index;
-    entry->bottom_index = 0;
-    entry->top_index = 0;
     entry->type = type;
-    obj_pools_index++;
+
+    if (type == slab) {
+        entry->generations = (uint32_t *)(base + objects_size);
+        obj_pool_init_free_list(entry);
+    }
+
+    *id = entry->id;
+    return true;
+}
+
+/*
+Creates a growable pool, it starts with one chunk of about a page and grows one chunk at a time up to max_size objects.
+The objects of a growable pool are not contiguous, the clients must access them through the pool functions.
+*/
+bool create_growable_obj_pool(pool_t *id, uint32_t obj_size, uint32_t max_size, object_pool_type type) {
+    if (obj_size == 0 || max_size == 0 || (type == slab && obj_size < sizeof(uint32_t))) {
+        return false;
+    }
+
+    //every chunk contains the biggest power of 2 number of objects (and their generations) that fits in a page, at least one
+    uint64_t slot_size = obj_size + (type == slab ? sizeof(uint32_t) : 0);
+    uint32_t shift = 0;
+
+    while (slot_size << (shift + 1) <= PAGE_SIZE) {
+        shift++;
+    }
+
+    uint64_t chunk_size = slot_size << shift;
+    object_pool_descriptor_t *entry = obj_pool_new_descriptor();
+
+    if (!entry) {
+        return false;
+    }
+
+    void **chunks = kalloc_page(1);
+
+    if (!chunks) {
+        obj_pool_release_descriptor(entry);
+        return false;
+    }
+
+    memclear(chunks, PAGE_SIZE);
+    entry->obj_size = obj_size;
+    entry->type = type;
+    entry->chunks = chunks;
+    entry->chunk_shift = shift;
+    entry->chunk_pages = chunk_size / PAGE_SIZE + (chunk_size % PAGE_SIZE != 0 ? 1 : 0);
+    entry->max_size = (uint64_t) max_size > (uint64_t) OBJ_POOL_MAX_CHUNKS << shift ? OBJ_POOL_MAX_CHUNKS << shift : max_size;
+
+    //allocate the first chunk
+    if (!obj_pool_grow(entry)) {
+        kfree_page(chunks);
+        obj_pool_release_descriptor(entry);
+        return false;
+    }
+
+    entry->base = chunks[0];
     *id = entry->id;
     return true;
 }
 
+/*
+Destroys a pool, its memory is freed and its id can be handed out again.
+The memory map pool can't be destroyed.
+*/
+bool obj_pool_destroy(pool_t id) {
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+
+    if (!pool || id == 0) {
+        return false;
+    }
+
+    if (pool->chunks) {
+        for (uint32_t i = 0; i < pool->chunks_count; i++) {
+            kfree_page(pool->chunks[i]);
+        }
+
+        kfree_page(pool->chunks);
+    } else {
+        kfree_page(pool->base);
+    }
+
+    obj_pool_release_descriptor(pool);
+    return true;
+}
+
 /*
 Puts an object into a pool.
 This function copy the object without erasing it from its original location.
 Return true if the insertion went good, false if: a bad pool id or object index is provided or if the pool is full.
-If this is not a manual pool, the object index field is ignored.
+If this is not a manual pool, the object index field is ignored (a slab pool allocates a new slot for the object).
 */
 bool obj_pool_put(pool_t id, void *obj, uint32_t obj_index) {
-    //checks if the pool id is valid (it doesn't exceed pools array capacity)
-    if (id >= obj_pools_index) {
-        return false; //illegal pool id
-    }
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id); //get the pool descriptor
 
-    object_pool_descriptor_t *pool = &obj_pools[id]; //get the pool descriptor
-
-    //checks if the object index is valid (it doesn't exceed the pools capacity)
-    if (obj_index >= pool->pool_size && pool->type == manual) {
-        return false; //illegal object index
+    if (!pool) {
+        return false;
     }
 
     //if this pool is manual copy the object into the pool at the specified index and return
     if (pool->type == manual) {
-        memcpy(pool->base + pool->obj_size * obj_index, obj, pool->obj_size);
+        //checks if the object index is valid (it doesn't exceed the pools capacity, a growable pool grows until it fits)
+        while (obj_index >= pool->pool_size) {
+            if (!obj_pool_grow(pool)) {
+                return false; //illegal object index
+            }
+        }
+
+        memcpy(obj_pool_slot(pool, obj_index), obj, pool->obj_size);
+
+        if (obj_index >= pool->count) {
+            pool->count = obj_index + 1;
+        }
     } else if (pool->type == stack) {
-        //if this pool is full return false
-        if (pool->top_index == pool->pool_size) {
+        //if this pool is full (and it can't grow) return false
+        if (pool->count == pool->pool_size && !obj_pool_grow(pool)) {
             return false;
         }
 
-        memcpy(pool->base + pool->obj_size * pool->top_index, obj, pool->obj_size);
-        pool->top_index++;
+        memcpy(obj_pool_slot(pool, pool->count), obj, pool->obj_size);
+        pool->count++;
     } else if (pool->type == queue) {
-        if (pool->top_index < pool->pool_size) {
-            memcpy(pool->base + pool->obj_size * pool->top_index, obj, pool->obj_size);
-            pool->top_index++;
-        } else if (pool->bottom_index > 0) {
-            memmove(pool->base, pool->base + pool->obj_size * pool->bottom_index, pool->obj_size * (pool->top_index - pool->bottom_index));
-            pool->top_index -= pool->bottom_index;
-            pool->bottom_index = 0;
-            memcpy(pool->base + pool->obj_size * pool->top_index, obj, pool->obj_size);
-            pool->top_index++;
-        } else {
+        //if this pool is full (and it can't grow) return false
+        if (pool->count == pool->pool_size && !obj_pool_grow(pool)) {
             return false;
         }
+
+        uint32_t tail = pool->head + pool->count;
+
+        if (tail >= pool->pool_size) {
+            tail -= pool->pool_size; //wrap around the ring buffer
+        }
+
+        memcpy(obj_pool_slot(pool, tail), obj, pool->obj_size);
+        pool->count++;
+    } else if (pool->type == slab) {
+        obj_handle_t handle;
+        void *slot;
+
+        if (!obj_pool_alloc(id, &handle, &slot)) {
+            return false;
+        }
+
+        memcpy(slot, obj, pool->obj_size);
     } else {
         return false; //unknown pool type, return false
     }
@@ -118,43 +400,49 @@ bool obj_pool_put(pool_t id, void *obj, uint32_t obj_index) {
 Gets an object from a pool.
 This function sets a pointer obj (parameter) to the right object. It's not a good idea to use that pointer to access other objects.
 Note that if the pool is a stack or a queue and an object is "removed", the object still resides in the pool memory, it's just no longer accessible
-with this function because the pool internal pointers are changed.
+with this function because the pool internal pointers are changed (it will be overwritten by the next insertions).
 Return true if the insertion went good, false if: a bad pool id or object index is provided or if the pool is empty.
-If this is not a manual pool, the object index field is ignored.
+If this is a stack or a queue, the object index field is ignored. If this is a slab pool, the index must refer to an allocated slot.
 */
 bool obj_pool_get(pool_t id, void **obj, uint32_t obj_index) {
     *obj = null;
-    
-    //checks if the pool id is valid (it doesn't exceed pools array capacity)
-    if (id >= obj_pools_index) {
-        return false; //illegal pool id
-    }
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id); //get the pool descriptor
 
-    object_pool_descriptor_t *pool = &obj_pools[id]; //get the pool descriptor
-
-    //checks if the object index is valid (it doesn't exceed the pool's capacity)
-    if (obj_index >= pool->pool_size && pool->type == manual) {
-        return false; //illegal object index
+    if (!pool) {
+        return false;
     }
 
     if (pool->type == manual) {
-        *obj = pool->base + pool->obj_size * obj_index;
+        //checks if the object index is valid (it doesn't exceed the pool's capacity)
+        if (obj_index >= pool->pool_size) {
+            return false; //illegal object index
+        }
+
+        *obj = obj_pool_slot(pool, obj_index);
     } else if (pool->type == stack) {
         //if the stack is empty return false
-        if (pool->top_index == 0) {
+        if (pool->count == 0) {
             return false;
         }
 
-        *obj = pool->base + pool->obj_size * (pool->top_index - 1);
-        pool->top_index--;
+        pool->count--;
+        *obj = obj_pool_slot(pool, pool->count);
     } else if (pool->type == queue) {
         //if the queue is empty return false
-        if (pool->bottom_index == pool->pool_size) {
+        if (pool->count == 0) {
+            return false;
+        }
+
+        *obj = obj_pool_slot(pool, pool->head);
+        pool->head = pool->head + 1 == pool->pool_size ? 0 : pool->head + 1;
+        pool->count--;
+    } else if (pool->type == slab) {
+        //the slot must exist and be allocated (odd generation)
+        if (obj_index >= pool->pool_size || !(*obj_pool_generation(pool, obj_index) & 1)) {
             return false;
         }
 
-        *obj = pool->base + pool->obj_size * pool->bottom_index;
-        pool->bottom_index++;
+        *obj = obj_pool_slot(pool, obj_index);
     } else {
         return false;
     }
@@ -162,90 +450,226 @@ bool obj_pool_get(pool_t id, void **obj, uint32_t obj_index) {
     return true;
 }
 
+/*
+Appends an object at the end of a manual pool, so that the client doesn't have to keep track of the next free index.
+If index is not null, it's set to the index of the new object.
+*/
+bool obj_pool_push(pool_t id, void *obj, uint32_t *index) {
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+
+    if (!pool || pool->type != manual) {
+        return false;
+    }
+
+    if (index) {
+        *index = pool->count;
+    }
+
+    return obj_pool_put(id, obj, pool->count);
+}
+
+/*
+Removes an object from a manual pool in constant time: the last object of the pool is moved in its place, so the order of the objects is not preserved.
+The slot that is freed at the end of the pool is cleared.
+*/
+bool obj_pool_remove(pool_t id, uint32_t index) {
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+
+    if (!pool || pool->type != manual || index >= pool->count) {
+        return false;
+    }
+
+    uint32_t last = pool->count - 1;
+
+    if (index != last) {
+        memcpy(obj_pool_slot(pool, index), obj_pool_slot(pool, last), pool->obj_size);
+    }
+
+    memclear(obj_pool_slot(pool, last), pool->obj_size);
+    pool->count--;
+    return true;
+}
+
+/*
+Shrinks a manual pool to count objects, the objects after the new end are cleared.
+Used by the clients that compact the pool by themselves (e.g. merging adjacent objects of an ordered pool).
+*/
+bool obj_pool_truncate(pool_t id, uint32_t count) {
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+
+    if (!pool || pool->type != manual || count > pool->count) {
+        return false;
+    }
+
+    obj_pool_clear(pool, count, pool->count);
+    pool->count = count;
+    return true;
+}
+
+//returns the number of objects in a pool (for manual pools the index of the last used object + 1)
+uint32_t obj_pool_count(pool_t id) {
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+    return pool ? pool->count : 0;
+}
+
+/*
+Allocates an object from a slab pool, taking the first slot of the free list.
+Sets handle to the handle of the new object and obj (if not null) to its address, the object memory is cleared.
+Returns false if this is not a slab pool or if the pool is full.
+*/
+bool obj_pool_alloc(pool_t id, obj_handle_t *handle, void **obj) {
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+
+    if (!pool || !handle || pool->type != slab) {
+        return false;
+    }
+
+    //if the pool is full (and it can't grow) return false
+    if (pool->free_head == OBJ_POOL_NO_SLOT && !obj_pool_grow(pool)) {
+        return false;
+    }
+
+    uint32_t index = pool->free_head;
+    void *slot = obj_pool_slot(pool, index);
+    uint32_t *gen = obj_pool_generation(pool, index);
+    pool->free_head = *(uint32_t *) slot;
+    (*gen)++; //becomes odd, the slot is now allocated
+    pool->count++;
+    memclear(slot, pool->obj_size);
+
+    *handle = OBJ_HANDLE(index, *gen);
+
+    if (obj) {
+        *obj = slot;
+    }
+
+    return true;
+}
+
+/*
+Gives an object back to its slab pool, the slot is put at the head of the free list.
+Returns false if the handle is stale or invalid.
+*/
+bool obj_pool_free(pool_t id, obj_handle_t handle) {
+    void *slot;
+
+    if (!obj_pool_lookup(id, handle, &slot)) {
+        return false;
+    }
+
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+    uint32_t index = OBJ_HANDLE_INDEX(handle);
+    (*obj_pool_generation(pool, index))++; //becomes even, the slot is now free
+    *(uint32_t *) slot = pool->free_head;
+    pool->free_head = index;
+    pool->count--;
+    return true;
+}
+
+/* sets obj to the address of the object referenced by handle, returns false if the handle is stale or invalid */
+bool obj_pool_lookup(pool_t id, obj_handle_t handle, void **obj) {
+    *obj = null;
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id);
+    uint32_t index = OBJ_HANDLE_INDEX(handle);
+    uint32_t gen = OBJ_HANDLE_GEN(handle);
+
+    if (!pool || pool->type != slab || index >= pool->pool_size || !(gen & 1) || *obj_pool_generation(pool, index) != gen) {
+        return false;
+    }
+
+    *obj = obj_pool_slot(pool, index);
+    return true;
+}
+
 //flushes a pool (clear it's memory)
 bool obj_pool_flush(pool_t id) {
-    //checks if the pool id is valid (it doesn't exceed pools array capacity)
-    if (id >= obj_pools_index) {
-        return false; //illegal pool id
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id); //get the pool descriptor
+
+    if (!pool) {
+        return false;
+    }
+
+    obj_pool_clear(pool, 0, pool->pool_size);
+    pool->count = 0;
+    pool->head = 0;
+
+    if (pool->type == slab) {
+        obj_pool_init_free_list(pool);
     }
 
-    object_pool_descriptor_t *pool = &obj_pools[id]; //get the pool descriptor
-    memclear(pool->base, pool->obj_size * pool->pool_size);
-    pool->top_index = 0;
-    pool->bottom_index = 0;
     return true;
 }
 
-//change pool type, if needed compact the objects, this should be avoided because this is requires a heavy computation running in O(n^2)
+//change pool type, if needed compact the objects. slab pools can't change type (and a pool can't become a slab pool)
 bool obj_pool_change_type(pool_t id, object_pool_type new_type) {
-    //checks if the pool id is valid (it doesn't exceed pools array capacity)
-    if (id >= obj_pools_index) {
-        return false; //illegal pool id
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id); //get the pool descriptor
+
+    if (!pool || pool->type == slab || new_type == slab) {
+        return false;
     }
 
-    object_pool_descriptor_t *pool = &obj_pools[id]; //get the pool descriptor
-    pool->type = new_type;
+    object_pool_type old_type = pool->type;
+
+    //a queue is made contiguous before changing type
+    if (old_type == queue && pool->head != 0 && !obj_pool_pack(id)) {
+        return false;
+    }
 
-    if (new_type == manual) {
-        pool->bottom_index = 0;
-        pool->top_index = 0;
+    if (new_type == manual || new_type == stack || new_type == queue) {
+        pool->type = new_type;
+        pool->head = 0;
         return true;
-    } else if (new_type == stack || new_type == queue) {
-        return obj_pool_pack(id);
     } else {
         return false; //invalid new type
     }
 }
 
-//compacts a pool, this should be avoided because it runs in O(n^2) time
+/*
+Compacts a pool in a single pass, moving every non empty object (an object is empty when all its bytes are 0) at the beginning of the pool.
+This is only needed to migrate old-style manual pools, obj_pool_remove() keeps a manual pool compact at all times.
+A queue is compacted by moving its objects at the beginning of the pool in order.
+*/
 bool obj_pool_pack(pool_t id) {
-    //checks if the pool id is valid (it doesn't exceed pools array capacity)
-    if (id >= obj_pools_index) {
-        return false; //illegal pool id
-    }
+    object_pool_descriptor_t *pool = obj_pool_descriptor(id); //get the pool descriptor
 
-    object_pool_descriptor_t *pool = &obj_pools[id]; //get the pool descriptor
-
-    //this function can be called only on manual and queue pools
-    if (pool->type == stack) {
+    if (!pool) {
         return false;
     }
 
-    //delete those unaccessible objects before executing the algorithm
-    if (pool->type == queue) {
-        memclear(pool->base, pool->obj_size * pool->bottom_index);
-        memclear(pool->base + pool->obj_size * pool->top_index, pool->obj_size * (pool->pool_size - pool->top_index));
+    //stacks are always compact and slab pools are referenced by handle, they can't be packed
+    if (pool->type == stack || pool->type == slab) {
+        return false;
     }
 
-    uint8_t empty_obj[pool->obj_size];
-    memclear(empty_obj, pool->obj_size);
-    pool->bottom_index = 0;
+    uint32_t w = 0;
 
-    for (uint32_t i = 0; i < pool->pool_size - 1; i++) {
-        void *obj = pool->base + pool->obj_size * i;
-
-        if (!memcmp(obj, empty_obj, pool->obj_size)) {
-            continue;
-        }
+    if (pool->type == queue) {
+        //rotate the ring buffer left by head so that the first object is at index 0 (three reversals, in place)
+        obj_pool_reverse(pool, 0, pool->head);
+        obj_pool_reverse(pool, pool->head, pool->pool_size);
+        obj_pool_reverse(pool, 0, pool->pool_size);
+        w = pool->count;
+    } else {
+        uint8_t empty_obj[pool->obj_size];
+        memclear(empty_obj, pool->obj_size);
 
-        bool found = false;
+        for (uint32_t i = 0; i < pool->pool_size; i++) {
+            void *obj = obj_pool_slot(pool, i);
 
-        for (uint32_t j = i + 1; j < pool->pool_size; j++) {
-            void *candidate = pool->base + pool->obj_size * j;
+            if (memcmp(obj, empty_obj, pool->obj_size)) {
+                continue; //empty object
+            }
 
-            if (!memcmp(candidate, empty_obj, pool->obj_size)) {
-                memmove(obj, candidate, pool->obj_size);
-                found = true;
-                pool->top_index = i + 1;
-                i--;
-                break;
+            if (w != i) {
+                memcpy(obj_pool_slot(pool, w), obj, pool->obj_size);
             }
-        }
 
-        if (!found) {
-            break;
+            w++;
         }
     }
 
+    obj_pool_clear(pool, w, pool->pool_size);
+    pool->count = w;
+    pool->head = 0;
     return true;
-}
\ No newline at end of file
+}
@@ -3,6 +3,8 @@
 #include <tty/include/tty.h>
 #include <include/low_level.h>
 #include <include/string.h>
+#include <include/klog.h>
+#include <tty/include/vsnprintf.h>
 
 //defined in tty.c
 extern uint64_t tty_height, tty_width;
@@ -53,6 +55,11 @@ void panic(char *reason) {
 
     printf("Other informations may follow...\n");
 
+    //the log records not printed yet
+    fmt_sink_t sink;
+    fmt_sink_console(&sink);
+    klog_flush(&sink);
+
     while(true);
     sys_hlt();
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+/*
+Per-cpu data areas.
+Every cpu calls percpu_init() with its index once, before using anything that keeps per-cpu state (e.g. the random generator), the boot
+cpu (index 0) first. percpu_online has a bit for every cpu that did.
+*/
+
+#include <include/types.h>
+#include <include/percpu.h>
+#include <include/low_level.h>
+#include <include/mem.h>
+#include <include/cpu.h>
+
+percpu_t percpu_areas[MAX_CPUS];
+uint64_t percpu_online;
+
+bool percpu_init(uint32_t cpu_index) {
+    if (cpu_index >= MAX_CPUS) {
+        return false;
+    }
+
+    percpu_t *area = &percpu_areas[cpu_index];
+    uint32_t ebx, edx;
+    memclear(area, sizeof(percpu_t));
+    cpuid(1, null, &ebx, null, null);
+    area->self = area;
+    area->cpu_index = cpu_index;
+    area->lapic_id = ebx >> 24; //initial apic id
+
+    //the 8 bit id is truncated on systems with x2apic ids above 255, leaf 0xB has the full 32 bit one
+    if (cpu_features.max_leaf >= 0xB) {
+        cpuid_count(0xB, 0, null, null, null, &edx);
+        area->lapic_id = edx;
+    }
+
+    uint64_t base = (uint64_t) area;
+    set_msr(IA32_GS_BASE, (uint32_t) base, (uint32_t)(base >> 32));
+
+    //globals are not reliably zeroed at boot (see tty_ready in kmain), the boot cpu clears the mask before the others add themselves
+    if (cpu_index == 0) {
+        percpu_online = 0;
+    }
+
+    __atomic_or_fetch(&percpu_online, 1ULL << cpu_index, __ATOMIC_RELEASE);
+    return true;
+}
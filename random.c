@@ -0,0 +1,318 @@
+/*
+Per-cpu random number generator.
+Every cpu runs its own ChaCha20 generator, kept in its percpu_t: the fast path takes no locks and touches no shared cache lines, it only
+disables the interrupts of the local cpu while the state is updated.
+Fast key erasure: a refill generates RANDOM_REFILL_BLOCKS blocks, the first 32 bytes become the new key and the rest is the output,
+every output byte is erased from the buffer when it's used, so the state never contains past outputs.
+Seeding: RDSEED or RDRAND when available plus the TSC jitter of a memory access loop, all hashed with SHA-256.
+Every RANDOM_RESEED_BYTES bytes the key is mixed with new hardware entropy.
+*/
+
+//the generator can be used by interrupt handlers, so this file must not use the SIMD registers (like the interrupt code)
+#pragma GCC target("general-regs-only")
+
+#include <include/types.h>
+#include <include/random.h>
+#include <include/percpu.h>
+#include <include/low_level.h>
+#include <include/cpu.h>
+#include <include/mem.h>
+#include <crypto/include/hash.h>
+
+#define RANDOM_HW_RETRIES 10
+#define RANDOM_JITTER_SAMPLES 256
+#define RANDOM_BULK_THRESHOLD RANDOM_BUFFER_SIZE //bigger requests are generated directly in the caller's buffer
+
+typedef uint64_t random_u64 __attribute__((may_alias, aligned(1)));
+typedef uint32_t random_u32 __attribute__((may_alias, aligned(1)));
+
+static inline uint32_t chacha_rol(uint32_t x, uint8_t n) {
+    return x << n | x >> (32 - n);
+}
+
+#define CHACHA_QUARTER(a, b, c, d)                      \
+    a += b; d ^= a; d = chacha_rol(d, 16);              \
+    c += d; b ^= c; b = chacha_rol(b, 12);              \
+    a += b; d ^= a; d = chacha_rol(d, 8);               \
+    c += d; b ^= c; b = chacha_rol(b, 7);
+
+//one ChaCha20 block (64 bit counter and nonce, as in the original definition)
+static void chacha20_block(const uint32_t key[8], uint64_t counter, uint64_t nonce, uint8_t *out) {
+    uint32_t in[16] = {
+        0x61707865, 0x3320646E, 0x79622D32, 0x6B206574, //"expand 32-byte k"
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        (uint32_t) counter, (uint32_t)(counter >> 32), (uint32_t) nonce, (uint32_t)(nonce >> 32)
+    };
+
+    uint32_t x[16];
+
+    for (uint8_t i = 0; i < 16; i++) {
+        x[i] = in[i];
+    }
+
+    for (uint8_t i = 0; i < 10; i++) {
+        CHACHA_QUARTER(x[0], x[4], x[8], x[12]);
+        CHACHA_QUARTER(x[1], x[5], x[9], x[13]);
+        CHACHA_QUARTER(x[2], x[6], x[10], x[14]);
+        CHACHA_QUARTER(x[3], x[7], x[11], x[15]);
+        CHACHA_QUARTER(x[0], x[5], x[10], x[15]);
+        CHACHA_QUARTER(x[1], x[6], x[11], x[12]);
+        CHACHA_QUARTER(x[2], x[7], x[8], x[13]);
+        CHACHA_QUARTER(x[3], x[4], x[9], x[14]);
+    }
+
+    for (uint8_t i = 0; i < 16; i++) {
+        ((random_u32 *) out)[i] = x[i] + in[i];
+    }
+}
+
+static bool rdseed64(uint64_t *value) {
+    for (uint8_t i = 0; i < RANDOM_HW_RETRIES; i++) {
+        uint8_t ok;
+        asm volatile("rdseed %0; setc %1" : "=r"(*value), "=qm"(ok) : : "cc");
+
+        if (ok) {
+            return true;
+        }
+
+        asm volatile("pause");
+    }
+
+    return false;
+}
+
+static bool rdrand64(uint64_t *value) {
+    for (uint8_t i = 0; i < RANDOM_HW_RETRIES; i++) {
+        uint8_t ok;
+        asm volatile("rdrand %0; setc %1" : "=r"(*value), "=qm"(ok) : : "cc");
+
+        if (ok) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//a 64 bits hardware random value, RDSEED (true entropy) if possible, RDRAND otherwise
+static bool random_hw64(uint64_t *value) {
+    return (cpu_has(CPU_FEATURE_RDSEED) && rdseed64(value)) || (cpu_has(CPU_FEATURE_RDRAND) && rdrand64(value));
+}
+
+/*
+collects a 256 bits seed: hardware random values (if any) and the TSC deltas of a loop whose timing depends on the caches, the tlb,
+the memory bus and the interrupts, hashed together with SHA-256.
+*/
+static void random_collect_seed(uint32_t seed[8]) {
+    sha256_ctx_t ctx;
+    uint8_t scratch[256];
+    uint64_t value;
+    sha256_init(&ctx);
+
+    for (uint8_t i = 0; i < RANDOM_KEY_SIZE / 8; i++) {
+        if (random_hw64(&value)) {
+            sha256_update(&ctx, &value, sizeof(value));
+        }
+    }
+
+    uint64_t prev = rdtsc();
+
+    for (uint32_t i = 0; i < RANDOM_JITTER_SAMPLES; i++) {
+        for (uint32_t j = 0; j <= (prev & 15); j++) {
+            ((volatile uint8_t *) scratch)[(prev >> j) & 0xFF] += j;
+        }
+
+        uint64_t now = rdtsc();
+        value = now - prev;
+        prev = now;
+        sha256_update(&ctx, &value, sizeof(value));
+    }
+
+    sha256_update(&ctx, scratch, sizeof(scratch));
+    sha256_update(&ctx, &this_cpu()->cpu_index, sizeof(uint32_t));
+    sha256_t digest = sha256_final(&ctx);
+    memcpy(seed, digest.bytes, RANDOM_KEY_SIZE);
+    memclear(&ctx, sizeof(ctx));
+    memclear(&digest, sizeof(digest));
+}
+
+/* seeds the generator of the calling cpu, percpu_init() must have been called on it */
+bool random_init_cpu() {
+    uint32_t seed[RANDOM_KEY_SIZE / 4];
+    random_collect_seed(seed);
+
+    bool int_enabled = save_disable_int();
+    random_state_t *state = &this_cpu()->random;
+
+    for (uint8_t i = 0; i < RANDOM_KEY_SIZE / 4; i++) {
+        state->key[i] = seed[i];
+    }
+
+    state->counter = 0;
+    state->position = RANDOM_BUFFER_SIZE; //empty, the first request refills it
+    state->generated = 0;
+    state->seeded = true;
+    restore_int(int_enabled);
+
+    memclear(seed, sizeof(seed));
+    return true;
+}
+
+/* seeds the generator of the boot cpu */
+bool random_init() {
+    return random_init_cpu();
+}
+
+//mixes new hardware entropy into the key (or the TSC if there's no hardware generator)
+static void random_reseed(random_state_t *state) {
+    for (uint8_t i = 0; i < RANDOM_KEY_SIZE / 8; i++) {
+        uint64_t value;
+
+        if (!random_hw64(&value)) {
+            value = rdtsc();
+        }
+
+        state->key[i * 2] ^= (uint32_t) value;
+        state->key[i * 2 + 1] ^= (uint32_t)(value >> 32);
+    }
+
+    state->generated = 0;
+}
+
+//must be called with the interrupts disabled
+static void random_refill(random_state_t *state) {
+    if (state->generated >= RANDOM_RESEED_BYTES) {
+        random_reseed(state);
+    }
+
+    for (uint8_t i = 0; i < RANDOM_REFILL_BLOCKS; i++) {
+        chacha20_block(state->key, state->counter++, this_cpu()->cpu_index, state->buffer + i * RANDOM_BLOCK_SIZE);
+    }
+
+    //fast key erasure: the key that generated this output is gone
+    for (uint8_t i = 0; i < RANDOM_KEY_SIZE / 4; i++) {
+        state->key[i] = ((random_u32 *) state->buffer)[i];
+        ((random_u32 *) state->buffer)[i] = 0;
+    }
+
+    state->position = RANDOM_KEY_SIZE;
+    state->generated += RANDOM_BUFFER_SIZE - RANDOM_KEY_SIZE;
+}
+
+/*
+takes size bytes (at most RANDOM_BUFFER_SIZE - RANDOM_KEY_SIZE) from the generator of this cpu.
+the generator of a cpu that has not been seeded yet is seeded now.
+*/
+static void random_take(void *dst, uint32_t size) {
+    if (!this_cpu()->random.seeded) {
+        random_init_cpu();
+    }
+
+    bool int_enabled = save_disable_int();
+    random_state_t *state = &this_cpu()->random;
+
+    if (state->position + size > RANDOM_BUFFER_SIZE) {
+        random_refill(state);
+    }
+
+    uint8_t *src = state->buffer + state->position;
+
+    for (uint32_t i = 0; i < size; i++) {
+        ((uint8_t *) dst)[i] = src[i];
+        src[i] = 0;
+    }
+
+    state->position += size;
+    restore_int(int_enabled);
+}
+
+uint64_t get_random_u64() {
+    uint64_t ret;
+    random_take(&ret, sizeof(ret));
+    return ret;
+}
+
+uint32_t get_random_u32() {
+    uint32_t ret;
+    random_take(&ret, sizeof(ret));
+    return ret;
+}
+
+//uniform random number in [0, bound) without modulo bias (multiply and shift, the biased products are rejected)
+uint64_t get_random_below(uint64_t bound) {
+    if (bound == 0) {
+        return 0;
+    }
+
+    __uint128_t product = (__uint128_t) get_random_u64() * bound;
+
+    if ((uint64_t) product < bound) {
+        uint64_t threshold = -bound % bound;
+
+        while ((uint64_t) product < threshold) {
+            product = (__uint128_t) get_random_u64() * bound;
+        }
+    }
+
+    return product >> 64;
+}
+
+/*
+fills buffer with size random bytes.
+small requests are taken from the per-cpu buffer, big ones take a one time key from it and run ChaCha20 directly into the caller's
+buffer with the interrupts enabled.
+*/
+void get_random_bytes(void *buffer, uint64_t size) {
+    if (size < RANDOM_BULK_THRESHOLD) {
+        uint32_t chunk = RANDOM_BUFFER_SIZE - RANDOM_KEY_SIZE;
+
+        for (uint64_t done = 0; done < size; done += chunk) {
+            random_take(buffer + done, size - done < chunk ? size - done : chunk);
+        }
+
+        return;
+    }
+
+    uint32_t key[RANDOM_KEY_SIZE / 4];
+    uint8_t block[RANDOM_BLOCK_SIZE];
+    uint64_t counter = 0;
+    random_take(key, sizeof(key));
+
+    for (; size >= RANDOM_BLOCK_SIZE; size -= RANDOM_BLOCK_SIZE, buffer += RANDOM_BLOCK_SIZE) {
+        chacha20_block(key, counter++, 0, buffer);
+    }
+
+    if (size) {
+        chacha20_block(key, counter, 0, block);
+
+        for (uint64_t i = 0; i < size; i++) {
+            ((uint8_t *) buffer)[i] = block[i];
+        }
+    }
+
+    memclear(key, sizeof(key));
+    memclear(block, sizeof(block));
+}
+
+//mixes data (e.g. device timings or a user supplied seed) into the generator of this cpu
+void random_add_entropy(const void *data, uint64_t size) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, size);
+    sha256_t digest = sha256_final(&ctx);
+
+    if (!this_cpu()->random.seeded) {
+        random_init_cpu();
+    }
+
+    bool int_enabled = save_disable_int();
+    random_state_t *state = &this_cpu()->random;
+
+    for (uint8_t i = 0; i < RANDOM_KEY_SIZE / 4; i++) {
+        state->key[i] ^= ((random_u32 *) digest.bytes)[i];
+    }
+
+    state->position = RANDOM_BUFFER_SIZE; //the buffered output was generated with the old key
+    restore_int(int_enabled);
+    memclear(&digest, sizeof(digest));
+}
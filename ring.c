@@ -0,0 +1,262 @@
+/*
+Lock free ring buffers with fixed size elements.
+The capacity of a ring must be a power of 2 and the memory of the slots is given by the caller (see SPSC_RING_BUFFER_SIZE and MPMC_RING_BUFFER_SIZE),
+so a ring can be declared statically and used before the kernel heap is ready.
+None of the functions blocks or disables interrupts, they can be called from interrupt handlers.
+*/
+
+#include <include/types.h>
+#include <include/ring.h>
+#include <include/mem.h>
+
+#define IS_POWER_OF_2(x) ((x) != 0 && ((x) & ((x) - 1)) == 0)
+
+static inline void *spsc_ring_slot(spsc_ring_t *ring, uint32_t pos) {
+    return ring->slots + (uint64_t)(pos & ring->mask) * ring->elem_size;
+}
+
+static inline uint64_t *mpmc_ring_slot(mpmc_ring_t *ring, uint64_t pos) {
+    return (uint64_t *)(ring->slots + (pos & ring->mask) * ring->slot_size);
+}
+
+//copies n elements from the ring starting at position pos to dst (or from src to the ring if to_ring is true), splitting the copy at the end of the buffer
+static void spsc_ring_copy(spsc_ring_t *ring, uint32_t pos, void *elems, uint32_t n, bool to_ring) {
+    uint32_t first = ring->mask + 1 - (pos & ring->mask);
+
+    if (first > n) {
+        first = n;
+    }
+
+    uint64_t first_size = (uint64_t) first * ring->elem_size;
+    uint64_t second_size = (uint64_t)(n - first) * ring->elem_size;
+
+    if (to_ring) {
+        memcpy(spsc_ring_slot(ring, pos), elems, first_size);
+        memcpy(ring->slots, elems + first_size, second_size);
+    } else {
+        memcpy(elems, spsc_ring_slot(ring, pos), first_size);
+        memcpy(elems + first_size, ring->slots, second_size);
+    }
+}
+
+bool spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t elem_size, uint32_t capacity) {
+    if (!ring || !buffer || elem_size == 0 || !IS_POWER_OF_2(capacity)) {
+        return false;
+    }
+
+    ring->head = 0;
+    ring->cached_tail = 0;
+    ring->tail = 0;
+    ring->cached_head = 0;
+    ring->slots = buffer;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    return true;
+}
+
+/*
+Enqueues up to n elements (stored one after the other in elems), returns the number of elements enqueued.
+Must be called by the producer only.
+*/
+uint32_t spsc_ring_enqueue_batch(spsc_ring_t *ring, void *elems, uint32_t n) {
+    uint32_t head = ring->head;
+    uint32_t free = ring->mask + 1 - (head - ring->cached_tail);
+
+    //the ring looks full, read the real tail
+    if (free < n) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        free = ring->mask + 1 - (head - ring->cached_tail);
+    }
+
+    if (n > free) {
+        n = free;
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    spsc_ring_copy(ring, head, elems, n, true);
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE); //publish the elements
+    return n;
+}
+
+/*
+Dequeues up to n elements into elems, returns the number of elements dequeued.
+Must be called by the consumer only.
+*/
+uint32_t spsc_ring_dequeue_batch(spsc_ring_t *ring, void *elems, uint32_t n) {
+    uint32_t tail = ring->tail;
+    uint32_t used = ring->cached_head - tail;
+
+    //the ring looks empty, read the real head
+    if (used < n) {
+        ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        used = ring->cached_head - tail;
+    }
+
+    if (n > used) {
+        n = used;
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    spsc_ring_copy(ring, tail, elems, n, false);
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE); //give the slots back to the producer
+    return n;
+}
+
+/*
+Returns the next free slot (null if the ring is full) so that the producer can build the element in place instead of copying it,
+the element is published by spsc_ring_commit(). Must be called by the producer only.
+*/
+void *spsc_ring_reserve(spsc_ring_t *ring) {
+    uint32_t head = ring->head;
+
+    if (head - ring->cached_tail > ring->mask) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        if (head - ring->cached_tail > ring->mask) {
+            return null;
+        }
+    }
+
+    return spsc_ring_slot(ring, head);
+}
+
+void spsc_ring_commit(spsc_ring_t *ring) {
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+bool spsc_ring_enqueue(spsc_ring_t *ring, void *elem) {
+    return spsc_ring_enqueue_batch(ring, elem, 1) == 1;
+}
+
+bool spsc_ring_dequeue(spsc_ring_t *ring, void *elem) {
+    return spsc_ring_dequeue_batch(ring, elem, 1) == 1;
+}
+
+//returns the number of elements in the ring, exact only if called by the producer or the consumer while the other side is idle
+uint32_t spsc_ring_count(spsc_ring_t *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+bool mpmc_ring_init(mpmc_ring_t *ring, void *buffer, uint32_t elem_size, uint32_t capacity) {
+    if (!ring || !buffer || elem_size == 0 || capacity < 2 || !IS_POWER_OF_2(capacity)) {
+        return false;
+    }
+
+    ring->slots = buffer;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    ring->slot_size = MPMC_RING_SLOT_SIZE(elem_size);
+    ring->enqueue_pos = 0;
+    ring->dequeue_pos = 0;
+
+    //every slot starts free for the first lap
+    for (uint64_t i = 0; i < capacity; i++) {
+        *mpmc_ring_slot(ring, i) = i;
+    }
+
+    return true;
+}
+
+/*
+Enqueues up to n elements, returns the number of elements enqueued.
+The producer counts how many consecutive slots are free starting from the enqueue position and claims all of them with a single compare and swap.
+*/
+uint32_t mpmc_ring_enqueue_batch(mpmc_ring_t *ring, void *elems, uint32_t n) {
+    uint64_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    uint32_t k;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    while (true) {
+        for (k = 0; k < n && k <= ring->mask; k++) {
+            if (__atomic_load_n(mpmc_ring_slot(ring, pos + k), __ATOMIC_ACQUIRE) != pos + k) {
+                break;
+            }
+        }
+
+        if (k == 0) {
+            long diff = (long) __atomic_load_n(mpmc_ring_slot(ring, pos), __ATOMIC_ACQUIRE) - (long) pos;
+
+            if (diff < 0) {
+                return 0; //the ring is full
+            }
+
+            //another producer took this position, try again from the new one
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        //on failure pos is updated with the current enqueue position
+        if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + k, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < k; i++) {
+        uint64_t *slot = mpmc_ring_slot(ring, pos + i);
+        memcpy(slot + 1, elems + (uint64_t) i * ring->elem_size, ring->elem_size);
+        __atomic_store_n(slot, pos + i + 1, __ATOMIC_RELEASE); //the slot is now full
+    }
+
+    return k;
+}
+
+/*
+Dequeues up to n elements, returns the number of elements dequeued.
+Same as mpmc_ring_enqueue_batch(), a slot is full for the position pos when its sequence is pos + 1.
+*/
+uint32_t mpmc_ring_dequeue_batch(mpmc_ring_t *ring, void *elems, uint32_t n) {
+    uint64_t pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    uint32_t k;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    while (true) {
+        for (k = 0; k < n && k <= ring->mask; k++) {
+            if (__atomic_load_n(mpmc_ring_slot(ring, pos + k), __ATOMIC_ACQUIRE) != pos + k + 1) {
+                break;
+            }
+        }
+
+        if (k == 0) {
+            long diff = (long) __atomic_load_n(mpmc_ring_slot(ring, pos), __ATOMIC_ACQUIRE) - (long)(pos + 1);
+
+            if (diff < 0) {
+                return 0; //the ring is empty
+            }
+
+            pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&ring->dequeue_pos, &pos, pos + k, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < k; i++) {
+        uint64_t *slot = mpmc_ring_slot(ring, pos + i);
+        memcpy(elems + (uint64_t) i * ring->elem_size, slot + 1, ring->elem_size);
+        __atomic_store_n(slot, pos + i + ring->mask + 1, __ATOMIC_RELEASE); //the slot is free for the next lap
+    }
+
+    return k;
+}
+
+bool mpmc_ring_enqueue(mpmc_ring_t *ring, void *elem) {
+    return mpmc_ring_enqueue_batch(ring, elem, 1) == 1;
+}
+
+bool mpmc_ring_dequeue(mpmc_ring_t *ring, void *elem) {
+    return mpmc_ring_dequeue_batch(ring, elem, 1) == 1;
+}
@@ -0,0 +1,124 @@
+/*
+Throughput benchmark of the ring buffers.
+The producer stands for an interrupt handler and the consumer for the code that drains the ring: the producer fills a burst of elements,
+the consumer drains it, so every element goes through the whole enqueue/dequeue path. Results are in cycles per element.
+*/
+
+#include <include/types.h>
+#include <include/ring.h>
+#include <include/low_level.h>
+#include <tty/include/tty.h>
+
+#define RING_BENCH_CAPACITY 256
+#define RING_BENCH_ELEMENTS (1 << 20)
+#define RING_BENCH_BURST 32
+
+typedef struct {
+    uint64_t data;
+    uint64_t tsc;
+} ring_bench_elem_t;
+
+uint8_t ring_bench_buffer[MPMC_RING_BUFFER_SIZE(sizeof(ring_bench_elem_t), RING_BENCH_CAPACITY)] __ring_aligned;
+spsc_ring_t ring_bench_spsc;
+mpmc_ring_t ring_bench_mpmc;
+
+static void ring_bench_print(char *name, uint64_t cycles, uint64_t elements, bool ok) {
+    printf("%s: %lu.%02lu cycles/elem %s\n", name, cycles / elements, (cycles % elements) * 100 / elements, ok ? "" : "(data mismatch)");
+}
+
+static void ring_bench_spsc_run(uint32_t burst) {
+    ring_bench_elem_t elems[RING_BENCH_BURST];
+    uint64_t produced = 0, consumed = 0;
+    bool ok = true;
+    spsc_ring_init(&ring_bench_spsc, ring_bench_buffer, sizeof(ring_bench_elem_t), RING_BENCH_CAPACITY);
+    uint64_t start = rdtsc();
+
+    while (consumed < RING_BENCH_ELEMENTS) {
+        //producer side
+        for (uint32_t i = 0; i < burst; i++) {
+            elems[i].data = produced + i;
+            elems[i].tsc = 0;
+        }
+
+        if (burst == 1) {
+            produced += spsc_ring_enqueue(&ring_bench_spsc, elems) ? 1 : 0;
+        } else {
+            produced += spsc_ring_enqueue_batch(&ring_bench_spsc, elems, burst);
+        }
+
+        //consumer side
+        uint32_t n = burst == 1 ? (spsc_ring_dequeue(&ring_bench_spsc, elems) ? 1 : 0) : spsc_ring_dequeue_batch(&ring_bench_spsc, elems, burst);
+
+        for (uint32_t i = 0; i < n; i++) {
+            ok &= elems[i].data == consumed + i;
+        }
+
+        consumed += n;
+    }
+
+    ring_bench_print(burst == 1 ? "spsc single" : "spsc batch ", rdtsc() - start, RING_BENCH_ELEMENTS, ok);
+}
+
+static void ring_bench_mpmc_run(uint32_t burst) {
+    ring_bench_elem_t elems[RING_BENCH_BURST];
+    uint64_t produced = 0, consumed = 0;
+    bool ok = true;
+    mpmc_ring_init(&ring_bench_mpmc, ring_bench_buffer, sizeof(ring_bench_elem_t), RING_BENCH_CAPACITY);
+    uint64_t start = rdtsc();
+
+    while (consumed < RING_BENCH_ELEMENTS) {
+        for (uint32_t i = 0; i < burst; i++) {
+            elems[i].data = produced + i;
+            elems[i].tsc = 0;
+        }
+
+        if (burst == 1) {
+            produced += mpmc_ring_enqueue(&ring_bench_mpmc, elems) ? 1 : 0;
+        } else {
+            produced += mpmc_ring_enqueue_batch(&ring_bench_mpmc, elems, burst);
+        }
+
+        uint32_t n = burst == 1 ? (mpmc_ring_dequeue(&ring_bench_mpmc, elems) ? 1 : 0) : mpmc_ring_dequeue_batch(&ring_bench_mpmc, elems, burst);
+
+        for (uint32_t i = 0; i < n; i++) {
+            ok &= elems[i].data == consumed + i;
+        }
+
+        consumed += n;
+    }
+
+    ring_bench_print(burst == 1 ? "mpmc single" : "mpmc batch ", rdtsc() - start, RING_BENCH_ELEMENTS, ok);
+}
+
+/*
+Measures the latency from the enqueue of an element to its dequeue when the consumer lags behind the producer by a full ring,
+which is the worst case for an interrupt handler that fills the ring while the consumer is not running.
+*/
+static void ring_bench_latency() {
+    ring_bench_elem_t elem;
+    uint64_t total = 0;
+    spsc_ring_init(&ring_bench_spsc, ring_bench_buffer, sizeof(ring_bench_elem_t), RING_BENCH_CAPACITY);
+
+    for (uint32_t round = 0; round < RING_BENCH_ELEMENTS / RING_BENCH_CAPACITY; round++) {
+        for (uint32_t i = 0; i < RING_BENCH_CAPACITY; i++) {
+            elem.data = i;
+            elem.tsc = rdtsc();
+            spsc_ring_enqueue(&ring_bench_spsc, &elem);
+        }
+
+        while (spsc_ring_dequeue(&ring_bench_spsc, &elem)) {
+            total += rdtsc() - elem.tsc;
+        }
+    }
+
+    ring_bench_print("spsc full ring latency", total, RING_BENCH_ELEMENTS, true);
+}
+
+void ring_bench() {
+    printf("ring buffers, %d elements of %d bytes, capacity %d\n", RING_BENCH_ELEMENTS, sizeof(ring_bench_elem_t), RING_BENCH_CAPACITY);
+    ring_bench_spsc_run(1);
+    ring_bench_spsc_run(RING_BENCH_BURST);
+    ring_bench_mpmc_run(1);
+    ring_bench_mpmc_run(RING_BENCH_BURST);
+    ring_bench_latency();
+}
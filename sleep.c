@@ -3,7 +3,7 @@
 #include <io/include/pit.h>
 #include <int/include/int.h>
 
-bool sleep_in_progress = false;
+volatile bool sleep_in_progress = false; //cleared by the PIT interrupt handler
 extern bool pit_ready; //defined in pit.c
 
 //sleep ms milliseconds (uses PIT)
@@ -17,9 +17,9 @@ bool sleep(uint16_t ms) {
     }
 
     uint32_t count = ms;
-    uint8_t hook_n;
+    int_hook_t hook;
     
-    if ((hook_n = int_hook(0x17, sleep_notify)) == 0xFF) {
+    if (!int_hook(0x17, sleep_notify, null, &hook)) {
         return false;
     }
 
@@ -35,9 +35,10 @@ bool sleep(uint16_t ms) {
     }
 
     pit_stop();
-    return int_unhook(0x17, hook_n);
+    return int_unhook(0x17, hook);
 }
 
-void sleep_notify() {
+bool sleep_notify(int_regs_t *regs, void *ctx) {
     sleep_in_progress = false;
+    return true;
 }
\ No newline at end of file
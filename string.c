@@ -1,107 +1,439 @@
+/*
+String routines.
+strlen, strnlen, strchr, strcmp and strncmp scan 8 bytes at a time (word-at-a-time), string_init() switches them to SSE2 (strlen, strnlen,
+strchr) and SSE4.2 (strcmp, strncmp, with pcmpistri) versions by patching their static call trampolines.
+Saving the SIMD state costs more than scanning a short string, so the SIMD versions scan the first STR_SIMD_THRESHOLD bytes with the
+word loop and open a kernel_fpu_begin()/kernel_fpu_end() section only for the longer strings.
+Word and aligned 16 bytes reads never cross a page boundary, unaligned reads are done only if they don't cross one. The bounded scans
+(strnlen, strncmp) read past their n bytes only up to the end of the aligned word (or 16 bytes) that holds the last one.
+*/
+
 #include <include/string.h>
 #include <include/types.h>
 #include <include/mem.h>
 #include <tty/include/tty.h>
 #include <include/math.h>
 #include <io/include/files.h>
+#include <include/fpu.h>
+#include <include/cpu.h>
+#include <include/alternatives.h>
+
+#define STR_SIMD_THRESHOLD 64
+#define STR_ONES 0x0101010101010101
+#define STR_HIGHS 0x8080808080808080
+#define STR_PAGE_SIZE 4096
+#define STR_NO_BUILTIN __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+//pcmpistri mode: unsigned bytes, equal each, negative polarity (the index is the first mismatch or the first terminator)
+#define PCMPISTRI_STRCMP 0x18
+
+uint32_t strlen_words(const char *str);
+uint32_t strnlen_words(const char *str, uint32_t n);
+char *strchr_words(const char *str, char c);
+int strcmp_words(const char *str1, const char *str2);
+int strncmp_words(const char *str1, const char *str2, uint32_t n);
 
-//catenate src to dest, returns the pointer to destination
+STATIC_CALL(strlen, strlen_words)
+STATIC_CALL(strnlen, strnlen_words)
+STATIC_CALL(strchr, strchr_words)
+STATIC_CALL(strcmp, strcmp_words)
+STATIC_CALL(strncmp, strncmp_words)
+
+//has a zero byte: every zero byte of v sets the high bit of its byte in the result (bytes after the first zero can be false positives)
+static inline uint64_t str_zero_bytes(uint64_t v) {
+    return (v - STR_ONES) & ~v & STR_HIGHS;
+}
+
+//index of the first byte flagged by str_zero_bytes()
+static inline uint32_t str_first_byte(uint64_t mask) {
+    return __builtin_ctzll(mask) / 8;
+}
+
+//true if reading size bytes from ptr crosses a page boundary
+static inline bool str_crosses_page(const void *ptr, uint32_t size) {
+    return ((uint64_t) ptr & (STR_PAGE_SIZE - 1)) > STR_PAGE_SIZE - size;
+}
+
+//catenate src to dest
 void strcat(char *dest, const char *src) {
-    dest += strlen(dest); //move the pointer at the end of the string
+    strcpy(dest + strlen(dest), src);
+}
+
+//copy src string (terminator included) into dest
+void strcpy(char *dest, const char *src) {
+    uint32_t length = strlen(src);
+    memcpy(dest, (void *) src, length + 1);
+}
 
-    for (uint32_t i = 0; i < strlen(src); i++) {
-        *(dest + i) = *(src + i);
+void *strncpy(char *dest, char *src, uint32_t n) {
+    uint32_t src_len = strnlen(src, n);
+    memcpy(dest, src, src_len);
+    memclear(dest + src_len, n - src_len);
+    return (void *) dest;
+}
+
+/*
+returns the length of the string str (terminator is not included in the output).
+the first word is read from the aligned address before str, the bytes before str are set to 0xFF so they can't be a terminator.
+*/
+uint32_t strlen_words(const char *str) {
+    uint64_t offset = (uint64_t) str & 7;
+    const uint64_t *word = (const uint64_t *)(str - offset);
+    uint64_t v = *word | ((1ul << (offset * 8)) - 1);
+
+    while (!str_zero_bytes(v)) {
+        v = *++word;
     }
+
+    return (const char *) word + str_first_byte(str_zero_bytes(v)) - str;
 }
 
-//copy src string into dest
-void strcpy(char *dest, const char *src) {
-    uint32_t i = 0;
+/*
+same as strlen() but it scans at most n bytes, if there's no terminator returns n.
+only the aligned words that hold the n bytes are read, the next one is loaded only if the scan goes on into it.
+*/
+uint32_t strnlen_words(const char *str, uint32_t n) {
+    if (n == 0) {
+        return 0;
+    }
 
-    while (*(src + i) != 0x0) {
-        *(dest + i) = *(src + i);
-        i++;
+    uint64_t offset = (uint64_t) str & 7;
+    const uint64_t *word = (const uint64_t *)(str - offset);
+    uint64_t v = *word | ((1ul << (offset * 8)) - 1);
+    uint64_t limit = offset + n; //bytes from the start of the first word
+
+    for (uint64_t i = 0; ; i += 8) {
+        uint64_t zeros = str_zero_bytes(v);
+
+        if (zeros) {
+            uint64_t length = i + str_first_byte(zeros) - offset;
+            return length < n ? length : n;
+        }
+
+        if (i + 8 >= limit) {
+            return n;
+        }
+
+        v = *++word;
     }
 }
 
-void *strncpy(char *dest, char *src, uint32_t n) {
-    uint32_t i = 0;
-    uint32_t src_len = strlen(src);
+/*
+returns a pointer to the first c or terminator in the first limit bytes of str, null if there's none.
+bytes before str (read with the first aligned word) are set to 0xFF in both tests so they can't match.
+*/
+static const char *str_find_words(const char *str, char c, uint64_t limit) {
+    uint64_t pattern = (uint8_t) c * STR_ONES;
+    uint64_t offset = (uint64_t) str & 7;
+    const uint64_t *word = (const uint64_t *)(str - offset);
+    uint64_t head = (1ul << (offset * 8)) - 1;
+    uint64_t v = *word;
+    uint64_t found = str_zero_bytes(v | head) | str_zero_bytes((v ^ pattern) | head);
+    uint64_t scanned = 8 - offset;
 
-    while(i < n) {
-        *(dest + i) = i < src_len ? *(src + i) : '\0';
-        i++;
+    while (!found) {
+        if (scanned >= limit) {
+            return null;
+        }
+
+        v = *++word;
+        found = str_zero_bytes(v) | str_zero_bytes(v ^ pattern);
+        scanned += 8;
     }
 
-    return (void *) dest;
+    const char *ptr = (const char *) word + str_first_byte(found);
+    return (uint64_t)(ptr - str) < limit ? ptr : null;
 }
 
-//returns the length of the string str (terminator is not included in the output)
-uint32_t strlen(const char *str) {
-    uint32_t i = 0;
+//returns a pointer to the first occurrence of c in str or null, if c is 0 returns a pointer to the terminator
+char *strchr_words(const char *str, char c) {
+    if (c == '\0') {
+        return (char *) str + strlen(str);
+    }
+
+    const char *ptr = str_find_words(str, c, (uint64_t) -1);
+    return *ptr == c ? (char *) ptr : null;
+}
+
+/*
+compares str1 and str2 for at most n bytes starting from index i, 8 bytes at a time while the reads don't cross a page boundary.
+returns 0 if the strings are equal, a negative number if str1 comes first and a positive number if str2 comes first.
+*/
+static int str_compare_words(const char *str1, const char *str2, uint64_t n, uint64_t i) {
+    while (i < n) {
+        if (n - i >= 8 && !str_crosses_page(str1 + i, 8) && !str_crosses_page(str2 + i, 8)) {
+            uint64_t v1 = *(const uint64_t *)(str1 + i);
+            uint64_t v2 = *(const uint64_t *)(str2 + i);
+
+            if (v1 == v2 && !str_zero_bytes(v1)) {
+                i += 8;
+                continue;
+            }
+
+            //the difference or the terminator is in this word, the byte loop below finds it
+        }
+
+        uint8_t c1 = str1[i], c2 = str2[i];
+
+        if (c1 != c2 || c1 == '\0') {
+            return c1 - c2;
+        }
 
-    while(*(str + i) != 0x00) {
         i++;
     }
 
-    return i;
+    return 0;
+}
+
+int strcmp_words(const char *str1, const char *str2) {
+    return str_compare_words(str1, str2, (uint64_t) -1, 0);
+}
+
+int strncmp_words(const char *str1, const char *str2, uint32_t n) {
+    return str_compare_words(str1, str2, n, 0);
+}
+
+//sse2 mask of the bytes equal to 0 in the aligned 16 bytes at ptr
+static inline uint32_t str_sse2_zero_mask(const void *ptr) {
+    uint32_t mask;
+    asm volatile(
+        "pxor %%xmm0, %%xmm0\n"
+        "pcmpeqb (%1), %%xmm0\n"
+        "pmovmskb %%xmm0, %0\n"
+        : "=r"(mask) : "r"(ptr) : "xmm0", "memory"
+    );
+    return mask;
 }
 
-uint32_t strcmp(const char *str1, const char *str2) {
-    uint32_t str1_l = strlen(str1);
-    uint32_t str2_l = strlen(str2);
+//scans the string from str (16 bytes aligned) for at most limit bytes with sse2, returns limit if there's no terminator
+static uint64_t str_sse2_scan(const char *str, uint64_t limit) {
+    uint64_t i = 0;
+
+    for (; i < limit; i += 16) {
+        uint32_t mask = str_sse2_zero_mask(str + i);
 
-    if (str1_l != str2_l) {
-        return -1;
+        if (mask) {
+            i += __builtin_ctz(mask);
+            break;
+        }
     }
 
-    for (uint32_t i = 0; i < str1_l; i++) {
-        if (*(str1 + i) != *(str2 + i)) {
-            return -1;
+    return i < limit ? i : limit;
+}
+
+uint32_t strlen_sse2(const char *str) {
+    uint32_t length = strnlen_words(str, STR_SIMD_THRESHOLD);
+
+    if (length < STR_SIMD_THRESHOLD || !kernel_fpu_begin()) {
+        return length < STR_SIMD_THRESHOLD ? length : length + strlen_words(str + length);
+    }
+
+    //continue from the aligned address after the bytes already scanned
+    const char *aligned = (const char *)((uint64_t)(str + length) & ~15ul);
+    length = aligned - str + str_sse2_scan(aligned, (uint64_t) -1);
+    kernel_fpu_end();
+    return length;
+}
+
+uint32_t strnlen_sse2(const char *str, uint32_t n) {
+    uint32_t length = strnlen_words(str, n < STR_SIMD_THRESHOLD ? n : STR_SIMD_THRESHOLD);
+
+    if (length < STR_SIMD_THRESHOLD || length == n || !kernel_fpu_begin()) {
+        return length < STR_SIMD_THRESHOLD || length == n ? length : length + strnlen_words(str + length, n - length);
+    }
+
+    const char *aligned = (const char *)((uint64_t)(str + length) & ~15ul);
+    uint64_t done = aligned - str;
+    length = done + str_sse2_scan(aligned, n - done);
+    kernel_fpu_end();
+    return length;
+}
+
+char *strchr_sse2(const char *str, char c) {
+    if (c == '\0') {
+        return (char *) str + strlen(str);
+    }
+
+    //short strings: the word loop finds c or the terminator in the first bytes
+    const char *ptr = str_find_words(str, c, STR_SIMD_THRESHOLD);
+
+    if (ptr) {
+        return *ptr == c ? (char *) ptr : null;
+    }
+
+    const char *end = str + STR_SIMD_THRESHOLD;
+
+    if (!kernel_fpu_begin()) {
+        return strchr_words(end, c);
+    }
+
+    const char *aligned = (const char *)((uint64_t) end & ~15ul);
+    uint64_t pattern = (uint8_t) c * STR_ONES;
+    char *ret;
+
+    asm volatile(
+        "movq %0, %%xmm1\n"
+        "punpcklqdq %%xmm1, %%xmm1\n" //c in every byte of xmm1
+        : : "r"(pattern) : "xmm1"
+    );
+
+    while (true) {
+        uint32_t mask;
+        asm volatile(
+            "movdqa (%1), %%xmm2\n"
+            "pxor %%xmm0, %%xmm0\n"
+            "pcmpeqb %%xmm2, %%xmm0\n"
+            "pcmpeqb %%xmm1, %%xmm2\n"
+            "por %%xmm2, %%xmm0\n"
+            "pmovmskb %%xmm0, %0\n"
+            : "=r"(mask) : "r"(aligned) : "xmm0", "xmm2", "memory"
+        );
+
+        if (mask) {
+            ret = (char *) aligned + __builtin_ctz(mask);
+            break;
         }
+
+        aligned += 16;
     }
 
-    return 0;
+    kernel_fpu_end();
+    return *ret == c ? ret : null;
 }
 
-int strncmp(char *str1, char *str2, uint32_t n) {
-    for (uint32_t i = 0; i < n; i++) {
-        if (*(str1 + i) > *(str2 + i)) {
-            return 1;
-        } else if (*(str1 + i) < *(str2 + i)) {
-            return -1;
+/*
+sse4.2 compare loop: pcmpistri finds the first mismatch or terminator in 16 bytes.
+CF is set if there's a mismatch (index in ecx), ZF if str2 ends in these 16 bytes (then the strings are equal).
+*/
+static int str_compare_sse42(const char *str1, const char *str2, uint64_t n) {
+    //compare the first bytes with the word loop, most strings differ (or end) there
+    uint64_t head = n < STR_SIMD_THRESHOLD ? n : STR_SIMD_THRESHOLD;
+    int diff = str_compare_words(str1, str2, head, 0);
+
+    if (diff || head == n || strnlen_words(str1, head) < head) {
+        return diff;
+    }
+
+    if (!kernel_fpu_begin()) {
+        return str_compare_words(str1, str2, n, head);
+    }
+
+    uint64_t i = head;
+    diff = 0;
+
+    while (i < n) {
+        if (n - i < 16 || str_crosses_page(str1 + i, 16) || str_crosses_page(str2 + i, 16)) {
+            uint8_t c1 = str1[i], c2 = str2[i];
+
+            if (c1 != c2 || c1 == '\0') {
+                diff = c1 - c2;
+                break;
+            }
+
+            i++;
+            continue;
+        }
+
+        uint32_t index;
+        uint8_t mismatch, end;
+        asm volatile(
+            "movdqu (%3), %%xmm0\n"
+            "pcmpistri %5, (%4), %%xmm0\n"
+            "setc %1\n"
+            "setz %2\n"
+            : "=c"(index), "=r"(mismatch), "=r"(end) : "r"(str1 + i), "r"(str2 + i), "i"(PCMPISTRI_STRCMP) : "xmm0", "cc", "memory"
+        );
+
+        if (mismatch) {
+            diff = (uint8_t) str1[i + index] - (uint8_t) str2[i + index];
+            break;
         }
+
+        if (end) {
+            break;
+        }
+
+        i += 16;
     }
 
-    return 0;
+    kernel_fpu_end();
+    return diff;
+}
+
+int strcmp_sse42(const char *str1, const char *str2) {
+    return str_compare_sse42(str1, str2, (uint64_t) -1);
+}
+
+int strncmp_sse42(const char *str1, const char *str2, uint32_t n) {
+    return str_compare_sse42(str1, str2, n);
 }
 
-//returns the first substring starting with the token or null if there's an error
+/* selects the string routines for this cpu, must be called after mem_init() */
+void string_init() {
+    if (cpu_has(CPU_FEATURE_SSE2)) {
+        static_call_update((void *) strlen, (void *) strlen_sse2);
+        static_call_update((void *) strnlen, (void *) strnlen_sse2);
+        static_call_update((void *) strchr, (void *) strchr_sse2);
+    }
+
+    if (cpu_has(CPU_FEATURE_SSE42)) {
+        static_call_update((void *) strcmp, (void *) strcmp_sse42);
+        static_call_update((void *) strncmp, (void *) strncmp_sse42);
+    }
+}
+
+//returns the first substring of str equal to token or null if there's none
 char *strtok(const char *str, const char *token) {
     uint32_t tok_l = strlen(token);
-    uint32_t str_l = strlen(str);
-    char buffer[tok_l + 1];
-    buffer[tok_l] = 0x00;
 
-    if (tok_l == 0 || str_l == 0) {
+    if (tok_l == 0) {
         return null;
     }
 
-    if (str_l < tok_l) {
+    for (char *ptr = strchr(str, token[0]); ptr; ptr = strchr(ptr + 1, token[0])) {
+        if (strncmp(ptr, token, tok_l) == STR_EQUAL) {
+            return ptr;
+        }
+    }
+
+    return null;
+}
+
+/*
+splits str in tokens separated by any of the characters in delim (reentrant version of the standard strtok, the position is kept in saveptr).
+the first call passes the string, the next ones pass null. returns the next token or null when there are no more tokens.
+*/
+char *strtok_r(char *str, const char *delim, char **saveptr) {
+    char *ptr = str ? str : *saveptr;
+
+    if (!ptr) {
         return null;
-    } else if (str_l == tok_l) {
-        return (char *) str;
     }
 
-    for (uint32_t i = 0; i < str_l - tok_l; i++) {
-        memcpy(buffer, (void *)(str + i), tok_l);
+    //skip the leading delimiters
+    while (*ptr != '\0' && strchr(delim, *ptr)) {
+        ptr++;
+    }
 
-        if (strcmp(buffer, token) == STR_EQUAL) {
-            return (char *)(str + i);
-        }
+    if (*ptr == '\0') {
+        *saveptr = null;
+        return null;
     }
 
-    return null;
+    char *token = ptr;
+
+    while (*ptr != '\0' && !strchr(delim, *ptr)) {
+        ptr++;
+    }
+
+    if (*ptr == '\0') {
+        *saveptr = null;
+    } else {
+        *ptr = '\0';
+        *saveptr = ptr + 1;
+    }
+
+    return token;
 }
 
 //convert string to signed integer
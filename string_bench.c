@@ -0,0 +1,147 @@
+/*
+Benchmark of the string routines against the byte loops they replaced, on inputs like the ones the kernel handles:
+acpi signatures, terminal command lines and file paths of growing length.
+For every input it prints the average number of cycles of a call, old version first.
+*/
+
+#include <include/types.h>
+#include <include/string.h>
+#include <include/mem.h>
+#include <include/low_level.h>
+#include <tty/include/tty.h>
+
+#define STRING_BENCH_ITERATIONS 20000
+#define STRING_BENCH_MAX_LENGTH 512
+#define STRING_BENCH_LEGACY __attribute__((noinline, optimize("no-tree-vectorize", "no-tree-loop-distribute-patterns")))
+
+char string_bench_str1[STRING_BENCH_MAX_LENGTH + 1];
+char string_bench_str2[STRING_BENCH_MAX_LENGTH + 1];
+volatile uint64_t string_bench_sink; //keeps the compiler from dropping the calls whose result is not used
+
+static const char *string_bench_inputs[] = {
+    "FACP",
+    "ls -la",
+    "cat /dev/hda1/readme.txt",
+    "/usr/share/doc/leokernel/drivers/storage/ide/controllers.txt",
+    "mount -t fat32 /dev/hda1 /mnt/disk0 && ls -la /mnt/disk0/home/user/documents/projects/kernel/src",
+    "/home/user/documents/projects/kernel/build/intermediate/objects/drivers/storage/ahci/controllers/"
+    "port_multiplier/command_list/command_table/physical_region_descriptor_table/entries.o"
+};
+
+STRING_BENCH_LEGACY
+static uint32_t legacy_strlen(const char *str) {
+    uint32_t i = 0;
+
+    while (str[i] != '\0') {
+        i++;
+    }
+
+    return i;
+}
+
+STRING_BENCH_LEGACY
+static int legacy_strcmp(const char *str1, const char *str2) {
+    uint32_t str1_l = legacy_strlen(str1);
+    uint32_t str2_l = legacy_strlen(str2);
+
+    if (str1_l != str2_l) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < str1_l; i++) {
+        if (str1[i] != str2[i]) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+STRING_BENCH_LEGACY
+static int legacy_strncmp(const char *str1, const char *str2, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (str1[i] > str2[i]) {
+            return 1;
+        } else if (str1[i] < str2[i]) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+STRING_BENCH_LEGACY
+static const char *legacy_strchr(const char *str, char c) {
+    for (uint32_t i = 0; str[i] != '\0'; i++) {
+        if (str[i] == c) {
+            return str + i;
+        }
+    }
+
+    return null;
+}
+
+typedef enum {
+    bench_strlen,
+    bench_legacy_strlen,
+    bench_strcmp,
+    bench_legacy_strcmp,
+    bench_strncmp,
+    bench_legacy_strncmp,
+    bench_strchr,
+    bench_legacy_strchr
+} string_bench_op_t;
+
+//returns the average cycles of a call of op on the two (equal) strings
+static uint64_t string_bench_run(string_bench_op_t op, uint32_t length) {
+    const char *str1 = string_bench_str1;
+    const char *str2 = string_bench_str2;
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < STRING_BENCH_ITERATIONS; i++) {
+        switch (op) {
+            case bench_strlen: string_bench_sink += strlen(str1); break;
+            case bench_legacy_strlen: string_bench_sink += legacy_strlen(str1); break;
+            case bench_strcmp: string_bench_sink += strcmp(str1, str2); break;
+            case bench_legacy_strcmp: string_bench_sink += legacy_strcmp(str1, str2); break;
+            case bench_strncmp: string_bench_sink += strncmp(str1, str2, length); break;
+            case bench_legacy_strncmp: string_bench_sink += legacy_strncmp(str1, str2, length); break;
+            case bench_strchr: string_bench_sink += (uint64_t) strchr(str1, '\t'); break; //not found, scans everything
+            case bench_legacy_strchr: string_bench_sink += (uint64_t) legacy_strchr(str1, '\t'); break;
+        }
+    }
+
+    return (rdtsc() - start) / STRING_BENCH_ITERATIONS;
+}
+
+void string_bench() {
+    printf("length   strlen old/new   strcmp old/new   strncmp old/new   strchr old/new\n");
+
+    for (uint32_t i = 0; i < sizeof(string_bench_inputs) / sizeof(char *); i++) {
+        uint32_t length = strlen(string_bench_inputs[i]);
+        strcpy(string_bench_str1, string_bench_inputs[i]);
+        strcpy(string_bench_str2, string_bench_inputs[i]);
+
+        uint64_t len_old = string_bench_run(bench_legacy_strlen, length);
+        uint64_t len_new = string_bench_run(bench_strlen, length);
+        uint64_t cmp_old = string_bench_run(bench_legacy_strcmp, length);
+        uint64_t cmp_new = string_bench_run(bench_strcmp, length);
+        uint64_t ncmp_old = string_bench_run(bench_legacy_strncmp, length);
+        uint64_t ncmp_new = string_bench_run(bench_strncmp, length);
+        uint64_t chr_old = string_bench_run(bench_legacy_strchr, length);
+        uint64_t chr_new = string_bench_run(bench_strchr, length);
+        printf("%6u   %8lu %6lu  %8lu %6lu   %8lu %6lu   %8lu %6lu\n", length, len_old, len_new, cmp_old, cmp_new, ncmp_old, ncmp_new, chr_old, chr_new);
+    }
+
+    //strtok_r on a command line
+    char command[] = "mount -t fat32 /dev/hda1 /mnt/disk0";
+    char *saveptr;
+    uint32_t tokens = 0;
+    uint64_t start = rdtsc();
+
+    for (char *token = strtok_r(command, " ", &saveptr); token; token = strtok_r(null, " ", &saveptr)) {
+        tokens++;
+    }
+
+    printf("strtok_r: %u tokens in %lu cycles\n", tokens, rdtsc() - start);
+}
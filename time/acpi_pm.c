@@ -0,0 +1,65 @@
+/*
+ACPI power management timer.
+A free running counter at ACPI_PM_FREQUENCY in the chipset, read with a single port access. The FADT gives its port and its width
+(24 bits, or 32 bits with the TMR_VAL_EXT flag). It's slow to read (an i/o cycle, ~1 us) but it doesn't depend on the cpu clock,
+so it's a good reference to measure the other counters against, and the clocksource of last resort (reliable, but the slowest to read
+and wrapping every 4.7 s with 24 bits).
+*/
+
+#include <include/types.h>
+#include <time/include/acpi_pm.h>
+#include <acpi/include/acpi.h>
+#include <io/include/port_io.h>
+#include <time/include/clocksource.h>
+
+extern acpi_fadt_t *__acpi_fadt; //defined in acpi_parser.c
+
+uint16_t acpi_pm_port = 0;
+uint32_t acpi_pm_width = 24;
+clocksource_t acpi_pm_clocksource;
+
+static uint64_t acpi_pm_counter() {
+    return acpi_pm_read();
+}
+
+/*
+finds the pm timer port in the fadt and registers the timer as a clocksource, must be called after init_acpi().
+returns false if there is no pm timer.
+*/
+bool acpi_pm_init() {
+    acpi_fadt_t *fadt = __acpi_fadt;
+
+    if (!fadt) {
+        return false;
+    }
+
+    uint64_t port = fadt->pm_tmr_blk;
+
+    //the 64 bit address of acpi 2.0+ wins, if it's in the i/o space
+    if (fadt->h.length >= __builtin_offsetof(acpi_fadt_t, x_pm_tmr_blk) + sizeof(acpi_gas_t) &&
+        fadt->x_pm_tmr_blk.address_space_id == system_io && fadt->x_pm_tmr_blk.address) {
+        port = fadt->x_pm_tmr_blk.address;
+    }
+
+    if (!port || port > 0xFFFF || fadt->pm_tmr_len < 4) {
+        return false;
+    }
+
+    acpi_pm_port = port;
+    acpi_pm_width = fadt->flags & ACPI_PM_TMR_VAL_EXT ? 32 : 24;
+
+    acpi_pm_clocksource.name = "acpi_pm";
+    acpi_pm_clocksource.read = acpi_pm_counter;
+    acpi_pm_clocksource.mask = acpi_pm_mask();
+    acpi_pm_clocksource.hz = ACPI_PM_FREQUENCY;
+    acpi_pm_clocksource.reliable = true;
+    return clocksource_register(&acpi_pm_clocksource);
+}
+
+uint32_t acpi_pm_read() {
+    return inl(acpi_pm_port) & acpi_pm_mask();
+}
+
+uint32_t acpi_pm_mask() {
+    return (uint32_t)((1ULL << acpi_pm_width) - 1);
+}
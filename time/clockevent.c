@@ -0,0 +1,27 @@
+/*
+Clockevents.
+The drivers of the timer devices (lapic timer, HPET comparators) register them here, timer_init() takes the one with the highest
+rating for the deadlines of the timers. A device registered after timer_init() is listed but not used.
+*/
+
+#include <include/types.h>
+#include <time/include/clockevent.h>
+
+clockevent_t *clockevent_list = null;
+clockevent_t *clockevent_current = null;
+
+//returns false if the device can't be armed or disarmed
+bool clockevent_register(clockevent_t *ce) {
+    if (!ce->arm || !ce->disarm) {
+        return false;
+    }
+
+    ce->next = clockevent_list;
+    clockevent_list = ce;
+
+    if (!clockevent_current || ce->rating > clockevent_current->rating) {
+        clockevent_current = ce;
+    }
+
+    return true;
+}
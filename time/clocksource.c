@@ -0,0 +1,212 @@
+/*
+Clocksources.
+The drivers of the free running counters (TSC, HPET, ACPI pm timer) register them here, and clock_ns(), the monotonic clock of the
+kernel, is built on the best one. Every registration measures the cost of a read (in TSC cycles) and ranks the sources again:
+- a reliable source (constant rate in every power state) beats one that isn't;
+- then the one that tells apart the shortest time, the larger of its resolution and its read cost (a 70 ns counter read in 500 ns is
+  a 500 ns clock);
+- then the cheapest to read.
+clock_ns() is a static call: a source with a 64 bit counter that counts from reset (the TSC) is called directly, the others are read
+through clock_ns_counter(), which adds the counts since the switch to the clock at the switch, over the wraps of the counter.
+A counter narrower than 64 bits has to be read at least once per wrap (4.7 s for a 24 bit pm timer), once the timers run a wheel timer
+reads it every half wrap.
+The clock is kept by one cpu with the interrupts disabled.
+*/
+
+#include <include/types.h>
+#include <time/include/clocksource.h>
+#include <time/include/tsc.h>
+#include <time/include/timer.h>
+#include <time/include/clockevent.h>
+#include <include/low_level.h>
+#include <include/alternatives.h>
+#include <include/klog.h>
+#include <tty/include/tty.h>
+
+clocksource_t *clocksource_list = null;
+clocksource_t *clocksource_current = null;
+bool clocksource_direct = false; //clock_ns() calls the read_ns() of the current source
+uint64_t clocksource_base_ns;    //clock at the switch to the current source
+uint64_t clocksource_last;       //last count read by clock_ns_counter()
+uint64_t clocksource_counts;     //counts since the switch
+wheel_timer_t clocksource_guard;
+bool clocksource_ready = false;
+
+uint64_t clock_ns_none();
+uint64_t clock_ns_counter();
+
+STATIC_CALL(clock_ns, clock_ns_none)
+
+uint64_t clock_ns_none() {
+    return 0;
+}
+
+uint64_t clock_ns_counter() {
+    bool enabled = save_disable_int();
+    clocksource_t *cs = clocksource_current;
+    uint64_t now = cs->read();
+    clocksource_counts += (now - clocksource_last) & cs->mask;
+    clocksource_last = now;
+    uint64_t ns = clocksource_base_ns + clocksource_to_ns(cs, clocksource_counts);
+    restore_int(enabled);
+    return ns;
+}
+
+uint64_t clocksource_to_ns(clocksource_t *cs, uint64_t counts) {
+    return (uint64_t)(((unsigned __int128) counts * cs->mult) >> CLOCKSOURCE_SHIFT);
+}
+
+uint64_t clocksource_resolution_ns(clocksource_t *cs) {
+    uint64_t ns = 1000000000 / cs->hz;
+    return ns ? ns : 1;
+}
+
+//cycles until the TSC is calibrated
+uint64_t clocksource_read_cost_ns(clocksource_t *cs) {
+    return tsc_khz ? cs->read_cycles * 1000000 / tsc_khz : cs->read_cycles;
+}
+
+static bool clocksource_better(clocksource_t *a, clocksource_t *b) {
+    if (a->reliable != b->reliable) {
+        return a->reliable;
+    }
+
+    uint64_t a_cost = clocksource_read_cost_ns(a);
+    uint64_t b_cost = clocksource_read_cost_ns(b);
+    uint64_t a_resolution = clocksource_resolution_ns(a);
+    uint64_t b_resolution = clocksource_resolution_ns(b);
+    uint64_t a_span = a_cost > a_resolution ? a_cost : a_resolution;
+    uint64_t b_span = b_cost > b_resolution ? b_cost : b_resolution;
+
+    if (a_span != b_span) {
+        return a_span < b_span;
+    }
+
+    return a_cost < b_cost;
+}
+
+//reads the clock before the counter of the current source wraps, so clock_ns_counter() sees every wrap
+static void clocksource_guard_arm();
+
+static void clocksource_guard_fn(void *ctx) {
+    clock_ns();
+    clocksource_guard_arm();
+}
+
+static void clocksource_guard_arm() {
+    clocksource_t *cs = clocksource_current;
+
+    if (!clocksource_ready) {
+        return;
+    }
+
+    if (clocksource_direct || cs->mask == 0xFFFFFFFFFFFFFFFF) {
+        wheel_timer_cancel(&clocksource_guard);
+        return;
+    }
+
+    //a wheel timer may fire 1/8 late, half the wrap is still in time
+    uint64_t period_ms = clocksource_to_ns(cs, cs->mask) / 2 / 1000000;
+    wheel_timer_add(&clocksource_guard, period_ms ? period_ms : 1);
+}
+
+//moves clock_ns() to another source, the clock goes on from where it was
+static void clocksource_switch(clocksource_t *cs) {
+    bool enabled = save_disable_int();
+    uint64_t now = clock_ns();
+    clocksource_direct = cs->read_ns && cs->read_ns() >= now;
+
+    if (clocksource_direct) {
+        clocksource_current = cs;
+        static_call_update((void *) clock_ns, (void *) cs->read_ns);
+    } else {
+        clocksource_base_ns = now;
+        clocksource_counts = 0;
+        clocksource_last = cs->read();
+        clocksource_current = cs;
+        static_call_update((void *) clock_ns, (void *) clock_ns_counter);
+    }
+
+    restore_int(enabled);
+    clocksource_guard_arm();
+    klog("clocksource: %s, %lu ns resolution, %lu ns per read\n", cs->name, clocksource_resolution_ns(cs), clocksource_read_cost_ns(cs));
+}
+
+static void clocksource_select() {
+    clocksource_t *best = null;
+
+    for (clocksource_t *cs = clocksource_list; cs; cs = cs->next) {
+        if (!best || clocksource_better(cs, best)) {
+            best = cs;
+        }
+    }
+
+    if (best && best != clocksource_current) {
+        clocksource_switch(best);
+    }
+}
+
+//TSC cycles of a read, with the interrupts disabled
+static uint64_t clocksource_measure(clocksource_t *cs) {
+    bool enabled = save_disable_int();
+    cs->read();
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < CLOCKSOURCE_COST_READS; i++) {
+        cs->read();
+    }
+
+    uint64_t cycles = (rdtsc() - start) / CLOCKSOURCE_COST_READS;
+    restore_int(enabled);
+    return cycles;
+}
+
+/*
+adds a counter to the sources and switches the clock to it if it's the best one.
+returns false if the source has no read function, frequency or width.
+*/
+bool clocksource_register(clocksource_t *cs) {
+    if (!cs->read || !cs->hz || !cs->mask) {
+        return false;
+    }
+
+    cs->mult = (1000000000ULL << CLOCKSOURCE_SHIFT) / cs->hz;
+    cs->read_cycles = clocksource_measure(cs);
+    cs->next = clocksource_list;
+    clocksource_list = cs;
+    clocksource_select();
+    return true;
+}
+
+/*
+ranks the sources again with their read costs in ns (the ones registered before the TSC was calibrated were compared in cycles) and
+starts reading a narrow counter before it wraps. must be called after timer_init().
+*/
+bool clocksource_init() {
+    if (!clocksource_current) {
+        return false;
+    }
+
+    wheel_timer_init(&clocksource_guard, clocksource_guard_fn, null);
+    clocksource_ready = true;
+    clocksource_select();
+    clocksource_guard_arm();
+    return true;
+}
+
+/* terminal command clocksource: the registered counters and timer devices, the ones in use marked with a * */
+void clocksource_print(char *args) {
+    printf("   clocksource    frequency  resolution read cost  reliable\n");
+
+    for (clocksource_t *cs = clocksource_list; cs; cs = cs->next) {
+        printf("%c %12s %9lu hz %8lu ns %7lu ns  %s\n", cs == clocksource_current ? '*' : ' ', cs->name, cs->hz,
+            clocksource_resolution_ns(cs), clocksource_read_cost_ns(cs), cs->reliable ? "yes" : "no");
+    }
+
+    printf("  clockevent rating  vector\n");
+
+    for (clockevent_t *ce = clockevent_list; ce; ce = ce->next) {
+        printf("%c %9s %6u    0x%02X %s\n", ce == clockevent_current ? '*' : ' ', ce->name, ce->rating, ce->vector,
+            ce->per_cpu ? "per cpu" : "global");
+    }
+}
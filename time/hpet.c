@@ -0,0 +1,176 @@
+/*
+High Precision Event Timer.
+A main counter (10 MHz or more, 32 or 64 bits) and at least 3 comparators, in a page of mmio registers found through the HPET acpi
+table. The counter is a reliable clocksource, cheaper to read than the pm timer (a memory read instead of an i/o cycle) and a reference
+to calibrate the TSC against. The first comparator that can interrupt through a free ioapic input is registered as a one-shot
+clockevent, a fallback for the lapic timer: its irq is pinned to the boot cpu, which owns the timers it serves.
+The comparators run in normal routing, the legacy replacement of the pit and rtc irqs stays off.
+*/
+
+#include <include/types.h>
+#include <time/include/hpet.h>
+#include <time/include/clocksource.h>
+#include <time/include/clockevent.h>
+#include <acpi/include/acpi.h>
+#include <acpi/include/acpi_parser.h>
+#include <mm/include/paging.h>
+#include <int/include/int.h>
+#include <int/include/apic.h>
+#include <int/include/irq_domain.h>
+#include <int/include/irq_balance.h>
+#include <include/percpu.h>
+#include <include/klog.h>
+
+volatile uint8_t *hpet_base = null;
+uint64_t hpet_hz = 0;
+uint64_t hpet_mask = 0;
+uint64_t hpet_counts_mult = 0; //counts per ns << CLOCKSOURCE_SHIFT
+clocksource_t hpet_clocksource;
+
+clockevent_t hpet_clockevent;
+uint32_t hpet_event_timer;    //comparator of the clockevent
+uint64_t hpet_event_mask;     //width of the comparator
+uint32_t hpet_event_gsi;
+
+static inline uint64_t hpet_reg_read(uint32_t reg) {
+    return *(volatile uint64_t *)(hpet_base + reg);
+}
+
+static inline void hpet_reg_write(uint32_t reg, uint64_t value) {
+    *(volatile uint64_t *)(hpet_base + reg) = value;
+}
+
+uint64_t hpet_read() {
+    return hpet_reg_read(HPET_COUNTER) & hpet_mask;
+}
+
+/*
+sets the comparator to deadline_ns, converted to counts from now. a comparator only fires when the counter equals it, so if the counter
+passed it before the write, it's written again further away.
+*/
+static void hpet_event_arm(uint64_t deadline_ns) {
+    uint64_t now = clock_ns();
+    uint64_t delta = deadline_ns > now ? deadline_ns - now : 0;
+    uint64_t counts = (uint64_t)(((unsigned __int128) delta * hpet_counts_mult) >> CLOCKSOURCE_SHIFT) + 1;
+
+    //a far deadline of a 32 bit comparator fires early and is armed again by the timers
+    counts = counts > hpet_event_mask / 2 ? hpet_event_mask / 2 : counts;
+    counts = counts < HPET_MIN_DELTA ? HPET_MIN_DELTA : counts;
+    hpet_reg_write(HPET_TIMER_CONFIG(hpet_event_timer), hpet_reg_read(HPET_TIMER_CONFIG(hpet_event_timer)) | HPET_TN_ENABLE);
+
+    while (true) {
+        uint64_t target = (hpet_read() + counts) & hpet_event_mask;
+        hpet_reg_write(HPET_TIMER_COMPARATOR(hpet_event_timer), target);
+
+        if (((hpet_read() - target) & hpet_event_mask) > hpet_event_mask / 2) {
+            return; //still ahead of the counter
+        }
+
+        counts *= 2;
+    }
+}
+
+static void hpet_event_disarm() {
+    hpet_reg_write(HPET_TIMER_CONFIG(hpet_event_timer), hpet_reg_read(HPET_TIMER_CONFIG(hpet_event_timer)) & ~HPET_TN_ENABLE);
+}
+
+//routes the first comparator with a free ioapic input to a new vector, edge triggered and disabled until it's armed
+static bool hpet_event_init(uint32_t timers) {
+    for (uint32_t n = 0; n < timers; n++) {
+        uint64_t config = hpet_reg_read(HPET_TIMER_CONFIG(n));
+        uint32_t routes = HPET_TN_ROUTE_CAP(config);
+
+        //the inputs above the isa irqs first, they're less likely to be wanted by a device
+        for (uint32_t i = 0; i < 32; i++) {
+            uint32_t gsi = (i + IRQ_ISA_COUNT) % 32;
+            irq_desc_t *desc = irq_get_desc(gsi);
+            uint8_t vector;
+
+            if (!(routes & 1U << gsi) || !desc || desc->configured) {
+                continue;
+            }
+
+            config &= ~(uint64_t)(HPET_TN_ROUTE_MASK | HPET_TN_LEVEL | HPET_TN_ENABLE | HPET_TN_PERIODIC | HPET_TN_FSB | HPET_TN_32BIT);
+            hpet_reg_write(HPET_TIMER_CONFIG(n), config | gsi << HPET_TN_ROUTE_SHIFT);
+
+            if (!int_alloc_vector(&vector)) {
+                return false;
+            }
+
+            if (!irq_setup(gsi, vector, active_high, edge, false)) {
+                int_free_vector(vector);
+                return false;
+            }
+
+            irq_pin(gsi, this_cpu()->cpu_index);
+            hpet_event_timer = n;
+            hpet_event_gsi = gsi;
+            hpet_event_mask = config & HPET_TN_64BIT_CAP ? hpet_mask : 0xFFFFFFFF;
+            hpet_clockevent.name = "hpet";
+            hpet_clockevent.arm = hpet_event_arm;
+            hpet_clockevent.disarm = hpet_event_disarm;
+            hpet_clockevent.vector = vector;
+            hpet_clockevent.rating = CLOCKEVENT_RATING_HPET;
+            hpet_clockevent.per_cpu = false;
+            return clockevent_register(&hpet_clockevent);
+        }
+    }
+
+    return false;
+}
+
+/*
+maps the HPET registers, starts the main counter and registers it as a clocksource and a comparator as a clockevent.
+must be called after init_apic(). returns false if there is no usable HPET.
+*/
+bool hpet_init() {
+    acpi_hpet_t *table = (acpi_hpet_t *) acpi_locate_table("HPET", 0);
+
+    if (!table || table->base_address.address_space_id != system_memory || !table->base_address.address) {
+        return false;
+    }
+
+    void *address = (void *) table->base_address.address;
+
+    if (get_physical_address(address) != address && !map_page(address, address)) {
+        return false;
+    }
+
+    hpet_base = (volatile uint8_t *) address;
+    uint64_t capabilities = hpet_reg_read(HPET_CAPABILITIES);
+    uint64_t period = HPET_CAP_PERIOD(capabilities);
+
+    if (!period || period > HPET_MAX_PERIOD_FS) {
+        hpet_base = null;
+        return false;
+    }
+
+    hpet_hz = 1000000000000000ULL / period;
+    hpet_mask = capabilities & HPET_CAP_COUNT_64 ? 0xFFFFFFFFFFFFFFFF : 0xFFFFFFFF;
+    hpet_counts_mult = (hpet_hz << CLOCKSOURCE_SHIFT) / 1000000000;
+
+    //every comparator off before the counter runs, the firmware may have left one armed
+    for (uint32_t n = 0; n < HPET_CAP_TIMERS(capabilities); n++) {
+        hpet_reg_write(HPET_TIMER_CONFIG(n), hpet_reg_read(HPET_TIMER_CONFIG(n)) & ~(uint64_t)(HPET_TN_ENABLE | HPET_TN_PERIODIC));
+    }
+
+    hpet_reg_write(HPET_CONFIG, (hpet_reg_read(HPET_CONFIG) & ~(uint64_t) HPET_CONFIG_LEGACY) | HPET_CONFIG_ENABLE);
+
+    hpet_clocksource.name = "hpet";
+    hpet_clocksource.read = hpet_read;
+    hpet_clocksource.mask = hpet_mask;
+    hpet_clocksource.hz = hpet_hz;
+    hpet_clocksource.reliable = true;
+
+    if (!clocksource_register(&hpet_clocksource)) {
+        return false;
+    }
+
+    klog("hpet: %lu hz, %u bit counter, %u comparators\n", hpet_hz, hpet_mask == 0xFFFFFFFF ? 32 : 64, HPET_CAP_TIMERS(capabilities));
+
+    if (hpet_event_init(HPET_CAP_TIMERS(capabilities))) {
+        klog("hpet: clockevent on comparator %u, gsi %u\n", hpet_event_timer, hpet_event_gsi);
+    }
+
+    return true;
+}
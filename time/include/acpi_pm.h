@@ -0,0 +1,10 @@
+#pragma once
+#include <include/types.h>
+#define ACPI_PM_FREQUENCY 3579545 //hz, fixed by the acpi specification
+#define ACPI_PM_TMR_VAL_EXT (1 << 8) //fadt flag: the counter is 32 bits wide instead of 24
+
+extern uint16_t acpi_pm_port; //0 if the platform has no pm timer
+
+bool acpi_pm_init();
+uint32_t acpi_pm_read();
+uint32_t acpi_pm_mask();
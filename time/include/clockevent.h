@@ -0,0 +1,24 @@
+#pragma once
+#include <include/types.h>
+#define CLOCKEVENT_RATING_LAPIC_DEADLINE 400 //per-cpu, exact to the cycle, one msr write
+#define CLOCKEVENT_RATING_LAPIC_ONESHOT 300  //per-cpu, counter clamped to 32 bits
+#define CLOCKEVENT_RATING_HPET 100           //one device for all the cpus, mmio writes and an ioapic route
+
+/*
+a device that interrupts once at a given time, what the timers (timer.c) arm for their earliest expiry.
+the interrupt arrives on vector, on the cpu that armed it (per_cpu) or on the cpu its irq is pinned to.
+*/
+typedef struct clockevent {
+    const char *name;
+    void (*arm)(uint64_t deadline_ns); //interrupt when clock_ns() reaches deadline_ns, immediately if it's past
+    void (*disarm)();
+    uint8_t vector;
+    uint32_t rating; //the highest one is used
+    bool per_cpu;
+    struct clockevent *next;
+} clockevent_t;
+
+extern clockevent_t *clockevent_current;
+extern clockevent_t *clockevent_list;
+
+bool clockevent_register(clockevent_t *ce);
@@ -0,0 +1,31 @@
+#pragma once
+#include <include/types.h>
+#define CLOCKSOURCE_SHIFT 32      //fixed point of the count -> ns factor
+#define CLOCKSOURCE_COST_READS 64 //reads timed to measure the cost of a read
+
+/*
+a free running counter the kernel clock can be built on.
+the registry measures the cost of a read and ranks the sources: the reliable ones first, then the one whose reading tells apart the
+shortest time (the larger of its resolution and its read cost), then the cheapest to read.
+*/
+typedef struct clocksource {
+    const char *name;
+    uint64_t (*read)();    //raw counter
+    uint64_t (*read_ns)(); //optional: ns since reset of a 64 bit counter, used as the clock directly instead of accumulating counts
+    uint64_t mask;         //the counter wraps at mask + 1
+    uint64_t hz;
+    bool reliable;         //constant rate in every power state and on every cpu
+    uint64_t mult;         //ns per count << CLOCKSOURCE_SHIFT, set by clocksource_register()
+    uint64_t read_cycles;  //TSC cycles of a read, set by clocksource_register()
+    struct clocksource *next;
+} clocksource_t;
+
+extern clocksource_t *clocksource_current;
+
+uint64_t clock_ns();
+bool clocksource_register(clocksource_t *cs);
+bool clocksource_init();
+uint64_t clocksource_to_ns(clocksource_t *cs, uint64_t counts);
+uint64_t clocksource_resolution_ns(clocksource_t *cs);
+uint64_t clocksource_read_cost_ns(clocksource_t *cs);
+void clocksource_print(char *args);
@@ -0,0 +1,34 @@
+#pragma once
+#include <include/types.h>
+
+/* registers, offsets from the base address */
+
+#define HPET_CAPABILITIES 0x000
+#define HPET_CONFIG 0x010
+#define HPET_COUNTER 0x0F0
+#define HPET_TIMER_CONFIG(n) (0x100 + 0x20 * (n))
+#define HPET_TIMER_COMPARATOR(n) (0x108 + 0x20 * (n))
+
+#define HPET_CAP_COUNT_64 (1 << 13)                     //the main counter is 64 bits wide
+#define HPET_CAP_TIMERS(cap) ((((cap) >> 8) & 0x1F) + 1) //number of comparators
+#define HPET_CAP_PERIOD(cap) ((cap) >> 32)              //femtoseconds per count
+#define HPET_MAX_PERIOD_FS 100000000                    //the specification caps the period at 100 ns
+#define HPET_CONFIG_ENABLE (1 << 0)                     //the main counter runs
+#define HPET_CONFIG_LEGACY (1 << 1)                     //comparators 0 and 1 replace the pit and rtc irqs
+
+#define HPET_TN_LEVEL (1 << 1)
+#define HPET_TN_ENABLE (1 << 2)
+#define HPET_TN_PERIODIC (1 << 3)
+#define HPET_TN_64BIT_CAP (1 << 5)
+#define HPET_TN_32BIT (1 << 8)
+#define HPET_TN_ROUTE_SHIFT 9
+#define HPET_TN_ROUTE_MASK (0x1F << HPET_TN_ROUTE_SHIFT)
+#define HPET_TN_FSB (1 << 14)
+#define HPET_TN_ROUTE_CAP(config) ((config) >> 32)       //bit n: the comparator can be routed to ioapic input n
+#define HPET_MIN_DELTA 128 //counts (~9 us at 14.3 MHz), a closer deadline may be passed before the comparator is written
+
+extern uint64_t hpet_hz;   //0 if there is no HPET
+extern uint64_t hpet_mask; //the main counter wraps at hpet_mask + 1
+
+bool hpet_init();
+uint64_t hpet_read();
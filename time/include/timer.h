@@ -0,0 +1,66 @@
+#pragma once
+#include <include/types.h>
+#define TIMER_TICK_NS 1000000         //granularity of the wheel (1 ms)
+#define TIMER_WHEEL_LEVELS 6
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS) //slots per level, one bit each in the pending map of the level
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_LEVEL_SHIFT_BITS 3      //every level is 8 times coarser than the previous one
+#define TIMER_LEVEL_SHIFT(level) ((level) * TIMER_LEVEL_SHIFT_BITS)
+#define TIMER_LEVEL_START(level) ((uint64_t) TIMER_WHEEL_MASK << TIMER_LEVEL_SHIFT((level) - 1)) //first timeout (ticks) of a level
+#define TIMER_WHEEL_CUTOFF TIMER_LEVEL_START(TIMER_WHEEL_LEVELS)
+#define TIMER_WHEEL_MAX (TIMER_WHEEL_CUTOFF - (1ULL << TIMER_LEVEL_SHIFT(TIMER_WHEEL_LEVELS - 1))) //longer timeouts are clamped (~34 min)
+#define HRTIMER_HEAP_SIZE 256         //pending hrtimers per cpu
+#define HRTIMER_INACTIVE 0xFFFFFFFF   //heap index of a timer that isn't queued
+#define TIMER_NONE 0xFFFFFFFFFFFFFFFF //no expiry
+
+typedef void (*timer_fn_t)(void *ctx);
+
+/*
+coarse timer (timeouts, watchdogs, retries): expires in wheel ticks, may fire up to 1/8 of its timeout late, never early.
+the callback runs in the timer softirq.
+*/
+typedef struct wheel_timer {
+    struct wheel_timer *next;
+    struct wheel_timer **pprev; //the link that points to this timer, unlinked in O(1)
+    struct timer_base *base;    //cpu the timer is queued on, null if it isn't
+    uint64_t expires;           //tick (clock_ns() / TIMER_TICK_NS)
+    uint32_t slot;              //level * TIMER_WHEEL_SLOTS + slot of the level
+    timer_fn_t fn;
+    void *ctx;
+} wheel_timer_t;
+
+/*
+precise timer: expires at a clock_ns() time, the callback runs in the timer interrupt with the interrupts disabled.
+*/
+typedef struct hrtimer {
+    uint64_t expires;
+    uint32_t index; //position in the heap of base, HRTIMER_INACTIVE if it isn't queued
+    struct timer_base *base;
+    timer_fn_t fn;
+    void *ctx;
+} hrtimer_t;
+
+//timers of a cpu, only touched by that cpu with the interrupts disabled
+typedef struct timer_base {
+    uint64_t clk; //next wheel tick to expire
+    uint64_t pending[TIMER_WHEEL_LEVELS]; //bit n: slot n of the level isn't empty
+    wheel_timer_t *slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+    hrtimer_t *heap[HRTIMER_HEAP_SIZE]; //min-heap by expiry
+    uint32_t heap_count;
+    uint64_t armed; //clock_ns() deadline programmed in the lapic timer, TIMER_NONE if disarmed
+    bool wheel_raised; //the softirq will expire the wheel, its deadline isn't armed meanwhile
+} timer_base_t;
+
+bool timer_init();
+bool timer_init_cpu();
+uint64_t timer_ticks();
+void wheel_timer_init(wheel_timer_t *timer, timer_fn_t fn, void *ctx);
+bool wheel_timer_add(wheel_timer_t *timer, uint64_t timeout_ms);
+bool wheel_timer_cancel(wheel_timer_t *timer);
+bool wheel_timer_pending(wheel_timer_t *timer);
+void hrtimer_init(hrtimer_t *timer, timer_fn_t fn, void *ctx);
+bool hrtimer_start(hrtimer_t *timer, uint64_t expires_ns);
+bool hrtimer_cancel(hrtimer_t *timer);
+bool hrtimer_pending(hrtimer_t *timer);
+bool timer_sleep_ns(uint64_t ns);
@@ -0,0 +1,28 @@
+#pragma once
+#include <include/types.h>
+#include <time/include/clocksource.h>
+#define TSC_SHIFT 32                //fixed point of the cycles <-> ns conversion factors
+#define TSC_CALIBRATION_MS 10       //measurement window of the calibration against the HPET, the pm timer or the pit
+#define TSC_CALIBRATION_POLLS 10000000 //reads of the reference before giving up on it (several seconds)
+#define TSC_NOMINAL_ERROR_PPM 10000 //error bound given to the nominal frequency from cpuid, used when nothing can measure the TSC
+#define TSC_NOMINAL_TOLERANCE 10 //a measurement more than 1/10 off the nominal frequency is rejected
+#define IA32_TSC_DEADLINE_MSR 0x6E0
+
+typedef enum {
+    tsc_source_none,
+    tsc_source_cpuid,   //frequency enumerated by cpuid leaf 0x15 (crystal and ratio), on bare metal
+    tsc_source_hpet,    //measured against the HPET
+    tsc_source_acpi_pm, //measured against the acpi pm timer
+    tsc_source_pit,     //measured against a one-shot count of pit channel 2
+    tsc_source_nominal  //nominal frequency from cpuid (leaf 0x16, or 0x15 under a hypervisor), nothing to measure against
+} tsc_source_t;
+
+extern uint64_t tsc_khz; //0 until tsc_init()
+extern uint64_t tsc_crystal_khz; //core crystal clock from cpuid leaf 0x15, 0 if not enumerated
+extern uint64_t tsc_error_ppm; //bound of the calibration error, 0 if the frequency was enumerated by leaf 0x15
+
+bool tsc_init();
+bool tsc_reliable();
+uint64_t tsc_to_ns(uint64_t cycles);
+uint64_t ns_to_tsc(uint64_t ns);
+uint64_t clock_ns_tsc();
@@ -0,0 +1,500 @@
+/*
+Timers.
+Every cpu has a timer_base_t with two kinds of timers, both driven by the clockevent device with the best rating (the lapic timer of the
+cpu unless it isn't usable, see clockevent.c):
+- wheel timers, for timeouts that are usually cancelled before they expire. The wheel has TIMER_WHEEL_LEVELS levels of
+  TIMER_WHEEL_SLOTS slots, level n counts in steps of 8^n ticks, so a timer goes to the first level whose range covers its timeout and
+  fires at most 1/8 of the timeout late. Timers are never cascaded to the lower levels: a slot expires as a whole when the wheel clock
+  reaches it. Add and cancel are O(1) (a list push and an unlink), the next expiry is found from the pending bitmaps of the levels.
+- hrtimers, in a min-heap by expiry. Every timer remembers its heap index, so start, modify and cancel are O(log n).
+There is no periodic tick: the clockevent is armed once, for the earliest of the heap top and the next wheel slot, and re-armed by
+the timer interrupt and by the operations that change the earliest expiry.
+The hrtimer callbacks run in the timer interrupt, the wheel callbacks in the timer softirq with the interrupts enabled.
+A timer is added, modified and cancelled on the cpu it runs on.
+*/
+
+#include <include/types.h>
+#include <time/include/timer.h>
+#include <time/include/clocksource.h>
+#include <int/include/int.h>
+#include <time/include/clockevent.h>
+#include <int/include/softirq.h>
+#include <include/percpu.h>
+#include <include/low_level.h>
+#include <include/mem.h>
+#include <include/klog.h>
+#include <mm/include/kmalloc.h>
+
+clockevent_t *timer_event = null; //device armed for the deadlines, taken by timer_init()
+
+//current wheel tick
+uint64_t timer_ticks() {
+    return clock_ns() / TIMER_TICK_NS;
+}
+
+/* wheel */
+
+/*
+slot of a timer that expires at tick expires, and in bucket_expiry the tick the slot expires at.
+the expiry is rounded up to the granularity of the level (a timer armed in the middle of a tick must not fire early).
+*/
+static uint32_t timer_wheel_index(uint64_t expires, uint64_t clk, uint64_t *bucket_expiry) {
+    if (expires < clk) {
+        *bucket_expiry = clk;
+        return clk & TIMER_WHEEL_MASK;
+    }
+
+    if (expires - clk >= TIMER_WHEEL_CUTOFF) {
+        expires = clk + TIMER_WHEEL_MAX;
+    }
+
+    uint64_t delta = expires - clk;
+    uint32_t level = 0;
+
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= TIMER_LEVEL_START(level + 1)) {
+        level++;
+    }
+
+    expires = (expires >> TIMER_LEVEL_SHIFT(level)) + 1;
+    *bucket_expiry = expires << TIMER_LEVEL_SHIFT(level);
+    return level * TIMER_WHEEL_SLOTS + (expires & TIMER_WHEEL_MASK);
+}
+
+//tick of the first slot that isn't empty, TIMER_NONE if the wheel is empty
+static uint64_t timer_wheel_next(timer_base_t *base) {
+    uint64_t next = TIMER_NONE;
+    uint64_t clk = base->clk;
+
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t pending = base->pending[level];
+        uint32_t pos = clk & TIMER_WHEEL_MASK;
+
+        if (pending) {
+            //slots after the clock of the level first, then the ones that wrap around
+            uint64_t rotated = pos ? pending >> pos | pending << (TIMER_WHEEL_SLOTS - pos) : pending;
+            uint64_t expiry = (clk + __builtin_ctzll(rotated)) << TIMER_LEVEL_SHIFT(level);
+            next = expiry < next ? expiry : next;
+        }
+
+        //the next slot of the upper level is the one the clock reaches when the lower bits wrap
+        bool adjust = (clk & ((1 << TIMER_LEVEL_SHIFT_BITS) - 1)) != 0;
+        clk = (clk >> TIMER_LEVEL_SHIFT_BITS) + adjust;
+    }
+
+    return next;
+}
+
+static void timer_wheel_unlink(wheel_timer_t *timer) {
+    timer_base_t *base = timer->base;
+    *timer->pprev = timer->next;
+
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+
+    if (!base->slots[timer->slot]) {
+        base->pending[timer->slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (timer->slot % TIMER_WHEEL_SLOTS));
+    }
+
+    timer->next = null;
+    timer->pprev = null;
+    timer->base = null;
+}
+
+/*
+moves the clock of an idle wheel to the current tick, so a new timer gets a level for its real timeout.
+the clock can't pass a slot that isn't empty.
+*/
+static void timer_wheel_forward(timer_base_t *base, uint64_t now) {
+    if (now > base->clk && timer_wheel_next(base) >= now) {
+        base->clk = now;
+    }
+}
+
+/*
+takes the slots that expire at the current clock off the wheel: the slot of level 0 and, when the clock is a multiple of their
+granularity, the ones of the upper levels. returns the number of lists in expired.
+*/
+static uint32_t timer_wheel_collect(timer_base_t *base, wheel_timer_t **expired) {
+    uint64_t clk = base->clk;
+    uint32_t count = 0;
+
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32_t slot = level * TIMER_WHEEL_SLOTS + (clk & TIMER_WHEEL_MASK);
+
+        if (base->pending[level] & 1ULL << (clk & TIMER_WHEEL_MASK)) {
+            base->pending[level] &= ~(1ULL << (clk & TIMER_WHEEL_MASK));
+            expired[count] = base->slots[slot];
+            expired[count]->pprev = &expired[count]; //a callback may cancel a timer of the list
+            base->slots[slot] = null;
+            count++;
+        }
+
+        if (clk & ((1 << TIMER_LEVEL_SHIFT_BITS) - 1)) {
+            break;
+        }
+
+        clk >>= TIMER_LEVEL_SHIFT_BITS;
+    }
+
+    return count;
+}
+
+/* hrtimer heap */
+
+static void hrtimer_heap_up(timer_base_t *base, uint32_t i) {
+    hrtimer_t *timer = base->heap[i];
+
+    while (i) {
+        uint32_t parent = (i - 1) / 2;
+
+        if (base->heap[parent]->expires <= timer->expires) {
+            break;
+        }
+
+        base->heap[i] = base->heap[parent];
+        base->heap[i]->index = i;
+        i = parent;
+    }
+
+    base->heap[i] = timer;
+    timer->index = i;
+}
+
+static void hrtimer_heap_down(timer_base_t *base, uint32_t i) {
+    hrtimer_t *timer = base->heap[i];
+
+    while (true) {
+        uint32_t child = i * 2 + 1;
+
+        if (child >= base->heap_count) {
+            break;
+        }
+
+        if (child + 1 < base->heap_count && base->heap[child + 1]->expires < base->heap[child]->expires) {
+            child++;
+        }
+
+        if (timer->expires <= base->heap[child]->expires) {
+            break;
+        }
+
+        base->heap[i] = base->heap[child];
+        base->heap[i]->index = i;
+        i = child;
+    }
+
+    base->heap[i] = timer;
+    timer->index = i;
+}
+
+static void hrtimer_heap_remove(timer_base_t *base, hrtimer_t *timer) {
+    uint32_t i = timer->index;
+    hrtimer_t *last = base->heap[--base->heap_count];
+    timer->index = HRTIMER_INACTIVE;
+    timer->base = null;
+
+    //the last timer fills the hole and moves up or down from there
+    if (last != timer) {
+        base->heap[i] = last;
+        last->index = i;
+        hrtimer_heap_up(base, i);
+        hrtimer_heap_down(base, last->index);
+    }
+}
+
+/* hardware deadline */
+
+//arms the clockevent for the earliest expiry of the cpu, if it changed
+static void timer_reprogram(timer_base_t *base) {
+    uint64_t next = base->heap_count ? base->heap[0]->expires : TIMER_NONE;
+
+    if (!base->wheel_raised) {
+        uint64_t tick = timer_wheel_next(base);
+
+        if (tick != TIMER_NONE && tick * TIMER_TICK_NS < next) {
+            next = tick * TIMER_TICK_NS;
+        }
+    }
+
+    if (next == base->armed) {
+        return;
+    }
+
+    base->armed = next;
+
+    if (next == TIMER_NONE) {
+        timer_event->disarm();
+    } else {
+        timer_event->arm(next);
+    }
+}
+
+/*
+clockevent interrupt: runs the hrtimers that expired, leaves the expired wheel slots to the softirq and arms the next deadline.
+a one-shot counter clamped to 32 bits can fire before any timer expired, then the deadline is just armed again.
+*/
+static bool timer_interrupt(int_regs_t *regs, void *ctx) {
+    timer_base_t *base = this_cpu()->timers;
+
+    //a deadline left by the firmware or armed before timer_init_cpu(), nothing to run
+    if (!base) {
+        return true;
+    }
+
+    base->armed = TIMER_NONE;
+    uint64_t now = clock_ns();
+
+    //a callback can start timers (itself too), they're in the heap before the next iteration
+    while (base->heap_count && base->heap[0]->expires <= now) {
+        hrtimer_t *timer = base->heap[0];
+        hrtimer_heap_remove(base, timer);
+        timer->fn(timer->ctx);
+    }
+
+    if (!base->wheel_raised && timer_wheel_next(base) <= now / TIMER_TICK_NS) {
+        base->wheel_raised = true;
+        softirq_raise(softirq_timer);
+    }
+
+    timer_reprogram(base);
+    return true;
+}
+
+/*
+expires the wheel slots up to the current tick. the clock jumps from one slot that isn't empty to the next, an idle wheel costs nothing.
+the callbacks run with the interrupts enabled, a timer can be added or cancelled by any of them.
+*/
+static void timer_softirq(void *ctx) {
+    timer_base_t *base = this_cpu()->timers;
+
+    if (!base) {
+        return;
+    }
+
+    bool enabled = save_disable_int();
+    base->wheel_raised = false;
+    uint64_t now = timer_ticks();
+
+    while (true) {
+        uint64_t next = timer_wheel_next(base);
+
+        if (next > now) {
+            break;
+        }
+
+        base->clk = next > base->clk ? next : base->clk;
+        wheel_timer_t *expired[TIMER_WHEEL_LEVELS];
+        uint32_t count = timer_wheel_collect(base, expired);
+        base->clk++;
+
+        for (uint32_t i = 0; i < count; i++) {
+            while (expired[i]) {
+                wheel_timer_t *timer = expired[i];
+                timer_wheel_unlink(timer);
+                restore_int(enabled);
+                timer->fn(timer->ctx);
+                disable_int();
+            }
+        }
+    }
+
+    if (base->clk <= now) {
+        base->clk = now + 1;
+    }
+
+    timer_reprogram(base);
+    restore_int(enabled);
+}
+
+/* wheel timers */
+
+void wheel_timer_init(wheel_timer_t *timer, timer_fn_t fn, void *ctx) {
+    memclear(timer, sizeof(wheel_timer_t));
+    timer->fn = fn;
+    timer->ctx = ctx;
+}
+
+/*
+(re)arms a wheel timer to fire in timeout_ms, a pending timer is moved to its new expiry.
+returns false if the timers of this cpu are not initialized.
+*/
+bool wheel_timer_add(wheel_timer_t *timer, uint64_t timeout_ms) {
+    timer_base_t *base = this_cpu()->timers;
+
+    if (!base) {
+        return false;
+    }
+
+    bool enabled = save_disable_int();
+
+    if (timer->base) {
+        timer_wheel_unlink(timer);
+    }
+
+    uint64_t now = timer_ticks();
+    timer_wheel_forward(base, now);
+
+    uint64_t bucket_expiry;
+    timer->expires = now + timeout_ms * 1000000 / TIMER_TICK_NS;
+    timer->slot = timer_wheel_index(timer->expires, base->clk, &bucket_expiry);
+    timer->base = base;
+    timer->pprev = &base->slots[timer->slot];
+    timer->next = base->slots[timer->slot];
+
+    if (timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+
+    base->slots[timer->slot] = timer;
+    base->pending[timer->slot / TIMER_WHEEL_SLOTS] |= 1ULL << (timer->slot % TIMER_WHEEL_SLOTS);
+    timer_reprogram(base);
+    restore_int(enabled);
+    return true;
+}
+
+//returns true if the timer was pending (its callback won't run)
+bool wheel_timer_cancel(wheel_timer_t *timer) {
+    bool enabled = save_disable_int();
+    timer_base_t *base = timer->base;
+
+    if (!base) {
+        restore_int(enabled);
+        return false;
+    }
+
+    timer_wheel_unlink(timer);
+    timer_reprogram(base);
+    restore_int(enabled);
+    return true;
+}
+
+bool wheel_timer_pending(wheel_timer_t *timer) {
+    return timer->base != null;
+}
+
+/* hrtimers */
+
+void hrtimer_init(hrtimer_t *timer, timer_fn_t fn, void *ctx) {
+    memclear(timer, sizeof(hrtimer_t));
+    timer->index = HRTIMER_INACTIVE;
+    timer->fn = fn;
+    timer->ctx = ctx;
+}
+
+/*
+(re)arms a hrtimer to fire when clock_ns() reaches expires_ns, a pending timer is moved in place to its new expiry.
+returns false if the timers of this cpu are not initialized or HRTIMER_HEAP_SIZE timers are already pending.
+*/
+bool hrtimer_start(hrtimer_t *timer, uint64_t expires_ns) {
+    bool enabled = save_disable_int();
+    timer_base_t *base = timer->base ? timer->base : this_cpu()->timers;
+
+    if (!base || (!timer->base && base->heap_count == HRTIMER_HEAP_SIZE)) {
+        restore_int(enabled);
+        return false;
+    }
+
+    timer->expires = expires_ns;
+
+    if (timer->base) {
+        hrtimer_heap_up(base, timer->index);
+        hrtimer_heap_down(base, timer->index);
+    } else {
+        timer->base = base;
+        base->heap[base->heap_count] = timer;
+        hrtimer_heap_up(base, base->heap_count++);
+    }
+
+    timer_reprogram(base);
+    restore_int(enabled);
+    return true;
+}
+
+//returns true if the timer was pending (its callback won't run)
+bool hrtimer_cancel(hrtimer_t *timer) {
+    bool enabled = save_disable_int();
+    timer_base_t *base = timer->base;
+
+    if (!base) {
+        restore_int(enabled);
+        return false;
+    }
+
+    hrtimer_heap_remove(base, timer);
+    timer_reprogram(base);
+    restore_int(enabled);
+    return true;
+}
+
+bool hrtimer_pending(hrtimer_t *timer) {
+    return timer->base != null;
+}
+
+static void timer_sleep_wake(void *ctx) {
+    *(volatile bool *) ctx = true;
+}
+
+/*
+halts the cpu for ns nanoseconds with a hrtimer, any number of sleepers can wait at the same time.
+must be called with the interrupts enabled. returns false if the timer can't be started.
+*/
+bool timer_sleep_ns(uint64_t ns) {
+    volatile bool done = false;
+    hrtimer_t timer;
+    hrtimer_init(&timer, timer_sleep_wake, (void *) &done);
+
+    if (!hrtimer_start(&timer, clock_ns() + ns)) {
+        return false;
+    }
+
+    disable_int();
+
+    while (!done) {
+        wait_for_int();
+        disable_int();
+    }
+
+    enable_int();
+    return true;
+}
+
+//allocates the timers of the current cpu, after timer_init() on the boot cpu
+bool timer_init_cpu() {
+    timer_base_t *base = kmalloc(sizeof(timer_base_t));
+
+    if (!base) {
+        return false;
+    }
+
+    memclear(base, sizeof(timer_base_t));
+    base->clk = timer_ticks();
+    base->armed = TIMER_NONE;
+    timer_event->disarm();
+    this_cpu()->timers = base;
+    return true;
+}
+
+/*
+initializes the timers of the boot cpu on the best clockevent and takes its vector.
+needs a clocksource (clock_ns()) and a registered clockevent (apic_timer_init(), hpet_init()).
+*/
+bool timer_init() {
+    if (!clocksource_current || !clockevent_current) {
+        return false;
+    }
+
+    timer_event = clockevent_current;
+
+    if (!softirq_open(softirq_timer, timer_softirq, null) || !int_hook(timer_event->vector, timer_interrupt, null, null)) {
+        return false;
+    }
+
+    if (!timer_init_cpu()) {
+        return false;
+    }
+
+    klog("timer: %u wheel levels of %u ms to %u ms, %u hrtimers per cpu, on %s\n", TIMER_WHEEL_LEVELS, TIMER_TICK_NS / 1000000,
+        (uint32_t)(TIMER_WHEEL_MAX * TIMER_TICK_NS / 1000000), HRTIMER_HEAP_SIZE, timer_event->name);
+    return true;
+}
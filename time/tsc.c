@@ -0,0 +1,269 @@
+/*
+TSC clocksource.
+tsc_init() finds the frequency of the TSC, from cpuid when the cpu enumerates it exactly (leaf 0x15: crystal frequency and TSC/crystal
+ratio, not trusted under a hypervisor) or by counting cycles over a single TSC_CALIBRATION_MS window of the best reference there is: the
+HPET, the acpi pm timer, or else a one-shot count of pit channel 2 (polled, no interrupts). The base frequency of leaf 0x16 is only the
+nominal one, a first guess: a measurement more than 1/TSC_NOMINAL_TOLERANCE away from it is dropped for the next reference, and it's
+used if none of the references works. The error bound of the frequency is printed with it.
+Cycles and nanoseconds are converted with a multiplication by a 32.32 fixed point factor and a shift, no division on the read path.
+The TSC is then registered as a clocksource (clocksource.c), read directly by clock_ns() in ns since reset when it's the best one.
+With an invariant TSC (constant rate in every P/C state) it's a reliable clock, without it the frequency may change with the cpu clock
+and the HPET or the pm timer is preferred.
+*/
+
+#include <include/types.h>
+#include <time/include/tsc.h>
+#include <include/low_level.h>
+#include <include/cpu.h>
+#include <io/include/pit.h>
+#include <time/include/acpi_pm.h>
+#include <time/include/hpet.h>
+#include <tty/include/tty.h>
+
+uint64_t tsc_khz = 0;
+uint64_t tsc_crystal_khz = 0;
+uint64_t tsc_error_ppm = 0;
+uint64_t tsc_ns_mult = 0;   //ns per cycle << TSC_SHIFT
+uint64_t tsc_cycle_mult = 0; //cycles per ns << TSC_SHIFT
+tsc_source_t tsc_source = tsc_source_none;
+const char *tsc_source_names[] = {"none", "cpuid", "hpet", "acpi pm timer", "pit", "cpuid nominal"};
+clocksource_t tsc_clocksource;
+
+uint64_t clock_ns_tsc() {
+    return tsc_to_ns(rdtsc());
+}
+
+uint64_t tsc_to_ns(uint64_t cycles) {
+    return (uint64_t)(((unsigned __int128) cycles * tsc_ns_mult) >> TSC_SHIFT);
+}
+
+uint64_t ns_to_tsc(uint64_t ns) {
+    return (uint64_t)(((unsigned __int128) ns * tsc_cycle_mult) >> TSC_SHIFT);
+}
+
+/*
+frequency enumerated by cpuid leaf 0x15 (crystal frequency and TSC/crystal ratio), in khz, 0 if it isn't.
+nominal_khz gets the same value or, without it, the base frequency of leaf 0x16: the nominal frequency of the processor, a first guess
+of the TSC rate that can be thousands of ppm off, 0 if neither leaf has it.
+*/
+static uint64_t tsc_cpuid_khz(uint64_t *nominal_khz) {
+    uint32_t eax, ebx, ecx, edx;
+    *nominal_khz = 0;
+
+    if (cpu_features.max_leaf >= 0x15) {
+        cpuid(0x15, &eax, &ebx, &ecx, &edx);
+
+        //tsc = crystal * ebx / eax, the crystal frequency (ecx) is optional
+        if (eax && ebx && ecx) {
+            tsc_crystal_khz = ecx / 1000;
+            *nominal_khz = (uint64_t) ecx * ebx / eax / 1000;
+            return *nominal_khz;
+        }
+    }
+
+    if (cpu_features.max_leaf >= 0x16) {
+        cpuid(0x16, &eax, &ebx, &ecx, &edx);
+
+        //base frequency in mhz
+        *nominal_khz = (uint64_t)(eax & 0xFFFF) * 1000;
+    }
+
+    return 0;
+}
+
+/*
+counts the cycles in TSC_CALIBRATION_MS of HPET, 0 if there is no HPET.
+the counter is read between two TSC reads at both ends of the window, the error is half of both reads and one HPET period.
+*/
+static uint64_t tsc_hpet_khz(uint64_t *error_ppm) {
+    if (!hpet_hz) {
+        return 0;
+    }
+
+    uint64_t window = hpet_hz / 1000 * TSC_CALIBRATION_MS;
+    uint64_t start_before = rdtsc();
+    uint64_t start_count = hpet_read();
+    uint64_t start = rdtsc();
+    uint64_t end_before, end_count, end;
+    uint32_t i = 0;
+
+    do {
+        if (i++ == TSC_CALIBRATION_POLLS) {
+            return 0;
+        }
+
+        end_before = rdtsc();
+        end_count = hpet_read();
+        end = rdtsc();
+    } while (((end_count - start_count) & hpet_mask) < window);
+
+    uint64_t counts = (end_count - start_count) & hpet_mask;
+    uint64_t cycles = (end + end_before - start - start_before) / 2;
+    *error_ppm = ((start - start_before + end - end_before) / 2 + cycles / counts) * 1000000 / cycles + 1;
+    return cycles * hpet_hz / counts / 1000;
+}
+
+/*
+waits for the next increment of the pm timer and returns the new value. tsc is the cycle count right after the read that saw it and
+uncertainty how long before that the edge may have been (back to the previous read). returns false if the counter doesn't move.
+*/
+static bool tsc_acpi_pm_edge(uint32_t *value, uint64_t *tsc, uint64_t *uncertainty) {
+    uint64_t last = rdtsc();
+    uint32_t prev = acpi_pm_read();
+
+    for (uint32_t i = 0; i < TSC_CALIBRATION_POLLS; i++) {
+        uint64_t before = rdtsc();
+        uint32_t read = acpi_pm_read();
+        uint64_t after = rdtsc();
+
+        if (read != prev) {
+            *value = read;
+            *tsc = after;
+            *uncertainty = after - last;
+            return true;
+        }
+
+        last = before;
+    }
+
+    return false;
+}
+
+/*
+counts the cycles between two edges of the pm timer TSC_CALIBRATION_MS apart, 0 if there is no pm timer.
+the window is an exact number of pm ticks, the error is only the uncertainty of the two edges.
+*/
+static uint64_t tsc_acpi_pm_khz(uint64_t *error_ppm) {
+    if (!acpi_pm_port) {
+        return 0;
+    }
+
+    uint32_t mask = acpi_pm_mask();
+    uint32_t start_value, end_value;
+    uint64_t start, end, start_uncertainty, end_uncertainty;
+
+    if (!tsc_acpi_pm_edge(&start_value, &start, &start_uncertainty)) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; ((acpi_pm_read() - start_value) & mask) < ACPI_PM_FREQUENCY / 1000 * TSC_CALIBRATION_MS; i++) {
+        if (i == TSC_CALIBRATION_POLLS) {
+            return 0;
+        }
+    }
+
+    if (!tsc_acpi_pm_edge(&end_value, &end, &end_uncertainty)) {
+        return 0;
+    }
+
+    uint64_t ticks = (end_value - start_value) & mask;
+    uint64_t cycles = end - start;
+    *error_ppm = (start_uncertainty + end_uncertainty) * 1000000 / cycles + 1;
+    return cycles * ACPI_PM_FREQUENCY / ticks / 1000;
+}
+
+/*
+counts the cycles of a one-shot count of pit channel 2, 0 if it never runs out.
+the output goes high between count and count + 1 ticks after the count is written (the count starts on the next pit clock edge), the
+half tick in between is part of the error, with the time of the write and of the last poll.
+*/
+static uint64_t tsc_pit_khz(uint64_t *error_ppm) {
+    uint32_t count = PIT_FREQUENCY / 1000 * TSC_CALIBRATION_MS;
+    uint64_t before = rdtsc();
+    pit_oneshot_start(count);
+    uint64_t start = rdtsc();
+    uint64_t last = start, end = 0;
+
+    for (uint32_t i = 0; i < TSC_CALIBRATION_POLLS; i++) {
+        uint64_t now = rdtsc();
+
+        if (pit_oneshot_done()) {
+            end = rdtsc();
+            break;
+        }
+
+        last = now;
+    }
+
+    if (!end) {
+        return 0;
+    }
+
+    uint64_t cycles = end - start;
+    uint64_t half_tick = cycles / count / 2;
+    *error_ppm = (start - before + end - last + half_tick) * 1000000 / cycles + 1;
+    return cycles * PIT_FREQUENCY * 2 / (count * 2 + 1) / 1000;
+}
+
+//a measurement far from the nominal frequency comes from a broken reference, the next one is tried
+static uint64_t tsc_check_nominal(uint64_t khz, uint64_t nominal_khz) {
+    uint64_t delta = khz > nominal_khz ? khz - nominal_khz : nominal_khz - khz;
+    return nominal_khz && delta > nominal_khz / TSC_NOMINAL_TOLERANCE ? 0 : khz;
+}
+
+/*
+calibrates the TSC and makes it the kernel clock.
+must be called after hpet_init() and acpi_pm_init(), their counters are the preferred references of the measurement.
+*/
+bool tsc_init() {
+    if (!cpu_has(CPU_FEATURE_TSC)) {
+        return false;
+    }
+
+    uint64_t start = rdtsc();
+    uint64_t nominal_khz;
+    uint64_t khz = tsc_cpuid_khz(&nominal_khz);
+    tsc_source = tsc_source_cpuid;
+    tsc_error_ppm = 0;
+
+    //a hypervisor enumerates the frequency of the host, the guest TSC may be scaled or emulated: it's measured like without leaf 0x15
+    if (cpu_has(CPU_FEATURE_HYPERVISOR)) {
+        khz = 0;
+    }
+
+    if (!khz) {
+        khz = tsc_check_nominal(tsc_hpet_khz(&tsc_error_ppm), nominal_khz);
+        tsc_source = tsc_source_hpet;
+    }
+
+    if (!khz) {
+        khz = tsc_check_nominal(tsc_acpi_pm_khz(&tsc_error_ppm), nominal_khz);
+        tsc_source = tsc_source_acpi_pm;
+    }
+
+    if (!khz) {
+        khz = tsc_check_nominal(tsc_pit_khz(&tsc_error_ppm), nominal_khz);
+        tsc_source = tsc_source_pit;
+    }
+
+    //no reference to measure against, the nominal frequency is all there is
+    if (!khz && nominal_khz) {
+        khz = nominal_khz;
+        tsc_source = tsc_source_nominal;
+        tsc_error_ppm = TSC_NOMINAL_ERROR_PPM;
+    }
+
+    if (!khz) {
+        tsc_source = tsc_source_none;
+        return false;
+    }
+
+    tsc_ns_mult = (1000000ULL << TSC_SHIFT) / khz;
+    tsc_cycle_mult = (khz << TSC_SHIFT) / 1000000;
+    tsc_khz = khz;
+    printf("tsc: %lu khz (%s, error < %lu ppm, %lu us, nominal %lu khz), %s\n", khz, tsc_source_names[tsc_source], tsc_error_ppm,
+        tsc_to_ns(rdtsc() - start) / 1000, nominal_khz, tsc_reliable() ? "invariant" : "not invariant");
+
+    tsc_clocksource.name = "tsc";
+    tsc_clocksource.read = rdtsc;
+    tsc_clocksource.read_ns = clock_ns_tsc;
+    tsc_clocksource.mask = 0xFFFFFFFFFFFFFFFF;
+    tsc_clocksource.hz = khz * 1000;
+    tsc_clocksource.reliable = tsc_reliable();
+    return clocksource_register(&tsc_clocksource);
+}
+
+//true if the TSC runs at a constant rate whatever the power state of the cpu
+bool tsc_reliable() {
+    return tsc_khz && cpu_has(CPU_FEATURE_INVARIANT_TSC);
+}
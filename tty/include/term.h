@@ -3,6 +3,20 @@
 #define TERMINAL_COMMAND_LENGTH 128
 #define CLEAR_SCREEN_ON_TERMINAL_START false
 
+typedef struct {
+    const char *name;
+    void (*run)(char *args);
+    const char *description;
+} term_command_t;
+
+//benchmark run by the bench command
+typedef struct {
+    const char *name;
+    void (*run)();
+    const char *description;
+} term_bench_t;
+
 void init_terminal(void);
 void term_putc(char c);
-void term_control(uint8_t code);
\ No newline at end of file
+void term_control(uint8_t code);
+void term_execute(char *line);
\ No newline at end of file
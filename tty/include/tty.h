@@ -6,7 +6,6 @@
 #define TTY_COLOR_RED   (tty_color_t) 0xFF0000
 #define TTY_COLOR_GREEN (tty_color_t) 0x00FF00
 #define TTY_COLOR_BLUE  (tty_color_t) 0x0000FF
-#define PRINTF_MAX_BUFFER 256
 
 typedef uint32_t tty_color_t;
 
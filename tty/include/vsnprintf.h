@@ -1,6 +1,27 @@
 #pragma once
 #include <include/types.h>
 #include <include/stdargs.h>
+#include <include/ring.h>
 
-char *num_fmt(uint64_t i, uint32_t base, uint32_t padding, char pad_with, bool upper, int len);
-void vsnprintf(char *buf, uint64_t len, char *fmt, va_list arg);
\ No newline at end of file
+/*
+destination of the formatted output.
+the formatter calls write() with runs of characters as soon as they're ready (literal text straight from the format string, numbers from a
+small buffer on the stack), there is no buffer for the whole message. count is the number of characters produced, also the ones a sink drops.
+*/
+typedef struct fmt_sink {
+    void (*write)(struct fmt_sink *sink, const char *str, uint64_t len);
+    void *data;     //sink specific: the string buffer or the ring
+    uint64_t size;  //capacity of the string sink
+    uint64_t count;
+} fmt_sink_t;
+
+void fmt_sink_string(fmt_sink_t *sink, char *buf, uint64_t size);
+void fmt_sink_ring(fmt_sink_t *sink, spsc_ring_t *ring);
+void fmt_sink_null(fmt_sink_t *sink);
+void fmt_sink_console(fmt_sink_t *sink);
+uint64_t vformat(fmt_sink_t *sink, const char *fmt, va_list arg);
+uint64_t vformat_array(fmt_sink_t *sink, const char *fmt, const uint64_t *args, uint32_t count);
+uint64_t format(fmt_sink_t *sink, const char *fmt, ...);
+uint64_t vsnprintf(char *buf, uint64_t len, const char *fmt, va_list arg);
+uint64_t snprintf(char *buf, uint64_t len, const char *fmt, ...);
+void vsnprintf_bench();
@@ -8,6 +8,15 @@
 #include <include/assert.h>
 #include <include/mem.h>
 #include <tty/include/def_colors.h>
+#include <tty/include/vsnprintf.h>
+#include <include/klog.h>
+#include <int/include/irqstat.h>
+#include <int/include/irq_balance.h>
+#include <time/include/clocksource.h>
+#include <drv/crypt/include/crypt.h>
+#include <include/ring.h>
+#include <crypto/include/hash.h>
+#include <int/include/apic.h>
 
 extern keyboard_status_t ks; //defined in keyboard.c
 bool terminal_ready = false;
@@ -16,6 +25,112 @@ const char prompt_char = '#';
 bool command_ready = false;
 char *term_command;
 
+static void term_help(char *args);
+static void term_clear(char *args);
+static void term_dmesg(char *args);
+static void term_bench(char *args);
+
+static const term_command_t term_commands[] = {
+    {"help", term_help, "lists the commands"},
+    {"clear", term_clear, "clears the screen"},
+    {"dmesg", term_dmesg, "prints the kernel log records logged since the last dmesg"},
+    {"irqstat", irqstat_print, "interrupt counts, rates and handler times per vector"},
+    {"irqbalance", irq_balance_print, "interrupt load of every cpu and destination of every irq"},
+    {"clocksource", clocksource_print, "counters and timer devices, with their resolution, read cost and rating"},
+    {"bench", term_bench, "runs a benchmark, bench alone lists them"},
+    {"cryptbench", crypt_bench_command, "cipher speed and encrypting block device overhead, overwrites sectors of a drive"}
+};
+
+static const term_bench_t term_benches[] = {
+    {"mem", mem_bench, "memcpy, memset, memmove and memcmp against the old routines"},
+    {"string", string_bench, "strlen, strcmp, strncmp and strchr against the old routines"},
+    {"ring", ring_bench, "spsc and mpmc rings, single and batched"},
+    {"printf", vsnprintf_bench, "formatter against the old vsnprintf"},
+    {"hash", hash_bench, "md5, sha256 and crc32c, streaming and multi-buffer"},
+    {"apic", apic_bench, "eoi and self ipi round trip in the current lapic mode"}
+};
+
+static void term_help(char *args) {
+    for (uint32_t i = 0; i < sizeof(term_commands) / sizeof(term_command_t); i++) {
+        printf("%8s  %s\n", term_commands[i].name, term_commands[i].description);
+    }
+}
+
+static void term_clear(char *args) {
+    tty_clear();
+}
+
+static void term_dmesg(char *args) {
+    fmt_sink_t sink;
+    fmt_sink_console(&sink);
+
+    if (klog_flush(&sink) == 0) {
+        printf("no new records\n");
+    }
+
+    uint64_t dropped = klog_dropped();
+
+    if (dropped) {
+        printf("%lu records dropped since boot\n", dropped);
+    }
+}
+
+static void term_bench(char *args) {
+    char *saveptr;
+    char *name = strtok_r(args, " ", &saveptr);
+
+    for (uint32_t i = 0; name && i < sizeof(term_benches) / sizeof(term_bench_t); i++) {
+        if (strcmp(name, term_benches[i].name) == STR_EQUAL) {
+            term_benches[i].run();
+            return;
+        }
+    }
+
+    if (name) {
+        printf("%s: unknown benchmark\n", name);
+    }
+
+    for (uint32_t i = 0; i < sizeof(term_benches) / sizeof(term_bench_t); i++) {
+        printf("%8s  %s\n", term_benches[i].name, term_benches[i].description);
+    }
+}
+
+/*
+splits the command line in the command name and its arguments and runs the command.
+*/
+void term_execute(char *line) {
+    while (*line == ' ') {
+        line++;
+    }
+
+    if (*line == '\0') {
+        return;
+    }
+
+    char *args = line;
+
+    while (*args && *args != ' ') {
+        args++;
+    }
+
+    uint32_t name_length = args - line;
+
+    while (*args == ' ') {
+        args++;
+    }
+
+    for (uint32_t i = 0; i < sizeof(term_commands) / sizeof(term_command_t); i++) {
+        const term_command_t *command = &term_commands[i];
+
+        if (strlen(command->name) == name_length && strncmp(line, command->name, name_length) == STR_EQUAL) {
+            command->run(args);
+            return;
+        }
+    }
+
+    printf("%s: unknown command, type help for the list of commands\n", line);
+}
+
 void init_terminal(void) {
     if (CLEAR_SCREEN_ON_TERMINAL_START) {
         tty_clear();
@@ -31,7 +146,9 @@ void init_terminal(void) {
         set_tty_char_fg(TTY_COLOR_WHITE);
         printf("%c ", prompt_char);
         while(!command_ready);
-        printf("\n%s\n", term_command);
+        printf("\n");
+        term_command[TERMINAL_COMMAND_LENGTH - 1] = '\0';
+        term_execute(term_command);
         memclear(term_command, TERMINAL_COMMAND_LENGTH);
         command_ready = false;
     }
@@ -222,26 +222,44 @@ void tty_backspace() {
     tty_clear_cell(tty_cursor.x, tty_cursor.y);
 }
 
+static inline bool tty_printable(char c) {
+    return c >= 32 && c <= 126 || c == '\n' || c == '\t';
+}
+
 void print_color(char *str, tty_color_t fg, tty_color_t bg) {
     if (!tty_ready) {return;}
-    uint32_t len = strlen(str);
 
-    for (int i = 0; i < len; i++) {
-        char c = *(str + i);
+    for (; *str; str++) {
+        if (tty_printable(*str)) {
+            putchar(*str, fg, bg);
+        }
+    }
+}
 
-        if (c >= 32 && c <= 126 || c == '\n' || c == '\t') {
-            putchar(c, fg, bg);
+static void tty_sink_write(fmt_sink_t *sink, const char *str, uint64_t len) {
+    for (uint64_t i = 0; i < len; i++) {
+        if (tty_printable(str[i])) {
+            putchar(str[i], tty_color.foreground, tty_color.background);
         }
     }
 }
 
+//sink that prints on the terminal with the current colors
+void fmt_sink_console(fmt_sink_t *sink) {
+    sink->write = tty_sink_write;
+    sink->data = null;
+    sink->size = 0;
+    sink->count = 0;
+}
+
+//the output goes straight to the terminal, there's no intermediate buffer (and no length limit)
 void printf(const char *fmt, ...) {
     if (!tty_ready) {return;}
     va_list args;
     va_start(args, fmt);
-    char buf[PRINTF_MAX_BUFFER];
-    vsnprintf(buf, PRINTF_MAX_BUFFER, (char *) fmt, args);
-    print_color(buf, tty_color.foreground, tty_color.background);
+    fmt_sink_t sink;
+    fmt_sink_console(&sink);
+    vformat(&sink, fmt, args);
     va_end(args);
 }
 
@@ -1,67 +1,218 @@
+/*
+Formatting engine used by printf() and snprintf().
+vformat() parses the format string and streams the output into a sink (console, ring log, string buffer, see fmt_sink_t): literal text
+is written straight from the format string and every number is converted in a small buffer on the stack of the caller.
+There is no static state, so nested calls (an interrupt handler printing while printf() is running) don't corrupt each other.
+Decimal numbers are converted two digits per division using a table of the 100 pairs "00".."99", hexadecimal numbers one byte
+(two digits) per step with a table of the 256 pairs "00".."ff".
+Supported conversions: %c %d %u %o %x %X %p %P %s %%, with a width ("%8d"), zero padding ("%08x") and the l modifier ("%lu").
+*/
+
+//printf() can be called by interrupt handlers, which don't save the SIMD registers
+#pragma GCC target("general-regs-only")
+
 #include <include/types.h>
 #include <include/stdargs.h>
 #include <include/mem.h>
+#include <include/string.h>
+#include <include/ring.h>
+#include <tty/include/vsnprintf.h>
 
-#define FMT_PUT(dst, len, c) { \
-    if (!(len))                \
-        goto end;              \
-    *(dst)++ = (c);            \
-    len--;                     \
+#define IS_DIGIT(c) (c >= '0' && c <= '9')
+#define FMT_NUMBER_SIZE 24 //a 64 bit number is 22 digits in octal
+#define FMT_PAD_CHUNK 16
+
+#define FMT_DEC_ROW(d) d "0" d "1" d "2" d "3" d "4" d "5" d "6" d "7" d "8" d "9"
+#define FMT_HEX_ROW_LOWER(d) FMT_DEC_ROW(d) d "a" d "b" d "c" d "d" d "e" d "f"
+#define FMT_HEX_ROW_UPPER(d) FMT_DEC_ROW(d) d "A" d "B" d "C" d "D" d "E" d "F"
+
+typedef uint16_t fmt_u16 __attribute__((may_alias, aligned(1)));
+
+//where the arguments come from: a va_list (printf) or an array of raw 64 bit values (the kernel log records)
+typedef struct {
+    va_list *list;
+    const uint64_t *array;
+    uint32_t count, next;
+} fmt_args_t;
+
+static const char fmt_decimal_pairs[] =
+    FMT_DEC_ROW("0") FMT_DEC_ROW("1") FMT_DEC_ROW("2") FMT_DEC_ROW("3") FMT_DEC_ROW("4")
+    FMT_DEC_ROW("5") FMT_DEC_ROW("6") FMT_DEC_ROW("7") FMT_DEC_ROW("8") FMT_DEC_ROW("9");
+
+static const char fmt_hex_pairs_lower[] =
+    FMT_HEX_ROW_LOWER("0") FMT_HEX_ROW_LOWER("1") FMT_HEX_ROW_LOWER("2") FMT_HEX_ROW_LOWER("3")
+    FMT_HEX_ROW_LOWER("4") FMT_HEX_ROW_LOWER("5") FMT_HEX_ROW_LOWER("6") FMT_HEX_ROW_LOWER("7")
+    FMT_HEX_ROW_LOWER("8") FMT_HEX_ROW_LOWER("9") FMT_HEX_ROW_LOWER("a") FMT_HEX_ROW_LOWER("b")
+    FMT_HEX_ROW_LOWER("c") FMT_HEX_ROW_LOWER("d") FMT_HEX_ROW_LOWER("e") FMT_HEX_ROW_LOWER("f");
+
+static const char fmt_hex_pairs_upper[] =
+    FMT_HEX_ROW_UPPER("0") FMT_HEX_ROW_UPPER("1") FMT_HEX_ROW_UPPER("2") FMT_HEX_ROW_UPPER("3")
+    FMT_HEX_ROW_UPPER("4") FMT_HEX_ROW_UPPER("5") FMT_HEX_ROW_UPPER("6") FMT_HEX_ROW_UPPER("7")
+    FMT_HEX_ROW_UPPER("8") FMT_HEX_ROW_UPPER("9") FMT_HEX_ROW_UPPER("A") FMT_HEX_ROW_UPPER("B")
+    FMT_HEX_ROW_UPPER("C") FMT_HEX_ROW_UPPER("D") FMT_HEX_ROW_UPPER("E") FMT_HEX_ROW_UPPER("F");
+
+static void fmt_string_write(fmt_sink_t *sink, const char *str, uint64_t len) {
+    //the last byte of the buffer is kept for the terminator
+    if (sink->count + 1 >= sink->size) {
+        return;
+    }
+
+    uint64_t space = sink->size - 1 - sink->count;
+    memcpy(sink->data + sink->count, (void *) str, len < space ? len : space);
 }
 
-#define IS_DIGIT(c) (c >= '0' && c <= '9')
+static void fmt_ring_write(fmt_sink_t *sink, const char *str, uint64_t len) {
+    spsc_ring_enqueue_batch((spsc_ring_t *) sink->data, (void *) str, (uint32_t) len); //what doesn't fit is dropped
+}
+
+static void fmt_null_write(fmt_sink_t *sink, const char *str, uint64_t len) {}
+
+//the string sink stops at size - 1 characters, vsnprintf() adds the terminator
+void fmt_sink_string(fmt_sink_t *sink, char *buf, uint64_t size) {
+    sink->write = fmt_string_write;
+    sink->data = buf;
+    sink->size = size;
+    sink->count = 0;
+}
+
+//the ring must have 1 byte elements and the caller must be its only producer
+void fmt_sink_ring(fmt_sink_t *sink, spsc_ring_t *ring) {
+    sink->write = fmt_ring_write;
+    sink->data = ring;
+    sink->size = 0;
+    sink->count = 0;
+}
 
-const char *digits_upper = "0123456789ABCDEF";
-const char *digits_lower = "0123456789abcdef";
+//only counts the characters
+void fmt_sink_null(fmt_sink_t *sink) {
+    sink->write = fmt_null_write;
+    sink->data = null;
+    sink->size = 0;
+    sink->count = 0;
+}
 
-char *num_fmt(long i, uint32_t base, uint32_t padding, char pad_with, bool upper, int len) {
-    bool neg = i < 0;
+static inline void fmt_write(fmt_sink_t *sink, const char *str, uint64_t len) {
+    sink->write(sink, str, len);
+    sink->count += len;
+}
 
-    if (neg && base != 16) {
-        i *= -1;
+static void fmt_pad(fmt_sink_t *sink, char c, uint64_t n) {
+    char chunk[FMT_PAD_CHUNK];
+
+    for (uint32_t i = 0; i < FMT_PAD_CHUNK; i++) {
+        chunk[i] = c;
     }
 
-    static char buf[100];
-    memclear((void *) buf, 100);
-    char *ptr = buf + 49;
-    *ptr = '\0';
+    for (; n > FMT_PAD_CHUNK; n -= FMT_PAD_CHUNK) {
+        fmt_write(sink, chunk, FMT_PAD_CHUNK);
+    }
 
-    const char *digits = upper ? digits_upper : digits_lower;
+    fmt_write(sink, chunk, n);
+}
 
-    do {
-        *--ptr = digits[(uint64_t) i % base];
-        if (padding)
-            padding--;
-        if (len > 0)
+//writes len characters right aligned in a field of width characters, with zero padding the sign stays in front of the zeros
+static void fmt_field(fmt_sink_t *sink, const char *str, uint64_t len, uint32_t width, char pad_with) {
+    if (len < width) {
+        if (pad_with == '0' && *str == '-') {
+            fmt_write(sink, str, 1);
+            str++;
             len--;
-    } while ((i = (uint64_t) i / base) != 0 && (len == -1 || len));
+            width--;
+        }
+
+        fmt_pad(sink, pad_with, width - len);
+    }
 
-    while (padding) {
-        *--ptr = pad_with;
-        padding--;
+    fmt_write(sink, str, len);
+}
+
+//the conversions write the digits backwards, ending at end, and return the first one
+static char *fmt_decimal(char *end, uint64_t value) {
+    char *ptr = end;
+
+    while (value >= 100) {
+        uint64_t pair = value % 100;
+        value /= 100;
+        ptr -= 2;
+        *(fmt_u16 *) ptr = *(fmt_u16 *)(fmt_decimal_pairs + pair * 2);
+    }
+
+    if (value >= 10) {
+        ptr -= 2;
+        *(fmt_u16 *) ptr = *(fmt_u16 *)(fmt_decimal_pairs + value * 2);
+    } else {
+        *--ptr = '0' + value;
+    }
+
+    return ptr;
+}
+
+static char *fmt_hex(char *end, uint64_t value, bool upper) {
+    const char *pairs = upper ? fmt_hex_pairs_upper : fmt_hex_pairs_lower;
+    char *ptr = end;
+
+    do {
+        ptr -= 2;
+        *(fmt_u16 *) ptr = *(fmt_u16 *)(pairs + (value & 0xFF) * 2);
+        value >>= 8;
+    } while (value);
+
+    //the highest byte can have a leading zero
+    if (*ptr == '0' && ptr + 1 < end) {
+        ptr++;
     }
 
-    if (neg && base != 16)
-        *--ptr = '-';
+    return ptr;
+}
+
+static char *fmt_octal(char *end, uint64_t value) {
+    char *ptr = end;
+
+    do {
+        *--ptr = '0' + (value & 7);
+        value >>= 3;
+    } while (value);
 
     return ptr;
 }
 
-void vsnprintf(char *buf, uint64_t len, char *fmt, va_list arg) {
-    uint64_t i;
-    char *s;
+//returns the next argument, the 32 bit ones are zero extended
+static uint64_t fmt_arg(fmt_args_t *args, bool wide) {
+    if (args->list) {
+        return wide ? va_arg(*args->list, uint64_t) : va_arg(*args->list, uint32_t);
+    }
+
+    if (args->next == args->count) {
+        return 0; //missing argument
+    }
 
-    while (*fmt && len) {
-        if (*fmt != '%') {
-            *buf++ = *fmt;
+    uint64_t value = args->array[args->next++];
+    return wide ? value : (uint32_t) value;
+}
+
+static uint64_t fmt_format(fmt_sink_t *sink, const char *fmt, fmt_args_t *args) {
+    uint64_t start = sink->count;
+
+    while (*fmt) {
+        //literal text up to the next conversion, written in one go
+        const char *run = fmt;
+
+        while (*fmt && *fmt != '%') {
             fmt++;
-            continue;
+        }
+
+        if (fmt != run) {
+            fmt_write(sink, run, fmt - run);
+        }
+
+        if (!*fmt) {
+            break;
         }
 
         fmt++;
-        int padding = 0;
+        uint32_t width = 0;
         char pad_with = ' ';
-        bool wide = 0, upper = 0;
+        bool wide = false;
 
         if (*fmt == '0') {
             pad_with = '0';
@@ -69,104 +220,92 @@ void vsnprintf(char *buf, uint64_t len, char *fmt, va_list arg) {
         }
 
         while (IS_DIGIT(*fmt)) {
-            padding *= 10;
-            padding += *fmt++ - '0';
+            width *= 10;
+            width += *fmt++ - '0';
         }
 
         while (*fmt == 'l') {
-            wide = 1;
+            wide = true;
             fmt++;
         }
 
-        upper = *fmt == 'X' || *fmt == 'P';
+        char number[FMT_NUMBER_SIZE];
+        char *end = number + FMT_NUMBER_SIZE;
+        char *digits;
 
         switch (*fmt) {
             case 'c': {
-                i = va_arg(arg, int);
-                FMT_PUT(buf, len, i)
+                number[0] = (char) fmt_arg(args, false);
+                fmt_field(sink, number, 1, width, ' ');
                 break;
             }
 
             case 'd': {
-                if (wide)
-                    i = va_arg(arg, long int);
-                else
-                    i = va_arg(arg, int);
-
-                char *c = num_fmt(i, 10, padding, pad_with, false, -1);
-                while (*c) {
-                    FMT_PUT(buf, len, *c);
-                    c++;
+                uint64_t raw = fmt_arg(args, wide);
+                long value = wide ? (long) raw : (int)(uint32_t) raw;
+                digits = fmt_decimal(end, value < 0 ? -(uint64_t) value : (uint64_t) value);
+
+                if (value < 0) {
+                    *--digits = '-';
                 }
+
+                fmt_field(sink, digits, end - digits, width, pad_with);
                 break;
             }
 
             case 'u': {
-                if (wide)
-                    i = va_arg(arg, long int);
-                else
-                    i = va_arg(arg, int);
-
-                char *c = num_fmt(i, 10, padding, pad_with, false, -1);
-                while (*c) {
-                    FMT_PUT(buf, len, *c);
-                    c++;
-                }
+                uint64_t value = fmt_arg(args, wide);
+                digits = fmt_decimal(end, value);
+                fmt_field(sink, digits, end - digits, width, pad_with);
                 break;
             }
 
             case 'o': {
-                if (wide)
-                    i = va_arg(arg, long int);
-                else
-                    i = va_arg(arg, int);
-
-                char *c = num_fmt(i, 8, padding, pad_with, false, -1);
-                while (*c) {
-                    FMT_PUT(buf, len, *c);
-                    c++;
-                }
+                uint64_t value = fmt_arg(args, wide);
+                digits = fmt_octal(end, value);
+                fmt_field(sink, digits, end - digits, width, pad_with);
                 break;
             }
 
             case 'X':
             case 'x': {
-                if (wide)
-                    i = va_arg(arg, long int);
-                else
-                    i = va_arg(arg, int);
-
-                char *c = num_fmt(i, 16, padding, pad_with, upper, wide ? 16 : 8);
-                while (*c) {
-                    FMT_PUT(buf, len, *c);
-                    c++;
-                }
+                uint64_t value = fmt_arg(args, wide);
+                digits = fmt_hex(end, value, *fmt == 'X');
+                fmt_field(sink, digits, end - digits, width, pad_with);
                 break;
             }
 
             case 'P':
             case 'p': {
-                i = (uint64_t)(va_arg(arg, void *));
-
-                char *c = num_fmt(i, 16, padding, pad_with, upper, 16);
-                while (*c) {
-                    FMT_PUT(buf, len, *c);
-                    c++;
-                }
+                uint64_t value = fmt_arg(args, true);
+                digits = fmt_hex(end, value, *fmt == 'P');
+                fmt_field(sink, digits, end - digits, width, pad_with);
                 break;
             }
 
             case 's': {
-                s = va_arg(arg, char *);
-                while (*s) {
-                    FMT_PUT(buf, len, *s);
-                    s++;
+                const char *str = (const char *) fmt_arg(args, true);
+
+                if (!str) {
+                    str = "(null)";
                 }
+
+                fmt_field(sink, str, strlen(str), width, ' ');
                 break;
             }
 
             case '%': {
-                FMT_PUT(buf, len, '%');
+                fmt_write(sink, "%", 1);
+                break;
+            }
+
+            case '\0': {
+                return sink->count - start; //the format ends with a lone '%'
+            }
+
+            default: {
+                //unknown conversion, printed as it is
+                fmt_write(sink, fmt - 1, 2);
                 break;
             }
         }
@@ -174,12 +313,66 @@ void vsnprintf(char *buf, uint64_t len, char *fmt, va_list arg) {
         fmt++;
     }
 
-    end:
-    if (!len) {
-        *buf++ = '.';
-        *buf++ = '.';
-        *buf++ = '.';
+    return sink->count - start;
+}
+
+uint64_t vformat(fmt_sink_t *sink, const char *fmt, va_list arg) {
+    //a va_list parameter can't be passed by address, its copy can
+    va_list list;
+    va_copy(list, arg);
+    fmt_args_t args = {&list, null, 0, 0};
+    uint64_t count = fmt_format(sink, fmt, &args);
+    va_end(list);
+    return count;
+}
+
+//same as vformat() with the arguments already collected in an array (see klog()), missing arguments are printed as 0
+uint64_t vformat_array(fmt_sink_t *sink, const char *fmt, const uint64_t *args, uint32_t count) {
+    fmt_args_t array = {null, args, count, 0};
+    return fmt_format(sink, fmt, &array);
+}
+
+uint64_t format(fmt_sink_t *sink, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    uint64_t count = vformat(sink, fmt, args);
+    va_end(args);
+    return count;
+}
+
+/*
+Formats into buf, which is always terminated if len is not 0.
+Returns the length of the whole output (like the C library), if it doesn't fit it's truncated and the last three characters become "...".
+*/
+uint64_t vsnprintf(char *buf, uint64_t len, const char *fmt, va_list arg) {
+    fmt_sink_t sink;
+
+    if (len == 0) {
+        fmt_sink_null(&sink);
+        return vformat(&sink, fmt, arg);
     }
 
-    *buf++ = '\0';
+    fmt_sink_string(&sink, buf, len);
+    uint64_t count = vformat(&sink, fmt, arg);
+
+    if (count < len) {
+        buf[count] = '\0';
+        return count;
+    }
+
+    buf[len - 1] = '\0';
+
+    for (uint64_t i = len > 4 ? len - 4 : 0; i < len - 1; i++) {
+        buf[i] = '.';
+    }
+
+    return count;
+}
+
+uint64_t snprintf(char *buf, uint64_t len, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    uint64_t count = vsnprintf(buf, len, fmt, args);
+    va_end(args);
+    return count;
 }
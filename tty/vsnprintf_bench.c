@@ -0,0 +1,173 @@
+/*
+Benchmark of the formatting engine against the path printf() used before: vsnprintf() into a PRINTF_MAX_BUFFER stack buffer with
+num_fmt() (static buffer cleared for every number, one division per digit), then strlen() of the result before printing.
+For every format line it prints the average number of cycles of the old path, of the new vsnprintf() and of vformat() into a sink
+that only counts the characters (the cost of the formatting alone, what printf() pays before the terminal).
+*/
+
+#include <include/types.h>
+#include <include/stdargs.h>
+#include <include/mem.h>
+#include <include/string.h>
+#include <include/low_level.h>
+#include <tty/include/tty.h>
+#include <tty/include/vsnprintf.h>
+
+#define VSNPRINTF_BENCH_ITERATIONS 20000
+#define VSNPRINTF_BENCH_BUFFER 256
+#define VSNPRINTF_BENCH_LEGACY __attribute__((noinline))
+
+typedef enum {
+    bench_legacy,
+    bench_vsnprintf,
+    bench_null_sink
+} vsnprintf_bench_op_t;
+
+volatile uint64_t vsnprintf_bench_sink; //keeps the compiler from dropping the calls whose result is not used
+
+VSNPRINTF_BENCH_LEGACY
+static char *legacy_num_fmt(long i, uint32_t base, uint32_t padding, char pad_with, bool upper, int len) {
+    static const char *digits_upper = "0123456789ABCDEF";
+    static const char *digits_lower = "0123456789abcdef";
+    static char buf[100];
+    bool neg = i < 0;
+
+    if (neg && base != 16) {
+        i *= -1;
+    }
+
+    memclear((void *) buf, 100);
+    char *ptr = buf + 49;
+    *ptr = '\0';
+    const char *digits = upper ? digits_upper : digits_lower;
+
+    do {
+        *--ptr = digits[(uint64_t) i % base];
+        if (padding)
+            padding--;
+        if (len > 0)
+            len--;
+    } while ((i = (uint64_t) i / base) != 0 && (len == -1 || len));
+
+    while (padding) {
+        *--ptr = pad_with;
+        padding--;
+    }
+
+    if (neg && base != 16)
+        *--ptr = '-';
+
+    return ptr;
+}
+
+//the old vsnprintf() for the conversions used by the benchmark, one bounds check per character
+VSNPRINTF_BENCH_LEGACY
+static void legacy_vsnprintf(char *buf, uint64_t len, const char *fmt, va_list arg) {
+    while (*fmt && len > 1) {
+        if (*fmt != '%') {
+            *buf++ = *fmt++;
+            len--;
+            continue;
+        }
+
+        fmt++;
+        uint32_t padding = 0;
+        char pad_with = ' ';
+        bool wide = false;
+        char *c = null;
+
+        if (*fmt == '0') {
+            pad_with = '0';
+            fmt++;
+        }
+
+        while (*fmt >= '0' && *fmt <= '9') {
+            padding = padding * 10 + *fmt++ - '0';
+        }
+
+        while (*fmt == 'l') {
+            wide = true;
+            fmt++;
+        }
+
+        switch (*fmt) {
+            case 'd':
+            case 'u':
+                c = legacy_num_fmt(wide ? va_arg(arg, long) : va_arg(arg, int), 10, padding, pad_with, false, -1);
+                break;
+            case 'x':
+            case 'X':
+                c = legacy_num_fmt(wide ? va_arg(arg, long) : va_arg(arg, int), 16, padding, pad_with, *fmt == 'X', wide ? 16 : 8);
+                break;
+            case 'p':
+                c = legacy_num_fmt((long) va_arg(arg, void *), 16, padding, pad_with, false, 16);
+                break;
+            case 's':
+                c = va_arg(arg, char *);
+                break;
+        }
+
+        for (; c && *c && len > 1; c++, len--) {
+            *buf++ = *c;
+        }
+
+        fmt++;
+    }
+
+    *buf = '\0';
+}
+
+static uint64_t vsnprintf_bench_call(vsnprintf_bench_op_t op, const char *fmt, ...) {
+    char buf[VSNPRINTF_BENCH_BUFFER];
+    fmt_sink_t sink;
+    va_list args;
+    va_start(args, fmt);
+    uint64_t start = rdtsc();
+
+    switch (op) {
+        case bench_legacy:
+            legacy_vsnprintf(buf, VSNPRINTF_BENCH_BUFFER, fmt, args);
+            vsnprintf_bench_sink += strlen(buf); //printf() measured the result before printing it
+            break;
+        case bench_vsnprintf:
+            vsnprintf_bench_sink += vsnprintf(buf, VSNPRINTF_BENCH_BUFFER, fmt, args);
+            break;
+        case bench_null_sink:
+            fmt_sink_null(&sink);
+            vsnprintf_bench_sink += vformat(&sink, fmt, args);
+            break;
+    }
+
+    uint64_t cycles = rdtsc() - start;
+    va_end(args);
+    return cycles;
+}
+
+//runs the same lines the kernel prints at boot and in the benchmarks
+static uint64_t vsnprintf_bench_run(vsnprintf_bench_op_t op, uint32_t line) {
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < VSNPRINTF_BENCH_ITERATIONS; i++) {
+        switch (line) {
+            case 0: total += vsnprintf_bench_call(op, "%s family 0x%X model 0x%X stepping %d\n", "GenuineIntel", 6, 0x8C, 1); break;
+            case 1: total += vsnprintf_bench_call(op, "L%d %s: %d KiB, %d ways, %d byte lines\n", 2, "unified", 1280, 20, 64); break;
+            case 2: total += vsnprintf_bench_call(op, "%6lu    %8lu %6lu %6lu\n", 4096L + i, 81234L, 1234L, 987654321L); break;
+            case 3: total += vsnprintf_bench_call(op, "page fault at %p, error %x\n", (void *) 0xFFFF800012345678, 0x7); break;
+            default: total += vsnprintf_bench_call(op, "%lu %lu %lu %lu\n", 18446744073709551615UL, 1000000007UL, 42UL, (uint64_t) i); break;
+        }
+    }
+
+    return total / VSNPRINTF_BENCH_ITERATIONS;
+}
+
+void vsnprintf_bench() {
+    static const char *lines[] = {"cpu info", "cache info", "bench table", "pointer/hex", "64 bit decimals"};
+    printf("line                 old     new    null sink\n");
+
+    for (uint32_t i = 0; i < sizeof(lines) / sizeof(char *); i++) {
+        uint64_t legacy = vsnprintf_bench_run(bench_legacy, i);
+        uint64_t fresh = vsnprintf_bench_run(bench_vsnprintf, i);
+        uint64_t null_sink = vsnprintf_bench_run(bench_null_sink, i);
+        printf("%16s %7lu %7lu %7lu\n", lines[i], legacy, fresh, null_sink);
+    }
+}